@@ -84,6 +84,9 @@ public:
         mWrapper->getUri = [](void *handle, char *uriString, size_t bufferSize) -> bool {
             return ((DataSource*)handle)->getUri(uriString, bufferSize);
         };
+        mWrapper->getView = [](void *handle, off64_t offset, size_t size) -> const void * {
+            return ((DataSource*)handle)->getView(offset, size);
+        };
         return mWrapper;
     }
 
@@ -35,6 +35,9 @@ struct CDataSource {
     uint32_t (*flags)(void *handle );
     bool (*getUri)(void *handle, char *uriString, size_t bufferSize);
     void *handle;
+    // Only valid if flags() includes DataSourceBase::kCanProvideViews, as sources wrapped
+    // by older platforms do not have it.
+    const void *(*getView)(void *handle, off64_t offset, size_t size);
 };
 
 enum CMediaTrackReadOptions : uint32_t {
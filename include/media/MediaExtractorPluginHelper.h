@@ -19,8 +19,10 @@
 #define MEDIA_EXTRACTOR_PLUGIN_HELPER_H_
 
 #include <arpa/inet.h>
+#include <limits.h>
 #include <stdio.h>
 #include <map>
+#include <memory>
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
@@ -324,6 +326,43 @@ public:
         return mSource->flags(mSource->handle);
     }
 
+    // same as DataSourceBase::kCanProvideViews
+    static constexpr uint32_t kCanProvideViews = 32;
+
+    // Returns a pointer to size bytes of the source at offset, which stays valid for the
+    // lifetime of the source, or nullptr if the source cannot provide them without copying,
+    // in which case readAt() must be used.
+    virtual const uint8_t *getView(off64_t offset, size_t size) {
+        if (!(mSource->flags(mSource->handle) & kCanProvideViews)) {
+            return nullptr;
+        }
+        return (const uint8_t *)mSource->getView(mSource->handle, offset, size);
+    }
+
+    // Points *data to size bytes of the source at offset, from a view of the source if it
+    // can provide one, or read into *buffer otherwise. Returns NO_MEMORY if the buffer could
+    // not be allocated, and NOT_ENOUGH_DATA if the bytes could not be read.
+    status_t getViewOrRead(off64_t offset, uint64_t size,
+            const uint8_t **data, std::unique_ptr<uint8_t[]> *buffer) {
+        *data = nullptr;
+        if (size > (uint64_t)SSIZE_MAX) {
+            return NO_MEMORY;
+        }
+        *data = getView(offset, size);
+        if (*data != nullptr) {
+            return OK;
+        }
+        buffer->reset(new (std::nothrow) uint8_t[size]);
+        if (*buffer == nullptr) {
+            return NO_MEMORY;
+        }
+        if (readAt(offset, buffer->get(), size) != (ssize_t)size) {
+            return NOT_ENOUGH_DATA;
+        }
+        *data = buffer->get();
+        return OK;
+    }
+
     // Convenience methods:
     bool getUInt16(off64_t offset, uint16_t *x) {
         *x = 0;
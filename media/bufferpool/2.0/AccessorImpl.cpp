@@ -22,6 +22,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <utils/Log.h>
+#include <algorithm>
 #include <thread>
 #include "AccessorImpl.h"
 #include "Connection.h"
@@ -55,6 +56,7 @@ struct InternalBuffer {
     const size_t mAllocSize;
     const std::vector<uint8_t> mConfig;
     bool mInvalidated;
+    bool mInFreeList;
 
     InternalBuffer(
             BufferId id,
@@ -63,7 +65,7 @@ struct InternalBuffer {
             const std::vector<uint8_t> &allocConfig)
             : mId(id), mOwnerCount(0), mTransactionCount(0),
             mAllocation(alloc), mAllocSize(allocSize), mConfig(allocConfig),
-            mInvalidated(false) {}
+            mInvalidated(false), mInFreeList(false) {}
 
     const native_handle_t *handle() {
         return mAllocation->handle();
@@ -100,44 +102,41 @@ struct TransactionStatus {
     }
 };
 
-// Helper template methods for handling map of set.
-template<class T, class U>
-bool insert(std::map<T, std::set<U>> *mapOfSet, T key, U value) {
-    auto iter = mapOfSet->find(key);
-    if (iter == mapOfSet->end()) {
-        std::set<U> valueSet{value};
-        mapOfSet->insert(std::make_pair(key, valueSet));
-        return true;
-    } else if (iter->second.find(value)  == iter->second.end()) {
-        iter->second.insert(value);
+// Helper template methods for handling unsorted vectors, which are used as
+// small sets.
+template<class T>
+bool insert(std::vector<T> *values, T value) {
+    if (std::find(values->begin(), values->end(), value) != values->end()) {
+        return false;
+    }
+    values->push_back(value);
+    return true;
+}
+
+template<class T>
+bool erase(std::vector<T> *values, T value) {
+    auto valueIter = std::find(values->begin(), values->end(), value);
+    if (valueIter != values->end()) {
+        // The order does not matter. An emptied vector is kept with its
+        // storage for the next insertion.
+        *valueIter = values->back();
+        values->pop_back();
         return true;
     }
     return false;
 }
 
-template<class T, class U>
-bool erase(std::map<T, std::set<U>> *mapOfSet, T key, U value) {
-    bool ret = false;
-    auto iter = mapOfSet->find(key);
-    if (iter != mapOfSet->end()) {
-        if (iter->second.erase(value) > 0) {
-            ret = true;
-        }
-        if (iter->second.size() == 0) {
-            mapOfSet->erase(iter);
-        }
-    }
-    return ret;
+template<class T>
+bool contains(const std::vector<T> &values, T value) {
+    return std::find(values.begin(), values.end(), value) != values.end();
 }
 
-template<class T, class U>
-bool contains(std::map<T, std::set<U>> *mapOfSet, T key, U value) {
-    auto iter = mapOfSet->find(key);
-    if (iter != mapOfSet->end()) {
-        auto setIter = iter->second.find(value);
-        return setIter != iter->second.end();
+// Adds a buffer to the free buffers unless it is already there.
+static void addFreeBuffer(std::vector<BufferId> *freeBuffers, InternalBuffer *buffer) {
+    if (!buffer->mInFreeList) {
+        buffer->mInFreeList = true;
+        freeBuffers->push_back(buffer->mId);
     }
-    return false;
 }
 
 #ifdef __ANDROID_VNDK__
@@ -176,7 +175,13 @@ ResultStatus Accessor::Impl::connect(
                 *connection = newConnection;
                 *pConnectionId = id;
                 *pMsgId = mBufferPool.mInvalidation.mInvalidationId;
-                mBufferPool.mConnectionIds.insert(id);
+                {
+                    std::lock_guard<std::mutex> connectionsLock(
+                            mBufferPool.mConnectionsMutex);
+                    mBufferPool.mConnections.emplace(
+                            id, std::make_shared<BufferPool::ConnectionState>(
+                                    mBufferPool.mObserver.getQueue(id)));
+                }
                 mBufferPool.mInvalidationChannel.getDesc(invDescPtr);
                 mBufferPool.mInvalidation.onConnect(id, observer);
                 if (sSeqId == kSeqIdMax) {
@@ -211,6 +216,7 @@ ResultStatus Accessor::Impl::close(ConnectionId connectionId) {
 ResultStatus Accessor::Impl::allocate(
         ConnectionId connectionId, const std::vector<uint8_t>& params,
         BufferId *bufferId, const native_handle_t** handle) {
+    mBufferPool.drainStatusMessages(connectionId);
     std::unique_lock<std::mutex> lock(mBufferPool.mMutex);
     mBufferPool.processStatusMessages();
     ResultStatus status = ResultStatus::OK;
@@ -228,7 +234,10 @@ ResultStatus Accessor::Impl::allocate(
     }
     if (status == ResultStatus::OK) {
         // TODO: handle ownBuffer failure
-        mBufferPool.handleOwnBuffer(connectionId, *bufferId);
+        auto connection = mBufferPool.mConnections.find(connectionId);
+        if (connection != mBufferPool.mConnections.end()) {
+            mBufferPool.handleOwnBuffer(*connection->second, *bufferId);
+        }
     }
     mBufferPool.cleanUp();
     scheduleEvictIfNeeded();
@@ -238,12 +247,14 @@ ResultStatus Accessor::Impl::allocate(
 ResultStatus Accessor::Impl::fetch(
         ConnectionId connectionId, TransactionId transactionId,
         BufferId bufferId, const native_handle_t** handle) {
+    mBufferPool.drainStatusMessages(connectionId);
     std::lock_guard<std::mutex> lock(mBufferPool.mMutex);
     mBufferPool.processStatusMessages();
     auto found = mBufferPool.mTransactions.find(transactionId);
+    auto connection = mBufferPool.mConnections.find(connectionId);
     if (found != mBufferPool.mTransactions.end() &&
-            contains(&mBufferPool.mPendingTransactions,
-                     connectionId, transactionId)) {
+            connection != mBufferPool.mConnections.end() &&
+            contains(connection->second->mPendingTransactions, transactionId)) {
         if (found->second->mSenderValidated &&
                 found->second->mStatus == BufferStatus::TRANSFER_FROM &&
                 found->second->mBufferId == bufferId) {
@@ -440,20 +451,19 @@ void Accessor::Impl::BufferPool::Invalidation::onHandleAck(
 }
 
 bool Accessor::Impl::BufferPool::handleOwnBuffer(
-        ConnectionId connectionId, BufferId bufferId) {
+        ConnectionState &connection, BufferId bufferId) {
 
-    bool added = insert(&mUsingBuffers, connectionId, bufferId);
+    bool added = insert(&connection.mUsingBuffers, bufferId);
     if (added) {
         auto iter = mBuffers.find(bufferId);
         iter->second->mOwnerCount++;
     }
-    insert(&mUsingConnections, bufferId, connectionId);
     return added;
 }
 
 bool Accessor::Impl::BufferPool::handleReleaseBuffer(
-        ConnectionId connectionId, BufferId bufferId) {
-    bool deleted = erase(&mUsingBuffers, connectionId, bufferId);
+        ConnectionState &connection, BufferId bufferId) {
+    bool deleted = erase(&connection.mUsingBuffers, bufferId);
     if (deleted) {
         auto iter = mBuffers.find(bufferId);
         iter->second->mOwnerCount--;
@@ -461,7 +471,7 @@ bool Accessor::Impl::BufferPool::handleReleaseBuffer(
                 iter->second->mTransactionCount == 0) {
             if (!iter->second->mInvalidated) {
                 mStats.onBufferUnused(iter->second->mAllocSize);
-                mFreeBuffers.insert(bufferId);
+                addFreeBuffer(&mFreeBuffers, iter->second.get());
             } else {
                 mStats.onBufferUnused(iter->second->mAllocSize);
                 mStats.onBufferEvicted(iter->second->mAllocSize);
@@ -470,12 +480,12 @@ bool Accessor::Impl::BufferPool::handleReleaseBuffer(
             }
         }
     }
-    erase(&mUsingConnections, bufferId, connectionId);
     ALOGV("release buffer %u : %d", bufferId, deleted);
     return deleted;
 }
 
-bool Accessor::Impl::BufferPool::handleTransferTo(const BufferStatusMessage &message) {
+bool Accessor::Impl::BufferPool::handleTransferTo(
+        ConnectionState &connection, const BufferStatusMessage &message) {
     auto completed = mCompletedTransactions.find(
             message.transactionId);
     if (completed != mCompletedTransactions.end()) {
@@ -486,7 +496,7 @@ bool Accessor::Impl::BufferPool::handleTransferTo(const BufferStatusMessage &mes
     // the buffer should exist and be owned.
     auto bufferIter = mBuffers.find(message.bufferId);
     if (bufferIter == mBuffers.end() ||
-            !contains(&mUsingBuffers, message.connectionId, message.bufferId)) {
+            !contains(connection.mUsingBuffers, message.bufferId)) {
         return false;
     }
     auto found = mTransactions.find(message.transactionId);
@@ -496,7 +506,8 @@ bool Accessor::Impl::BufferPool::handleTransferTo(const BufferStatusMessage &mes
         found->second->mSenderValidated = true;
         return true;
     }
-    if (mConnectionIds.find(message.targetConnectionId) == mConnectionIds.end()) {
+    auto target = mConnections.find(message.targetConnectionId);
+    if (target == mConnections.end()) {
         // N.B: it could be fake or receive connection already closed.
         ALOGD("bufferpool2 %p receiver connection %lld is no longer valid",
               this, (long long)message.targetConnectionId);
@@ -506,13 +517,13 @@ bool Accessor::Impl::BufferPool::handleTransferTo(const BufferStatusMessage &mes
     mTransactions.insert(std::make_pair(
             message.transactionId,
             std::make_unique<TransactionStatus>(message, mTimestampUs)));
-    insert(&mPendingTransactions, message.targetConnectionId,
-           message.transactionId);
+    insert(&target->second->mPendingTransactions, message.transactionId);
     bufferIter->second->mTransactionCount++;
     return true;
 }
 
-bool Accessor::Impl::BufferPool::handleTransferFrom(const BufferStatusMessage &message) {
+bool Accessor::Impl::BufferPool::handleTransferFrom(
+        ConnectionState &connection, const BufferStatusMessage &message) {
     auto found = mTransactions.find(message.transactionId);
     if (found == mTransactions.end()) {
         // TODO: is it feasible to check ownership here?
@@ -520,8 +531,7 @@ bool Accessor::Impl::BufferPool::handleTransferFrom(const BufferStatusMessage &m
         mTransactions.insert(std::make_pair(
                 message.transactionId,
                 std::make_unique<TransactionStatus>(message, mTimestampUs)));
-        insert(&mPendingTransactions, message.connectionId,
-               message.transactionId);
+        insert(&connection.mPendingTransactions, message.transactionId);
         auto bufferIter = mBuffers.find(message.bufferId);
         bufferIter->second->mTransactionCount++;
     } else {
@@ -532,25 +542,25 @@ bool Accessor::Impl::BufferPool::handleTransferFrom(const BufferStatusMessage &m
     return true;
 }
 
-bool Accessor::Impl::BufferPool::handleTransferResult(const BufferStatusMessage &message) {
+bool Accessor::Impl::BufferPool::handleTransferResult(
+        ConnectionState &connection, const BufferStatusMessage &message) {
     auto found = mTransactions.find(message.transactionId);
     if (found != mTransactions.end()) {
-        bool deleted = erase(&mPendingTransactions, message.connectionId,
-                             message.transactionId);
+        bool deleted = erase(&connection.mPendingTransactions, message.transactionId);
         if (deleted) {
             if (!found->second->mSenderValidated) {
                 mCompletedTransactions.insert(message.transactionId);
             }
             auto bufferIter = mBuffers.find(message.bufferId);
             if (message.newStatus == BufferStatus::TRANSFER_OK) {
-                handleOwnBuffer(message.connectionId, message.bufferId);
+                handleOwnBuffer(connection, message.bufferId);
             }
             bufferIter->second->mTransactionCount--;
             if (bufferIter->second->mOwnerCount == 0
                 && bufferIter->second->mTransactionCount == 0) {
                 if (!bufferIter->second->mInvalidated) {
                     mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                    mFreeBuffers.insert(message.bufferId);
+                    addFreeBuffer(&mFreeBuffers, bufferIter->second.get());
                 } else {
                     mStats.onBufferUnused(bufferIter->second->mAllocSize);
                     mStats.onBufferEvicted(bufferIter->second->mAllocSize);
@@ -569,25 +579,64 @@ bool Accessor::Impl::BufferPool::handleTransferResult(const BufferStatusMessage
     return false;
 }
 
+void Accessor::Impl::BufferPool::ConnectionState::drainStatusMessages(
+        ConnectionId connectionId) {
+    if (mQueue && mQueue->availableToRead() > 0) {
+        mHasMessages = true;
+        BufferStatusObserver::getBufferStatusChanges(connectionId, mQueue, mMessages);
+    }
+}
+
+void Accessor::Impl::BufferPool::drainStatusMessages(ConnectionId connectionId) {
+    std::shared_ptr<ConnectionState> connection;
+    {
+        std::lock_guard<std::mutex> lock(mConnectionsMutex);
+        auto it = mConnections.find(connectionId);
+        if (it == mConnections.end() || it->second->mQueue->availableToRead() == 0) {
+            return;
+        }
+        connection = it->second;
+    }
+    std::lock_guard<std::mutex> lock(connection->mMutex);
+    connection->drainStatusMessages(connectionId);
+}
+
 void Accessor::Impl::BufferPool::processStatusMessages() {
-    std::vector<BufferStatusMessage> messages;
-    mObserver.getBufferStatusChanges(messages);
     mTimestampUs = getTimestampNow();
-    for (BufferStatusMessage& message: messages) {
+    for (auto &it : mConnections) {
+        ConnectionState &connection = *it.second;
+        // The FMQ is checked first. A concurrent drain sets mHasMessages before it empties
+        // the FMQ, so the messages are found in either of them.
+        if (connection.mQueue->availableToRead() == 0 && !connection.mHasMessages) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(connection.mMutex);
+            connection.drainStatusMessages(it.first);
+            // Leaves the emptied storage of the last batch to the connection.
+            std::swap(mMessages, connection.mMessages);
+            connection.mHasMessages = false;
+        }
+        processStatusMessages(connection);
+        mMessages.clear();
+    }
+}
+
+void Accessor::Impl::BufferPool::processStatusMessages(ConnectionState &connection) {
+    for (BufferStatusMessage& message: mMessages) {
         bool ret = false;
         switch (message.newStatus) {
             case BufferStatus::NOT_USED:
-                ret = handleReleaseBuffer(
-                        message.connectionId, message.bufferId);
+                ret = handleReleaseBuffer(connection, message.bufferId);
                 break;
             case BufferStatus::USED:
                 // not happening
                 break;
             case BufferStatus::TRANSFER_TO:
-                ret = handleTransferTo(message);
+                ret = handleTransferTo(connection, message);
                 break;
             case BufferStatus::TRANSFER_FROM:
-                ret = handleTransferFrom(message);
+                ret = handleTransferFrom(connection, message);
                 break;
             case BufferStatus::TRANSFER_TIMEOUT:
                 // TODO
@@ -600,7 +649,7 @@ void Accessor::Impl::BufferPool::processStatusMessages() {
                 break;
             case BufferStatus::TRANSFER_OK:
             case BufferStatus::TRANSFER_ERROR:
-                ret = handleTransferResult(message);
+                ret = handleTransferResult(connection, message);
                 break;
             case BufferStatus::INVALIDATION_ACK:
                 mInvalidation.onAck(message.connectionId, message.bufferId);
@@ -612,66 +661,69 @@ void Accessor::Impl::BufferPool::processStatusMessages() {
                   message.newStatus, (long long)message.connectionId);
         }
     }
-    messages.clear();
 }
 
 bool Accessor::Impl::BufferPool::handleClose(ConnectionId connectionId) {
+    auto found = mConnections.find(connectionId);
+    if (found == mConnections.end()) {
+        return false;
+    }
+    ConnectionState &connection = *found->second;
+
     // Cleaning buffers
-    auto buffers = mUsingBuffers.find(connectionId);
-    if (buffers != mUsingBuffers.end()) {
-        for (const BufferId& bufferId : buffers->second) {
-            bool deleted = erase(&mUsingConnections, bufferId, connectionId);
-            if (deleted) {
-                auto bufferIter = mBuffers.find(bufferId);
-                bufferIter->second->mOwnerCount--;
-                if (bufferIter->second->mOwnerCount == 0 &&
-                        bufferIter->second->mTransactionCount == 0) {
-                    // TODO: handle freebuffer insert fail
-                    if (!bufferIter->second->mInvalidated) {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mFreeBuffers.insert(bufferId);
-                    } else {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mStats.onBufferEvicted(bufferIter->second->mAllocSize);
-                        mBuffers.erase(bufferIter);
-                        mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
-                    }
-                }
+    for (const BufferId& bufferId : connection.mUsingBuffers) {
+        auto bufferIter = mBuffers.find(bufferId);
+        bufferIter->second->mOwnerCount--;
+        if (bufferIter->second->mOwnerCount == 0 &&
+                bufferIter->second->mTransactionCount == 0) {
+            // TODO: handle freebuffer insert fail
+            if (!bufferIter->second->mInvalidated) {
+                mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                addFreeBuffer(&mFreeBuffers, bufferIter->second.get());
+            } else {
+                mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                mStats.onBufferEvicted(bufferIter->second->mAllocSize);
+                mBuffers.erase(bufferIter);
+                mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
             }
         }
-        mUsingBuffers.erase(buffers);
     }
 
     // Cleaning transactions
-    auto pending = mPendingTransactions.find(connectionId);
-    if (pending != mPendingTransactions.end()) {
-        for (const TransactionId& transactionId : pending->second) {
-            auto iter = mTransactions.find(transactionId);
-            if (iter != mTransactions.end()) {
-                if (!iter->second->mSenderValidated) {
-                    mCompletedTransactions.insert(transactionId);
-                }
-                BufferId bufferId = iter->second->mBufferId;
-                auto bufferIter = mBuffers.find(bufferId);
-                bufferIter->second->mTransactionCount--;
-                if (bufferIter->second->mOwnerCount == 0 &&
-                    bufferIter->second->mTransactionCount == 0) {
-                    // TODO: handle freebuffer insert fail
-                    if (!bufferIter->second->mInvalidated) {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mFreeBuffers.insert(bufferId);
-                    } else {
-                        mStats.onBufferUnused(bufferIter->second->mAllocSize);
-                        mStats.onBufferEvicted(bufferIter->second->mAllocSize);
-                        mBuffers.erase(bufferIter);
-                        mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
-                    }
+    for (const TransactionId& transactionId : connection.mPendingTransactions) {
+        auto iter = mTransactions.find(transactionId);
+        if (iter != mTransactions.end()) {
+            if (!iter->second->mSenderValidated) {
+                mCompletedTransactions.insert(transactionId);
+            }
+            BufferId bufferId = iter->second->mBufferId;
+            auto bufferIter = mBuffers.find(bufferId);
+            bufferIter->second->mTransactionCount--;
+            if (bufferIter->second->mOwnerCount == 0 &&
+                bufferIter->second->mTransactionCount == 0) {
+                // TODO: handle freebuffer insert fail
+                if (!bufferIter->second->mInvalidated) {
+                    mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                    addFreeBuffer(&mFreeBuffers, bufferIter->second.get());
+                } else {
+                    mStats.onBufferUnused(bufferIter->second->mAllocSize);
+                    mStats.onBufferEvicted(bufferIter->second->mAllocSize);
+                    mBuffers.erase(bufferIter);
+                    mInvalidation.onBufferInvalidated(bufferId, mInvalidationChannel);
                 }
-                mTransactions.erase(iter);
             }
+            mTransactions.erase(iter);
         }
     }
-    mConnectionIds.erase(connectionId);
+
+    // The FMQ is destroyed after this. A drain which found the connection
+    // before it is removed must not read the FMQ.
+    std::lock_guard<std::mutex> connectionsLock(mConnectionsMutex);
+    {
+        std::lock_guard<std::mutex> lock(connection.mMutex);
+        connection.mQueue = nullptr;
+    }
+    mConnections.erase(found);
     return true;
 }
 
@@ -679,21 +731,20 @@ bool Accessor::Impl::BufferPool::getFreeBuffer(
         const std::shared_ptr<BufferPoolAllocator> &allocator,
         const std::vector<uint8_t> &params, BufferId *pId,
         const native_handle_t** handle) {
-    auto bufferIt = mFreeBuffers.begin();
-    for (;bufferIt != mFreeBuffers.end(); ++bufferIt) {
-        BufferId bufferId = *bufferIt;
-        if (allocator->compatible(params, mBuffers[bufferId]->mConfig)) {
-            break;
-        }
-    }
-    if (bufferIt != mFreeBuffers.end()) {
-        BufferId id = *bufferIt;
-        mFreeBuffers.erase(bufferIt);
-        mStats.onBufferRecycled(mBuffers[id]->mAllocSize);
-        *handle = mBuffers[id]->handle();
-        *pId = id;
-        ALOGV("recycle a buffer %u %p", id, *handle);
-        return true;
+    // Recycles the most recently freed compatible buffer.
+    for (auto freeIt = mFreeBuffers.rbegin(); freeIt != mFreeBuffers.rend(); ++freeIt) {
+        BufferId id = *freeIt;
+        auto bufferIt = mBuffers.find(id);
+        if (bufferIt != mBuffers.end() &&
+                allocator->compatible(params, bufferIt->second->mConfig)) {
+            mFreeBuffers.erase(std::next(freeIt).base());
+            bufferIt->second->mInFreeList = false;
+            mStats.onBufferRecycled(bufferIt->second->mAllocSize);
+            *handle = bufferIt->second->handle();
+            *pId = id;
+            ALOGV("recycle a buffer %u %p", id, *handle);
+            return true;
+        }
     }
     return false;
 }
@@ -740,7 +791,11 @@ void Accessor::Impl::BufferPool::cleanUp(bool clearCache) {
                   mStats.mTotalRecycles, mStats.mTotalAllocations,
                   mStats.mTotalFetches, mStats.mTotalTransfers);
         }
-        for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end();) {
+        // Evicts the least recently freed buffers, and compacts the rest in
+        // place.
+        auto keptIt = mFreeBuffers.begin();
+        auto freeIt = mFreeBuffers.begin();
+        for (; freeIt != mFreeBuffers.end(); ++freeIt) {
             if (!clearCache && mStats.buffersNotInUse() <= kUnusedBufferCountTarget &&
                     (mStats.mSizeCached < kMinAllocBytesForEviction ||
                      mBuffers.size() < kMinBufferCountForEviction)) {
@@ -751,33 +806,34 @@ void Accessor::Impl::BufferPool::cleanUp(bool clearCache) {
                     it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
                 mStats.onBufferEvicted(it->second->mAllocSize);
                 mBuffers.erase(it);
-                freeIt = mFreeBuffers.erase(freeIt);
             } else {
-                ++freeIt;
+                *keptIt++ = *freeIt;
                 ALOGW("bufferpool2 inconsistent!");
             }
         }
+        mFreeBuffers.erase(std::copy(freeIt, mFreeBuffers.end(), keptIt), mFreeBuffers.end());
     }
 }
 
 void Accessor::Impl::BufferPool::invalidate(
         bool needsAck, BufferId from, BufferId to,
         const std::shared_ptr<Accessor::Impl> &impl) {
-    for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end();) {
+    auto keptIt = mFreeBuffers.begin();
+    for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end(); ++freeIt) {
         if (isBufferInRange(from, to, *freeIt)) {
             auto it = mBuffers.find(*freeIt);
             if (it != mBuffers.end() &&
                 it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
                 mStats.onBufferEvicted(it->second->mAllocSize);
                 mBuffers.erase(it);
-                freeIt = mFreeBuffers.erase(freeIt);
                 continue;
             } else {
                 ALOGW("bufferpool2 inconsistent!");
             }
         }
-        ++freeIt;
+        *keptIt++ = *freeIt;
     }
+    mFreeBuffers.erase(keptIt, mFreeBuffers.end());
 
     size_t left = 0;
     for (auto it = mBuffers.begin(); it != mBuffers.end(); ++it) {
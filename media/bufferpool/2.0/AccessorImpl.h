@@ -19,6 +19,9 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <condition_variable>
 #include <utils/Timers.h>
 #include "Accessor.h"
@@ -101,21 +104,57 @@ private:
         BufferStatusObserver mObserver;
         BufferInvalidationChannel mInvalidationChannel;
 
-        std::map<ConnectionId, std::set<BufferId>> mUsingBuffers;
-        std::map<BufferId, std::set<ConnectionId>> mUsingConnections;
+        /**
+         * Per-connection shard of the buffer pool bookkeeping.
+         *
+         * The status messages of a connection are drained from its FMQ into mMessages under
+         * mMutex, so the connection can drain them before it takes the pool lock. The owned
+         * buffers and the pending transactions are guarded by the pool lock.
+         */
+        struct ConnectionState {
+            std::mutex mMutex;
+            // nullptr after the connection is closed. Changed holding the pool lock,
+            // mConnectionsMutex and mMutex, so any of them is enough to read it.
+            BufferStatusQueue *mQueue;
+            // Drained status messages, which are not processed yet.
+            std::vector<BufferStatusMessage> mMessages;
+            // Set before the FMQ is drained, and cleared when mMessages is taken for
+            // processing. Lets processStatusMessages() skip idle connections without mMutex.
+            std::atomic<bool> mHasMessages;
+
+            // A connection owns and receives a few buffers at a time, so the ids are kept in
+            // unsorted vectors which are searched linearly. The vectors keep their storage
+            // until the connection is closed.
+            std::vector<BufferId> mUsingBuffers;
+            std::vector<TransactionId> mPendingTransactions;
+
+            explicit ConnectionState(BufferStatusQueue *queue)
+                : mQueue(queue), mHasMessages(false) {}
+
+            /** Drains the FMQ into mMessages. mMutex should be held. */
+            void drainStatusMessages(ConnectionId connectionId);
+        };
+
+        // Connections are added and removed holding both the pool lock and
+        // mConnectionsMutex, so either of them is enough to look up a connection.
+        std::mutex mConnectionsMutex;
+        std::unordered_map<ConnectionId, std::shared_ptr<ConnectionState>> mConnections;
 
-        std::map<ConnectionId, std::set<TransactionId>> mPendingTransactions;
         // Transactions completed before TRANSFER_TO message arrival.
         // Fetch does not occur for the transactions.
         // Only transaction id is kept for the transactions in short duration.
-        std::set<TransactionId> mCompletedTransactions;
+        std::unordered_set<TransactionId> mCompletedTransactions;
         // Currently active(pending) transations' status & information.
-        std::map<TransactionId, std::unique_ptr<TransactionStatus>>
+        std::unordered_map<TransactionId, std::unique_ptr<TransactionStatus>>
                 mTransactions;
 
-        std::map<BufferId, std::unique_ptr<InternalBuffer>> mBuffers;
-        std::set<BufferId> mFreeBuffers;
-        std::set<ConnectionId> mConnectionIds;
+        std::unordered_map<BufferId, std::unique_ptr<InternalBuffer>> mBuffers;
+        // Free buffers in the order they were freed. The most recently freed buffer is recycled
+        // first, and the least recently freed buffers are evicted first.
+        std::vector<BufferId> mFreeBuffers;
+
+        // Buffer status messages of a connection being processed. Kept to reuse the storage.
+        std::vector<BufferStatusMessage> mMessages;
 
         struct Invalidation {
             static std::atomic<std::uint32_t> sInvSeqId;
@@ -258,63 +297,87 @@ private:
         /** Destroys a buffer pool. */
         ~BufferPool();
 
+        /**
+         * Drains the pending buffer status messages of a connection without
+         * the pool lock. The messages are processed on the next
+         * processStatusMessages().
+         *
+         * @param connectionId  the id of the connection.
+         */
+        void drainStatusMessages(ConnectionId connectionId);
+
         /**
          * Processes all pending buffer status messages, and returns the result.
+         * The messages are processed one connection at a time in a batch.
          * Each status message is handled by methods with 'handle' prefix.
          */
         void processStatusMessages();
 
+        /**
+         * Processes the drained buffer status messages of a connection in
+         * mMessages.
+         *
+         * @param connection    the connection which sent the messages.
+         */
+        void processStatusMessages(ConnectionState &connection);
+
         /**
          * Handles a buffer being owned by a connection.
          *
-         * @param connectionId  the id of the buffer owning connection.
+         * @param connection    the buffer owning connection.
          * @param bufferId      the id of the buffer.
          *
          * @return {@code true} when the buffer is owned,
          *         {@code false} otherwise.
          */
-        bool handleOwnBuffer(ConnectionId connectionId, BufferId bufferId);
+        bool handleOwnBuffer(ConnectionState &connection, BufferId bufferId);
 
         /**
          * Handles a buffer being released by a connection.
          *
-         * @param connectionId  the id of the buffer owning connection.
+         * @param connection    the buffer owning connection.
          * @param bufferId      the id of the buffer.
          *
          * @return {@code true} when the buffer ownership is released,
          *         {@code false} otherwise.
          */
-        bool handleReleaseBuffer(ConnectionId connectionId, BufferId bufferId);
+        bool handleReleaseBuffer(ConnectionState &connection, BufferId bufferId);
 
         /**
          * Handles a transfer transaction start message from the sender.
          *
-         * @param message   a buffer status message for the transaction.
+         * @param connection    the connection which sent the message.
+         * @param message       a buffer status message for the transaction.
          *
          * @result {@code true} when transfer_to message is acknowledged,
          *         {@code false} otherwise.
          */
-        bool handleTransferTo(const BufferStatusMessage &message);
+        bool handleTransferTo(
+                ConnectionState &connection, const BufferStatusMessage &message);
 
         /**
          * Handles a transfer transaction being acked by the receiver.
          *
-         * @param message   a buffer status message for the transaction.
+         * @param connection    the connection which sent the message.
+         * @param message       a buffer status message for the transaction.
          *
          * @result {@code true} when transfer_from message is acknowledged,
          *         {@code false} otherwise.
          */
-        bool handleTransferFrom(const BufferStatusMessage &message);
+        bool handleTransferFrom(
+                ConnectionState &connection, const BufferStatusMessage &message);
 
         /**
          * Handles a transfer transaction result message from the receiver.
          *
-         * @param message   a buffer status message for the transaction.
+         * @param connection    the connection which sent the message.
+         * @param message       a buffer status message for the transaction.
          *
          * @result {@code true} when the exisitng transaction is finished,
          *         {@code false} otherwise.
          */
-        bool handleTransferResult(const BufferStatusMessage &message);
+        bool handleTransferResult(
+                ConnectionState &connection, const BufferStatusMessage &message);
 
         /**
          * Handles a connection being closed, and returns the result. All the
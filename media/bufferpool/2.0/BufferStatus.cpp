@@ -84,22 +84,30 @@ ResultStatus BufferStatusObserver::close(ConnectionId id) {
     return ResultStatus::OK;
 }
 
-void BufferStatusObserver::getBufferStatusChanges(std::vector<BufferStatusMessage> &messages) {
-    for (auto it = mBufferStatusQueues.begin(); it != mBufferStatusQueues.end(); ++it) {
-        BufferStatusMessage message;
-        size_t avail = it->second->availableToRead();
-        while (avail > 0) {
-            if (!it->second->read(&message, 1)) {
-                // Since avaliable # of reads are already confirmed,
-                // this should not happen.
-                // TODO: error handling (spurious client?)
-                ALOGW("FMQ message cannot be read from %lld", (long long)it->first);
-                return;
-            }
-            message.connectionId = it->first;
-            messages.push_back(message);
-            --avail;
+BufferStatusQueue *BufferStatusObserver::getQueue(ConnectionId id) {
+    auto it = mBufferStatusQueues.find(id);
+    if (it == mBufferStatusQueues.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void BufferStatusObserver::getBufferStatusChanges(
+        ConnectionId id, BufferStatusQueue *queue,
+        std::vector<BufferStatusMessage> &messages) {
+    BufferStatusMessage message;
+    size_t avail = queue->availableToRead();
+    while (avail > 0) {
+        if (!queue->read(&message, 1)) {
+            // Since avaliable # of reads are already confirmed,
+            // this should not happen.
+            // TODO: error handling (spurious client?)
+            ALOGW("FMQ message cannot be read from %lld", (long long)id);
+            return;
         }
+        message.connectionId = id;
+        messages.push_back(message);
+        --avail;
     }
 }
 
@@ -73,11 +73,25 @@ public:
      */
     ResultStatus close(ConnectionId id);
 
-    /** Retrieves all pending FMQ buffer status messages from clients.
+    /** Returns the buffer status message FMQ for the specified connection
+     * (client). The FMQ is valid until the connection is closed.
      *
-     * @param messages  retrieved pending messages.
+     * @param connectionId  connection Id of the specified client.
+     *
+     * @return the FMQ if the connection is open, nullptr otherwise.
+     */
+    BufferStatusQueue *getQueue(ConnectionId id);
+
+    /** Retrieves all pending FMQ buffer status messages from a client. Only
+     * one thread may read a FMQ at a time.
+     *
+     * @param connectionId  connection Id of the client.
+     * @param queue         buffer status message FMQ of the client.
+     * @param messages      retrieved pending messages are appended to this.
      */
-    void getBufferStatusChanges(std::vector<BufferStatusMessage> &messages);
+    static void getBufferStatusChanges(
+            ConnectionId id, BufferStatusQueue *queue,
+            std::vector<BufferStatusMessage> &messages);
 };
 
 /**
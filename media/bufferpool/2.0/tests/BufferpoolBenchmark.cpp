@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "BufferpoolBenchmark"
+#include <utils/Log.h>
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Accessor.h>
+#include <BufferStatus.h>
+#include <Connection.h>
+#include <benchmark/benchmark.h>
+#include "allocator.h"
+
+using namespace android::hardware::media::bufferpool::V2_0::implementation;
+using android::sp;
+using android::hardware::media::bufferpool::V2_0::BufferStatus;
+using android::hardware::media::bufferpool::V2_0::ResultStatus;
+
+namespace {
+
+// Number of buffers each connection holds after receiving them, before releasing the oldest.
+constexpr size_t kHeldBuffersPerConnection = 4;
+
+// A local connection to the shared pool, which sends status messages as BufferPoolClient does.
+struct Client {
+    // closes the connection when destroyed
+    sp<Connection> mConnection;
+    ConnectionId mId;
+    std::unique_ptr<BufferStatusChannel> mChannel;
+    std::deque<BufferId> mHeldBuffers;
+    std::list<BufferId> mPending;
+    std::list<BufferId> mPosted;
+
+    bool post(TransactionId transactionId, BufferId bufferId, BufferStatus status,
+              ConnectionId targetId) {
+        mPosted.clear();
+        return mChannel->postBufferStatusMessage(
+                transactionId, bufferId, status, mId, targetId, mPending, mPosted);
+    }
+
+    void release(BufferId bufferId) {
+        mPending.push_back(bufferId);
+        mPosted.clear();
+        mChannel->postBufferRelease(mId, mPending, mPosted);
+    }
+};
+
+// Transaction ids are unique across the benchmark threads.
+std::atomic<TransactionId> sTransactionId{0};
+
+// The pool shared by all benchmark threads.
+sp<Accessor> GetAccessor() {
+    static std::once_flag sOnce;
+    static sp<Accessor> sAccessor;
+    std::call_once(sOnce, [] {
+        // as ClientManager does before creating accessors
+        Accessor::createInvalidator();
+        Accessor::createEvictor();
+        sAccessor = new Accessor(std::make_shared<TestBufferPoolAllocator>());
+    });
+    return sAccessor;
+}
+
+// Each iteration allocates a buffer on a connection, transfers it to the next connection and
+// releases it from the sender. The receivers release the buffers they hold in turn. Arg is the
+// number of connections of each thread.
+void BM_AllocateTransferRelease(benchmark::State &state) {
+    const sp<Accessor> accessor = GetAccessor();
+    if (!accessor->isValid()) {
+        state.SkipWithError("invalid accessor");
+        return;
+    }
+    std::vector<uint8_t> params;
+    getTestAllocatorParams(&params);
+
+    std::vector<Client> clients(state.range(0));
+    for (Client &client : clients) {
+        uint32_t msgId;
+        const StatusDescriptor *statusDesc;
+        const InvalidationDescriptor *invDesc;
+        ResultStatus status = accessor->connect(
+                nullptr /* observer */, true /* local */, &client.mConnection, &client.mId,
+                &msgId, &statusDesc, &invDesc);
+        if (status != ResultStatus::OK) {
+            state.SkipWithError("connect failed");
+            return;
+        }
+        client.mChannel = std::make_unique<BufferStatusChannel>(*statusDesc);
+    }
+
+    size_t sender = 0;
+    for (auto _ : state) {
+        Client &from = clients[sender];
+        sender = (sender + 1) % clients.size();
+        Client &to = clients[sender];
+
+        BufferId bufferId;
+        const native_handle_t *handle;
+        if (accessor->allocate(from.mId, params, &bufferId, &handle) != ResultStatus::OK) {
+            state.SkipWithError("allocate failed");
+            break;
+        }
+        const TransactionId transactionId = ++sTransactionId;
+        from.post(transactionId, bufferId, BufferStatus::TRANSFER_TO, to.mId);
+        from.release(bufferId);
+
+        to.post(transactionId, bufferId, BufferStatus::TRANSFER_FROM, from.mId);
+        if (accessor->fetch(to.mId, transactionId, bufferId, &handle) != ResultStatus::OK) {
+            state.SkipWithError("fetch failed");
+            break;
+        }
+        to.post(transactionId, bufferId, BufferStatus::TRANSFER_OK, from.mId);
+        to.mHeldBuffers.push_back(bufferId);
+        if (to.mHeldBuffers.size() > kHeldBuffersPerConnection) {
+            to.release(to.mHeldBuffers.front());
+            to.mHeldBuffers.pop_front();
+        }
+    }
+    state.counters["ops"] = benchmark::Counter(
+            state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_AllocateTransferRelease)
+        ->ArgName("connections")
+        ->RangeMultiplier(4)->Range(2, 128)
+        ->ThreadRange(1, 4)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
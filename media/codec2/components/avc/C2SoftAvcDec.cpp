@@ -510,7 +510,9 @@ void C2SoftAvcDec::getVersion() {
 
 status_t C2SoftAvcDec::initDecoder() {
     if (OK != createDecoder()) return UNKNOWN_ERROR;
-    mNumCores = MIN(getCpuCoreCount(), MAX_NUM_CORES);
+    mThreadLease = GetCodecThreadBudget().acquire(
+            MIN(getCpuCoreCount(), MAX_NUM_CORES), mWidth, mHeight, 0 /* frameRate */);
+    mNumCores = mThreadLease->threads();
     mStride = ALIGN128(mWidth);
     mSignalledError = false;
     resetPlugin();
@@ -661,6 +663,10 @@ status_t C2SoftAvcDec::resetDecoder() {
         return UNKNOWN_ERROR;
     }
     mStride = 0;
+    // pick up the share of the thread budget, which may have changed since the decoder started
+    if (mThreadLease) {
+        mNumCores = mThreadLease->threads();
+    }
     (void) setNumCores();
     mSignalledError = false;
     mHeaderDecoded = false;
@@ -691,6 +697,7 @@ status_t C2SoftAvcDec::deleteDecoder() {
         }
         mDecHandle = nullptr;
     }
+    mThreadLease.reset();
 
     return OK;
 }
@@ -933,6 +940,7 @@ void C2SoftAvcDec::process(
                 mWidth = ps_decode_op->u4_pic_wd;
                 mHeight = ps_decode_op->u4_pic_ht;
                 CHECK_EQ(0u, ps_decode_op->u4_output_present);
+                mThreadLease->setLoad(mWidth, mHeight, 0 /* frameRate */);
 
                 C2StreamPictureSizeInfo::output size(0u, mWidth, mHeight);
                 std::vector<std::unique_ptr<C2SettingResult>> failures;
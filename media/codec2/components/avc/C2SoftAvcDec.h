@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ColorUtils.h>
 
 #include <atomic>
+#include <CodecThreadBudget.h>
 #include <SimpleC2Component.h>
 
 #include "ih264_typedefs.h"
@@ -152,6 +153,7 @@ private:
     uint8_t *mOutBufferFlush;
 
     size_t mNumCores;
+    std::unique_ptr<CodecThreadBudget::Lease> mThreadLease;
     IV_COLOR_FORMAT_T mIvColorFormat;
     uint32_t mOutputDelay;
     uint32_t mWidth;
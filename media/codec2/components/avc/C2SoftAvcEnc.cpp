@@ -1346,6 +1346,9 @@ c2_status_t C2SoftAvcEnc::initEncoder() {
     logVersion();
 
     /* set processor details */
+    mThreadLease = GetCodecThreadBudget().acquire(
+            MIN(GetCPUCoreCount(), CODEC_MAX_CORES), width, height, mFrameRate->value);
+    mNumCores = mThreadLease->threads();
     setNumCores();
 
     /* Video control Set Frame dimensions */
@@ -1433,6 +1436,7 @@ c2_status_t C2SoftAvcEnc::releaseEncoder() {
 
     // clear other pointers into the space being free()d
     mCodecCtx = nullptr;
+    mThreadLease.reset();
 
     mStarted = false;
 
@@ -22,6 +22,7 @@
 
 #include <utils/Vector.h>
 
+#include <CodecThreadBudget.h>
 #include <SimpleC2Component.h>
 
 #include "ih264_typedefs.h"
@@ -182,6 +183,7 @@ private:
     iv_mem_rec_t *mMemRecords;   // Memory records requested by the codec
     size_t mNumMemRecords;       // Number of memory records requested by codec
     size_t mNumCores;            // Number of cores used by the codec
+    std::unique_ptr<CodecThreadBudget::Lease> mThreadLease;
 
     std::shared_ptr<C2LinearBlock> mOutBlock;
 
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "CodecThreadBudget"
+#include <log/log.h>
+
+#include <CodecThreadBudget.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <cutils/properties.h>
+#include <unistd.h>
+
+namespace android {
+
+namespace {
+
+// of the codecs that do not know their frame rate
+constexpr float kDefaultFrameRate = 30.f;
+
+}  // namespace
+
+CodecThreadBudget::Lease::Lease(CodecThreadBudget *budget, size_t maxThreads, double load)
+    : mBudget(budget), mMaxThreads(std::max(maxThreads, size_t(1))), mLoad(load),
+      mThreads(1) {
+}
+
+CodecThreadBudget::Lease::~Lease() {
+    std::lock_guard<std::mutex> lock(mBudget->mLock);
+    mBudget->mLeases.remove(this);
+    mBudget->rebalance_l();
+}
+
+void CodecThreadBudget::Lease::setLoad(uint32_t width, uint32_t height, float frameRate) {
+    std::lock_guard<std::mutex> lock(mBudget->mLock);
+    mLoad = Load(width, height, frameRate);
+    mBudget->rebalance_l();
+}
+
+CodecThreadBudget::CodecThreadBudget(size_t threads) : mThreads(threads) {
+}
+
+std::unique_ptr<CodecThreadBudget::Lease> CodecThreadBudget::acquire(
+        size_t maxThreads, uint32_t width, uint32_t height, float frameRate) {
+    std::unique_ptr<Lease> lease(new Lease(this, maxThreads, Load(width, height, frameRate)));
+    std::lock_guard<std::mutex> lock(mLock);
+    mLeases.push_back(lease.get());
+    rebalance_l();
+    ALOGV("leased %zu of %zu threads to %ux%u@%.1f (%zu codecs)",
+          lease->threads(), mThreads, width, height, frameRate, mLeases.size());
+    return lease;
+}
+
+size_t CodecThreadBudget::threads() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mThreads;
+}
+
+void CodecThreadBudget::setThreads(size_t threads) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mThreads = threads;
+    rebalance_l();
+}
+
+// static
+double CodecThreadBudget::Load(uint32_t width, uint32_t height, float frameRate) {
+    return std::max(double(width) * height, 1.) * (frameRate > 0 ? frameRate : kDefaultFrameRate);
+}
+
+void CodecThreadBudget::rebalance_l() {
+    if (mThreads == 0u) {
+        for (Lease *lease : mLeases) {
+            lease->mThreads = lease->mMaxThreads;
+        }
+        return;
+    }
+    // Every codec gets a thread, then each spare thread goes to the codec furthest below its
+    // share of the budget that can still use one more.
+    double totalLoad = 0;
+    for (const Lease *lease : mLeases) {
+        totalLoad += lease->mLoad;
+    }
+    std::vector<size_t> threads(mLeases.size(), 1u);
+    size_t spare = mThreads > mLeases.size() ? mThreads - mLeases.size() : 0u;
+    for (; spare > 0u; --spare) {
+        size_t best = threads.size();
+        double bestDeficit = 0;
+        size_t i = 0;
+        for (const Lease *lease : mLeases) {
+            const double deficit = mThreads * lease->mLoad / totalLoad - threads[i];
+            if (threads[i] < lease->mMaxThreads
+                    && (best == threads.size() || deficit > bestDeficit)) {
+                best = i;
+                bestDeficit = deficit;
+            }
+            ++i;
+        }
+        if (best == threads.size()) {
+            break;
+        }
+        ++threads[best];
+    }
+    size_t i = 0;
+    for (Lease *lease : mLeases) {
+        lease->mThreads = threads[i++];
+    }
+}
+
+CodecThreadBudget &GetCodecThreadBudget() {
+    static CodecThreadBudget *sBudget = [] {
+        int32_t threads = property_get_int32("media.c2.sw.thread_budget", -1);
+        if (threads < 0) {
+            threads = std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L);
+        }
+        ALOGV("software codec thread budget: %d", threads);
+        return new CodecThreadBudget(threads);
+    }();
+    return *sBudget;
+}
+
+}  // namespace android
@@ -0,0 +1,585 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "PixelConversionKernels"
+#include <log/log.h>
+
+#include <PixelConversionKernels.h>
+
+#include <atomic>
+#include <initializer_list>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define PIXEL_CONVERSION_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERSION_NEON
+#endif
+
+namespace android {
+
+namespace {
+
+constexpr uint32_t kAlpha = 3u << 30;
+constexpr int32_t kMax10Bit = 1023;
+
+size_t convertNone16To8(uint8_t * /* dst */, const uint16_t * /* src */, size_t /* count */) {
+    return 0;
+}
+
+size_t convertNone16ToP010(
+        uint16_t * /* dst */, const uint16_t * /* src */, size_t /* count */) {
+    return 0;
+}
+
+size_t convertNone16ToP010UV(
+        uint16_t * /* dstUV */, const uint16_t * /* srcU */, const uint16_t * /* srcV */,
+        size_t /* count */) {
+    return 0;
+}
+
+size_t convertNone16ToY410(
+        uint32_t * /* dstTop */, uint32_t * /* dstBot */, const uint16_t * /* srcYTop */,
+        const uint16_t * /* srcYBot */, const uint16_t * /* srcU */, const uint16_t * /* srcV */,
+        size_t /* width */) {
+    return 0;
+}
+
+size_t convertNone16ToRGBA1010102(
+        uint32_t * /* dstTop */, uint32_t * /* dstBot */, const uint16_t * /* srcYTop */,
+        const uint16_t * /* srcYBot */, const uint16_t * /* srcU */, const uint16_t * /* srcV */,
+        size_t /* width */, const YUVToRGBCoeffs & /* coeffs */) {
+    return 0;
+}
+
+const PixelConversionKernels kScalarKernels = {
+    PixelConversionIsa::SCALAR,
+    convertNone16To8,
+    convertNone16ToP010,
+    convertNone16ToP010UV,
+    convertNone16ToY410,
+    convertNone16ToRGBA1010102,
+};
+
+#ifdef PIXEL_CONVERSION_X86
+
+// The kernels are built for the instruction set they use, whatever the build targets, and only
+// run once the CPU is known to support it.
+#define TARGET_SSE4_1 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// Y410 conversion keeps the 10 low bits of the first of every two samples, and all bits of the
+// second, as the scalar conversion does.
+#define Y410_LANE_MASK 0x3ff, -1
+
+TARGET_SSE4_1
+size_t convert16To8Sse41(uint8_t *dst, const uint16_t *src, size_t count) {
+    const __m128i lowByte = _mm_set1_epi16(0xff);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        lo = _mm_and_si128(_mm_srli_epi16(lo, 2), lowByte);
+        hi = _mm_and_si128(_mm_srli_epi16(hi, 2), lowByte);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+TARGET_SSE4_1
+size_t convert16ToP010Sse41(uint16_t *dst, const uint16_t *src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_slli_epi16(s, 6));
+    }
+    return i;
+}
+
+TARGET_SSE4_1
+size_t convert16ToP010UVSse41(
+        uint16_t *dstUV, const uint16_t *srcU, const uint16_t *srcV, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i u = _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(srcU + i)), 6);
+        __m128i v = _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(srcV + i)), 6);
+        _mm_storeu_si128((__m128i *)(dstUV + 2 * i), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *)(dstUV + 2 * i + 8), _mm_unpackhi_epi16(u, v));
+    }
+    return i;
+}
+
+TARGET_SSE4_1
+size_t convert16ToY410Sse41(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width) {
+    const __m128i laneMask = _mm_setr_epi32(Y410_LANE_MASK, Y410_LANE_MASK);
+    const __m128i alpha = _mm_set1_epi32(kAlpha);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i u = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(srcU + x / 2)));
+        __m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(srcV + x / 2)));
+        __m128i uv = _mm_or_si128(
+                _mm_and_si128(u, laneMask), _mm_slli_epi32(_mm_and_si128(v, laneMask), 20));
+        uv = _mm_or_si128(uv, alpha);
+        // each chroma sample for two pixels
+        const __m128i uvLo = _mm_unpacklo_epi32(uv, uv);
+        const __m128i uvHi = _mm_unpackhi_epi32(uv, uv);
+
+        __m128i y = _mm_loadu_si128((const __m128i *)(srcYTop + x));
+        __m128i yLo = _mm_and_si128(_mm_cvtepu16_epi32(y), laneMask);
+        __m128i yHi = _mm_and_si128(_mm_cvtepu16_epi32(_mm_srli_si128(y, 8)), laneMask);
+        _mm_storeu_si128((__m128i *)(dstTop + x), _mm_or_si128(_mm_slli_epi32(yLo, 10), uvLo));
+        _mm_storeu_si128((__m128i *)(dstTop + x + 4),
+                         _mm_or_si128(_mm_slli_epi32(yHi, 10), uvHi));
+
+        y = _mm_loadu_si128((const __m128i *)(srcYBot + x));
+        yLo = _mm_and_si128(_mm_cvtepu16_epi32(y), laneMask);
+        yHi = _mm_and_si128(_mm_cvtepu16_epi32(_mm_srli_si128(y, 8)), laneMask);
+        _mm_storeu_si128((__m128i *)(dstBot + x), _mm_or_si128(_mm_slli_epi32(yLo, 10), uvLo));
+        _mm_storeu_si128((__m128i *)(dstBot + x + 4),
+                         _mm_or_si128(_mm_slli_epi32(yHi, 10), uvHi));
+    }
+    return x;
+}
+
+struct RGBConstantsSse41 {
+    __m128i y, c16, round, zero, max, alpha;
+};
+
+// Converts 4 pixels from their Y and the U/V terms of their blue, green and red components.
+TARGET_SSE4_1 inline __m128i convertToRGBA1010102Sse41(
+        __m128i y, __m128i bUV, __m128i gUV, __m128i rUV, const RGBConstantsSse41 &k) {
+    const __m128i yMult = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(y, k.c16), k.y), k.round);
+    // Arithmetic shifts round negative values down rather than towards zero like the scalar
+    // division, but those are clipped to 0 either way.
+    __m128i b = _mm_srai_epi32(_mm_add_epi32(yMult, bUV), 10);
+    __m128i g = _mm_srai_epi32(_mm_add_epi32(yMult, gUV), 10);
+    __m128i r = _mm_srai_epi32(_mm_add_epi32(yMult, rUV), 10);
+    b = _mm_min_epi32(_mm_max_epi32(b, k.zero), k.max);
+    g = _mm_min_epi32(_mm_max_epi32(g, k.zero), k.max);
+    r = _mm_min_epi32(_mm_max_epi32(r, k.zero), k.max);
+    return _mm_or_si128(_mm_or_si128(k.alpha, _mm_slli_epi32(b, 20)),
+                        _mm_or_si128(_mm_slli_epi32(g, 10), r));
+}
+
+TARGET_SSE4_1
+size_t convert16ToRGBA1010102Sse41(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width, const YUVToRGBCoeffs &coeffs) {
+    const RGBConstantsSse41 k = {
+        _mm_set1_epi32(coeffs._y), _mm_set1_epi32(coeffs._c16), _mm_set1_epi32(512),
+        _mm_setzero_si128(), _mm_set1_epi32(kMax10Bit), _mm_set1_epi32(kAlpha),
+    };
+    const __m128i bU = _mm_set1_epi32(coeffs._b_u);
+    const __m128i negGU = _mm_set1_epi32(-coeffs._g_u);
+    const __m128i negGV = _mm_set1_epi32(-coeffs._g_v);
+    const __m128i rV = _mm_set1_epi32(coeffs._r_v);
+    const __m128i neutral = _mm_set1_epi32(512);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i u = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(srcU + x / 2)));
+        __m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(srcV + x / 2)));
+        u = _mm_sub_epi32(u, neutral);
+        v = _mm_sub_epi32(v, neutral);
+        const __m128i bUV = _mm_mullo_epi32(u, bU);
+        const __m128i gUV = _mm_add_epi32(_mm_mullo_epi32(u, negGU), _mm_mullo_epi32(v, negGV));
+        const __m128i rUV = _mm_mullo_epi32(v, rV);
+        // each chroma sample for two pixels
+        const __m128i bLo = _mm_unpacklo_epi32(bUV, bUV);
+        const __m128i bHi = _mm_unpackhi_epi32(bUV, bUV);
+        const __m128i gLo = _mm_unpacklo_epi32(gUV, gUV);
+        const __m128i gHi = _mm_unpackhi_epi32(gUV, gUV);
+        const __m128i rLo = _mm_unpacklo_epi32(rUV, rUV);
+        const __m128i rHi = _mm_unpackhi_epi32(rUV, rUV);
+
+        __m128i y = _mm_loadu_si128((const __m128i *)(srcYTop + x));
+        _mm_storeu_si128((__m128i *)(dstTop + x),
+                         convertToRGBA1010102Sse41(_mm_cvtepu16_epi32(y), bLo, gLo, rLo, k));
+        _mm_storeu_si128((__m128i *)(dstTop + x + 4),
+                         convertToRGBA1010102Sse41(_mm_cvtepu16_epi32(_mm_srli_si128(y, 8)),
+                                                   bHi, gHi, rHi, k));
+
+        y = _mm_loadu_si128((const __m128i *)(srcYBot + x));
+        _mm_storeu_si128((__m128i *)(dstBot + x),
+                         convertToRGBA1010102Sse41(_mm_cvtepu16_epi32(y), bLo, gLo, rLo, k));
+        _mm_storeu_si128((__m128i *)(dstBot + x + 4),
+                         convertToRGBA1010102Sse41(_mm_cvtepu16_epi32(_mm_srli_si128(y, 8)),
+                                                   bHi, gHi, rHi, k));
+    }
+    return x;
+}
+
+TARGET_AVX2
+size_t convert16To8Avx2(uint8_t *dst, const uint16_t *src, size_t count) {
+    const __m256i lowByte = _mm256_set1_epi16(0xff);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+        lo = _mm256_and_si256(_mm256_srli_epi16(lo, 2), lowByte);
+        hi = _mm256_and_si256(_mm256_srli_epi16(hi, 2), lowByte);
+        // packus interleaves the 128 bit lanes of its inputs
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+    return i;
+}
+
+TARGET_AVX2
+size_t convert16ToP010Avx2(uint16_t *dst, const uint16_t *src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_slli_epi16(s, 6));
+    }
+    return i;
+}
+
+TARGET_AVX2
+size_t convert16ToP010UVAvx2(
+        uint16_t *dstUV, const uint16_t *srcU, const uint16_t *srcV, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i u = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)(srcU + i)), 6);
+        __m256i v = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)(srcV + i)), 6);
+        // unpack interleaves within the 128 bit lanes
+        const __m256i lo = _mm256_unpacklo_epi16(u, v);
+        const __m256i hi = _mm256_unpackhi_epi16(u, v);
+        _mm256_storeu_si256((__m256i *)(dstUV + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dstUV + 2 * i + 16),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+TARGET_AVX2
+size_t convert16ToY410Avx2(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width) {
+    const __m256i laneMask = _mm256_setr_epi32(
+            Y410_LANE_MASK, Y410_LANE_MASK, Y410_LANE_MASK, Y410_LANE_MASK);
+    const __m256i alpha = _mm256_set1_epi32(kAlpha);
+    const __m256i dupLo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i dupHi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i u = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(srcU + x / 2)));
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(srcV + x / 2)));
+        __m256i uv = _mm256_or_si256(_mm256_and_si256(u, laneMask),
+                                     _mm256_slli_epi32(_mm256_and_si256(v, laneMask), 20));
+        uv = _mm256_or_si256(uv, alpha);
+        const __m256i uvLo = _mm256_permutevar8x32_epi32(uv, dupLo);
+        const __m256i uvHi = _mm256_permutevar8x32_epi32(uv, dupHi);
+
+        __m256i y = _mm256_loadu_si256((const __m256i *)(srcYTop + x));
+        __m256i yLo = _mm256_and_si256(
+                _mm256_cvtepu16_epi32(_mm256_castsi256_si128(y)), laneMask);
+        __m256i yHi = _mm256_and_si256(
+                _mm256_cvtepu16_epi32(_mm256_extracti128_si256(y, 1)), laneMask);
+        _mm256_storeu_si256((__m256i *)(dstTop + x),
+                            _mm256_or_si256(_mm256_slli_epi32(yLo, 10), uvLo));
+        _mm256_storeu_si256((__m256i *)(dstTop + x + 8),
+                            _mm256_or_si256(_mm256_slli_epi32(yHi, 10), uvHi));
+
+        y = _mm256_loadu_si256((const __m256i *)(srcYBot + x));
+        yLo = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(y)), laneMask);
+        yHi = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(y, 1)), laneMask);
+        _mm256_storeu_si256((__m256i *)(dstBot + x),
+                            _mm256_or_si256(_mm256_slli_epi32(yLo, 10), uvLo));
+        _mm256_storeu_si256((__m256i *)(dstBot + x + 8),
+                            _mm256_or_si256(_mm256_slli_epi32(yHi, 10), uvHi));
+    }
+    return x;
+}
+
+struct RGBConstantsAvx2 {
+    __m256i y, c16, round, zero, max, alpha;
+};
+
+// Converts 8 pixels from their Y and the U/V terms of their blue, green and red components.
+TARGET_AVX2 inline __m256i convertToRGBA1010102Avx2(
+        __m256i y, __m256i bUV, __m256i gUV, __m256i rUV, const RGBConstantsAvx2 &k) {
+    const __m256i yMult = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_sub_epi32(y, k.c16), k.y), k.round);
+    __m256i b = _mm256_srai_epi32(_mm256_add_epi32(yMult, bUV), 10);
+    __m256i g = _mm256_srai_epi32(_mm256_add_epi32(yMult, gUV), 10);
+    __m256i r = _mm256_srai_epi32(_mm256_add_epi32(yMult, rUV), 10);
+    b = _mm256_min_epi32(_mm256_max_epi32(b, k.zero), k.max);
+    g = _mm256_min_epi32(_mm256_max_epi32(g, k.zero), k.max);
+    r = _mm256_min_epi32(_mm256_max_epi32(r, k.zero), k.max);
+    return _mm256_or_si256(_mm256_or_si256(k.alpha, _mm256_slli_epi32(b, 20)),
+                           _mm256_or_si256(_mm256_slli_epi32(g, 10), r));
+}
+
+TARGET_AVX2
+size_t convert16ToRGBA1010102Avx2(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width, const YUVToRGBCoeffs &coeffs) {
+    const RGBConstantsAvx2 k = {
+        _mm256_set1_epi32(coeffs._y), _mm256_set1_epi32(coeffs._c16), _mm256_set1_epi32(512),
+        _mm256_setzero_si256(), _mm256_set1_epi32(kMax10Bit), _mm256_set1_epi32(kAlpha),
+    };
+    const __m256i bU = _mm256_set1_epi32(coeffs._b_u);
+    const __m256i negGU = _mm256_set1_epi32(-coeffs._g_u);
+    const __m256i negGV = _mm256_set1_epi32(-coeffs._g_v);
+    const __m256i rV = _mm256_set1_epi32(coeffs._r_v);
+    const __m256i neutral = _mm256_set1_epi32(512);
+    const __m256i dupLo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i dupHi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i u = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(srcU + x / 2)));
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(srcV + x / 2)));
+        u = _mm256_sub_epi32(u, neutral);
+        v = _mm256_sub_epi32(v, neutral);
+        const __m256i bUV = _mm256_mullo_epi32(u, bU);
+        const __m256i gUV = _mm256_add_epi32(
+                _mm256_mullo_epi32(u, negGU), _mm256_mullo_epi32(v, negGV));
+        const __m256i rUV = _mm256_mullo_epi32(v, rV);
+        const __m256i bLo = _mm256_permutevar8x32_epi32(bUV, dupLo);
+        const __m256i bHi = _mm256_permutevar8x32_epi32(bUV, dupHi);
+        const __m256i gLo = _mm256_permutevar8x32_epi32(gUV, dupLo);
+        const __m256i gHi = _mm256_permutevar8x32_epi32(gUV, dupHi);
+        const __m256i rLo = _mm256_permutevar8x32_epi32(rUV, dupLo);
+        const __m256i rHi = _mm256_permutevar8x32_epi32(rUV, dupHi);
+
+        __m256i y = _mm256_loadu_si256((const __m256i *)(srcYTop + x));
+        _mm256_storeu_si256((__m256i *)(dstTop + x), convertToRGBA1010102Avx2(
+                _mm256_cvtepu16_epi32(_mm256_castsi256_si128(y)), bLo, gLo, rLo, k));
+        _mm256_storeu_si256((__m256i *)(dstTop + x + 8), convertToRGBA1010102Avx2(
+                _mm256_cvtepu16_epi32(_mm256_extracti128_si256(y, 1)), bHi, gHi, rHi, k));
+
+        y = _mm256_loadu_si256((const __m256i *)(srcYBot + x));
+        _mm256_storeu_si256((__m256i *)(dstBot + x), convertToRGBA1010102Avx2(
+                _mm256_cvtepu16_epi32(_mm256_castsi256_si128(y)), bLo, gLo, rLo, k));
+        _mm256_storeu_si256((__m256i *)(dstBot + x + 8), convertToRGBA1010102Avx2(
+                _mm256_cvtepu16_epi32(_mm256_extracti128_si256(y, 1)), bHi, gHi, rHi, k));
+    }
+    return x;
+}
+
+const PixelConversionKernels kSse41Kernels = {
+    PixelConversionIsa::SSE4_1,
+    convert16To8Sse41,
+    convert16ToP010Sse41,
+    convert16ToP010UVSse41,
+    convert16ToY410Sse41,
+    convert16ToRGBA1010102Sse41,
+};
+
+const PixelConversionKernels kAvx2Kernels = {
+    PixelConversionIsa::AVX2,
+    convert16To8Avx2,
+    convert16ToP010Avx2,
+    convert16ToP010UVAvx2,
+    convert16ToY410Avx2,
+    convert16ToRGBA1010102Avx2,
+};
+
+#endif  // PIXEL_CONVERSION_X86
+
+#ifdef PIXEL_CONVERSION_NEON
+
+size_t convert16To8Neon(uint8_t *dst, const uint16_t *src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x8_t lo = vshrn_n_u16(vld1q_u16(src + i), 2);
+        const uint8x8_t hi = vshrn_n_u16(vld1q_u16(src + i + 8), 2);
+        vst1q_u8(dst + i, vcombine_u8(lo, hi));
+    }
+    return i;
+}
+
+size_t convert16ToP010Neon(uint16_t *dst, const uint16_t *src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(dst + i, vshlq_n_u16(vld1q_u16(src + i), 6));
+    }
+    return i;
+}
+
+size_t convert16ToP010UVNeon(
+        uint16_t *dstUV, const uint16_t *srcU, const uint16_t *srcV, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8x2_t uv;
+        uv.val[0] = vshlq_n_u16(vld1q_u16(srcU + i), 6);
+        uv.val[1] = vshlq_n_u16(vld1q_u16(srcV + i), 6);
+        vst2q_u16(dstUV + 2 * i, uv);
+    }
+    return i;
+}
+
+// Y410 conversion keeps the 10 low bits of the first of every two samples, and all bits of the
+// second, as the scalar conversion does.
+static const uint32_t kY410LaneMask[4] = { 0x3ff, 0xffffffff, 0x3ff, 0xffffffff };
+
+size_t convert16ToY410Neon(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width) {
+    const uint32x4_t laneMask = vld1q_u32(kY410LaneMask);
+    const uint32x4_t alpha = vdupq_n_u32(kAlpha);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const uint32x4_t u = vandq_u32(vmovl_u16(vld1_u16(srcU + x / 2)), laneMask);
+        const uint32x4_t v = vandq_u32(vmovl_u16(vld1_u16(srcV + x / 2)), laneMask);
+        const uint32x4_t uv = vorrq_u32(vorrq_u32(u, vshlq_n_u32(v, 20)), alpha);
+        // each chroma sample for two pixels
+        const uint32x4x2_t uvDup = vzipq_u32(uv, uv);
+
+        uint16x8_t y = vld1q_u16(srcYTop + x);
+        uint32x4_t yLo = vandq_u32(vmovl_u16(vget_low_u16(y)), laneMask);
+        uint32x4_t yHi = vandq_u32(vmovl_u16(vget_high_u16(y)), laneMask);
+        vst1q_u32(dstTop + x, vorrq_u32(vshlq_n_u32(yLo, 10), uvDup.val[0]));
+        vst1q_u32(dstTop + x + 4, vorrq_u32(vshlq_n_u32(yHi, 10), uvDup.val[1]));
+
+        y = vld1q_u16(srcYBot + x);
+        yLo = vandq_u32(vmovl_u16(vget_low_u16(y)), laneMask);
+        yHi = vandq_u32(vmovl_u16(vget_high_u16(y)), laneMask);
+        vst1q_u32(dstBot + x, vorrq_u32(vshlq_n_u32(yLo, 10), uvDup.val[0]));
+        vst1q_u32(dstBot + x + 4, vorrq_u32(vshlq_n_u32(yHi, 10), uvDup.val[1]));
+    }
+    return x;
+}
+
+// Converts 4 pixels from their Y and the U/V terms of their blue, green and red components.
+inline uint32x4_t convertToRGBA1010102Neon(
+        uint16x4_t y, int32x4_t bUV, int32x4_t gUV, int32x4_t rUV,
+        const YUVToRGBCoeffs &coeffs) {
+    const int32x4_t yMult = vmlaq_n_s32(
+            vdupq_n_s32(512),
+            vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(y)), vdupq_n_s32(coeffs._c16)),
+            coeffs._y);
+    // Arithmetic shifts round negative values down rather than towards zero like the scalar
+    // division, but those are clipped to 0 either way.
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t max = vdupq_n_s32(kMax10Bit);
+    const int32x4_t b = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(yMult, bUV), 10), zero), max);
+    const int32x4_t g = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(yMult, gUV), 10), zero), max);
+    const int32x4_t r = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(yMult, rUV), 10), zero), max);
+    return vorrq_u32(
+            vorrq_u32(vdupq_n_u32(kAlpha), vshlq_n_u32(vreinterpretq_u32_s32(b), 20)),
+            vorrq_u32(vshlq_n_u32(vreinterpretq_u32_s32(g), 10), vreinterpretq_u32_s32(r)));
+}
+
+size_t convert16ToRGBA1010102Neon(
+        uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+        const uint16_t *srcU, const uint16_t *srcV, size_t width, const YUVToRGBCoeffs &coeffs) {
+    const int32x4_t neutral = vdupq_n_s32(512);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const int32x4_t u = vsubq_s32(
+                vreinterpretq_s32_u32(vmovl_u16(vld1_u16(srcU + x / 2))), neutral);
+        const int32x4_t v = vsubq_s32(
+                vreinterpretq_s32_u32(vmovl_u16(vld1_u16(srcV + x / 2))), neutral);
+        const int32x4_t bUV = vmulq_n_s32(u, coeffs._b_u);
+        const int32x4_t gUV = vmlaq_n_s32(vmulq_n_s32(u, -coeffs._g_u), v, -coeffs._g_v);
+        const int32x4_t rUV = vmulq_n_s32(v, coeffs._r_v);
+        // each chroma sample for two pixels
+        const int32x4x2_t b = vzipq_s32(bUV, bUV);
+        const int32x4x2_t g = vzipq_s32(gUV, gUV);
+        const int32x4x2_t r = vzipq_s32(rUV, rUV);
+
+        uint16x8_t y = vld1q_u16(srcYTop + x);
+        vst1q_u32(dstTop + x, convertToRGBA1010102Neon(
+                vget_low_u16(y), b.val[0], g.val[0], r.val[0], coeffs));
+        vst1q_u32(dstTop + x + 4, convertToRGBA1010102Neon(
+                vget_high_u16(y), b.val[1], g.val[1], r.val[1], coeffs));
+
+        y = vld1q_u16(srcYBot + x);
+        vst1q_u32(dstBot + x, convertToRGBA1010102Neon(
+                vget_low_u16(y), b.val[0], g.val[0], r.val[0], coeffs));
+        vst1q_u32(dstBot + x + 4, convertToRGBA1010102Neon(
+                vget_high_u16(y), b.val[1], g.val[1], r.val[1], coeffs));
+    }
+    return x;
+}
+
+const PixelConversionKernels kNeonKernels = {
+    PixelConversionIsa::NEON,
+    convert16To8Neon,
+    convert16ToP010Neon,
+    convert16ToP010UVNeon,
+    convert16ToY410Neon,
+    convert16ToRGBA1010102Neon,
+};
+
+#endif  // PIXEL_CONVERSION_NEON
+
+// Returns the kernels of |isa|, or nullptr if the build or the CPU does not support it.
+const PixelConversionKernels *getKernels(PixelConversionIsa isa) {
+    switch (isa) {
+        case PixelConversionIsa::SCALAR:
+            return &kScalarKernels;
+#ifdef PIXEL_CONVERSION_X86
+        case PixelConversionIsa::SSE4_1:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.1") ? &kSse41Kernels : nullptr;
+        case PixelConversionIsa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+#endif
+#ifdef PIXEL_CONVERSION_NEON
+        case PixelConversionIsa::NEON:
+            return &kNeonKernels;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+const PixelConversionKernels *getBestKernels() {
+    for (PixelConversionIsa isa : { PixelConversionIsa::AVX2, PixelConversionIsa::SSE4_1,
+                                    PixelConversionIsa::NEON }) {
+        const PixelConversionKernels *kernels = getKernels(isa);
+        if (kernels != nullptr) {
+            return kernels;
+        }
+    }
+    return &kScalarKernels;
+}
+
+std::atomic<const PixelConversionKernels *> gKernels{nullptr};
+
+}  // namespace
+
+const PixelConversionKernels &GetPixelConversionKernels() {
+    const PixelConversionKernels *kernels = gKernels.load(std::memory_order_relaxed);
+    if (kernels == nullptr) {
+        kernels = getBestKernels();
+        ALOGV("using %d pixel conversion kernels", (int)kernels->isa);
+        gKernels.store(kernels, std::memory_order_relaxed);
+    }
+    return *kernels;
+}
+
+bool IsPixelConversionIsaSupported(PixelConversionIsa isa) {
+    return getKernels(isa) != nullptr;
+}
+
+bool SetPixelConversionIsa(PixelConversionIsa isa) {
+    const PixelConversionKernels *kernels = getKernels(isa);
+    if (kernels == nullptr) {
+        return false;
+    }
+    gKernels.store(kernels, std::memory_order_relaxed);
+    return true;
+}
+
+}  // namespace android
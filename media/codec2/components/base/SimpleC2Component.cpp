@@ -29,6 +29,7 @@
 #include <C2PlatformSupport.h>
 #include <Codec2BufferUtils.h>
 #include <Codec2CommonUtils.h>
+#include <PixelConversionKernels.h>
 #include <SimpleC2Component.h>
 
 namespace android {
@@ -73,6 +74,8 @@ void convertYUV420Planar8ToYV12(uint8_t *dstY, uint8_t *dstU, uint8_t *dstV, con
 void convertYUV420Planar16ToY410(uint32_t *dst, const uint16_t *srcY, const uint16_t *srcU,
                                  const uint16_t *srcV, size_t srcYStride, size_t srcUStride,
                                  size_t srcVStride, size_t dstStride, size_t width, size_t height) {
+    const PixelConversionKernels &kernels = GetPixelConversionKernels();
+
     // Converting two lines at a time, slightly faster
     for (size_t y = 0; y < height; y += 2) {
         uint32_t *dstTop = (uint32_t *)dst;
@@ -82,8 +85,16 @@ void convertYUV420Planar16ToY410(uint32_t *dst, const uint16_t *srcY, const uint
         uint16_t *uSrc = (uint16_t *)srcU;
         uint16_t *vSrc = (uint16_t *)srcV;
 
+        // Vectorized part of the lines, if any.
+        size_t x = kernels.convert16ToY410(dstTop, dstBot, ySrcTop, ySrcBot, uSrc, vSrc, width);
+        dstTop += x;
+        dstBot += x;
+        ySrcTop += x;
+        ySrcBot += x;
+        uSrc += x / 2;
+        vSrc += x / 2;
+
         uint32_t u01, v01, y01, y23, y45, y67, uv0, uv1;
-        size_t x = 0;
         for (; x < width - 3; x += 4) {
             u01 = *((uint32_t *)uSrc);
             uSrc += 2;
@@ -189,11 +200,7 @@ static C2ColorAspectsStruct FillMissingColorAspects(
 
 // matrix conversion coefficients
 // (see media/libstagefright/colorconverter/ColorConverter.cpp for more details)
-struct Coeffs {
-    int32_t _y, _b_u, _g_u, _g_v, _r_v, _c16;
-};
-
-static const struct Coeffs GetCoeffsForAspects(const C2ColorAspectsStruct &aspects) {
+static const YUVToRGBCoeffs GetCoeffsForAspects(const C2ColorAspectsStruct &aspects) {
     bool isFullRange = aspects.range == C2Color::RANGE_FULL;
 
     switch (aspects.matrix) {
@@ -202,9 +209,9 @@ static const struct Coeffs GetCoeffsForAspects(const C2ColorAspectsStruct &aspec
          * BT.601:  K_R = 0.299;  K_B = 0.114
          */
         if (isFullRange) {
-            return Coeffs { 1024, 1436, 352, 731, 1815, 0 };
+            return YUVToRGBCoeffs { 1024, 1436, 352, 731, 1815, 0 };
         } else {
-            return Coeffs { 1196, 1639, 402, 835, 2072, 64 };
+            return YUVToRGBCoeffs { 1196, 1639, 402, 835, 2072, 64 };
         }
         break;
 
@@ -213,9 +220,9 @@ static const struct Coeffs GetCoeffsForAspects(const C2ColorAspectsStruct &aspec
          * BT.709:  K_R = 0.2126;  K_B = 0.0722
          */
         if (isFullRange) {
-            return Coeffs { 1024, 1613, 192, 479, 1900, 0 };
+            return YUVToRGBCoeffs { 1024, 1613, 192, 479, 1900, 0 };
         } else {
-            return Coeffs { 1196, 1841, 219, 547, 2169, 64 };
+            return YUVToRGBCoeffs { 1196, 1841, 219, 547, 2169, 64 };
         }
         break;
 
@@ -225,9 +232,9 @@ static const struct Coeffs GetCoeffsForAspects(const C2ColorAspectsStruct &aspec
          * BT.2020:  K_R = 0.2627;  K_B = 0.0593
          */
         if (isFullRange) {
-            return Coeffs { 1024, 1510, 169, 585, 1927, 0 };
+            return YUVToRGBCoeffs { 1024, 1510, 169, 585, 1927, 0 };
         } else {
-            return Coeffs { 1196, 1724, 192, 668, 2200, 64 };
+            return YUVToRGBCoeffs { 1196, 1724, 192, 668, 2200, 64 };
         }
     }
 }
@@ -244,7 +251,7 @@ void convertYUV420Planar16ToRGBA1010102(
 
     C2ColorAspectsStruct _aspects = FillMissingColorAspects(aspects, width, height);
 
-    struct Coeffs coeffs = GetCoeffsForAspects(_aspects);
+    YUVToRGBCoeffs coeffs = GetCoeffsForAspects(_aspects);
 
     int32_t _y = coeffs._y;
     int32_t _b_u = coeffs._b_u;
@@ -253,6 +260,8 @@ void convertYUV420Planar16ToRGBA1010102(
     int32_t _r_v = coeffs._r_v;
     int32_t _c16 = coeffs._c16;
 
+    const PixelConversionKernels &kernels = GetPixelConversionKernels();
+
     // Converting two lines at a time, slightly faster
     for (size_t y = 0; y < height; y += 2) {
         uint32_t *dstTop = (uint32_t *)dst;
@@ -262,7 +271,17 @@ void convertYUV420Planar16ToRGBA1010102(
         uint16_t *uSrc = (uint16_t *)srcU;
         uint16_t *vSrc = (uint16_t *)srcV;
 
-        for (size_t x = 0; x < width; x += 2) {
+        // Vectorized part of the lines, if any.
+        size_t x = kernels.convert16ToRGBA1010102(
+                dstTop, dstBot, ySrcTop, ySrcBot, uSrc, vSrc, width, coeffs);
+        dstTop += x;
+        dstBot += x;
+        ySrcTop += x;
+        ySrcBot += x;
+        uSrc += x / 2;
+        vSrc += x / 2;
+
+        for (; x < width; x += 2) {
             int32_t u, v, y00, y01, y10, y11;
             u = *uSrc - 512;
             uSrc += 1;
@@ -348,8 +367,10 @@ void convertYUV420Planar16ToYV12(uint8_t *dstY, uint8_t *dstU, uint8_t *dstV, co
                                  size_t srcUStride, size_t srcVStride, size_t dstYStride,
                                  size_t dstUVStride, size_t width, size_t height,
                                  bool isMonochrome) {
+    const PixelConversionKernels &kernels = GetPixelConversionKernels();
+
     for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
+        for (size_t x = kernels.convert16To8(dstY, srcY, width); x < width; ++x) {
             dstY[x] = (uint8_t)(srcY[x] >> 2);
         }
         srcY += srcYStride;
@@ -367,9 +388,12 @@ void convertYUV420Planar16ToYV12(uint8_t *dstY, uint8_t *dstU, uint8_t *dstV, co
         return;
     }
 
+    const size_t uvWidth = (width + 1) / 2;
     for (size_t y = 0; y < (height + 1) / 2; ++y) {
-        for (size_t x = 0; x < (width + 1) / 2; ++x) {
+        for (size_t x = kernels.convert16To8(dstU, srcU, uvWidth); x < uvWidth; ++x) {
             dstU[x] = (uint8_t)(srcU[x] >> 2);
+        }
+        for (size_t x = kernels.convert16To8(dstV, srcV, uvWidth); x < uvWidth; ++x) {
             dstV[x] = (uint8_t)(srcV[x] >> 2);
         }
         srcU += srcUStride;
@@ -384,8 +408,10 @@ void convertYUV420Planar16ToP010(uint16_t *dstY, uint16_t *dstUV, const uint16_t
                                  size_t srcUStride, size_t srcVStride, size_t dstYStride,
                                  size_t dstUVStride, size_t width, size_t height,
                                  bool isMonochrome) {
+    const PixelConversionKernels &kernels = GetPixelConversionKernels();
+
     for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
+        for (size_t x = kernels.convert16ToP010(dstY, srcY, width); x < width; ++x) {
             dstY[x] = srcY[x] << 6;
         }
         srcY += srcYStride;
@@ -404,8 +430,9 @@ void convertYUV420Planar16ToP010(uint16_t *dstY, uint16_t *dstUV, const uint16_t
         return;
     }
 
+    const size_t uvWidth = (width + 1) / 2;
     for (size_t y = 0; y < (height + 1) / 2; ++y) {
-        for (size_t x = 0; x < (width + 1) / 2; ++x) {
+        for (size_t x = kernels.convert16ToP010UV(dstUV, srcU, srcV, uvWidth); x < uvWidth; ++x) {
             dstUV[2 * x] = srcU[x] << 6;
             dstUV[2 * x + 1] = srcV[x] << 6;
         }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CODEC_THREAD_BUDGET_H_
+#define CODEC_THREAD_BUDGET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace android {
+
+/**
+ * Shares a budget of threads between the software codecs of a process, so that concurrent codecs
+ * do not each start as many threads as the CPU has cores.
+ *
+ * A codec holds a lease while its codec library exists. Each lease gets at least one thread, and
+ * the rest of the budget is split in proportion to the pixel rates of the codecs, up to the number
+ * of threads each codec can use. The leases are rebalanced as codecs come and go, or change their
+ * resolution or frame rate. A codec picks up its new share at the next point where it can change
+ * the threads of its library without losing decoder state, such as a flush, a decoder reset or
+ * a key frame.
+ */
+class CodecThreadBudget {
+public:
+    class Lease {
+    public:
+        ~Lease();
+
+        /**
+         * Returns the number of threads the codec may use. This is never 0.
+         */
+        size_t threads() const { return mThreads.load(std::memory_order_relaxed); }
+
+        /**
+         * Updates the resolution and frame rate of the codec, and rebalances the budget.
+         * |frameRate| may be 0 if unknown.
+         */
+        void setLoad(uint32_t width, uint32_t height, float frameRate);
+
+    private:
+        friend class CodecThreadBudget;
+
+        Lease(CodecThreadBudget *budget, size_t maxThreads, double load);
+
+        CodecThreadBudget *const mBudget;
+        const size_t mMaxThreads;
+        // pixels per second; guarded by the lock of |mBudget|
+        double mLoad;
+        std::atomic<size_t> mThreads;
+    };
+
+    /**
+     * Creates a budget of |threads| threads. A budget of 0 threads does not limit the codecs,
+     * which then get the maximum number of threads they ask for.
+     */
+    explicit CodecThreadBudget(size_t threads);
+
+    /**
+     * Leases threads for a codec that can use up to |maxThreads| threads to process frames of
+     * |width| x |height| pixels at |frameRate| frames per second. |frameRate| may be 0 if unknown.
+     * The lease must not outlive the budget.
+     */
+    std::unique_ptr<Lease> acquire(
+            size_t maxThreads, uint32_t width, uint32_t height, float frameRate);
+
+    /**
+     * Returns the number of threads of the budget, 0 if unlimited.
+     */
+    size_t threads() const;
+
+    /**
+     * Changes the number of threads of the budget, and rebalances the leases. Meant for tests and
+     * benchmarks.
+     */
+    void setThreads(size_t threads);
+
+private:
+    static double Load(uint32_t width, uint32_t height, float frameRate);
+
+    void rebalance_l();
+
+    mutable std::mutex mLock;
+    size_t mThreads;
+    std::list<Lease *> mLeases;
+};
+
+/**
+ * Returns the budget shared by the software codecs of the process. Its number of threads is the
+ * media.c2.sw.thread_budget property: a negative value (the default) makes the budget the number
+ * of online CPU cores, and 0 does not limit the codecs.
+ */
+CodecThreadBudget &GetCodecThreadBudget();
+
+}  // namespace android
+
+#endif  // CODEC_THREAD_BUDGET_H_
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PIXEL_CONVERSION_KERNELS_H_
+#define PIXEL_CONVERSION_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// YUV to RGB matrix coefficients, in 10 bit fixed point.
+// (see media/libstagefright/colorconverter/ColorConverter.cpp for more details)
+struct YUVToRGBCoeffs {
+    int32_t _y, _b_u, _g_u, _g_v, _r_v, _c16;
+};
+
+// Instruction sets that the row kernels of the YUV conversions are implemented with.
+enum class PixelConversionIsa {
+    SCALAR,
+    SSE4_1,
+    AVX2,
+    NEON,
+};
+
+// Row kernels of the YUV conversions declared in SimpleC2Component.h. A kernel converts as many
+// whole vectors of pixels from the start of the row as fit, and returns how many pixels it
+// converted. The conversions finish each row with their scalar loop, so that the output is
+// bit-exact whichever instruction set is used. The scalar kernels convert nothing.
+struct PixelConversionKernels {
+    PixelConversionIsa isa;
+
+    // dst[i] = src[i] >> 2, of |count| samples.
+    size_t (*convert16To8)(uint8_t *dst, const uint16_t *src, size_t count);
+
+    // dst[i] = src[i] << 6, of |count| samples.
+    size_t (*convert16ToP010)(uint16_t *dst, const uint16_t *src, size_t count);
+
+    // dstUV[2 * i] = srcU[i] << 6 and dstUV[2 * i + 1] = srcV[i] << 6, of |count| samples
+    // of each plane.
+    size_t (*convert16ToP010UV)(
+            uint16_t *dstUV, const uint16_t *srcU, const uint16_t *srcV, size_t count);
+
+    // Two rows of Y410 pixels from two rows of Y and one of U and V, of |width| pixels.
+    size_t (*convert16ToY410)(
+            uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+            const uint16_t *srcU, const uint16_t *srcV, size_t width);
+
+    // Two rows of RGBA1010102 pixels from two rows of Y and one of U and V, of |width| pixels.
+    size_t (*convert16ToRGBA1010102)(
+            uint32_t *dstTop, uint32_t *dstBot, const uint16_t *srcYTop, const uint16_t *srcYBot,
+            const uint16_t *srcU, const uint16_t *srcV, size_t width,
+            const YUVToRGBCoeffs &coeffs);
+};
+
+// Returns the kernels that the conversions use, by default those of the best instruction set
+// the CPU supports.
+const PixelConversionKernels &GetPixelConversionKernels();
+
+// Returns whether the build and the CPU support the kernels of |isa|.
+bool IsPixelConversionIsaSupported(PixelConversionIsa isa);
+
+// Makes the conversions use the kernels of |isa|, for tests and benchmarks. Returns false and
+// keeps the current kernels if |isa| is not supported.
+bool SetPixelConversionIsa(PixelConversionIsa isa);
+
+}  // namespace android
+
+#endif  // PIXEL_CONVERSION_KERNELS_H_
@@ -330,6 +330,7 @@ class C2SoftGav1Dec::IntfImpl : public SimpleInterface<void>::BaseParams {
 
   // unsafe getters
   std::shared_ptr<C2StreamPixelFormatInfo::output> getPixelFormat_l() const { return mPixelFormat; }
+  std::shared_ptr<C2StreamPictureSizeInfo::output> getSize_l() const { return mSize; }
 
  private:
   std::shared_ptr<C2StreamProfileLevelInfo::input> mProfileLevel;
@@ -419,10 +420,19 @@ bool C2SoftGav1Dec::initDecoder() {
   mSignalledError = false;
   mSignalledOutputEos = false;
   mHalPixelFormat = HAL_PIXEL_FORMAT_YV12;
+  std::shared_ptr<C2StreamPictureSizeInfo::output> size;
   {
       IntfImpl::Lock lock = mIntf->lock();
       mPixelFormatInfo = mIntf->getPixelFormat_l();
+      size = mIntf->getSize_l();
   }
+  mThreadLease = GetCodecThreadBudget().acquire(GetCPUCoreCount(), size->width,
+                                                size->height, 0 /* frameRate */);
+  return initCodecContext();
+}
+
+// Creates mCodecCtx with the threads of the lease.
+bool C2SoftGav1Dec::initCodecContext() {
   mCodecCtx.reset(new libgav1::Decoder());
 
   if (mCodecCtx == nullptr) {
@@ -431,7 +441,7 @@ bool C2SoftGav1Dec::initDecoder() {
   }
 
   libgav1::DecoderSettings settings = {};
-  settings.threads = GetCPUCoreCount();
+  settings.threads = mThreads = mThreadLease->threads();
 
   ALOGV("Using libgav1 AV1 software decoder.");
   Libgav1StatusCode status = mCodecCtx->Init(&settings);
@@ -443,7 +453,10 @@ bool C2SoftGav1Dec::initDecoder() {
   return true;
 }
 
-void C2SoftGav1Dec::destroyDecoder() { mCodecCtx = nullptr; }
+void C2SoftGav1Dec::destroyDecoder() {
+  mCodecCtx = nullptr;
+  mThreadLease.reset();
+}
 
 void fillEmptyWork(const std::unique_ptr<C2Work> &work) {
   uint32_t flags = 0;
@@ -486,6 +499,58 @@ void C2SoftGav1Dec::finishWork(uint64_t index,
   }
 }
 
+// Returns whether the temporal unit starts a new coded video sequence, with a sequence header
+// and a shown key frame, which replaces all the reference frames.
+static bool isKeyTemporalUnit(const uint8_t *data, size_t size) {
+  constexpr int kObuSequenceHeader = 1;
+  constexpr int kObuFrameHeader = 3;
+  constexpr int kObuFrame = 6;
+  bool sequenceHeader = false;
+  bool reducedStillPictureHeader = false;
+  while (size > 0) {
+    // obu_forbidden_bit f(1), obu_type f(4), obu_extension_flag f(1), obu_has_size_field f(1)
+    const int type = (data[0] >> 3) & 0xf;
+    size_t headerSize = (data[0] & 0x4) ? 2 : 1;
+    if (!(data[0] & 0x2)) {
+      return false;
+    }
+    uint64_t obuSize = 0;
+    size_t i = 0;
+    for (; i < 8; ++i) {
+      if (headerSize + i >= size) {
+        return false;
+      }
+      const uint8_t byte = data[headerSize + i];
+      obuSize |= uint64_t(byte & 0x7f) << (7 * i);
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    if (i == 8) {
+      return false;
+    }
+    headerSize += i + 1;
+    if (obuSize > size - headerSize) {
+      return false;
+    }
+    const uint8_t *payload = data + headerSize;
+    if (type == kObuSequenceHeader && obuSize > 0) {
+      // seq_profile f(3), still_picture f(1), reduced_still_picture_header f(1)
+      sequenceHeader = true;
+      reducedStillPictureHeader = payload[0] & 0x8;
+    } else if ((type == kObuFrameHeader || type == kObuFrame) && obuSize > 0) {
+      if (!sequenceHeader) {
+        return false;
+      }
+      // show_existing_frame f(1), frame_type f(2) with KEY_FRAME 0, show_frame f(1)
+      return reducedStillPictureHeader || (payload[0] & 0xf0) == 0x10;
+    }
+    data += headerSize + obuSize;
+    size -= headerSize + obuSize;
+  }
+  return false;
+}
+
 void C2SoftGav1Dec::process(const std::unique_ptr<C2Work> &work,
                             const std::shared_ptr<C2BlockPool> &pool) {
   work->result = C2_OK;
@@ -527,6 +592,21 @@ void C2SoftGav1Dec::process(const std::unique_ptr<C2Work> &work,
   if (inSize) {
     uint8_t *bitstream = const_cast<uint8_t *>(rView.data() + inOffset);
 
+    // A new coded video sequence is where the decoder can be recreated with its current share
+    // of the thread budget. This covers the first temporal unit after a flush and resolution
+    // changes.
+    if (mThreadLease->threads() != mThreads &&
+        isKeyTemporalUnit(bitstream, inSize)) {
+      ALOGV("changing from %zu to %zu threads", mThreads, mThreadLease->threads());
+      drainInternal(DRAIN_COMPONENT_NO_EOS, pool, work);
+      if (!initCodecContext()) {
+        work->result = C2_CORRUPTED;
+        work->workletsProcessed = 1u;
+        mSignalledError = true;
+        return;
+      }
+    }
+
     mTimeStart = systemTime();
     nsecs_t delay = mTimeStart - mTimeEnd;
 
@@ -616,6 +696,7 @@ bool C2SoftGav1Dec::outputBuffer(const std::shared_ptr<C2BlockPool> &pool,
   if (width != mWidth || height != mHeight) {
     mWidth = width;
     mHeight = height;
+    mThreadLease->setLoad(mWidth, mHeight, 0 /* frameRate */);
 
     C2StreamPictureSizeInfo::output size(0u, mWidth, mHeight);
     std::vector<std::unique_ptr<C2SettingResult>> failures;
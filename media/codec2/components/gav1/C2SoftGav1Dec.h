@@ -21,6 +21,7 @@
 
 #include <media/stagefright/foundation/ColorUtils.h>
 
+#include <CodecThreadBudget.h>
 #include <SimpleC2Component.h>
 #include <C2Config.h>
 #include "libgav1/src/gav1/decoder.h"
@@ -50,6 +51,8 @@ struct C2SoftGav1Dec : public SimpleC2Component {
  private:
   std::shared_ptr<IntfImpl> mIntf;
   std::unique_ptr<libgav1::Decoder> mCodecCtx;
+  std::unique_ptr<CodecThreadBudget::Lease> mThreadLease;
+  size_t mThreads = 0;  // threads of mCodecCtx
 
   // configurations used by component in process
   // (TODO: keep this in intf but make them internal only)
@@ -86,6 +89,7 @@ struct C2SoftGav1Dec : public SimpleC2Component {
   nsecs_t mTimeEnd = 0;    // Time at the end of decode()
 
   bool initDecoder();
+  bool initCodecContext();
   void getVuiParams(const libgav1::DecoderBuffer *buffer);
   void destroyDecoder();
   void finishWork(uint64_t index, const std::unique_ptr<C2Work>& work,
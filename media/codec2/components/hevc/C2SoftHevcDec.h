@@ -21,6 +21,7 @@
 
 #include <atomic>
 #include <inttypes.h>
+#include <CodecThreadBudget.h>
 #include <SimpleC2Component.h>
 
 #include "ihevc_typedefs.h"
@@ -110,6 +111,7 @@ struct C2SoftHevcDec : public SimpleC2Component {
     uint8_t *mOutBufferFlush;
 
     size_t mNumCores;
+    std::unique_ptr<CodecThreadBudget::Lease> mThreadLease;
     IV_COLOR_FORMAT_T mIvColorformat;
     uint32_t mOutputDelay;
     uint32_t mWidth;
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <CodecThreadBudget.h>
+#include <benchmark/benchmark.h>
+
+using namespace android;
+
+namespace {
+
+constexpr size_t kWidth = 1920;
+constexpr size_t kHeight = 1080;
+constexpr size_t kFramesPerCodec = 16;
+// Each frame is split in bands of rows, like the tiles or rows that the decoders share between
+// their threads.
+constexpr size_t kBandsPerFrame = 34;
+
+/**
+ * Decodes frames of synthetic work with a number of threads. The threads process the bands of a
+ * frame, and wait for each other at the end of the frame as frame-threaded decoders do.
+ */
+class SyntheticDecoder {
+public:
+    explicit SyntheticDecoder(size_t threads) : mPlane(kWidth * kHeight, 0x80) {
+        for (size_t i = 1; i < threads; ++i) {
+            mThreads.emplace_back([this] { threadLoop(); });
+        }
+    }
+
+    ~SyntheticDecoder() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mExit = true;
+        }
+        mCond.notify_all();
+        for (std::thread &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    void decodeFrame() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mNextBand = 0;
+            mBandsDone = 0;
+            ++mFrame;
+        }
+        mCond.notify_all();
+        processBands();
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this] { return mBandsDone == kBandsPerFrame; });
+    }
+
+private:
+    void threadLoop() {
+        uint64_t frame = 0;
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mCond.wait(lock, [this, frame] { return mExit || mFrame != frame; });
+            if (mExit) {
+                return;
+            }
+            frame = mFrame;
+            lock.unlock();
+            processBands();
+            lock.lock();
+        }
+    }
+
+    void processBands() {
+        size_t done = 0;
+        for (size_t band = mNextBand++; band < kBandsPerFrame; band = mNextBand++) {
+            const size_t top = kHeight * band / kBandsPerFrame;
+            const size_t bottom = kHeight * (band + 1) / kBandsPerFrame;
+            for (size_t y = top; y < bottom; ++y) {
+                uint8_t *row = mPlane.data() + y * kWidth;
+                for (size_t x = 1; x + 1 < kWidth; ++x) {
+                    row[x] = (row[x - 1] + 2 * row[x] + row[x + 1] + 2) >> 2;
+                }
+            }
+            ++done;
+        }
+        if (done > 0) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mBandsDone += done;
+            if (mBandsDone == kBandsPerFrame) {
+                mCond.notify_all();
+            }
+        }
+    }
+
+    std::vector<uint8_t> mPlane;
+    std::vector<std::thread> mThreads;
+    std::atomic<size_t> mNextBand{kBandsPerFrame};
+    std::mutex mLock;
+    std::condition_variable mCond;
+    uint64_t mFrame{0};
+    size_t mBandsDone{0};
+    bool mExit{false};
+};
+
+// Args are the number of concurrent codecs, and whether the thread budget limits them to the
+// number of CPU cores. The codecs lease their threads before any of them starts decoding.
+void BM_ConcurrentDecodes(benchmark::State &state) {
+    const size_t numCodecs = state.range(0);
+    const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    CodecThreadBudget budget(state.range(1) ? cores : 0);
+    std::vector<std::unique_ptr<CodecThreadBudget::Lease>> leases;
+    for (size_t i = 0; i < numCodecs; ++i) {
+        leases.push_back(budget.acquire(cores, kWidth, kHeight, 30));
+    }
+    for (auto _ : state) {
+        std::vector<std::thread> codecs;
+        for (size_t i = 0; i < numCodecs; ++i) {
+            codecs.emplace_back([threads = leases[i]->threads()] {
+                SyntheticDecoder decoder(threads);
+                for (size_t frame = 0; frame < kFramesPerCodec; ++frame) {
+                    decoder.decodeFrame();
+                }
+            });
+        }
+        for (std::thread &codec : codecs) {
+            codec.join();
+        }
+    }
+    state.counters["fps"] = benchmark::Counter(
+            state.iterations() * numCodecs * kFramesPerCodec, benchmark::Counter::kIsRate);
+    state.counters["threads"] = leases[0]->threads();
+}
+
+}  // namespace
+
+BENCHMARK(BM_ConcurrentDecodes)
+        ->ArgNames({ "codecs", "budget" })
+        ->ArgsProduct({ { 1, 2, 4, 8, 16 }, { 0, 1 } })
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2SoftCodecThreadBudgetTest"
+#include <log/log.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <CodecThreadBudget.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+TEST(CodecThreadBudgetTest, Unlimited) {
+    CodecThreadBudget budget(0);
+    std::unique_ptr<CodecThreadBudget::Lease> a = budget.acquire(8, 1920, 1080, 30);
+    std::unique_ptr<CodecThreadBudget::Lease> b = budget.acquire(4, 1920, 1080, 30);
+    EXPECT_EQ(8u, a->threads());
+    EXPECT_EQ(4u, b->threads());
+}
+
+TEST(CodecThreadBudgetTest, SplitsByPixelRate) {
+    CodecThreadBudget budget(8);
+    std::unique_ptr<CodecThreadBudget::Lease> a = budget.acquire(8, 1920, 1080, 30);
+    EXPECT_EQ(8u, a->threads());
+
+    std::unique_ptr<CodecThreadBudget::Lease> b = budget.acquire(8, 1920, 1080, 30);
+    EXPECT_EQ(4u, a->threads());
+    EXPECT_EQ(4u, b->threads());
+
+    std::unique_ptr<CodecThreadBudget::Lease> c = budget.acquire(8, 640, 480, 30);
+    EXPECT_EQ(1u, c->threads());
+    EXPECT_EQ(7u, a->threads() + b->threads());
+    EXPECT_LE(3u, std::min(a->threads(), b->threads()));
+
+    // the codecs that stay get the threads of those that stop
+    c.reset();
+    EXPECT_EQ(4u, a->threads());
+    EXPECT_EQ(4u, b->threads());
+    b.reset();
+    EXPECT_EQ(8u, a->threads());
+}
+
+TEST(CodecThreadBudgetTest, SetLoad) {
+    CodecThreadBudget budget(8);
+    std::unique_ptr<CodecThreadBudget::Lease> a = budget.acquire(8, 1920, 1080, 30);
+    std::unique_ptr<CodecThreadBudget::Lease> b = budget.acquire(8, 1920, 1080, 30);
+    a->setLoad(3840, 2160, 60);
+    EXPECT_EQ(7u, a->threads());
+    EXPECT_EQ(1u, b->threads());
+
+    // codecs that do not know their frame rate count as 30 fps
+    a->setLoad(1920, 1080, 0);
+    EXPECT_EQ(4u, a->threads());
+    EXPECT_EQ(4u, b->threads());
+}
+
+TEST(CodecThreadBudgetTest, MaxThreads) {
+    CodecThreadBudget budget(8);
+    std::unique_ptr<CodecThreadBudget::Lease> a = budget.acquire(2, 3840, 2160, 30);
+    std::unique_ptr<CodecThreadBudget::Lease> b = budget.acquire(8, 640, 480, 30);
+    EXPECT_EQ(2u, a->threads());
+    EXPECT_EQ(6u, b->threads());
+
+    std::unique_ptr<CodecThreadBudget::Lease> c = budget.acquire(0, 640, 480, 30);
+    EXPECT_EQ(1u, c->threads());
+}
+
+TEST(CodecThreadBudgetTest, MoreCodecsThanThreads) {
+    CodecThreadBudget budget(2);
+    std::vector<std::unique_ptr<CodecThreadBudget::Lease>> leases;
+    for (size_t i = 0; i < 3; ++i) {
+        leases.push_back(budget.acquire(4, 1920, 1080, 30));
+    }
+    for (const std::unique_ptr<CodecThreadBudget::Lease> &lease : leases) {
+        EXPECT_EQ(1u, lease->threads());
+    }
+}
+
+TEST(CodecThreadBudgetTest, SetThreads) {
+    CodecThreadBudget budget(2);
+    std::unique_ptr<CodecThreadBudget::Lease> a = budget.acquire(4, 1920, 1080, 30);
+    std::unique_ptr<CodecThreadBudget::Lease> b = budget.acquire(4, 1920, 1080, 30);
+    EXPECT_EQ(1u, a->threads());
+
+    budget.setThreads(6);
+    EXPECT_EQ(6u, budget.threads());
+    EXPECT_EQ(3u, a->threads());
+    EXPECT_EQ(3u, b->threads());
+
+    budget.setThreads(0);
+    EXPECT_EQ(4u, a->threads());
+    EXPECT_EQ(4u, b->threads());
+}
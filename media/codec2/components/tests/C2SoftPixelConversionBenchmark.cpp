@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <C2Config.h>
+#include <PixelConversionKernels.h>
+#include <SimpleC2Component.h>
+#include <benchmark/benchmark.h>
+
+using namespace android;
+
+namespace {
+
+// 16 bit YUV 4:2:0 source frame.
+struct Source {
+    Source(size_t width, size_t height)
+        : width(width), height(height), y(width * height), u(width * height / 4),
+          v(width * height / 4) {
+        std::mt19937 random(0x5eed);
+        std::uniform_int_distribution<uint16_t> dist(0, 1023);
+        for (std::vector<uint16_t> *plane : { &y, &u, &v }) {
+            for (uint16_t &sample : *plane) {
+                sample = dist(random);
+            }
+        }
+    }
+
+    size_t width;
+    size_t height;
+    std::vector<uint16_t> y;
+    std::vector<uint16_t> u;
+    std::vector<uint16_t> v;
+};
+
+// Args are the instruction set, then the width and height of the frame.
+template <typename Convert>
+void benchmarkConversion(benchmark::State &state, Convert convert) {
+    const PixelConversionIsa defaultIsa = GetPixelConversionKernels().isa;
+    if (!SetPixelConversionIsa((PixelConversionIsa)state.range(0))) {
+        state.SkipWithError("instruction set not supported");
+        return;
+    }
+    const Source src(state.range(1), state.range(2));
+    for (auto _ : state) {
+        convert(src);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * src.width * src.height);
+    SetPixelConversionIsa(defaultIsa);
+}
+
+void BM_ConvertToY410(benchmark::State &state) {
+    std::vector<uint32_t> dst(state.range(1) * state.range(2));
+    benchmarkConversion(state, [&dst](const Source &src) {
+        convertYUV420Planar16ToY410(dst.data(), src.y.data(), src.u.data(), src.v.data(),
+                                    src.width, src.width / 2, src.width / 2, src.width,
+                                    src.width, src.height);
+    });
+}
+
+void BM_ConvertToRGBA1010102(benchmark::State &state) {
+    std::vector<uint32_t> dst(state.range(1) * state.range(2));
+    benchmarkConversion(state, [&dst](const Source &src) {
+        convertYUV420Planar16ToRGBA1010102(dst.data(), src.y.data(), src.u.data(), src.v.data(),
+                                           src.width, src.width / 2, src.width / 2, src.width,
+                                           src.width, src.height);
+    });
+}
+
+void BM_ConvertToYV12(benchmark::State &state) {
+    std::vector<uint8_t> dst(state.range(1) * state.range(2) * 3 / 2);
+    benchmarkConversion(state, [&dst](const Source &src) {
+        uint8_t *dstY = dst.data();
+        uint8_t *dstV = dstY + src.width * src.height;
+        uint8_t *dstU = dstV + src.width * src.height / 4;
+        convertYUV420Planar16ToYV12(dstY, dstU, dstV, src.y.data(), src.u.data(), src.v.data(),
+                                    src.width, src.width / 2, src.width / 2, src.width,
+                                    src.width / 2, src.width, src.height);
+    });
+}
+
+void BM_ConvertToP010(benchmark::State &state) {
+    std::vector<uint16_t> dst(state.range(1) * state.range(2) * 3 / 2);
+    benchmarkConversion(state, [&dst](const Source &src) {
+        uint16_t *dstY = dst.data();
+        uint16_t *dstUV = dstY + src.width * src.height;
+        convertYUV420Planar16ToP010(dstY, dstUV, src.y.data(), src.u.data(), src.v.data(),
+                                    src.width, src.width / 2, src.width / 2, src.width,
+                                    src.width, src.width, src.height);
+    });
+}
+
+void conversionArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "isa", "width", "height" });
+    for (PixelConversionIsa isa : { PixelConversionIsa::SCALAR, PixelConversionIsa::SSE4_1,
+                                    PixelConversionIsa::AVX2, PixelConversionIsa::NEON }) {
+        if (!IsPixelConversionIsaSupported(isa)) {
+            continue;
+        }
+        b->Args({ (int)isa, 1280, 720 });
+        b->Args({ (int)isa, 1920, 1080 });
+        b->Args({ (int)isa, 3840, 2160 });
+    }
+}
+
+}  // namespace
+
+BENCHMARK(BM_ConvertToY410)->Apply(conversionArgs);
+BENCHMARK(BM_ConvertToRGBA1010102)->Apply(conversionArgs);
+BENCHMARK(BM_ConvertToYV12)->Apply(conversionArgs);
+BENCHMARK(BM_ConvertToP010)->Apply(conversionArgs);
+
+BENCHMARK_MAIN();
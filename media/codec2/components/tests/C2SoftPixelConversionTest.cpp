@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2SoftPixelConversionTest"
+#include <log/log.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <C2Config.h>
+#include <PixelConversionKernels.h>
+#include <SimpleC2Component.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+namespace {
+
+// Widths with and without a scalar tail after the vectorized part of the rows.
+const size_t kWidths[] = { 4, 6, 8, 14, 16, 34, 64, 94, 258, 1282 };
+const size_t kHeight = 6;
+
+// Strides are aligned as in the graphic buffers, with some padding.
+size_t alignedStride(size_t width) {
+    return (width + 31) & ~15;
+}
+
+std::string isaName(PixelConversionIsa isa) {
+    switch (isa) {
+        case PixelConversionIsa::SCALAR: return "Scalar";
+        case PixelConversionIsa::SSE4_1: return "Sse41";
+        case PixelConversionIsa::AVX2: return "Avx2";
+        case PixelConversionIsa::NEON: return "Neon";
+    }
+    return "Unknown";
+}
+
+}  // namespace
+
+// Checks that the conversions produce the same output with the kernels of an instruction set as
+// with the scalar ones.
+class PixelConversionTest : public ::testing::TestWithParam<PixelConversionIsa> {
+public:
+    void SetUp() override {
+        mIsa = GetParam();
+        mDefaultIsa = GetPixelConversionKernels().isa;
+        if (!IsPixelConversionIsaSupported(mIsa)) {
+            GTEST_SKIP() << isaName(mIsa) << " is not supported";
+        }
+    }
+
+    void TearDown() override {
+        SetPixelConversionIsa(mDefaultIsa);
+    }
+
+    // Fills the planes of a |width| x |height| picture with random |bits| bit samples.
+    void fillSource(size_t width, size_t height, int bits) {
+        mYStride = alignedStride(width);
+        mUVStride = alignedStride((width + 1) / 2);
+        // The two line conversions read a line past odd heights.
+        const size_t lines = height + 1;
+        mSrcY.resize(mYStride * lines);
+        mSrcU.resize(mUVStride * ((lines + 1) / 2));
+        mSrcV.resize(mUVStride * ((lines + 1) / 2));
+        std::uniform_int_distribution<uint32_t> dist(0, (1u << bits) - 1);
+        for (std::vector<uint16_t> *plane : { &mSrcY, &mSrcU, &mSrcV }) {
+            for (uint16_t &sample : *plane) {
+                sample = dist(mRandom);
+            }
+        }
+    }
+
+    // Runs |convert| with the scalar kernels then the tested ones, and compares the outputs.
+    template <typename T, typename Convert>
+    void compare(size_t size, Convert convert, const std::string &what) {
+        std::vector<T> expected(size, 0);
+        std::vector<T> actual(size, 0);
+        ASSERT_TRUE(SetPixelConversionIsa(PixelConversionIsa::SCALAR));
+        convert(expected.data());
+        ASSERT_TRUE(SetPixelConversionIsa(mIsa));
+        convert(actual.data());
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQ(expected[i], actual[i]) << what << " differs at " << i;
+        }
+    }
+
+    PixelConversionIsa mIsa;
+    PixelConversionIsa mDefaultIsa;
+    std::mt19937 mRandom{0x5eed};
+    std::vector<uint16_t> mSrcY;
+    std::vector<uint16_t> mSrcU;
+    std::vector<uint16_t> mSrcV;
+    size_t mYStride;
+    size_t mUVStride;
+};
+
+TEST_P(PixelConversionTest, Y410) {
+    for (int bits : { 10, 16 }) {
+        for (size_t width : kWidths) {
+            fillSource(width, kHeight, bits);
+            const size_t dstStride = alignedStride(width);
+            compare<uint32_t>(dstStride * kHeight, [&](uint32_t *dst) {
+                convertYUV420Planar16ToY410(dst, mSrcY.data(), mSrcU.data(), mSrcV.data(),
+                                            mYStride, mUVStride, mUVStride, dstStride,
+                                            width, kHeight);
+            }, "Y410 width " + std::to_string(width) + " bits " + std::to_string(bits));
+        }
+    }
+}
+
+TEST_P(PixelConversionTest, RGBA1010102) {
+    const std::vector<std::shared_ptr<const C2ColorAspectsStruct>> aspects = {
+        nullptr,
+        std::make_shared<C2ColorAspectsStruct>(
+                C2Color::RANGE_FULL, C2Color::PRIMARIES_BT601_625,
+                C2Color::TRANSFER_UNSPECIFIED, C2Color::MATRIX_BT601),
+        std::make_shared<C2ColorAspectsStruct>(
+                C2Color::RANGE_LIMITED, C2Color::PRIMARIES_BT709,
+                C2Color::TRANSFER_UNSPECIFIED, C2Color::MATRIX_BT709),
+        std::make_shared<C2ColorAspectsStruct>(
+                C2Color::RANGE_LIMITED, C2Color::PRIMARIES_BT2020,
+                C2Color::TRANSFER_ST2084, C2Color::MATRIX_BT2020),
+    };
+    for (int bits : { 10, 16 }) {
+        for (size_t i = 0; i < aspects.size(); ++i) {
+            for (size_t width : kWidths) {
+                fillSource(width, kHeight, bits);
+                const size_t dstStride = alignedStride(width);
+                compare<uint32_t>(dstStride * kHeight, [&](uint32_t *dst) {
+                    convertYUV420Planar16ToRGBA1010102(
+                            dst, mSrcY.data(), mSrcU.data(), mSrcV.data(), mYStride, mUVStride,
+                            mUVStride, dstStride, width, kHeight, aspects[i]);
+                }, "RGBA1010102 aspects " + std::to_string(i) + " width "
+                        + std::to_string(width) + " bits " + std::to_string(bits));
+            }
+        }
+    }
+}
+
+TEST_P(PixelConversionTest, YV12) {
+    for (size_t height : { kHeight, kHeight - 1 }) {
+        for (size_t width : kWidths) {
+            for (size_t oddWidth : { width, width + 1 }) {
+                fillSource(oddWidth, height, 16);
+                const size_t dstYStride = alignedStride(oddWidth);
+                const size_t dstUVStride = alignedStride((oddWidth + 1) / 2);
+                const size_t ySize = dstYStride * height;
+                const size_t uvSize = dstUVStride * ((height + 1) / 2);
+                compare<uint8_t>(ySize + 2 * uvSize, [&](uint8_t *dst) {
+                    convertYUV420Planar16ToYV12(
+                            dst, dst + ySize + uvSize, dst + ySize, mSrcY.data(), mSrcU.data(),
+                            mSrcV.data(), mYStride, mUVStride, mUVStride, dstYStride,
+                            dstUVStride, oddWidth, height);
+                }, "YV12 " + std::to_string(oddWidth) + "x" + std::to_string(height));
+            }
+        }
+    }
+}
+
+TEST_P(PixelConversionTest, P010) {
+    for (size_t height : { kHeight, kHeight - 1 }) {
+        for (size_t width : kWidths) {
+            for (size_t oddWidth : { width, width + 1 }) {
+                fillSource(oddWidth, height, 16);
+                const size_t dstYStride = alignedStride(oddWidth);
+                const size_t dstUVStride = dstYStride;
+                const size_t ySize = dstYStride * height;
+                const size_t uvSize = dstUVStride * ((height + 1) / 2);
+                compare<uint16_t>(ySize + uvSize, [&](uint16_t *dst) {
+                    convertYUV420Planar16ToP010(
+                            dst, dst + ySize, mSrcY.data(), mSrcU.data(), mSrcV.data(),
+                            mYStride, mUVStride, mUVStride, dstYStride, dstUVStride,
+                            oddWidth, height);
+                }, "P010 " + std::to_string(oddWidth) + "x" + std::to_string(height));
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        PixelConversionIsas, PixelConversionTest,
+        ::testing::Values(PixelConversionIsa::SSE4_1, PixelConversionIsa::AVX2,
+                          PixelConversionIsa::NEON),
+        [](const ::testing::TestParamInfo<PixelConversionIsa> &info) {
+            return isaName(info.param);
+        });
@@ -462,9 +462,33 @@ status_t C2SoftVpxDec::initDecoder() {
         return NO_MEMORY;
     }
 
+    mThreadLease = GetCodecThreadBudget().acquire(
+            GetCPUCoreCount(), mWidth, mHeight, 0 /* frameRate */);
+    status_t err = initCodecContext();
+    if (err != OK) {
+        return err;
+    }
+
+    if (mMode == MODE_VP9) {
+        using namespace std::string_literals;
+        for (int i = 0; i < mCoreCount; ++i) {
+            sp<ConverterThread> thread(new ConverterThread(mQueue));
+            mConverterThreads.push_back(thread);
+            if (thread->run(("vp9conv #"s + std::to_string(i)).c_str(),
+                            ANDROID_PRIORITY_AUDIO) != OK) {
+                return UNKNOWN_ERROR;
+            }
+        }
+    }
+
+    return OK;
+}
+
+// Initializes mCodecCtx with the threads of the lease.
+status_t C2SoftVpxDec::initCodecContext() {
     vpx_codec_dec_cfg_t cfg;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
-    cfg.threads = mCoreCount = GetCPUCoreCount();
+    cfg.threads = mCoreCount = mThreadLease->threads();
 
     vpx_codec_flags_t flags;
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
@@ -478,18 +502,6 @@ status_t C2SoftVpxDec::initDecoder() {
         return UNKNOWN_ERROR;
     }
 
-    if (mMode == MODE_VP9) {
-        using namespace std::string_literals;
-        for (int i = 0; i < mCoreCount; ++i) {
-            sp<ConverterThread> thread(new ConverterThread(mQueue));
-            mConverterThreads.push_back(thread);
-            if (thread->run(("vp9conv #"s + std::to_string(i)).c_str(),
-                            ANDROID_PRIORITY_AUDIO) != OK) {
-                return UNKNOWN_ERROR;
-            }
-        }
-    }
-
     return OK;
 }
 
@@ -499,6 +511,7 @@ status_t C2SoftVpxDec::destroyDecoder() {
         delete mCodecCtx;
         mCodecCtx = nullptr;
     }
+    mThreadLease.reset();
     bool running = true;
     for (const sp<ConverterThread> &thread : mConverterThreads) {
         thread->requestExit();
@@ -577,6 +590,16 @@ void C2SoftVpxDec::finishWork(uint64_t index, const std::unique_ptr<C2Work> &wor
     }
 }
 
+bool C2SoftVpxDec::isKeyFrame(const uint8_t *data, size_t size) {
+    vpx_codec_stream_info_t si;
+    memset(&si, 0, sizeof(si));
+    si.sz = sizeof(si);
+    return vpx_codec_peek_stream_info(
+                   mMode == MODE_VP8 ? &vpx_codec_vp8_dx_algo : &vpx_codec_vp9_dx_algo,
+                   data, size, &si) == VPX_CODEC_OK
+            && si.is_kf;
+}
+
 void C2SoftVpxDec::process(
         const std::unique_ptr<C2Work> &work,
         const std::shared_ptr<C2BlockPool> &pool) {
@@ -628,6 +651,21 @@ void C2SoftVpxDec::process(
 
     if (inSize) {
         uint8_t *bitstream = const_cast<uint8_t *>(rView.data() + inOffset);
+        // A key frame replaces all the reference frames, which is where the decoder can be
+        // recreated with its current share of the thread budget. This covers the first frame
+        // after a flush and resolution changes.
+        if (!mFrameParallelMode && mThreadLease->threads() != (size_t)mCoreCount
+                && isKeyFrame(bitstream, inSize)) {
+            ALOGV("changing from %d to %zu threads", mCoreCount, mThreadLease->threads());
+            drainInternal(DRAIN_COMPONENT_NO_EOS, pool, work);
+            vpx_codec_destroy(mCodecCtx);
+            if (initCodecContext() != OK) {
+                mSignalledError = true;
+                work->workletsProcessed = 1u;
+                work->result = C2_CORRUPTED;
+                return;
+            }
+        }
         vpx_codec_err_t err = vpx_codec_decode(
                 mCodecCtx, bitstream, inSize, &work->input.ordinal.frameIndex, 0);
         if (err != VPX_CODEC_OK) {
@@ -676,6 +714,7 @@ status_t C2SoftVpxDec::outputBuffer(
     if (img->d_w != mWidth || img->d_h != mHeight) {
         mWidth = img->d_w;
         mHeight = img->d_h;
+        mThreadLease->setLoad(mWidth, mHeight, 0 /* frameRate */);
 
         C2StreamPictureSizeInfo::output size(0u, mWidth, mHeight);
         std::vector<std::unique_ptr<C2SettingResult>> failures;
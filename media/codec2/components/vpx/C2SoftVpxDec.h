@@ -17,6 +17,7 @@
 #ifndef ANDROID_C2_SOFT_VPX_DEC_H_
 #define ANDROID_C2_SOFT_VPX_DEC_H_
 
+#include <CodecThreadBudget.h>
 #include <SimpleC2Component.h>
 
 
@@ -78,6 +79,7 @@ struct C2SoftVpxDec : public SimpleC2Component {
     bool mSignalledError;
 
     int mCoreCount;
+    std::unique_ptr<CodecThreadBudget::Lease> mThreadLease;
     struct ConversionQueue {
         std::list<std::function<void()>> entries;
         Condition cond;
@@ -87,7 +89,9 @@ struct C2SoftVpxDec : public SimpleC2Component {
     std::vector<sp<ConverterThread>> mConverterThreads;
 
     status_t initDecoder();
+    status_t initCodecContext();
     status_t destroyDecoder();
+    bool isKeyFrame(const uint8_t *data, size_t size);
     void finishWork(uint64_t index, const std::unique_ptr<C2Work> &work,
                     const std::shared_ptr<C2GraphicBlock> &block);
     status_t outputBuffer(
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <Codec2BufferUtils.h>
+
+#include "TestImage.h"
+
+using namespace android;
+
+namespace {
+
+TestImage CreateImage(TestImageFormat format, int64_t width, int64_t height) {
+    return TestImage(format, width, height, (width + 63) & ~63, height);
+}
+
+// Args are the source and destination formats, the number of threads, then the width and
+// height of the image.
+void BM_ImageCopyViewToMediaImage(benchmark::State &state) {
+    TestImage src = CreateImage((TestImageFormat)state.range(0), state.range(3), state.range(4));
+    TestImage dst = CreateImage((TestImageFormat)state.range(1), state.range(3), state.range(4));
+    src.fillRandom(0);
+    TestImageView view(&src);
+    SetImageCopyThreadCount(state.range(2));
+    for (auto _ : state) {
+        if (ImageCopy(dst.base(), &dst.mediaImage, view.view) != OK) {
+            state.SkipWithError("copy failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    SetImageCopyThreadCount(1);
+    state.SetBytesProcessed(state.iterations() * dst.memory.size());
+}
+
+void BM_ImageCopyMediaImageToView(benchmark::State &state) {
+    TestImage src = CreateImage((TestImageFormat)state.range(0), state.range(3), state.range(4));
+    TestImage dst = CreateImage((TestImageFormat)state.range(1), state.range(3), state.range(4));
+    src.fillRandom(0);
+    TestImageView view(&dst);
+    SetImageCopyThreadCount(state.range(2));
+    for (auto _ : state) {
+        if (ImageCopy(view.view, src.base(), &src.mediaImage) != OK) {
+            state.SkipWithError("copy failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    SetImageCopyThreadCount(1);
+    state.SetBytesProcessed(state.iterations() * dst.memory.size());
+}
+
+// Args are the number of threads, then the width and height of the image.
+void BM_ConvertRGBToPlanarYUV(benchmark::State &state) {
+    TestImage src = CreateImage(TestImageFormat::RGBA, state.range(1), state.range(2));
+    src.fillRandom(0);
+    TestImageView view(&src);
+    const size_t stride = (state.range(1) + 63) & ~63;
+    std::vector<uint8_t> dst(stride * state.range(2) * 3 / 2);
+    SetImageCopyThreadCount(state.range(0));
+    for (auto _ : state) {
+        ConvertRGBToPlanarYUV(dst.data(), stride, state.range(2), dst.size(), view.view);
+        benchmark::ClobberMemory();
+    }
+    SetImageCopyThreadCount(1);
+    state.SetItemsProcessed(state.iterations() * state.range(1) * state.range(2));
+}
+
+const int64_t kThreads[] = { 1, 2, 4 };
+const std::pair<int64_t, int64_t> kSizes[] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+
+void imageCopyArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "src", "dst", "threads", "width", "height" });
+    const std::pair<TestImageFormat, TestImageFormat> pairs[] = {
+        { TestImageFormat::NV12, TestImageFormat::NV12 },
+        { TestImageFormat::NV12, TestImageFormat::I420 },
+        { TestImageFormat::NV21, TestImageFormat::NV12 },
+        { TestImageFormat::I420, TestImageFormat::NV12 },
+        { TestImageFormat::P010, TestImageFormat::P010 },
+        { TestImageFormat::P010, TestImageFormat::I010 },
+    };
+    for (const auto &[src, dst] : pairs) {
+        for (int64_t threads : kThreads) {
+            for (const auto &[width, height] : kSizes) {
+                b->Args({ (int64_t)src, (int64_t)dst, threads, width, height });
+            }
+        }
+    }
+}
+
+void convertArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "threads", "width", "height" });
+    for (int64_t threads : kThreads) {
+        for (const auto &[width, height] : kSizes) {
+            b->Args({ threads, width, height });
+        }
+    }
+}
+
+}  // namespace
+
+BENCHMARK(BM_ImageCopyViewToMediaImage)->Apply(imageCopyArgs)->UseRealTime();
+BENCHMARK(BM_ImageCopyMediaImageToView)->Apply(imageCopyArgs)->UseRealTime();
+BENCHMARK(BM_ConvertRGBToPlanarYUV)->Apply(convertArgs)->UseRealTime();
+
+BENCHMARK_MAIN();
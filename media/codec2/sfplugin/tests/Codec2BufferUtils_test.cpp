@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Codec2BufferUtils.h>
+
+#include "TestImage.h"
+
+namespace android {
+
+namespace {
+
+// A small image, copied on the calling thread only, and a large one, split in row bands.
+const std::pair<uint32_t, uint32_t> kSizes[] = { { 320, 240 }, { 3840, 2160 } };
+
+TestImage CreateImage(TestImageFormat format, uint32_t width, uint32_t height, uint32_t pad) {
+    return TestImage(format, width, height, ((width + 63) & ~63) + pad, height + 16);
+}
+
+// Returns the sample at (x, y) of plane |i| of a YUV image, in the coordinates of the plane.
+uint32_t Sample(const TestImage &image, uint32_t i, uint32_t x, uint32_t y) {
+    const MediaImage2::PlaneInfo &plane = image.mediaImage.mPlane[i];
+    const uint8_t *p = image.base() + plane.mOffset + (ptrdiff_t)y * plane.mRowInc
+            + (ptrdiff_t)x * plane.mColInc;
+    if (image.mediaImage.mBitDepthAllocated == 16) {
+        return p[0] | (p[1] << 8);
+    }
+    return p[0];
+}
+
+void ExpectSameSamples(const TestImage &expected, const TestImage &actual,
+                       const std::string &what) {
+    for (uint32_t i = 0; i < 3; ++i) {
+        const uint32_t sampling = i == 0 ? 1 : 2;
+        for (uint32_t y = 0; y < expected.height / sampling; ++y) {
+            for (uint32_t x = 0; x < expected.width / sampling; ++x) {
+                ASSERT_EQ(Sample(expected, i, x, y), Sample(actual, i, x, y))
+                        << what << ": plane " << i << " differs at (" << x << ", " << y << ")";
+            }
+        }
+    }
+}
+
+}  // namespace
+
+// Copies between the YUV 420 layouts of views and media images.
+class ImageCopyTest : public ::testing::TestWithParam<
+        std::tuple<TestImageFormat, TestImageFormat, size_t /* threads */>> {
+public:
+    void SetUp() override {
+        std::tie(mSrcFormat, mDstFormat, mThreads) = GetParam();
+        SetImageCopyThreadCount(mThreads);
+    }
+
+    void TearDown() override {
+        SetImageCopyThreadCount(1);
+    }
+
+    TestImageFormat mSrcFormat;
+    TestImageFormat mDstFormat;
+    size_t mThreads;
+};
+
+TEST_P(ImageCopyTest, ViewToMediaImage) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage src = CreateImage(mSrcFormat, width, height, 64);
+        TestImage dst = CreateImage(mDstFormat, width, height, 32);
+        src.fillRandom(width);
+        TestImageView view(&src);
+        ASSERT_EQ(OK, ImageCopy(dst.base(), &dst.mediaImage, view.view));
+        ExpectSameSamples(src, dst, std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+TEST_P(ImageCopyTest, MediaImageToView) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage src = CreateImage(mSrcFormat, width, height, 32);
+        TestImage dst = CreateImage(mDstFormat, width, height, 64);
+        src.fillRandom(height);
+        TestImageView view(&dst);
+        ASSERT_EQ(OK, ImageCopy(view.view, src.base(), &src.mediaImage));
+        ExpectSameSamples(src, dst, std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+std::string ImageCopyTestName(
+        const ::testing::TestParamInfo<ImageCopyTest::ParamType> &info) {
+    return std::string(TestImageFormatName(std::get<0>(info.param))) + "To"
+            + TestImageFormatName(std::get<1>(info.param)) + "_"
+            + std::to_string(std::get<2>(info.param)) + "Threads";
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        Yuv420, ImageCopyTest,
+        ::testing::Combine(
+                ::testing::Values(TestImageFormat::NV12, TestImageFormat::NV21,
+                                  TestImageFormat::I420),
+                ::testing::Values(TestImageFormat::NV12, TestImageFormat::NV21,
+                                  TestImageFormat::I420),
+                ::testing::Values(1, 4)),
+        ImageCopyTestName);
+
+INSTANTIATE_TEST_SUITE_P(
+        Yuv420_10Bit, ImageCopyTest,
+        ::testing::Combine(
+                ::testing::Values(TestImageFormat::P010, TestImageFormat::I010),
+                ::testing::Values(TestImageFormat::P010, TestImageFormat::I010),
+                ::testing::Values(1, 4)),
+        ImageCopyTestName);
+
+// Copies between views and media images of the same layout.
+class ImageCopySameLayoutTest : public ::testing::TestWithParam<
+        std::tuple<TestImageFormat, size_t /* threads */>> {
+public:
+    void SetUp() override {
+        std::tie(mFormat, mThreads) = GetParam();
+        SetImageCopyThreadCount(mThreads);
+    }
+
+    void TearDown() override {
+        SetImageCopyThreadCount(1);
+    }
+
+    TestImageFormat mFormat;
+    size_t mThreads;
+};
+
+TEST_P(ImageCopySameLayoutTest, Copy) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage src = CreateImage(mFormat, width, height, 64);
+        TestImage dst = CreateImage(mFormat, width, height, 64);
+        src.fillRandom(width + height);
+        TestImageView view(&src);
+        ASSERT_EQ(OK, ImageCopy(dst.base(), &dst.mediaImage, view.view));
+        ExpectSameSamples(src, dst, std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+TEST_P(ImageCopySameLayoutTest, SameMemory) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage image = CreateImage(mFormat, width, height, 64);
+        image.fillRandom(width + height);
+        const std::vector<uint8_t> memory = image.memory;
+        TestImageView view(&image);
+        ASSERT_EQ(OK, ImageCopy(view.view, image.base(), &image.mediaImage));
+        ASSERT_EQ(OK, ImageCopy(image.base(), &image.mediaImage, view.view));
+        EXPECT_EQ(memory, image.memory);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        Formats, ImageCopySameLayoutTest,
+        ::testing::Combine(
+                ::testing::Values(TestImageFormat::NV12, TestImageFormat::NV21,
+                                  TestImageFormat::I420, TestImageFormat::P010,
+                                  TestImageFormat::I010),
+                ::testing::Values(1, 4)),
+        [](const ::testing::TestParamInfo<ImageCopySameLayoutTest::ParamType> &info) {
+            return std::string(TestImageFormatName(std::get<0>(info.param))) + "_"
+                    + std::to_string(std::get<1>(info.param)) + "Threads";
+        });
+
+// Converts RGB views to planar YUV 420.
+class ConvertRGBToPlanarYUVTest : public ::testing::TestWithParam<size_t /* threads */> {
+public:
+    void SetUp() override {
+        SetImageCopyThreadCount(GetParam());
+    }
+
+    void TearDown() override {
+        SetImageCopyThreadCount(1);
+    }
+
+    // Converts |src| one pixel at a time, as ConvertRGBToPlanarYUV did before it was split in
+    // rows.
+    static void Convert(const TestImage &src, uint8_t *dstY, size_t dstStride, size_t dstVStride,
+                        C2Color::matrix_t matrix, C2Color::range_t range) {
+        static const int16_t kBt601[2][3][3] = {
+            { { 77, 150, 29 }, { -43, -85, 128 }, { 128, -107, -21 } },
+            { { 66, 129, 25 }, { -38, -74, 112 }, { 112, -94, -18 } },
+        };
+        static const int16_t kBt709[2][3][3] = {
+            { { 54, 183, 19 }, { -29, -99, 128 }, { 128, -116, -12 } },
+            { { 47, 157, 16 }, { -26, -86, 112 }, { 112, -102, -10 } },
+        };
+        const int16_t (*w)[3] = matrix == C2Color::MATRIX_BT709 ? kBt709[range - 1]
+                                                                : kBt601[range - 1];
+        const int zero = range == C2Color::RANGE_FULL ? 0 : 16;
+        const int maxLuma = range == C2Color::RANGE_FULL ? 255 : 235;
+        const int maxChroma = range == C2Color::RANGE_FULL ? 255 : 240;
+        uint8_t *dstU = dstY + dstStride * dstVStride;
+        uint8_t *dstV = dstU + (dstStride / 2) * (dstVStride / 2);
+        for (uint32_t y = 0; y < src.height; ++y) {
+            for (uint32_t x = 0; x < src.width; ++x) {
+                int rgb[3];
+                for (uint32_t i = 0; i < 3; ++i) {
+                    const C2PlaneInfo &plane = src.layout.planes[i];
+                    rgb[i] = src.base()[src.offsets[i] + y * plane.rowInc + x * plane.colInc];
+                }
+                const int luma = ((rgb[0] * w[0][0] + rgb[1] * w[0][1] + rgb[2] * w[0][2]) >> 8)
+                        + zero;
+                dstY[y * dstStride + x] = std::clamp(luma, zero, maxLuma);
+                if ((x & 1) == 0 && (y & 1) == 0) {
+                    const int u = ((rgb[0] * w[1][0] + rgb[1] * w[1][1] + rgb[2] * w[1][2]) >> 8)
+                            + 128;
+                    const int v = ((rgb[0] * w[2][0] + rgb[1] * w[2][1] + rgb[2] * w[2][2]) >> 8)
+                            + 128;
+                    dstU[(y / 2) * (dstStride / 2) + x / 2] = std::clamp(u, zero, maxChroma);
+                    dstV[(y / 2) * (dstStride / 2) + x / 2] = std::clamp(v, zero, maxChroma);
+                }
+            }
+        }
+    }
+
+    void compare(TestImage *src, const std::string &what) {
+        const size_t dstStride = (src->width + 63) & ~63;
+        const size_t dstVStride = src->height;
+        const size_t size = dstStride * dstVStride * 3 / 2;
+        for (C2Color::matrix_t matrix : { C2Color::MATRIX_BT601, C2Color::MATRIX_BT709 }) {
+            for (C2Color::range_t range : { C2Color::RANGE_FULL, C2Color::RANGE_LIMITED }) {
+                std::vector<uint8_t> expected(size, 0);
+                std::vector<uint8_t> actual(size, 0);
+                Convert(*src, expected.data(), dstStride, dstVStride, matrix, range);
+                TestImageView view(src);
+                ASSERT_EQ(OK, ConvertRGBToPlanarYUV(actual.data(), dstStride, dstVStride, size,
+                                                    view.view, matrix, range));
+                ASSERT_EQ(expected, actual) << what << " matrix " << matrix << " range " << range;
+            }
+        }
+    }
+};
+
+TEST_P(ConvertRGBToPlanarYUVTest, Rgba) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage src = CreateImage(TestImageFormat::RGBA, width, height, 16);
+        src.fillRandom(width);
+        compare(&src, "RGBA " + std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+TEST_P(ConvertRGBToPlanarYUVTest, Bgra) {
+    for (const auto &[width, height] : kSizes) {
+        TestImage src = CreateImage(TestImageFormat::RGBA, width, height, 16);
+        std::swap(src.offsets[C2PlanarLayout::PLANE_R], src.offsets[C2PlanarLayout::PLANE_B]);
+        std::swap(src.layout.planes[C2PlanarLayout::PLANE_R].offset,
+                  src.layout.planes[C2PlanarLayout::PLANE_B].offset);
+        src.fillRandom(height);
+        compare(&src, "BGRA " + std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+TEST_P(ConvertRGBToPlanarYUVTest, PlanarRgb) {
+    for (const auto &[width, height] : kSizes) {
+        // lay the R, G and B planes of an RGBA image out one after the other
+        TestImage src = CreateImage(TestImageFormat::RGBA, width, height, 16);
+        const int32_t rowInc = src.layout.planes[0].rowInc / 4;
+        const size_t planeSize = rowInc * (height + 16);
+        src.layout.type = C2PlanarLayout::TYPE_RGB;
+        src.layout.numPlanes = 3;
+        src.layout.rootPlanes = 3;
+        for (uint32_t i = 0; i < 3; ++i) {
+            src.layout.planes[i].colInc = 1;
+            src.layout.planes[i].rowInc = rowInc;
+            src.layout.planes[i].rootIx = i;
+            src.layout.planes[i].offset = 0;
+            src.offsets[i] = i * planeSize;
+        }
+        src.fillRandom(width + height);
+        compare(&src, "RGB " + std::to_string(width) + "x" + std::to_string(height));
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        Threads, ConvertRGBToPlanarYUVTest, ::testing::Values(1, 4),
+        [](const ::testing::TestParamInfo<size_t> &info) {
+            return std::to_string(info.param) + "Threads";
+        });
+
+}  // namespace android
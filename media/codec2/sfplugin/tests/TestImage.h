@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CODEC2_SFPLUGIN_TESTS_TEST_IMAGE_H_
+#define CODEC2_SFPLUGIN_TESTS_TEST_IMAGE_H_
+
+#include <random>
+#include <vector>
+
+#include <C2Buffer.h>
+#include <C2BlockInternal.h>
+#include <media/hardware/VideoAPI.h>
+
+namespace android {
+
+/**
+ * Layouts of the images of Codec2BufferUtils tests and benchmarks.
+ */
+enum class TestImageFormat {
+    NV12,
+    NV21,
+    I420,
+    P010,
+    // planar 10-bit YUV 420 in 16-bit samples
+    I010,
+    RGBA,
+};
+
+inline const char *TestImageFormatName(TestImageFormat format) {
+    switch (format) {
+        case TestImageFormat::NV12: return "NV12";
+        case TestImageFormat::NV21: return "NV21";
+        case TestImageFormat::I420: return "I420";
+        case TestImageFormat::P010: return "P010";
+        case TestImageFormat::I010: return "I010";
+        case TestImageFormat::RGBA: return "RGBA";
+    }
+    return "unknown";
+}
+
+/**
+ * Memory of an image, with its layout as a MediaImage2 (for YUV formats) and as a
+ * C2PlanarLayout. Rows are padded to |stride| pixels, and planes to |vstride| rows.
+ */
+struct TestImage {
+    TestImage(TestImageFormat format, uint32_t width, uint32_t height,
+              uint32_t stride, uint32_t vstride)
+        : format(format), width(width), height(height), offsets(4, 0) {
+        const bool is16Bit = format == TestImageFormat::P010 || format == TestImageFormat::I010;
+        const int32_t bpp = is16Bit ? 2 : 1;
+        const uint32_t depth = is16Bit ? 10 : 8;
+
+        if (format == TestImageFormat::RGBA) {
+            memory.resize(stride * vstride * 4);
+            layout = { C2PlanarLayout::TYPE_RGBA, 4 /* numPlanes */, 1 /* rootPlanes */, {} };
+            const C2PlaneInfo::channel_t channels[] = {
+                C2PlaneInfo::CHANNEL_R, C2PlaneInfo::CHANNEL_G,
+                C2PlaneInfo::CHANNEL_B, C2PlaneInfo::CHANNEL_A,
+            };
+            for (uint32_t i = 0; i < 4; ++i) {
+                layout.planes[i] = {
+                    channels[i], 4 /* colInc */, (int32_t)stride * 4 /* rowInc */,
+                    1, 1, 8, 8, 0, C2PlaneInfo::NATIVE,
+                    C2PlanarLayout::PLANE_R /* rootIx */, i /* offset */,
+                };
+                offsets[i] = i;
+            }
+            mediaImage = {};
+            return;
+        }
+
+        const bool planar = format == TestImageFormat::I420 || format == TestImageFormat::I010;
+        const int32_t rowInc = stride * bpp;
+        const int32_t chromaColInc = planar ? bpp : 2 * bpp;
+        const int32_t chromaRowInc = planar ? rowInc / 2 : rowInc;
+        const size_t lumaSize = rowInc * vstride;
+        const size_t chromaSize = chromaRowInc * (vstride / 2);
+        memory.resize(lumaSize + 2 * chromaSize);
+
+        offsets[C2PlanarLayout::PLANE_Y] = 0;
+        C2PlanarLayout::plane_index_t uRoot = C2PlanarLayout::PLANE_U;
+        C2PlanarLayout::plane_index_t vRoot = C2PlanarLayout::PLANE_V;
+        uint32_t uOffset = 0;
+        uint32_t vOffset = 0;
+        if (planar) {
+            offsets[C2PlanarLayout::PLANE_U] = lumaSize;
+            offsets[C2PlanarLayout::PLANE_V] = lumaSize + chromaSize;
+        } else if (format == TestImageFormat::NV21) {
+            offsets[C2PlanarLayout::PLANE_V] = lumaSize;
+            offsets[C2PlanarLayout::PLANE_U] = lumaSize + bpp;
+            uRoot = C2PlanarLayout::PLANE_V;
+            uOffset = bpp;
+        } else {
+            offsets[C2PlanarLayout::PLANE_U] = lumaSize;
+            offsets[C2PlanarLayout::PLANE_V] = lumaSize + bpp;
+            vRoot = C2PlanarLayout::PLANE_U;
+            vOffset = bpp;
+        }
+
+        layout = { C2PlanarLayout::TYPE_YUV, 3 /* numPlanes */, planar ? 3u : 2u, {} };
+        layout.planes[C2PlanarLayout::PLANE_Y] = {
+            C2PlaneInfo::CHANNEL_Y, bpp, rowInc, 1, 1, 8u * bpp, depth, 8u * bpp - depth,
+            C2PlaneInfo::NATIVE, C2PlanarLayout::PLANE_Y, 0,
+        };
+        layout.planes[C2PlanarLayout::PLANE_U] = {
+            C2PlaneInfo::CHANNEL_CB, chromaColInc, chromaRowInc, 2, 2, 8u * bpp, depth,
+            8u * bpp - depth, C2PlaneInfo::NATIVE, uRoot, uOffset,
+        };
+        layout.planes[C2PlanarLayout::PLANE_V] = {
+            C2PlaneInfo::CHANNEL_CR, chromaColInc, chromaRowInc, 2, 2, 8u * bpp, depth,
+            8u * bpp - depth, C2PlaneInfo::NATIVE, vRoot, vOffset,
+        };
+
+        mediaImage = {
+            MediaImage2::MEDIA_IMAGE_TYPE_YUV, 3 /* mNumPlanes */, width, height,
+            depth, 8u * bpp, {},
+        };
+        mediaImage.mPlane[MediaImage2::Y] = {
+            (uint32_t)offsets[C2PlanarLayout::PLANE_Y], bpp, rowInc, 1, 1,
+        };
+        mediaImage.mPlane[MediaImage2::U] = {
+            (uint32_t)offsets[C2PlanarLayout::PLANE_U], chromaColInc, chromaRowInc, 2, 2,
+        };
+        mediaImage.mPlane[MediaImage2::V] = {
+            (uint32_t)offsets[C2PlanarLayout::PLANE_V], chromaColInc, chromaRowInc, 2, 2,
+        };
+    }
+
+    uint8_t *base() {
+        return memory.data();
+    }
+
+    const uint8_t *base() const {
+        return memory.data();
+    }
+
+    void fillRandom(uint32_t seed) {
+        std::mt19937 random(seed);
+        for (uint8_t &byte : memory) {
+            byte = random();
+        }
+    }
+
+    TestImageFormat format;
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> memory;
+    MediaImage2 mediaImage;
+    C2PlanarLayout layout;
+    // of each plane of |layout| in |memory|
+    std::vector<size_t> offsets;
+};
+
+/**
+ * A graphic allocation that maps the memory of a TestImage.
+ */
+class TestImageAllocation : public C2GraphicAllocation {
+public:
+    explicit TestImageAllocation(TestImage *image)
+        : C2GraphicAllocation(image->width, image->height), mImage(image) {
+    }
+
+    c2_status_t map(
+            C2Rect, C2MemoryUsage, C2Fence *, C2PlanarLayout *layout, uint8_t **addr) override {
+        *layout = mImage->layout;
+        for (size_t i = 0; i < mImage->layout.numPlanes; ++i) {
+            addr[i] = mImage->base() + mImage->offsets[i];
+        }
+        return C2_OK;
+    }
+
+    c2_status_t unmap(uint8_t **, C2Rect, C2Fence *) override { return C2_OK; }
+
+    C2Allocator::id_t getAllocatorId() const override { return -1; }
+
+    const C2Handle *handle() const override { return nullptr; }
+
+    bool equals(const std::shared_ptr<const C2GraphicAllocation> &other) const override {
+        return other.get() == this;
+    }
+
+private:
+    TestImage *mImage;
+};
+
+/**
+ * A graphic view of the memory of a TestImage.
+ */
+struct TestImageView {
+    explicit TestImageView(TestImage *image)
+        : block(_C2BlockFactory::CreateGraphicBlock(
+                  std::make_shared<TestImageAllocation>(image))),
+          view(block->map().get()) {
+    }
+
+    std::shared_ptr<C2GraphicBlock> block;
+    C2GraphicView view;
+};
+
+}  // namespace android
+
+#endif  // CODEC2_SFPLUGIN_TESTS_TEST_IMAGE_H_
@@ -21,9 +21,18 @@
 #include <utils/Trace.h>
 
 #include <libyuv.h>
+#include <pthread.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <list>
 #include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/properties.h>
 
 #include <android/hardware_buffer.h>
 #include <media/hardware/HardwareAPI.h>
@@ -37,6 +46,171 @@ namespace android {
 
 namespace {
 
+/**
+ * A pool of worker threads shared by all image copies, that copy the rows of large images in
+ * bands together with the calling thread.
+ *
+ * Only one caller uses the workers at a time. Other callers meanwhile copy on their own thread,
+ * so that codecs never wait for each other.
+ */
+class RowBandPool {
+public:
+    static RowBandPool &Get() {
+        // never destroyed, as copies may run during static destruction
+        static RowBandPool *sPool = new RowBandPool(
+                base::GetIntProperty<int32_t>("media.c2.image_copy.threads", 1));
+        return *sPool;
+    }
+
+    /**
+     * Returns the number of threads that run bands, including the calling thread.
+     */
+    size_t threadCount() const {
+        return mThreadCount.load(std::memory_order_relaxed);
+    }
+
+    void setThreadCount(size_t count) {
+        count = std::clamp(count, (size_t)1, kMaxThreads);
+        std::lock_guard<std::mutex> runLock(mRunLock);
+        if (count == threadCount()) {
+            return;
+        }
+        stopWorkers();
+        startWorkers(count - 1);
+        mThreadCount.store(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * Calls |fn| for each band in [0, |numBands|), and returns once all calls returned.
+     */
+    void run(size_t numBands, const std::function<void(size_t)> &fn) {
+        std::unique_lock<std::mutex> runLock(mRunLock, std::try_to_lock);
+        if (!runLock.owns_lock() || mNumWorkers == 0) {
+            for (size_t i = 0; i < numBands; ++i) {
+                fn(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mFn = &fn;
+            mNumBands = numBands;
+            mNextBand = 0;
+            mNumDoneWorkers = 0;
+            ++mGeneration;
+        }
+        mWorkCond.notify_all();
+        runBands();
+        // Wait for all workers, not only for all bands, so that none can pick up a band of
+        // the next run with this one's function.
+        std::unique_lock<std::mutex> lock(mLock);
+        mDoneCond.wait(lock, [this] { return mNumDoneWorkers == mNumWorkers; });
+        mFn = nullptr;
+    }
+
+private:
+    static constexpr size_t kMaxThreads = 8;
+
+    explicit RowBandPool(int32_t threadCount) : mThreadCount(1) {
+        if (threadCount > 1) {
+            setThreadCount(threadCount);
+        }
+    }
+
+    void startWorkers(size_t count) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = false;
+        mNumWorkers = count;
+        // The workers start from the current generation, as a run may bump it before they
+        // get the lock.
+        for (size_t i = 0; i < count; ++i) {
+            mWorkers.emplace_back(&RowBandPool::workerLoop, this, mGeneration);
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mExit = true;
+        }
+        mWorkCond.notify_all();
+        for (std::thread &worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+        mNumWorkers = 0;
+    }
+
+    void runBands() {
+        for (size_t i = mNextBand++; i < mNumBands; i = mNextBand++) {
+            (*mFn)(i);
+        }
+    }
+
+    void workerLoop(uint64_t generation) {
+        pthread_setname_np(pthread_self(), "C2ImageCopy");
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mWorkCond.wait(lock, [this, generation] {
+                return mExit || mGeneration != generation;
+            });
+            if (mExit) {
+                return;
+            }
+            generation = mGeneration;
+            lock.unlock();
+            runBands();
+            lock.lock();
+            if (++mNumDoneWorkers == mNumWorkers) {
+                mDoneCond.notify_one();
+            }
+        }
+    }
+
+    std::atomic<size_t> mThreadCount;
+    // held by the caller using the workers, and while the workers are replaced
+    std::mutex mRunLock;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mLock;
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    size_t mNumWorkers = 0;
+    size_t mNumDoneWorkers = 0;
+    uint64_t mGeneration = 0;
+    bool mExit = false;
+
+    // current run; set under mLock before the workers are woken up
+    const std::function<void(size_t)> *mFn = nullptr;
+    size_t mNumBands = 0;
+    std::atomic<size_t> mNextBand{0};
+};
+
+// Images of at least this many pixels are copied in parallel bands of rows.
+constexpr uint32_t kMinParallelPixels = 1920 * 1080;
+// Bands have at least this many rows, to keep the overhead per band low.
+constexpr uint32_t kMinBandRows = 64;
+
+/**
+ * Calls |fn(top, rows)| for bands of rows that cover the |height| rows of an image, from
+ * several threads if the image is large and parallel copies are enabled. All bands but the last
+ * have an even number of rows, so that bands start on a row of 4:2:0 subsampled planes.
+ */
+template<typename Fn>
+void ForEachRowBand(uint32_t width, uint32_t height, Fn fn) {
+    RowBandPool &pool = RowBandPool::Get();
+    const size_t numBands = std::min<size_t>(pool.threadCount(), height / kMinBandRows);
+    if (numBands <= 1 || width * height < kMinParallelPixels) {
+        fn(0u, height);
+        return;
+    }
+    const uint32_t bandRows = align(divUp<uint32_t>(height, numBands), 2);
+    pool.run(divUp(height, bandRows), [&fn, height, bandRows](size_t band) {
+        const uint32_t top = band * bandRows;
+        fn(top, std::min(bandRows, height - top));
+    });
+}
+
 /**
  * A flippable, optimizable memcpy. Constructs such as (from ? src : dst)
  * do not work as the results are always const.
@@ -67,15 +241,11 @@ struct MemCopier<false, S> {
  */
 template<bool ToMediaImage, typename View, typename ImagePixel>
 static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBase) {
-    // TODO: more efficient copying --- e.g. copy interleaved planes together, etc.
+    typedef typename std::conditional<ToMediaImage, const uint8_t, uint8_t>::type ViewPixel;
     const C2PlanarLayout &layout = view.layout();
     const size_t bpp = divUp(img->mBitDepthAllocated, 8u);
 
     for (uint32_t i = 0; i < layout.numPlanes; ++i) {
-        typename std::conditional<ToMediaImage, uint8_t, const uint8_t>::type *imgRow =
-            imgBase + img->mPlane[i].mOffset;
-        typename std::conditional<ToMediaImage, const uint8_t, uint8_t>::type *viewRow =
-            viewRow = view.data()[i];
         const C2PlaneInfo &plane = layout.planes[i];
         if (plane.colSampling != img->mPlane[i].mHorizSubsampling
                 || plane.rowSampling != img->mPlane[i].mVertSubsampling
@@ -86,38 +256,243 @@ static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBa
                 || (bpp > 1 && plane.endianness != plane.NATIVE)) {
             return BAD_VALUE;
         }
+    }
+
+    bool copied[C2PlanarLayout::MAX_NUM_PLANES] = {};
+    for (uint32_t i = 0; i < layout.numPlanes; ++i) {
+        if (copied[i]) {
+            continue;
+        }
+        ImagePixel *imgBegin = imgBase + img->mPlane[i].mOffset;
+        ViewPixel *viewBegin = view.data()[i];
+        const C2PlaneInfo &plane = layout.planes[i];
+        const int32_t imgRowInc = img->mPlane[i].mRowInc;
+        const int32_t imgColInc = img->mPlane[i].mColInc;
 
         uint32_t planeW = img->mWidth / plane.colSampling;
         uint32_t planeH = img->mHeight / plane.rowSampling;
 
-        bool canCopyByRow = (plane.colInc == bpp) && (img->mPlane[i].mColInc == bpp);
-        bool canCopyByPlane = canCopyByRow && (plane.rowInc == img->mPlane[i].mRowInc);
-        if (canCopyByPlane) {
-            MemCopier<ToMediaImage, 0>::copy(imgRow, viewRow, plane.rowInc * planeH);
-        } else if (canCopyByRow) {
-            for (uint32_t row = 0; row < planeH; ++row) {
-                MemCopier<ToMediaImage, 0>::copy(
-                        imgRow, viewRow, std::min(plane.rowInc, img->mPlane[i].mRowInc));
-                imgRow += img->mPlane[i].mRowInc;
-                viewRow += plane.rowInc;
-            }
-        } else {
-            for (uint32_t row = 0; row < planeH; ++row) {
-                decltype(imgRow) imgPtr = imgRow;
-                decltype(viewRow) viewPtr = viewRow;
-                for (uint32_t col = 0; col < planeW; ++col) {
-                    MemCopier<ToMediaImage, 0>::copy(imgPtr, viewPtr, bpp);
-                    imgPtr += img->mPlane[i].mColInc;
-                    viewPtr += plane.colInc;
+        bool canCopyByRow = (plane.colInc == bpp) && (imgColInc == bpp);
+        bool canCopyByPlane = canCopyByRow && (plane.rowInc == imgRowInc);
+        size_t rowSize = std::min(plane.rowInc, imgRowInc);
+
+        // A plane interleaved with the next one in the same way on both sides, as the chroma
+        // planes of P010, is copied together with it, by rows twice as wide.
+        for (uint32_t j = i + 1; j < layout.numPlanes && !canCopyByRow; ++j) {
+            const C2PlaneInfo &other = layout.planes[j];
+            const ptrdiff_t viewDist = view.data()[j] - viewBegin;
+            const ptrdiff_t imgDist = imgBase + img->mPlane[j].mOffset - imgBegin;
+            const int32_t pairColInc = 2 * bpp;
+            if (plane.colInc == pairColInc && other.colInc == pairColInc
+                    && imgColInc == pairColInc && img->mPlane[j].mColInc == pairColInc
+                    && other.rowInc == plane.rowInc && img->mPlane[j].mRowInc == imgRowInc
+                    && other.colSampling == plane.colSampling
+                    && other.rowSampling == plane.rowSampling
+                    && (viewDist == (ptrdiff_t)bpp || viewDist == -(ptrdiff_t)bpp)
+                    && imgDist == viewDist) {
+                if (viewDist < 0) {
+                    imgBegin += imgDist;
+                    viewBegin += viewDist;
                 }
-                imgRow += img->mPlane[i].mRowInc;
-                viewRow += plane.rowInc;
+                canCopyByRow = true;
+                rowSize = planeW * 2 * bpp;
+                copied[j] = true;
             }
         }
+
+        if (canCopyByPlane && imgBegin == viewBegin) {
+            // The view maps the MediaImage memory itself.
+            continue;
+        }
+        ForEachRowBand(planeW, planeH, [&](uint32_t top, uint32_t rows) {
+            ImagePixel *imgRow = imgBegin + (ptrdiff_t)top * imgRowInc;
+            ViewPixel *viewRow = viewBegin + (ptrdiff_t)top * plane.rowInc;
+            if (canCopyByPlane) {
+                MemCopier<ToMediaImage, 0>::copy(imgRow, viewRow, plane.rowInc * rows);
+            } else if (canCopyByRow) {
+                for (uint32_t row = 0; row < rows; ++row) {
+                    MemCopier<ToMediaImage, 0>::copy(imgRow, viewRow, rowSize);
+                    imgRow += imgRowInc;
+                    viewRow += plane.rowInc;
+                }
+            } else {
+                for (uint32_t row = 0; row < rows; ++row) {
+                    decltype(imgRow) imgPtr = imgRow;
+                    decltype(viewRow) viewPtr = viewRow;
+                    for (uint32_t col = 0; col < planeW; ++col) {
+                        MemCopier<ToMediaImage, 0>::copy(imgPtr, viewPtr, bpp);
+                        imgPtr += imgColInc;
+                        viewPtr += plane.colInc;
+                    }
+                    imgRow += imgRowInc;
+                    viewRow += plane.rowInc;
+                }
+            }
+        });
     }
     return OK;
 }
 
+/**
+ * 8-bit YUV 420 layouts that libyuv converts between.
+ */
+enum Yuv420Format {
+    YUV420_NV12,
+    YUV420_NV21,
+    YUV420_I420,
+    YUV420_OTHER,
+};
+
+template<typename Image>
+Yuv420Format GetYuv420Format(const Image &image) {
+    if (IsNV12(image)) {
+        return YUV420_NV12;
+    } else if (IsNV21(image)) {
+        return YUV420_NV21;
+    } else if (IsI420(image)) {
+        return YUV420_I420;
+    }
+    return YUV420_OTHER;
+}
+
+const char *const kYuv420CopyTraces[3][3] = {
+    { "ImageCopy: NV12->NV12", "ImageCopy: NV12->NV21", "ImageCopy: NV12->I420" },
+    { "ImageCopy: NV21->NV12", "ImageCopy: NV21->NV21", "ImageCopy: NV21->I420" },
+    { "ImageCopy: I420->NV12", "ImageCopy: I420->NV21", "ImageCopy: I420->I420" },
+};
+
+/**
+ * Planes of an 8-bit YUV 420 image. The interleaved chroma plane of NV12 starts at |u|, that of
+ * NV21 at |v|.
+ */
+template<typename Pixel>
+struct Yuv420Planes {
+    Pixel *y;
+    Pixel *u;
+    Pixel *v;
+    int32_t strideY;
+    int32_t strideU;
+    int32_t strideV;
+
+    /**
+     * Returns the planes of the image starting at (even) luma row |top|.
+     */
+    Yuv420Planes fromRow(uint32_t top) const {
+        return Yuv420Planes {
+            y + (ptrdiff_t)top * strideY,
+            u + (ptrdiff_t)(top / 2) * strideU,
+            v + (ptrdiff_t)(top / 2) * strideV,
+            strideY, strideU, strideV,
+        };
+    }
+};
+
+/**
+ * Copies a plane, with a single memcpy if the strides match, or not at all if both are the same
+ * memory.
+ */
+void CopyPlane(const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride,
+               int width, int height) {
+    if (height <= 0) {
+        return;
+    }
+    if (srcStride == dstStride && srcStride >= width) {
+        if (src != dst) {
+            memcpy(dst, src, (size_t)srcStride * (height - 1) + width);
+        }
+        return;
+    }
+    libyuv::CopyPlane(src, srcStride, dst, dstStride, width, height);
+}
+
+/**
+ * Converts |height| rows between 8-bit YUV 420 images.
+ *
+ * \return false if libyuv failed
+ */
+bool ConvertYuv420Rows(
+        Yuv420Format srcFormat, const Yuv420Planes<const uint8_t> &src,
+        Yuv420Format dstFormat, const Yuv420Planes<uint8_t> &dst, int width, int height) {
+    switch (srcFormat) {
+        case YUV420_NV12:
+            switch (dstFormat) {
+                case YUV420_NV12:
+                    CopyPlane(src.y, src.strideY, dst.y, dst.strideY, width, height);
+                    CopyPlane(src.u, src.strideU, dst.u, dst.strideU, width, height / 2);
+                    return true;
+                case YUV420_NV21:
+                    return !libyuv::NV21ToNV12(src.y, src.strideY, src.u, src.strideU,
+                                               dst.y, dst.strideY, dst.v, dst.strideV,
+                                               width, height);
+                case YUV420_I420:
+                    return !libyuv::NV12ToI420(src.y, src.strideY, src.u, src.strideU,
+                                               dst.y, dst.strideY, dst.u, dst.strideU,
+                                               dst.v, dst.strideV, width, height);
+                default:
+                    return false;
+            }
+        case YUV420_NV21:
+            switch (dstFormat) {
+                case YUV420_NV12:
+                    return !libyuv::NV21ToNV12(src.y, src.strideY, src.v, src.strideV,
+                                               dst.y, dst.strideY, dst.u, dst.strideU,
+                                               width, height);
+                case YUV420_NV21:
+                    CopyPlane(src.y, src.strideY, dst.y, dst.strideY, width, height);
+                    CopyPlane(src.v, src.strideV, dst.v, dst.strideV, width, height / 2);
+                    return true;
+                case YUV420_I420:
+                    return !libyuv::NV21ToI420(src.y, src.strideY, src.v, src.strideV,
+                                               dst.y, dst.strideY, dst.u, dst.strideU,
+                                               dst.v, dst.strideV, width, height);
+                default:
+                    return false;
+            }
+        case YUV420_I420:
+            switch (dstFormat) {
+                case YUV420_NV12:
+                    return !libyuv::I420ToNV12(src.y, src.strideY, src.u, src.strideU,
+                                               src.v, src.strideV, dst.y, dst.strideY,
+                                               dst.u, dst.strideU, width, height);
+                case YUV420_NV21:
+                    return !libyuv::I420ToNV21(src.y, src.strideY, src.u, src.strideU,
+                                               src.v, src.strideV, dst.y, dst.strideY,
+                                               dst.v, dst.strideV, width, height);
+                case YUV420_I420:
+                    CopyPlane(src.y, src.strideY, dst.y, dst.strideY, width, height);
+                    CopyPlane(src.u, src.strideU, dst.u, dst.strideU, width / 2, height / 2);
+                    CopyPlane(src.v, src.strideV, dst.v, dst.strideV, width / 2, height / 2);
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Copies between 8-bit YUV 420 images with libyuv, in bands of rows for large images.
+ *
+ * \return false if the formats are not supported or libyuv failed
+ */
+bool CopyYuv420(
+        Yuv420Format srcFormat, const Yuv420Planes<const uint8_t> &src,
+        Yuv420Format dstFormat, const Yuv420Planes<uint8_t> &dst, int width, int height) {
+    if (srcFormat == YUV420_OTHER || dstFormat == YUV420_OTHER) {
+        return false;
+    }
+    ScopedTrace trace(ATRACE_TAG, kYuv420CopyTraces[srcFormat][dstFormat]);
+    std::atomic<bool> converted{true};
+    ForEachRowBand(width, height, [&](uint32_t top, uint32_t rows) {
+        if (!ConvertYuv420Rows(srcFormat, src.fromRow(top), dstFormat, dst.fromRow(top),
+                               width, rows)) {
+            converted = false;
+        }
+    });
+    return converted;
+}
+
 }  // namespace
 
 status_t ImageCopy(uint8_t *imgBase, const MediaImage2 *img, const C2GraphicView &view) {
@@ -127,79 +502,23 @@ status_t ImageCopy(uint8_t *imgBase, const MediaImage2 *img, const C2GraphicView
         || view.crop().height != img->mHeight) {
         return BAD_VALUE;
     }
-    const uint8_t* src_y = view.data()[0];
-    const uint8_t* src_u = view.data()[1];
-    const uint8_t* src_v = view.data()[2];
-    int32_t src_stride_y = view.layout().planes[0].rowInc;
-    int32_t src_stride_u = view.layout().planes[1].rowInc;
-    int32_t src_stride_v = view.layout().planes[2].rowInc;
-    uint8_t* dst_y = imgBase + img->mPlane[0].mOffset;
-    uint8_t* dst_u = imgBase + img->mPlane[1].mOffset;
-    uint8_t* dst_v = imgBase + img->mPlane[2].mOffset;
-    int32_t dst_stride_y = img->mPlane[0].mRowInc;
-    int32_t dst_stride_u = img->mPlane[1].mRowInc;
-    int32_t dst_stride_v = img->mPlane[2].mRowInc;
-    int width = view.crop().width;
-    int height = view.crop().height;
-
-    if (IsNV12(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV12");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width, height / 2);
-            return OK;
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV21");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_u, src_stride_u,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->I420");
-            if (!libyuv::NV12ToI420(src_y, src_stride_y, src_u, src_stride_u, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsNV21(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV12");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV21");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width, height / 2);
-            return OK;
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->I420");
-            if (!libyuv::NV21ToI420(src_y, src_stride_y, src_v, src_stride_v, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsI420(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV12");
-            if (!libyuv::I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV21");
-            if (!libyuv::I420ToNV21(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->I420");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width / 2, height / 2);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width / 2, height / 2);
-            return OK;
-        }
+    const Yuv420Planes<const uint8_t> src = {
+        view.data()[0], view.data()[1], view.data()[2],
+        view.layout().planes[0].rowInc,
+        view.layout().planes[1].rowInc,
+        view.layout().planes[2].rowInc,
+    };
+    const Yuv420Planes<uint8_t> dst = {
+        imgBase + img->mPlane[0].mOffset,
+        imgBase + img->mPlane[1].mOffset,
+        imgBase + img->mPlane[2].mOffset,
+        img->mPlane[0].mRowInc,
+        img->mPlane[1].mRowInc,
+        img->mPlane[2].mRowInc,
+    };
+    if (CopyYuv420(GetYuv420Format(view), src, GetYuv420Format(img), dst,
+                   view.crop().width, view.crop().height)) {
+        return OK;
     }
     ScopedTrace trace(ATRACE_TAG, "ImageCopy: generic");
     return _ImageCopy<true>(view, img, imgBase);
@@ -212,83 +531,32 @@ status_t ImageCopy(C2GraphicView &view, const uint8_t *imgBase, const MediaImage
         || view.crop().height != img->mHeight) {
         return BAD_VALUE;
     }
-    const uint8_t* src_y = imgBase + img->mPlane[0].mOffset;
-    const uint8_t* src_u = imgBase + img->mPlane[1].mOffset;
-    const uint8_t* src_v = imgBase + img->mPlane[2].mOffset;
-    int32_t src_stride_y = img->mPlane[0].mRowInc;
-    int32_t src_stride_u = img->mPlane[1].mRowInc;
-    int32_t src_stride_v = img->mPlane[2].mRowInc;
-    uint8_t* dst_y = view.data()[0];
-    uint8_t* dst_u = view.data()[1];
-    uint8_t* dst_v = view.data()[2];
-    int32_t dst_stride_y = view.layout().planes[0].rowInc;
-    int32_t dst_stride_u = view.layout().planes[1].rowInc;
-    int32_t dst_stride_v = view.layout().planes[2].rowInc;
-    int width = view.crop().width;
-    int height = view.crop().height;
-    if (IsNV12(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV12");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width, height / 2);
-            return OK;
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV21");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_u, src_stride_u,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->I420");
-            if (!libyuv::NV12ToI420(src_y, src_stride_y, src_u, src_stride_u, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsNV21(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV12");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV21");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width, height / 2);
-            return OK;
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->I420");
-            if (!libyuv::NV21ToI420(src_y, src_stride_y, src_v, src_stride_v, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsI420(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV12");
-            if (!libyuv::I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV21");
-            if (!libyuv::I420ToNV21(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->I420");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width / 2, height / 2);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width / 2, height / 2);
-            return OK;
-        }
+    const Yuv420Planes<const uint8_t> src = {
+        imgBase + img->mPlane[0].mOffset,
+        imgBase + img->mPlane[1].mOffset,
+        imgBase + img->mPlane[2].mOffset,
+        img->mPlane[0].mRowInc,
+        img->mPlane[1].mRowInc,
+        img->mPlane[2].mRowInc,
+    };
+    const Yuv420Planes<uint8_t> dst = {
+        view.data()[0], view.data()[1], view.data()[2],
+        view.layout().planes[0].rowInc,
+        view.layout().planes[1].rowInc,
+        view.layout().planes[2].rowInc,
+    };
+    if (CopyYuv420(GetYuv420Format(img), src, GetYuv420Format(view), dst,
+                   view.crop().width, view.crop().height)) {
+        return OK;
     }
     ScopedTrace trace(ATRACE_TAG, "ImageCopy: generic");
     return _ImageCopy<false>(view, img, imgBase);
 }
 
+void SetImageCopyThreadCount(size_t count) {
+    RowBandPool::Get().setThreadCount(count);
+}
+
 bool IsYUV420(const C2GraphicView &view) {
     const C2PlanarLayout &layout = view.layout();
     return (layout.numPlanes == 3
@@ -549,6 +817,64 @@ static const int16_t bt709Matrix[2][3][3] = {
     { { 47, 157, 16 }, { -26, -86, 112 }, { 112, -102, -10 } }, /* RANGE_LIMITED */
 };
 
+#define CLIP3(min,v,max) (((v) < (min)) ? (min) : (((max) > (v)) ? (v) : (max)))
+
+namespace {
+
+struct RGBToYUVParams {
+    const int16_t (*weights)[3];
+    uint8_t zeroLvl;
+    uint8_t maxLvlLuma;
+    uint8_t maxLvlChroma;
+};
+
+/**
+ * Converts a row of RGB pixels to YUV, and its chroma if |dstU| and |dstV| are not null.
+ * |ColInc| is the distance between the pixels of all planes if it is known at compile time, or 0
+ * to use the column increments of the planes. With a known distance, as for RGBA pixels, the
+ * compiler vectorizes the loops.
+ */
+template<int32_t ColInc>
+void ConvertRGBRowToYUV(
+        const uint8_t *pRed, const uint8_t *pGreen, const uint8_t *pBlue,
+        const C2PlanarLayout &layout, size_t width, const RGBToYUVParams &params,
+        uint8_t *dstY, uint8_t *dstU, uint8_t *dstV) {
+    const ptrdiff_t redInc = ColInc != 0 ? ColInc : layout.planes[C2PlanarLayout::PLANE_R].colInc;
+    const ptrdiff_t greenInc =
+        ColInc != 0 ? ColInc : layout.planes[C2PlanarLayout::PLANE_G].colInc;
+    const ptrdiff_t blueInc = ColInc != 0 ? ColInc : layout.planes[C2PlanarLayout::PLANE_B].colInc;
+    const int16_t (*weights)[3] = params.weights;
+    for (size_t x = 0; x < width; ++x) {
+        uint8_t r = pRed[x * redInc];
+        uint8_t g = pGreen[x * greenInc];
+        uint8_t b = pBlue[x * blueInc];
+
+        unsigned luma = ((r * weights[0][0] + g * weights[0][1] + b * weights[0][2]) >> 8) +
+                         params.zeroLvl;
+
+        dstY[x] = CLIP3(params.zeroLvl, luma, params.maxLvlLuma);
+    }
+    if (dstU == nullptr || dstV == nullptr) {
+        return;
+    }
+    for (size_t x = 0; x < width; x += 2) {
+        uint8_t r = pRed[x * redInc];
+        uint8_t g = pGreen[x * greenInc];
+        uint8_t b = pBlue[x * blueInc];
+
+        unsigned U = ((r * weights[1][0] + g * weights[1][1] + b * weights[1][2]) >> 8) +
+                      128;
+
+        unsigned V = ((r * weights[2][0] + g * weights[2][1] + b * weights[2][2]) >> 8) +
+                      128;
+
+        dstU[x >> 1] = CLIP3(params.zeroLvl, U, params.maxLvlChroma);
+        dstV[x >> 1] = CLIP3(params.zeroLvl, V, params.maxLvlChroma);
+    }
+}
+
+}  // namespace
+
 status_t ConvertRGBToPlanarYUV(
         uint8_t *dstY, size_t dstStride, size_t dstVStride, size_t bufferSize,
         const C2GraphicView &src, C2Color::matrix_t colorMatrix, C2Color::range_t colorRange) {
@@ -565,62 +891,46 @@ status_t ConvertRGBToPlanarYUV(
     uint8_t *dstV = dstU + (dstStride >> 1) * (dstVStride >> 1);
 
     const C2PlanarLayout &layout = src.layout();
-    const uint8_t *pRed   = src.data()[C2PlanarLayout::PLANE_R];
-    const uint8_t *pGreen = src.data()[C2PlanarLayout::PLANE_G];
-    const uint8_t *pBlue  = src.data()[C2PlanarLayout::PLANE_B];
+    const C2PlaneInfo &red = layout.planes[C2PlanarLayout::PLANE_R];
+    const C2PlaneInfo &green = layout.planes[C2PlanarLayout::PLANE_G];
+    const C2PlaneInfo &blue = layout.planes[C2PlanarLayout::PLANE_B];
 
     // set default range as limited
     if (colorRange != C2Color::RANGE_FULL && colorRange != C2Color::RANGE_LIMITED) {
         colorRange = C2Color::RANGE_LIMITED;
     }
-    const int16_t (*weights)[3] =
+    RGBToYUVParams params;
+    params.weights =
         (colorMatrix == C2Color::MATRIX_BT709) ?
             bt709Matrix[colorRange - 1] : bt601Matrix[colorRange - 1];
-    uint8_t zeroLvl =  colorRange == C2Color::RANGE_FULL ? 0 : 16;
-    uint8_t maxLvlLuma =  colorRange == C2Color::RANGE_FULL ? 255 : 235;
-    uint8_t maxLvlChroma =  colorRange == C2Color::RANGE_FULL ? 255 : 240;
-
-#define CLIP3(min,v,max) (((v) < (min)) ? (min) : (((max) > (v)) ? (v) : (max)))
-    for (size_t y = 0; y < src.height(); ++y) {
-        for (size_t x = 0; x < src.width(); ++x) {
-            uint8_t r = *pRed;
-            uint8_t g = *pGreen;
-            uint8_t b = *pBlue;
-
-            unsigned luma = ((r * weights[0][0] + g * weights[0][1] + b * weights[0][2]) >> 8) +
-                             zeroLvl;
-
-            dstY[x] = CLIP3(zeroLvl, luma, maxLvlLuma);
-
-            if ((x & 1) == 0 && (y & 1) == 0) {
-                unsigned U = ((r * weights[1][0] + g * weights[1][1] + b * weights[1][2]) >> 8) +
-                              128;
-
-                unsigned V = ((r * weights[2][0] + g * weights[2][1] + b * weights[2][2]) >> 8) +
-                              128;
-
-                dstU[x >> 1] = CLIP3(zeroLvl, U, maxLvlChroma);
-                dstV[x >> 1] = CLIP3(zeroLvl, V, maxLvlChroma);
+    params.zeroLvl =  colorRange == C2Color::RANGE_FULL ? 0 : 16;
+    params.maxLvlLuma =  colorRange == C2Color::RANGE_FULL ? 255 : 235;
+    params.maxLvlChroma =  colorRange == C2Color::RANGE_FULL ? 255 : 240;
+
+    // RGBA or BGRA pixels
+    const bool fourBytePixels = red.colInc == 4 && green.colInc == 4 && blue.colInc == 4;
+    ScopedTrace trace(ATRACE_TAG, "ConvertRGBToPlanarYUV");
+    ForEachRowBand(src.width(), src.height(), [&](uint32_t top, uint32_t rows) {
+        const uint8_t *const *data = src.data();
+        for (uint32_t y = top; y < top + rows; ++y) {
+            const uint8_t *pRed   = data[C2PlanarLayout::PLANE_R] + (ptrdiff_t)y * red.rowInc;
+            const uint8_t *pGreen = data[C2PlanarLayout::PLANE_G] + (ptrdiff_t)y * green.rowInc;
+            const uint8_t *pBlue  = data[C2PlanarLayout::PLANE_B] + (ptrdiff_t)y * blue.rowInc;
+            uint8_t *rowU = nullptr;
+            uint8_t *rowV = nullptr;
+            if ((y & 1) == 0) {
+                rowU = dstU + (y >> 1) * (dstStride >> 1);
+                rowV = dstV + (y >> 1) * (dstStride >> 1);
+            }
+            if (fourBytePixels) {
+                ConvertRGBRowToYUV<4>(pRed, pGreen, pBlue, layout, src.width(), params,
+                                      dstY + y * dstStride, rowU, rowV);
+            } else {
+                ConvertRGBRowToYUV<0>(pRed, pGreen, pBlue, layout, src.width(), params,
+                                      dstY + y * dstStride, rowU, rowV);
             }
-            pRed   += layout.planes[C2PlanarLayout::PLANE_R].colInc;
-            pGreen += layout.planes[C2PlanarLayout::PLANE_G].colInc;
-            pBlue  += layout.planes[C2PlanarLayout::PLANE_B].colInc;
-        }
-
-        if ((y & 1) == 0) {
-            dstU += dstStride >> 1;
-            dstV += dstStride >> 1;
         }
-
-        pRed   -= layout.planes[C2PlanarLayout::PLANE_R].colInc * src.width();
-        pGreen -= layout.planes[C2PlanarLayout::PLANE_G].colInc * src.width();
-        pBlue  -= layout.planes[C2PlanarLayout::PLANE_B].colInc * src.width();
-        pRed   += layout.planes[C2PlanarLayout::PLANE_R].rowInc;
-        pGreen += layout.planes[C2PlanarLayout::PLANE_G].rowInc;
-        pBlue  += layout.planes[C2PlanarLayout::PLANE_B].rowInc;
-
-        dstY += dstStride;
-    }
+    });
     return OK;
 }
 
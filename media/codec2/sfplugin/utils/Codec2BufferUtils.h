@@ -87,6 +87,16 @@ status_t ImageCopy(uint8_t *imgBase, const MediaImage2 *img, const C2GraphicView
  */
 status_t ImageCopy(C2GraphicView &view, const uint8_t *imgBase, const MediaImage2 *img);
 
+/**
+ * Sets the number of threads, including the calling thread, that ImageCopy and
+ * ConvertRGBToPlanarYUV use for large images. The threads are shared by all codecs in the
+ * process. The default is 1, or the media.c2.image_copy.threads property, and copies on the
+ * calling thread only.
+ *
+ * \param count number of threads, up to 8
+ */
+void SetImageCopyThreadCount(size_t count);
+
 /**
  * Returns true iff a view has a YUV 420 888 layout.
  */
@@ -38,6 +38,7 @@
 
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <algorithm>
 #include <vector>
 
 namespace android {
@@ -387,6 +388,7 @@ void BlockIterator::advance_l() {
             CHECK(nextCluster != NULL);
             CHECK(!nextCluster->EOS());
 
+            mExtractor->addToClusterIndex_l(mCluster, nextCluster);
             mCluster = nextCluster;
 
             res = mCluster->Parse(pos, len);
@@ -584,7 +586,7 @@ int64_t BlockIterator::blockTimeUs() const {
 }
 
 void BlockIterator::seekwithoutcue_l(int64_t seekTimeUs, int64_t *actualFrameTimeUs) {
-    mCluster = mExtractor->mSegment->FindCluster(seekTimeUs * 1000ll);
+    mCluster = mExtractor->findCluster_l(seekTimeUs * 1000ll);
     const long status = mCluster->GetFirst(mBlockEntry);
     if (status < 0) {  // error
         ALOGE("get last blockenry failed!");
@@ -1330,7 +1332,8 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
       mSegment(NULL),
       mExtractedThumbnails(false),
       mIsWebm(false),
-      mSeekPreRollNs(0) {
+      mSeekPreRollNs(0),
+      mClusterIndexDone(false) {
     off64_t size;
     mIsLiveStreaming =
         (mDataSource->flags()
@@ -1400,8 +1403,11 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
                 ret = mSegment->LoadCluster(pos, len);
                 ALOGV("has Cue data, Cluster num=%ld", mSegment->GetCount());
             } else  {
-                long status_Load = mSegment->Load();
-                ALOGW("no Cue data,Segment Load status:%ld",status_Load);
+                // Rather than loading every cluster up front, clusters are
+                // indexed as they are parsed, see findCluster_l().
+                long len;
+                long status_Load = mSegment->LoadCluster(pos, len);
+                ALOGV("no Cue data, LoadCluster status:%ld", status_Load);
             }
         } else if (ret > 0) {
             ret = mkvparser::E_BUFFER_NOT_FULL;
@@ -1420,6 +1426,11 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
         return;
     }
 
+    const mkvparser::Cluster *firstCluster = mSegment->GetFirst();
+    if (firstCluster != NULL && !firstCluster->EOS() && firstCluster->GetTime() >= 0) {
+        mClusterIndex.push_back({firstCluster->GetTime(), firstCluster});
+    }
+
 #if 0
     const mkvparser::SegmentInfo *info = mSegment->GetInfo();
     ALOGI("muxing app: %s, writing app: %s",
@@ -1447,6 +1458,63 @@ MatroskaExtractor::~MatroskaExtractor() {
     }
 }
 
+void MatroskaExtractor::addToClusterIndex_l(
+        const mkvparser::Cluster *prev, const mkvparser::Cluster *next) {
+    // Only the cluster right after the last indexed one is added, which keeps
+    // the index free of gaps.
+    if (mClusterIndexDone || mClusterIndex.empty() || mClusterIndex.back().mCluster != prev) {
+        return;
+    }
+
+    long long timeNs = next->GetTime();
+    if (timeNs < 0) {
+        return;
+    }
+    if (timeNs < mClusterIndex.back().mTimeNs) {
+        ALOGW("cluster times are not increasing, stop indexing clusters");
+        mClusterIndexDone = true;
+        return;
+    }
+    mClusterIndex.push_back({timeNs, next});
+}
+
+const mkvparser::Cluster *MatroskaExtractor::findCluster_l(long long timeNs) {
+    if (mClusterIndex.empty()) {
+        return mSegment->FindCluster(timeNs);
+    }
+
+    // Extend the index up to the first cluster starting after timeNs. This only
+    // reads the cluster headers, and each cluster only once.
+    while (!mClusterIndexDone && mClusterIndex.back().mTimeNs <= timeNs) {
+        const mkvparser::Cluster *last = mClusterIndex.back().mCluster;
+        const mkvparser::Cluster *next;
+        long long pos;
+        long len;
+        long res = mSegment->ParseNext(last, next, pos, len);
+        if (res != 0 || next == NULL || next->EOS()) {
+            if (res > 0) {
+                // no more clusters
+                mClusterIndexDone = true;
+            }
+            break;
+        }
+
+        addToClusterIndex_l(last, next);
+        if (mClusterIndex.back().mCluster != next) {
+            break;
+        }
+    }
+
+    // The last cluster starting at or before timeNs.
+    auto it = std::upper_bound(
+            mClusterIndex.begin(), mClusterIndex.end(), timeNs,
+            [](long long t, const ClusterIndexEntry &entry) { return t < entry.mTimeNs; });
+    if (it != mClusterIndex.begin()) {
+        --it;
+    }
+    return it->mCluster;
+}
+
 size_t MatroskaExtractor::countTracks() {
     return mTracks.size();
 }
@@ -26,6 +26,8 @@
 #include <utils/Vector.h>
 #include <utils/threads.h>
 
+#include <vector>
+
 namespace android {
 
 struct AMessage;
@@ -92,6 +94,19 @@ private:
     bool mIsWebm;
     int64_t mSeekPreRollNs;
 
+    // Start times of the clusters from the first one on, as far as they have been
+    // parsed, to seek in files without Cues. Guarded by mLock.
+    struct ClusterIndexEntry {
+        long long mTimeNs;
+        const mkvparser::Cluster *mCluster;
+    };
+    std::vector<ClusterIndexEntry> mClusterIndex;
+    bool mClusterIndexDone;
+
+    void addToClusterIndex_l(
+            const mkvparser::Cluster *prev, const mkvparser::Cluster *next);
+    const mkvparser::Cluster *findCluster_l(long long timeNs);
+
     status_t synthesizeAVCC(TrackInfo *trackInfo, size_t index);
     status_t synthesizeMPEG2(TrackInfo *trackInfo, size_t index);
     status_t synthesizeMPEG4(TrackInfo *trackInfo, size_t index);
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameIndexSeeker"
+#include <utils/Log.h>
+
+#include "FrameIndexSeeker.h"
+
+#include <algorithm>
+
+#include <media/MediaExtractorPluginApi.h>
+#include <media/MediaExtractorPluginHelper.h>
+#include <media/stagefright/DataSourceBase.h>
+#include <media/stagefright/foundation/avc_utils.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+
+namespace android {
+
+// The header bits that must match between frames, same as in MP3Extractor.
+static const uint32_t kMask = 0xfffe0c00;
+
+// Largest MPEG audio frame, see MP3Source::kMaxFrameSize.
+static const size_t kMaxFrameSize = 4096;
+
+// Frame headers are walked in blocks of this size.
+static const size_t kScanBlockSize = 64 * 1024;
+
+// 64 KB of positions. With 1152 samples per frame at 44.1 kHz, every frame of
+// the first 3.5 minutes is indexed, and every 128th frame of a 4 hour stream.
+const size_t FrameIndexSeeker::kMaxEntries = 8192;
+
+// static
+FrameIndexSeeker *FrameIndexSeeker::CreateFromSource(
+        DataSourceHelper *source, off64_t first_frame_pos, uint32_t fixed_header) {
+    int sampleRate;
+    int samplesPerFrame;
+    size_t frameSize;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, NULL, &samplesPerFrame)
+            || sampleRate <= 0 || samplesPerFrame <= 0) {
+        return NULL;
+    }
+
+    FrameIndexSeeker *seeker = new FrameIndexSeeker;
+    seeker->mDataSource = source;
+    seeker->mFixedHeader = fixed_header;
+    seeker->mSampleRate = sampleRate;
+    seeker->mSamplesPerFrame = samplesPerFrame;
+    seeker->mCanScan = (source->flags()
+            & (DataSourceBase::kIsCachingDataSource | DataSourceBase::kIsHTTPBasedSource)) == 0;
+    seeker->mEndPos = first_frame_pos;
+
+    return seeker;
+}
+
+FrameIndexSeeker::FrameIndexSeeker()
+    : mDataSource(NULL),
+      mFixedHeader(0),
+      mSampleRate(0),
+      mSamplesPerFrame(0),
+      mCanScan(false),
+      mStride(1),
+      mEndPos(0),
+      mEndFrame(0),
+      mEndReached(false) {
+}
+
+bool FrameIndexSeeker::getDuration(int64_t *durationUs) {
+    if (!mEndReached) {
+        return false;
+    }
+
+    *durationUs = frameTimeUs(mEndFrame);
+
+    return true;
+}
+
+bool FrameIndexSeeker::getOffsetForTime(
+        int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode mode) {
+    if (*timeUs >= INT64_MAX / mSampleRate) {
+        return false;
+    }
+
+    // The last frame starting at or before *timeUs, as frameTimeUs() rounds down.
+    int64_t targetFrame = 0;
+    if (*timeUs > 0) {
+        targetFrame = ((*timeUs + 1) * mSampleRate - 1) / (mSamplesPerFrame * 1000000LL);
+    }
+    if (frameTimeUs(targetFrame) < *timeUs) {
+        switch (mode) {
+            case MediaTrackHelper::ReadOptions::SEEK_NEXT_SYNC:
+                ++targetFrame;
+                break;
+            case MediaTrackHelper::ReadOptions::SEEK_CLOSEST_SYNC:
+            case MediaTrackHelper::ReadOptions::SEEK_CLOSEST:
+                if (frameTimeUs(targetFrame + 1) - *timeUs < *timeUs - frameTimeUs(targetFrame)) {
+                    ++targetFrame;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    off64_t framePos;
+    int64_t frame;
+    if (targetFrame >= mEndFrame) {
+        if (!mEndReached && !mCanScan) {
+            // Leave it to the bitrate based estimate rather than reading up
+            // to the target through the network.
+            return false;
+        }
+        framePos = mEndPos;
+        frame = mEndFrame;
+        if (!mEndReached) {
+            ALOGV("indexing frames %lld to %lld", (long long)mEndFrame, (long long)targetFrame);
+            if (!walkFrames(&framePos, &frame, targetFrame) && !mEndReached) {
+                // Lost sync before the target, whose position is unknown.
+                return false;
+            }
+        }
+        // Past the last frame, seek to the end of the stream.
+    } else {
+        const size_t index = targetFrame / mStride;
+        framePos = mPositions[index];
+        frame = index * mStride;
+        if (!walkFrames(&framePos, &frame, targetFrame)) {
+            return false;
+        }
+    }
+
+    *pos = framePos;
+    *timeUs = frameTimeUs(frame);
+
+    return true;
+}
+
+void FrameIndexSeeker::onFrameRead(off64_t pos, size_t frameSize) {
+    // Only extend the index with the frame right after it.
+    if (pos == mEndPos && !mEndReached) {
+        addFrame(pos, frameSize);
+    }
+}
+
+int64_t FrameIndexSeeker::frameTimeUs(int64_t frame) const {
+    return frame * mSamplesPerFrame * 1000000LL / mSampleRate;
+}
+
+void FrameIndexSeeker::addFrame(off64_t pos, size_t frameSize) {
+    if (mEndFrame % mStride == 0) {
+        if (mPositions.size() == kMaxEntries) {
+            // Keep every other entry, the frames that are multiples of twice the stride.
+            size_t n = 0;
+            for (size_t i = 0; i < mPositions.size(); i += 2) {
+                mPositions[n++] = mPositions[i];
+            }
+            mPositions.resize(n);
+            mStride *= 2;
+            ALOGV("index full, now indexing every %lld frames", (long long)mStride);
+        }
+        if (mEndFrame % mStride == 0) {
+            mPositions.push_back(pos);
+        }
+    }
+
+    mEndPos = pos + frameSize;
+    ++mEndFrame;
+}
+
+bool FrameIndexSeeker::walkFrames(off64_t *pos, int64_t *frame, int64_t targetFrame) {
+    std::vector<uint8_t> buffer;
+    off64_t bufferPos = 0;
+    bool lostSync = false;
+    while (*frame < targetFrame) {
+        if (*pos < bufferPos || *pos + 4 > bufferPos + (off64_t)buffer.size()) {
+            // Read the next block, up to the largest size the remaining frames can have.
+            const size_t size = std::min<int64_t>(
+                    targetFrame - *frame, kScanBlockSize / kMaxFrameSize) * kMaxFrameSize;
+            buffer.resize(size);
+            ssize_t n = mDataSource->readAt(*pos, buffer.data(), size);
+            buffer.resize(n < 0 ? 0 : n);
+            bufferPos = *pos;
+            if (n < 4) {
+                break;
+            }
+        }
+
+        const uint32_t header = U32_AT(&buffer[*pos - bufferPos]);
+        size_t frameSize;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(header, &frameSize)) {
+            ALOGV("lost sync at %lld", (long long)*pos);
+            lostSync = true;
+            break;
+        }
+
+        if (*pos == mEndPos && !mEndReached) {
+            addFrame(*pos, frameSize);
+        }
+        *pos += frameSize;
+        ++*frame;
+    }
+
+    if (*frame == targetFrame) {
+        return true;
+    }
+    if (*pos == mEndPos) {
+        if (lostSync) {
+            // The frame numbers past this point are unknown, leave seeks
+            // beyond it to the bitrate based estimate.
+            mCanScan = false;
+        } else {
+            ALOGV("indexed all %lld frames", (long long)mEndFrame);
+            mEndReached = true;
+        }
+    }
+    return false;
+}
+
+}  // namespace android
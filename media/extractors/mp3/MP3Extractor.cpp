@@ -20,6 +20,7 @@
 
 #include "MP3Extractor.h"
 
+#include "FrameIndexSeeker.h"
 #include "ID3.h"
 #include "VBRISeeker.h"
 #include "XINGSeeker.h"
@@ -310,6 +311,9 @@ MP3Extractor::MP3Extractor(
         }
         mFirstFramePos = pos;
         mFixedHeader = header;
+    } else {
+        // Without a table of contents, index the frames to seek accurately.
+        mSeeker = FrameIndexSeeker::CreateFromSource(mDataSource, mFirstFramePos, mFixedHeader);
     }
 
     size_t frame_size;
@@ -494,7 +498,7 @@ media_status_t MP3Source::read(
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
         int64_t actualSeekTimeUs = seekTimeUs;
         if (mSeeker == NULL
-                || !mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
+                || !mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos, mode)) {
             int32_t bitrate;
             if (!AMediaFormat_getInt32(mMeta, AMEDIAFORMAT_KEY_BIT_RATE, &bitrate)) {
                 // bitrate is in bits/sec.
@@ -592,6 +596,9 @@ media_status_t MP3Source::read(
     AMediaFormat_setInt64(meta, AMEDIAFORMAT_KEY_TIME_US, mCurrentTimeUs);
     AMediaFormat_setInt32(meta, AMEDIAFORMAT_KEY_IS_SYNC_FRAME, 1);
 
+    if (mSeeker != NULL) {
+        mSeeker->onFrameRead(mCurrentPos, frame_size);
+    }
     mCurrentPos += frame_size;
 
     mSamplesRead += num_samples;
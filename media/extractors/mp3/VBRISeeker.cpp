@@ -164,7 +164,8 @@ bool VBRISeeker::getDuration(int64_t *durationUs) {
     return true;
 }
 
-bool VBRISeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+bool VBRISeeker::getOffsetForTime(
+        int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode /* mode */) {
     if (mDurationUs < 0 || mSegments.size() == 0) {
         return false;
     }
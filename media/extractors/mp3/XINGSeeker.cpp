@@ -45,7 +45,8 @@ bool XINGSeeker::getDuration(int64_t *durationUs) {
     return true;
 }
 
-bool XINGSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+bool XINGSeeker::getOffsetForTime(
+        int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode /* mode */) {
     if (mSizeBytes == 0 || mDurationUs < 0) {
         return false;
     }
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_INDEX_SEEKER_H_
+
+#define FRAME_INDEX_SEEKER_H_
+
+#include "MP3Seeker.h"
+
+#include <vector>
+
+namespace android {
+
+class DataSourceHelper;
+
+// Seeker for streams without a XING or VBRI table of contents. It indexes the
+// positions of the frames from the first one on, as they are read or scanned
+// for a seek, so that seeks land on the exact frame of the requested time.
+// At most kMaxEntries frames are indexed: once the index is full, every other
+// entry is dropped and only every second frame is indexed from then on. A seek
+// looks up the closest preceding indexed frame and walks the frame headers
+// from there.
+struct FrameIndexSeeker : public MP3Seeker {
+    static FrameIndexSeeker *CreateFromSource(
+            DataSourceHelper *source, off64_t first_frame_pos, uint32_t fixed_header);
+
+    // Only known once the whole stream has been indexed.
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(
+            int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode mode);
+    virtual void onFrameRead(off64_t pos, size_t frameSize);
+
+private:
+    static const size_t kMaxEntries;
+
+    DataSourceHelper *mDataSource;
+    uint32_t mFixedHeader;
+    int32_t mSampleRate;
+    int32_t mSamplesPerFrame;
+    // Frames are scanned ahead for a seek only if the source is not streamed,
+    // and until a frame header does not match.
+    bool mCanScan;
+
+    // Positions of the frames whose number is a multiple of mStride, so
+    // mPositions[i] is the position of frame i * mStride.
+    std::vector<off64_t> mPositions;
+    int64_t mStride;
+    // Position and number of the first frame that has not been indexed yet.
+    off64_t mEndPos;
+    int64_t mEndFrame;
+    // Set once the frame at mEndPos can not be read, so the index is complete.
+    bool mEndReached;
+
+    FrameIndexSeeker();
+
+    // Rounded down, as MP3Source computes the frame times from the sample count.
+    int64_t frameTimeUs(int64_t frame) const;
+    void addFrame(off64_t pos, size_t frameSize);
+    // Walks the frame headers from frame number *frame at *pos to frame number
+    // |targetFrame|, indexing any frame past the end of the index on the way.
+    bool walkFrames(off64_t *pos, int64_t *frame, int64_t targetFrame);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameIndexSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_INDEX_SEEKER_H_
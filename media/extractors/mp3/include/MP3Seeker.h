@@ -18,6 +18,7 @@
 
 #define MP3_SEEKER_H_
 
+#include <media/MediaExtractorPluginHelper.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/RefBase.h>
 
@@ -30,8 +31,13 @@ struct MP3Seeker {
 
     // Given a request seek time in "*timeUs", find the byte offset closest
     // to that position and return it in "*pos". Update "*timeUs" to reflect
-    // the actual time that seekpoint represents.
-    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos) = 0;
+    // the actual time that seekpoint represents. Seekers that know where
+    // each frame is pick the frame of "*timeUs" according to "mode".
+    virtual bool getOffsetForTime(
+            int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode mode) = 0;
+
+    // Called with the position and size of each frame that has been read.
+    virtual void onFrameRead(off64_t /* pos */, size_t /* frameSize */) {}
 
     virtual ~MP3Seeker() {}
 
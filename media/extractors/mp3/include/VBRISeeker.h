@@ -31,7 +31,8 @@ struct VBRISeeker : public MP3Seeker {
             DataSourceHelper *source, off64_t post_id3_pos);
 
     virtual bool getDuration(int64_t *durationUs);
-    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+    virtual bool getOffsetForTime(
+            int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode mode);
 
 private:
     off64_t mBasePos;
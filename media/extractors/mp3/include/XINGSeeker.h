@@ -29,7 +29,8 @@ struct XINGSeeker : public MP3Seeker {
             DataSourceHelper *source, off64_t first_frame_pos);
 
     virtual bool getDuration(int64_t *durationUs);
-    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+    virtual bool getOffsetForTime(
+            int64_t *timeUs, off64_t *pos, MediaTrackHelper::ReadOptions::SeekMode mode);
 
     virtual int32_t getEncoderDelay();
     virtual int32_t getEncoderPadding();
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <android-base/properties.h>
 #include <log/log.h>
 #include <utils/Log.h>
 
@@ -214,6 +215,8 @@ private:
         size_t size;
         uint32_t duration;
         int32_t compositionOffset;
+        // whether the sample flags of the trun box mark this as a sync sample
+        bool isSync;
         uint8_t iv[16];
         Vector<uint32_t> clearsizes;
         Vector<uint32_t> encryptedsizes;
@@ -240,6 +243,7 @@ public:
     ssize_t readAt(off64_t offset, void *data, size_t size) override;
     status_t getSize(off64_t *size) override;
     uint32_t flags() override;
+    const uint8_t *getView(off64_t offset, size_t size) override;
 
     status_t setCachedRange(off64_t offset, size_t size, bool assumeSourceOwnershipOnSuccess);
 
@@ -304,6 +308,19 @@ uint32_t CachedRangedDataSource::flags() {
     return mSource->flags();
 }
 
+const uint8_t *CachedRangedDataSource::getView(off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    // the cache is only replaced before the source is used.
+    if (isInRange(mCachedOffset, mCachedSize, offset, size)) {
+        return &mCache[offset - mCachedOffset];
+    }
+
+    return mSource->getView(offset, size);
+}
+
+static_assert(DataSourceHelper::kCanProvideViews == DataSourceBase::kCanProvideViews);
+
 status_t CachedRangedDataSource::setCachedRange(off64_t offset,
         size_t size,
         bool assumeSourceOwnershipOnSuccess) {
@@ -432,10 +449,35 @@ MPEG4Extractor::MPEG4Extractor(DataSourceHelper *source, const char *mime)
       mHasMoovBox(false),
       mPreferHeif(mime != NULL && !strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_HEIF)),
       mIsAvif(false),
+      mSampleIndexMode(SampleTable::kIndexModeDirect),
+      mSampleIndexBudget(SampleTable::kDefaultIndexBudget),
+      mDeferSampleTableLoading(false),
       mFirstTrack(NULL),
       mLastTrack(NULL) {
     ALOGV("mime=%s, mPreferHeif=%d", mime, mPreferHeif);
     mFileMetaData = AMediaFormat_new();
+
+    const std::string indexMode =
+            android::base::GetProperty("media.extractor.mp4.sample_index", "direct");
+    if (indexMode == "full") {
+        mSampleIndexMode = SampleTable::kIndexModeFull;
+    } else if (indexMode == "windowed") {
+        mSampleIndexMode = SampleTable::kIndexModeWindowed;
+    }
+    mSampleIndexBudget = android::base::GetUintProperty<size_t>(
+            "media.extractor.mp4.sample_index_kb", SampleTable::kDefaultIndexBudget / 1024,
+            SIZE_MAX / 1024) * 1024;
+    mDeferSampleTableLoading =
+            android::base::GetBoolProperty("media.extractor.mp4.defer_stbl", false);
+}
+
+void MPEG4Extractor::setSampleIndexMode(uint32_t mode, size_t budget) {
+    mSampleIndexMode = mode;
+    mSampleIndexBudget = budget;
+}
+
+void MPEG4Extractor::setDeferSampleTableLoading(bool defer) {
+    mDeferSampleTableLoading = defer;
 }
 
 MPEG4Extractor::~MPEG4Extractor() {
@@ -1011,6 +1053,8 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 }
 
                 mLastTrack->sampleTable = new SampleTable(mDataSource);
+                mLastTrack->sampleTable->setIndexMode(mSampleIndexMode, mSampleIndexBudget);
+                mLastTrack->sampleTable->setDeferLoading(mDeferSampleTableLoading);
             }
 
             bool isTrack = false;
@@ -2525,15 +2569,14 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         {
             *offset += chunk_size;
 
-            auto buffer = heapbuffer<uint8_t>(chunk_data_size);
-
-            if (buffer.get() == NULL) {
+            const uint8_t *data;
+            std::unique_ptr<uint8_t[]> buffer;
+            status_t err = mDataSource->getViewOrRead(
+                    data_offset, chunk_data_size, &data, &buffer);
+            if (err == NO_MEMORY) {
                 ALOGE("b/28471206");
                 return NO_MEMORY;
-            }
-
-            if (mDataSource->readAt(
-                        data_offset, buffer.get(), chunk_data_size) < chunk_data_size) {
+            } else if (err != OK) {
                 return ERROR_IO;
             }
 
@@ -2541,21 +2584,20 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
 
             AMediaFormat_setBuffer(mLastTrack->meta,
-                    AMEDIAFORMAT_KEY_CSD_AVC, buffer.get(), chunk_data_size);
+                    AMEDIAFORMAT_KEY_CSD_AVC, data, chunk_data_size);
 
             break;
         }
         case FOURCC("hvcC"):
         {
-            auto buffer = heapbuffer<uint8_t>(chunk_data_size);
-
-            if (buffer.get() == NULL) {
+            const uint8_t *data;
+            std::unique_ptr<uint8_t[]> buffer;
+            status_t err = mDataSource->getViewOrRead(
+                    data_offset, chunk_data_size, &data, &buffer);
+            if (err == NO_MEMORY) {
                 ALOGE("b/28471206");
                 return NO_MEMORY;
-            }
-
-            if (mDataSource->readAt(
-                        data_offset, buffer.get(), chunk_data_size) < chunk_data_size) {
+            } else if (err != OK) {
                 return ERROR_IO;
             }
 
@@ -2563,7 +2605,7 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
 
             AMediaFormat_setBuffer(mLastTrack->meta,
-                    AMEDIAFORMAT_KEY_CSD_HEVC, buffer.get(), chunk_data_size);
+                    AMEDIAFORMAT_KEY_CSD_HEVC, data, chunk_data_size);
 
             *offset += chunk_size;
             break;
@@ -2572,15 +2614,14 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         case FOURCC("vpcC"):
         case FOURCC("av1C"):
         {
-            auto buffer = heapbuffer<uint8_t>(chunk_data_size);
-
-            if (buffer.get() == NULL) {
+            const uint8_t *data;
+            std::unique_ptr<uint8_t[]> buffer;
+            status_t err = mDataSource->getViewOrRead(
+                    data_offset, chunk_data_size, &data, &buffer);
+            if (err == NO_MEMORY) {
                 ALOGE("b/28471206");
                 return NO_MEMORY;
-            }
-
-            if (mDataSource->readAt(
-                        data_offset, buffer.get(), chunk_data_size) < chunk_data_size) {
+            } else if (err != OK) {
                 return ERROR_IO;
             }
 
@@ -2588,7 +2629,7 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
 
             AMediaFormat_setBuffer(mLastTrack->meta,
-                   AMEDIAFORMAT_KEY_CSD_0, buffer.get(), chunk_data_size);
+                   AMEDIAFORMAT_KEY_CSD_0, data, chunk_data_size);
 
             *offset += chunk_size;
             break;
@@ -2602,14 +2643,14 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
             }
 
-            auto buffer = heapbuffer<uint8_t>(chunk_data_size);
-
-            if (buffer.get() == NULL) {
+            const uint8_t *data;
+            std::unique_ptr<uint8_t[]> buffer;
+            status_t err = mDataSource->getViewOrRead(
+                    data_offset, chunk_data_size, &data, &buffer);
+            if (err == NO_MEMORY) {
                 ALOGE("b/28471206");
                 return NO_MEMORY;
-            }
-
-            if (mDataSource->readAt(data_offset, buffer.get(), chunk_data_size) < chunk_data_size) {
+            } else if (err != OK) {
                 return ERROR_IO;
             }
 
@@ -2617,7 +2658,7 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
 
             AMediaFormat_setBuffer(mLastTrack->meta, AMEDIAFORMAT_KEY_CSD_2,
-                                    buffer.get(), chunk_data_size);
+                                    data, chunk_data_size);
             AMediaFormat_setString(mLastTrack->meta, AMEDIAFORMAT_KEY_MIME,
                                    MEDIA_MIMETYPE_VIDEO_DOLBY_VISION);
 
@@ -2980,13 +3021,14 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
             if (chunk_data_size < 0 || static_cast<uint64_t>(chunk_data_size) >= SIZE_MAX - 1) {
                 return ERROR_MALFORMED;
             }
-            auto buffer = heapbuffer<uint8_t>(chunk_data_size);
-            if (buffer.get() == NULL) {
+            const uint8_t *data;
+            std::unique_ptr<uint8_t[]> buffer;
+            status_t err = mDataSource->getViewOrRead(
+                    data_offset, chunk_data_size, &data, &buffer);
+            if (err == NO_MEMORY) {
                 ALOGE("b/28471206");
                 return NO_MEMORY;
-            }
-            if (mDataSource->readAt(
-                data_offset, buffer.get(), chunk_data_size) != (ssize_t)chunk_data_size) {
+            } else if (err != OK) {
                 return ERROR_IO;
             }
             const int kSkipBytesOfDataBox = 16;
@@ -2996,7 +3038,7 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
             AMediaFormat_setBuffer(mFileMetaData,
                 AMEDIAFORMAT_KEY_ALBUMART,
-                buffer.get() + kSkipBytesOfDataBox, chunk_data_size - kSkipBytesOfDataBox);
+                data + kSkipBytesOfDataBox, chunk_data_size - kSkipBytesOfDataBox);
 
             break;
         }
@@ -5864,6 +5906,9 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
         kSampleCompositionTimeOffsetPresent = 0x800,
     };
 
+    // sample_is_non_sync_sample of the sample flags
+    static constexpr uint32_t kSampleIsNonSyncSample = 0x10000;
+
     uint32_t flags;
     if (!mDataSource->getUInt32(offset, &flags)) {
         return ERROR_MALFORMED;
@@ -6034,6 +6079,7 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
         tmp.size = sampleSize;
         tmp.duration = sampleDuration;
         tmp.compositionOffset = sampleCtsOffset;
+        tmp.isSync = (flags & kSampleFlagsPresent) && !(sampleFlags & kSampleIsNonSyncSample);
         memset(tmp.iv, 0, sizeof(tmp.iv));
         if (mCurrentSamples.add(tmp) < 0) {
             ALOGW("b/123389881 failed saving sample(n=%zu)", mCurrentSamples.size());
@@ -6691,8 +6737,9 @@ media_status_t MPEG4Source::fragmentedRead(
             mBuffer->release();
             mBuffer = NULL;
         }
-        if (mCurrentSampleIndex >= mCurrentSamples.size()) {
-            // move to next fragment if there is one
+        // move to next fragment if there is one, skipping the fragments which have no
+        // samples of this track.
+        while (mCurrentSampleIndex >= mCurrentSamples.size()) {
             if (mNextMoofOffset <= mCurrentMoofOffset) {
                 return AMEDIA_ERROR_END_OF_STREAM;
             }
@@ -6704,9 +6751,6 @@ media_status_t MPEG4Source::fragmentedRead(
             if (err != OK) {
                 return AMEDIA_ERROR_UNKNOWN;
             }
-            if (mCurrentSampleIndex >= mCurrentSamples.size()) {
-                return AMEDIA_ERROR_END_OF_STREAM;
-            }
         }
 
         const Sample *smpl = &mCurrentSamples[mCurrentSampleIndex];
@@ -6723,7 +6767,7 @@ media_status_t MPEG4Source::fragmentedRead(
         }
 
         mCurrentTime += smpl->duration;
-        isSyncSample = (mCurrentSampleIndex == 0);
+        isSyncSample = (mCurrentSampleIndex == 0) || smpl->isSync;
 
         status_t err = mBufferGroup->acquire_buffer(&mBuffer);
 
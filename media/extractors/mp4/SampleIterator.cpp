@@ -206,29 +206,21 @@ status_t SampleIterator::getChunkOffset(uint32_t chunk, off64_t *offset) {
         return ERROR_OUT_OF_RANGE;
     }
 
+    const uint8_t *entry;
     if (mTable->mChunkOffsetType == SampleTable::kChunkOffsetType32) {
-        uint32_t offset32;
-
-        if (mTable->mDataSource->readAt(
-                    mTable->mChunkOffsetOffset + 8 + 4 * chunk,
-                    &offset32,
-                    sizeof(offset32)) < (ssize_t)sizeof(offset32)) {
+        if ((entry = mTable->getChunkOffsetEntry_l(4 * (size_t)chunk, 4)) == NULL) {
             return ERROR_IO;
         }
 
-        *offset = ntohl(offset32);
+        *offset = U32_AT(entry);
     } else {
         CHECK_EQ(mTable->mChunkOffsetType, SampleTable::kChunkOffsetType64);
 
-        uint64_t offset64;
-        if (mTable->mDataSource->readAt(
-                    mTable->mChunkOffsetOffset + 8 + 8 * chunk,
-                    &offset64,
-                    sizeof(offset64)) < (ssize_t)sizeof(offset64)) {
+        if ((entry = mTable->getChunkOffsetEntry_l(8 * (size_t)chunk, 8)) == NULL) {
             return ERROR_IO;
         }
 
-        *offset = ntoh64(offset64);
+        *offset = U64_AT(entry);
     }
 
     return OK;
@@ -247,43 +239,35 @@ status_t SampleIterator::getSampleSizeDirect(
         return OK;
     }
 
+    const uint8_t *entry;
     switch (mTable->mSampleSizeFieldSize) {
         case 32:
         {
-            uint32_t x;
-            if (mTable->mDataSource->readAt(
-                        mTable->mSampleSizeOffset + 12 + 4 * sampleIndex,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+            if ((entry = mTable->getSampleSizeEntry_l(4 * (size_t)sampleIndex, 4)) == NULL) {
                 return ERROR_IO;
             }
 
-            *size = ntohl(x);
+            *size = U32_AT(entry);
             break;
         }
 
         case 16:
         {
-            uint16_t x;
-            if (mTable->mDataSource->readAt(
-                        mTable->mSampleSizeOffset + 12 + 2 * sampleIndex,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+            if ((entry = mTable->getSampleSizeEntry_l(2 * (size_t)sampleIndex, 2)) == NULL) {
                 return ERROR_IO;
             }
 
-            *size = ntohs(x);
+            *size = U16_AT(entry);
             break;
         }
 
         case 8:
         {
-            uint8_t x;
-            if (mTable->mDataSource->readAt(
-                        mTable->mSampleSizeOffset + 12 + sampleIndex,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+            if ((entry = mTable->getSampleSizeEntry_l(sampleIndex, 1)) == NULL) {
                 return ERROR_IO;
             }
 
-            *size = x;
+            *size = *entry;
             break;
         }
 
@@ -291,14 +275,11 @@ status_t SampleIterator::getSampleSizeDirect(
         {
             CHECK_EQ(mTable->mSampleSizeFieldSize, 4u);
 
-            uint8_t x;
-            if (mTable->mDataSource->readAt(
-                        mTable->mSampleSizeOffset + 12 + sampleIndex / 2,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+            if ((entry = mTable->getSampleSizeEntry_l(sampleIndex / 2, 1)) == NULL) {
                 return ERROR_IO;
             }
 
-            *size = (sampleIndex & 1) ? x & 0x0f : x >> 4;
+            *size = (sampleIndex & 1) ? *entry & 0x0f : *entry >> 4;
             break;
         }
     }
@@ -328,8 +309,8 @@ status_t SampleIterator::findSampleTimeAndDuration(
         mTTSSampleIndex += mTTSCount;
         mTTSSampleTime += mTTSCount * mTTSDuration;
 
-        mTTSCount = mTable->mTimeToSample[2 * mTimeToSampleIndex];
-        mTTSDuration = mTable->mTimeToSample[2 * mTimeToSampleIndex + 1];
+        mTTSCount = mTable->getTimeToSample(2 * mTimeToSampleIndex);
+        mTTSDuration = mTable->getTimeToSample(2 * mTimeToSampleIndex + 1);
 
         ++mTimeToSampleIndex;
     }
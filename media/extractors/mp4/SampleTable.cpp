@@ -18,7 +18,10 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <limits>
+#include <memory>
+#include <vector>
 
 #include "SampleTable.h"
 #include "SampleIterator.h"
@@ -114,20 +117,194 @@ int32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Provides the entries of a sample size or chunk offset table, from a view of the
+// source or according to the index mode.
+struct SampleTable::TableIndex {
+    TableIndex(DataSourceHelper *source, off64_t offset, size_t size,
+            const uint8_t *view, uint32_t mode, size_t budget);
+
+    // length is at most 8 and offset a multiple of it, so that entries never span windows.
+    const uint8_t *get(size_t offset, size_t length);
+
+    // Returns the bytes from offset to the end of the table or of a window, and sets
+    // *length to their number. Successive blocks from offset 0 never split an entry.
+    const uint8_t *getBlock(size_t offset, size_t *length);
+
+private:
+    static constexpr size_t kWindowSize = 16 * 1024;
+
+    struct Window {
+        size_t mStart;
+        uint64_t mLastUse;
+        std::unique_ptr<uint8_t[]> mData;
+    };
+
+    DataSourceHelper *mSource;
+    off64_t mOffset;
+    size_t mSize;
+    const uint8_t *mView;
+    uint32_t mMode;
+
+    std::unique_ptr<uint8_t[]> mTable;
+    std::unique_ptr<uint8_t[]> mBlock;
+
+    size_t mMaxWindows;
+    std::vector<Window> mWindows;
+    uint64_t mUseCount;
+
+    uint8_t mEntry[8];
+
+    void readTableIfNeeded();
+    const uint8_t *getFromWindow(size_t offset);
+
+    DISALLOW_EVIL_CONSTRUCTORS(TableIndex);
+};
+
+SampleTable::TableIndex::TableIndex(
+        DataSourceHelper *source, off64_t offset, size_t size,
+        const uint8_t *view, uint32_t mode, size_t budget)
+    : mSource(source),
+      mOffset(offset),
+      mSize(size),
+      mView(view),
+      mMode(mode),
+      mMaxWindows(std::max(budget / kWindowSize, (size_t)2)),
+      mUseCount(0) {
+}
+
+const uint8_t *SampleTable::TableIndex::get(size_t offset, size_t length) {
+    if (offset > mSize || length > mSize - offset || length > sizeof(mEntry)) {
+        return NULL;
+    }
+
+    if (mView != NULL) {
+        return mView + offset;
+    }
+
+    readTableIfNeeded();
+
+    switch (mMode) {
+        case kIndexModeFull:
+            return mTable.get() + offset;
+
+        case kIndexModeWindowed:
+            return getFromWindow(offset);
+
+        default:
+            if (mSource->readAt(mOffset + offset, mEntry, length) < (ssize_t)length) {
+                return NULL;
+            }
+            return mEntry;
+    }
+}
+
+const uint8_t *SampleTable::TableIndex::getBlock(size_t offset, size_t *length) {
+    if (offset >= mSize) {
+        return NULL;
+    }
+
+    if (mView != NULL) {
+        *length = mSize - offset;
+        return mView + offset;
+    }
+
+    readTableIfNeeded();
+
+    const size_t windowEnd = std::min(offset - offset % kWindowSize + kWindowSize, mSize);
+    switch (mMode) {
+        case kIndexModeFull:
+            *length = mSize - offset;
+            return mTable.get() + offset;
+
+        case kIndexModeWindowed:
+            *length = windowEnd - offset;
+            return getFromWindow(offset);
+
+        default:
+            *length = windowEnd - offset;
+            if (mBlock == NULL) {
+                mBlock.reset(new (std::nothrow) uint8_t[kWindowSize]);
+            }
+            if (mBlock == NULL
+                    || mSource->readAt(mOffset + offset, mBlock.get(), *length)
+                            < (ssize_t)*length) {
+                return NULL;
+            }
+            return mBlock.get();
+    }
+}
+
+void SampleTable::TableIndex::readTableIfNeeded() {
+    if (mMode != kIndexModeFull || mTable != NULL) {
+        return;
+    }
+
+    mTable.reset(new (std::nothrow) uint8_t[mSize]);
+    if (mTable == NULL || mSource->readAt(mOffset, mTable.get(), mSize) != (ssize_t)mSize) {
+        ALOGW("Cannot read table of %zu bytes, reading entries as needed.", mSize);
+        mTable.reset();
+        mMode = kIndexModeDirect;
+    }
+}
+
+const uint8_t *SampleTable::TableIndex::getFromWindow(size_t offset) {
+    const size_t start = offset - offset % kWindowSize;
+
+    Window *window = NULL;
+    for (Window &w : mWindows) {
+        if (w.mStart == start) {
+            window = &w;
+            break;
+        }
+        if (window == NULL || w.mLastUse < window->mLastUse) {
+            window = &w;
+        }
+    }
+
+    if (window == NULL || window->mStart != start) {
+        if (mWindows.size() < mMaxWindows) {
+            mWindows.push_back({SIZE_MAX, 0, std::unique_ptr<uint8_t[]>(
+                    new (std::nothrow) uint8_t[kWindowSize])});
+            window = &mWindows.back();
+            if (window->mData == NULL) {
+                mWindows.pop_back();
+                return NULL;
+            }
+        }
+        // evicts the least recently used window when all are in use.
+        const size_t length = std::min(kWindowSize, mSize - start);
+        window->mStart = SIZE_MAX;
+        if (mSource->readAt(mOffset + start, window->mData.get(), length) < (ssize_t)length) {
+            return NULL;
+        }
+        window->mStart = start;
+    }
+
+    window->mLastUse = ++mUseCount;
+    return window->mData.get() + (offset - start);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 SampleTable::SampleTable(DataSourceHelper *source)
     : mDataSource(source),
       mChunkOffsetOffset(-1),
       mChunkOffsetType(0),
       mNumChunkOffsets(0),
+      mChunkOffsetIndex(NULL),
       mSampleToChunkOffset(-1),
       mNumSampleToChunkOffsets(0),
       mSampleSizeOffset(-1),
       mSampleSizeFieldSize(0),
       mDefaultSampleSize(0),
       mNumSampleSizes(0),
+      mSampleSizeIndex(NULL),
+      mIndexMode(kIndexModeDirect),
+      mIndexBudget(kDefaultIndexBudget),
       mHasTimeToSample(false),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleView(NULL),
       mSampleTimeEntries(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
@@ -136,6 +313,8 @@ SampleTable::SampleTable(DataSourceHelper *source)
       mNumSyncSamples(0),
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
+      mDeferLoading(false),
+      mDeferredStatus(OK),
       mSampleToChunkEntries(NULL),
       mTotalSize(0) {
     mSampleIterator = new SampleIterator(this);
@@ -162,13 +341,108 @@ SampleTable::~SampleTable() {
 
     delete mSampleIterator;
     mSampleIterator = NULL;
+
+    delete mChunkOffsetIndex;
+    mChunkOffsetIndex = NULL;
+
+    delete mSampleSizeIndex;
+    mSampleSizeIndex = NULL;
+}
+
+void SampleTable::setIndexMode(uint32_t mode, size_t budget) {
+    mIndexMode = mode;
+    mIndexBudget = budget;
+}
+
+SampleTable::TableIndex *SampleTable::newTableIndex(off64_t data_offset, size_t data_size) {
+    const uint8_t *view = mDataSource->getView(data_offset, data_size);
+    uint32_t mode = mIndexMode;
+    if (view == NULL && mode == kIndexModeWindowed && data_size <= mIndexBudget) {
+        mode = kIndexModeFull;
+    }
+    if (view == NULL && mode == kIndexModeFull) {
+        if (mTotalSize + data_size > kMaxTotalSize) {
+            ALOGW("Table of %zu bytes would make sample table too large, using windows.",
+                    data_size);
+            mode = kIndexModeWindowed;
+        } else {
+            mTotalSize += data_size;
+        }
+    }
+    return new TableIndex(mDataSource, data_offset, data_size, view, mode, mIndexBudget);
+}
+
+const uint8_t *SampleTable::getChunkOffsetEntry_l(size_t offset, size_t length) {
+    return mChunkOffsetIndex != NULL ? mChunkOffsetIndex->get(offset, length) : NULL;
+}
+
+const uint8_t *SampleTable::getSampleSizeEntry_l(size_t offset, size_t length) {
+    return mSampleSizeIndex != NULL ? mSampleSizeIndex->get(offset, length) : NULL;
 }
 
 bool SampleTable::isValid() const {
     return mChunkOffsetOffset >= 0
-        && mSampleToChunkOffset >= 0
+        && (mSampleToChunkOffset >= 0 || hasDeferredTable(FOURCC("stsc")))
         && mSampleSizeOffset >= 0
-        && mHasTimeToSample;
+        && (mHasTimeToSample || hasDeferredTable(FOURCC("stts")));
+}
+
+status_t SampleTable::deferTable(uint32_t type, off64_t data_offset, size_t data_size) {
+    if (hasDeferredTable(type)) {
+        // already set
+        return ERROR_MALFORMED;
+    }
+
+    DeferredTable table;
+    table.mType = type;
+    table.mOffset = data_offset;
+    table.mSize = data_size;
+    mDeferredTables.push_back(table);
+
+    return OK;
+}
+
+bool SampleTable::hasDeferredTable(uint32_t type) const {
+    for (size_t i = 0; i < mDeferredTables.size(); ++i) {
+        if (mDeferredTables[i].mType == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+status_t SampleTable::loadDeferredTables_l() {
+    if (!mDeferLoading) {
+        return mDeferredStatus;
+    }
+
+    mDeferLoading = false;
+    for (size_t i = 0; i < mDeferredTables.size() && mDeferredStatus == OK; ++i) {
+        const DeferredTable &table = mDeferredTables[i];
+        switch (table.mType) {
+            case FOURCC("stsc"):
+                mDeferredStatus = setSampleToChunkParams(table.mOffset, table.mSize);
+                break;
+            case FOURCC("stts"):
+                mDeferredStatus = setTimeToSampleParams(table.mOffset, table.mSize);
+                break;
+            case FOURCC("ctts"):
+                mDeferredStatus = setCompositionTimeToSampleParams(table.mOffset, table.mSize);
+                break;
+            default:
+                CHECK_EQ(table.mType, FOURCC("stss"));
+                mDeferredStatus = setSyncSampleParams(table.mOffset, table.mSize);
+                break;
+        }
+        if (mDeferredStatus != OK) {
+            char chunk[5];
+            MakeFourCCString(table.mType, chunk);
+            ALOGE("Cannot load deferred %s table: %d", chunk, mDeferredStatus);
+        }
+    }
+    mDeferredTables.clear();
+
+    return mDeferredStatus;
 }
 
 status_t SampleTable::setChunkOffsetParams(
@@ -209,11 +483,18 @@ status_t SampleTable::setChunkOffsetParams(
         }
     }
 
+    mChunkOffsetIndex = newTableIndex(data_offset + 8,
+            (size_t)mNumChunkOffsets * (mChunkOffsetType == kChunkOffsetType32 ? 4 : 8));
+
     return OK;
 }
 
 status_t SampleTable::setSampleToChunkParams(
         off64_t data_offset, size_t data_size) {
+    if (mDeferLoading) {
+        return deferTable(FOURCC("stsc"), data_offset, data_size);
+    }
+
     if (mSampleToChunkOffset >= 0) {
         // already set
         return ERROR_MALFORMED;
@@ -284,14 +565,19 @@ status_t SampleTable::setSampleToChunkParams(
         return ERROR_MALFORMED;
     }
 
+    const uint8_t *entries = mDataSource->getView(mSampleToChunkOffset + 8,
+            (size_t)mNumSampleToChunkOffsets * sizeof(SampleToChunkEntry));
     for (uint32_t i = 0; i < mNumSampleToChunkOffsets; ++i) {
-        uint8_t buffer[sizeof(SampleToChunkEntry)];
+        uint8_t entry[sizeof(SampleToChunkEntry)];
+        const uint8_t *buffer = entry;
 
-        if (mDataSource->readAt(
+        if (entries != NULL) {
+            buffer = entries + i * sizeof(SampleToChunkEntry);
+        } else if (mDataSource->readAt(
                     mSampleToChunkOffset + 8 + i * sizeof(SampleToChunkEntry),
-                    buffer,
-                    sizeof(buffer))
-                != (ssize_t)sizeof(buffer)) {
+                    entry,
+                    sizeof(entry))
+                != (ssize_t)sizeof(entry)) {
             return ERROR_IO;
         }
         // chunk index is 1 based in the spec.
@@ -351,6 +637,8 @@ status_t SampleTable::setSampleSizeParams(
         if (data_size < 12 + mNumSampleSizes * 4) {
             return ERROR_MALFORMED;
         }
+
+        mSampleSizeIndex = newTableIndex(data_offset + 12, (size_t)mNumSampleSizes * 4);
     } else {
         if ((mDefaultSampleSize & 0xffffff00) != 0) {
             // The high 24 bits are reserved and must be 0.
@@ -368,6 +656,9 @@ status_t SampleTable::setSampleSizeParams(
         if (data_size < 12 + (mNumSampleSizes * mSampleSizeFieldSize + 4) / 8) {
             return ERROR_MALFORMED;
         }
+
+        mSampleSizeIndex = newTableIndex(data_offset + 12,
+                ((size_t)mNumSampleSizes * mSampleSizeFieldSize + 4) / 8);
     }
 
     return OK;
@@ -375,6 +666,10 @@ status_t SampleTable::setSampleSizeParams(
 
 status_t SampleTable::setTimeToSampleParams(
         off64_t data_offset, size_t data_size) {
+    if (mDeferLoading) {
+        return deferTable(FOURCC("stts"), data_offset, data_size);
+    }
+
     if (mHasTimeToSample || data_size < 8) {
         return ERROR_MALFORMED;
     }
@@ -409,6 +704,12 @@ status_t SampleTable::setTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    mTimeToSampleView = mDataSource->getView(data_offset + 8, (size_t)allocSize);
+    if (mTimeToSampleView != NULL) {
+        mHasTimeToSample = true;
+        return OK;
+    }
+
     mTimeToSample = new (std::nothrow) uint32_t[mTimeToSampleCount * 2];
     if (!mTimeToSample) {
         ALOGE("Cannot allocate time-to-sample table with %llu entries.",
@@ -436,6 +737,10 @@ status_t SampleTable::setTimeToSampleParams(
 // regardless of version.
 status_t SampleTable::setCompositionTimeToSampleParams(
         off64_t data_offset, size_t data_size) {
+    if (mDeferLoading) {
+        return deferTable(FOURCC("ctts"), data_offset, data_size);
+    }
+
     ALOGI("There are reordered frames present.");
 
     if (mCompositionTimeDeltaEntries != NULL || data_size < 8) {
@@ -509,6 +814,10 @@ status_t SampleTable::setCompositionTimeToSampleParams(
 }
 
 status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size) {
+    if (mDeferLoading) {
+        return deferTable(FOURCC("stss"), data_offset, data_size);
+    }
+
     if (mSyncSampleOffset >= 0 || data_size < 8) {
         return ERROR_MALFORMED;
     }
@@ -595,17 +904,56 @@ status_t SampleTable::getMaxSampleSize(size_t *max_size) {
 
     *max_size = 0;
 
-    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
-        size_t sample_size;
-        status_t err = getSampleSize_l(i, &sample_size);
+    if (mNumSampleSizes == 0) {
+        return OK;
+    }
 
-        if (err != OK) {
-            return err;
+    if (mDefaultSampleSize > 0) {
+        *max_size = mDefaultSampleSize;
+        return OK;
+    }
+
+    if (mSampleSizeIndex == NULL) {
+        return ERROR_IO;
+    }
+
+    // Scan the sizes a block at a time rather than looking them up one by one, which
+    // would take a read per sample in kIndexModeDirect.
+    const size_t fieldSize = mSampleSizeFieldSize;
+    uint32_t sampleIndex = 0;
+    for (size_t offset = 0; sampleIndex < mNumSampleSizes;) {
+        size_t length;
+        const uint8_t *block = mSampleSizeIndex->getBlock(offset, &length);
+        if (block == NULL) {
+            return ERROR_IO;
         }
 
-        if (sample_size > *max_size) {
-            *max_size = sample_size;
+        const uint32_t firstIndex = sampleIndex;
+        const uint32_t endIndex = (uint32_t)std::min(
+                (uint64_t)mNumSampleSizes, (uint64_t)(offset + length) * 8 / fieldSize);
+        for (; sampleIndex < endIndex; ++sampleIndex) {
+            const size_t i = sampleIndex - firstIndex;
+            size_t sample_size;
+            switch (fieldSize) {
+                case 32:
+                    sample_size = U32_AT(block + 4 * i);
+                    break;
+                case 16:
+                    sample_size = U16_AT(block + 2 * i);
+                    break;
+                case 8:
+                    sample_size = block[i];
+                    break;
+                default:
+                    sample_size = (sampleIndex & 1) ? block[i / 2] & 0x0f : block[i / 2] >> 4;
+                    break;
+            }
+
+            if (sample_size > *max_size) {
+                *max_size = sample_size;
+            }
         }
+        offset += length;
     }
 
     return OK;
@@ -664,8 +1012,8 @@ void SampleTable::buildSampleEntriesTable() {
     uint64_t sampleTime = 0;
 
     for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
-        uint32_t n = mTimeToSample[2 * i];
-        uint32_t delta = mTimeToSample[2 * i + 1];
+        uint32_t n = getTimeToSample(2 * i);
+        uint32_t delta = getTimeToSample(2 * i + 1);
 
         for (uint32_t j = 0; j < n; ++j) {
             if (sampleIndex < mNumSampleSizes) {
@@ -717,6 +1065,14 @@ void SampleTable::buildSampleEntriesTable() {
 status_t SampleTable::findSampleAtTime(
         uint64_t req_time, uint64_t scale_num, uint64_t scale_den,
         uint32_t *sample_index, uint32_t flags) {
+    {
+        Mutex::Autolock autoLock(mLock);
+        status_t err = loadDeferredTables_l();
+        if (err != OK) {
+            return err;
+        }
+    }
+
     buildSampleEntriesTable();
 
     if (mSampleTimeEntries == NULL) {
@@ -802,6 +1158,11 @@ status_t SampleTable::findSyncSampleNear(
 
     *sample_index = 0;
 
+    status_t err = loadDeferredTables_l();
+    if (err != OK) {
+        return err;
+    }
+
     if (mSyncSampleOffset < 0) {
         // All samples are sync-samples.
         *sample_index = start_sample_index;
@@ -865,7 +1226,7 @@ status_t SampleTable::findSyncSampleNear(
             // this route is not used, but implement it nonetheless
             CHECK(flags == kFlagClosest);
 
-            status_t err = mSampleIterator->seekTo(start_sample_index);
+            err = mSampleIterator->seekTo(start_sample_index);
             if (err != OK) {
                 return err;
             }
@@ -899,6 +1260,11 @@ status_t SampleTable::findSyncSampleNear(
 status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
     Mutex::Autolock autoLock(mLock);
 
+    status_t err = loadDeferredTables_l();
+    if (err != OK) {
+        return err;
+    }
+
     if (mSyncSampleOffset < 0) {
         // All samples are sync-samples.
         *sample_index = 0;
@@ -923,7 +1289,7 @@ status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
 
         // Now x is a sample index.
         size_t sampleSize;
-        status_t err = getSampleSize_l(x, &sampleSize);
+        err = getSampleSize_l(x, &sampleSize);
         if (err != OK) {
             return err;
         }
@@ -960,7 +1326,8 @@ status_t SampleTable::getMetaDataForSample(
     Mutex::Autolock autoLock(mLock);
 
     status_t err;
-    if ((err = mSampleIterator->seekTo(sampleIndex)) != OK) {
+    if ((err = loadDeferredTables_l()) != OK
+            || (err = mSampleIterator->seekTo(sampleIndex)) != OK) {
         return err;
     }
 
@@ -65,6 +65,17 @@ public:
     virtual uint32_t flags() const;
     virtual const char * name() { return "MPEG4Extractor"; }
 
+    // Sets the SampleTable index mode and budget of the tracks. Must be called before the
+    // tracks are parsed; the default comes from the media.extractor.mp4.sample_index and
+    // media.extractor.mp4.sample_index_kb properties.
+    void setSampleIndexMode(uint32_t mode, size_t budget);
+
+    // Defers reading the larger sample tables of each track until its first sample is
+    // looked up, so that tracks which are not used are never read, and tracks which are
+    // read from different threads are loaded in parallel. Must be called before the tracks
+    // are parsed; the default comes from the media.extractor.mp4.defer_stbl property.
+    void setDeferSampleTableLoading(bool defer);
+
 protected:
     virtual ~MPEG4Extractor();
 
@@ -146,6 +157,10 @@ private:
     bool mPreferHeif;
     bool mIsAvif;
 
+    uint32_t mSampleIndexMode;
+    size_t mSampleIndexBudget;
+    bool mDeferSampleTableLoading;
+
     Track *mFirstTrack, *mLastTrack;
 
     AMediaFormat *mFileMetaData;
@@ -23,7 +23,9 @@
 
 #include <media/MediaExtractorPluginHelper.h>
 #include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/foundation/ByteUtils.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -93,11 +95,35 @@ public:
         mDefaultSampleSize = sampleSize;
     }
 
+    // How the sample size and chunk offset tables are accessed when the source does not
+    // provide views of them.
+    enum {
+        // read each entry from the source when it is needed.
+        kIndexModeDirect,
+        // read each table into memory the first time it is needed.
+        kIndexModeFull,
+        // keep recently used windows of each table in memory, within a budget per table.
+        // Tables which fit in the budget are read as a whole.
+        kIndexModeWindowed,
+    };
+    static constexpr size_t kDefaultIndexBudget = 256 * 1024;
+
+    // Must be called before the sample size and chunk offset parameters are set.
+    void setIndexMode(uint32_t mode, size_t budget = kDefaultIndexBudget);
+
+    // Defers reading the sample-to-chunk, time-to-sample, composition time-to-sample and
+    // sync sample tables until the first sample lookup, which then returns any error in
+    // them. Must be called before their parameters are set.
+    void setDeferLoading(bool defer) {
+        mDeferLoading = defer;
+    }
+
 protected:
     ~SampleTable();
 
 private:
     struct CompositionDeltaLookup;
+    struct TableIndex;
 
     static const uint32_t kChunkOffsetType32;
     static const uint32_t kChunkOffsetType64;
@@ -113,6 +139,7 @@ private:
     off64_t mChunkOffsetOffset;
     uint32_t mChunkOffsetType;
     uint32_t mNumChunkOffsets;
+    TableIndex *mChunkOffsetIndex;
 
     off64_t mSampleToChunkOffset;
     uint32_t mNumSampleToChunkOffsets;
@@ -121,10 +148,18 @@ private:
     uint32_t mSampleSizeFieldSize;
     uint32_t mDefaultSampleSize;
     uint32_t mNumSampleSizes;
+    // NULL if all samples have the default size.
+    TableIndex *mSampleSizeIndex;
+
+    uint32_t mIndexMode;
+    size_t mIndexBudget;
 
     bool mHasTimeToSample;
     uint32_t mTimeToSampleCount;
+    // sample count and delta pairs, decoded into mTimeToSample unless the source
+    // provides a view of them.
     uint32_t* mTimeToSample;
+    const uint8_t *mTimeToSampleView;
 
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
@@ -143,6 +178,15 @@ private:
 
     SampleIterator *mSampleIterator;
 
+    struct DeferredTable {
+        uint32_t mType;
+        off64_t mOffset;
+        size_t mSize;
+    };
+    bool mDeferLoading;
+    Vector<DeferredTable> mDeferredTables;
+    status_t mDeferredStatus;
+
     struct SampleToChunkEntry {
         uint32_t startChunk;
         uint32_t samplesPerChunk;
@@ -163,7 +207,23 @@ private:
                 ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
     }
 
+    uint32_t getTimeToSample(size_t i) const {
+        return mTimeToSampleView != NULL ? U32_AT(mTimeToSampleView + 4 * i) : mTimeToSample[i];
+    }
+
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
+
+    TableIndex *newTableIndex(off64_t data_offset, size_t data_size);
+
+    status_t deferTable(uint32_t type, off64_t data_offset, size_t data_size);
+    bool hasDeferredTable(uint32_t type) const;
+    status_t loadDeferredTables_l();
+
+    // Return the length bytes at offset in the chunk offset or sample size entries, or
+    // NULL if they cannot be read. They remain valid until the next call.
+    const uint8_t *getChunkOffsetEntry_l(size_t offset, size_t length);
+    const uint8_t *getSampleSizeEntry_l(size_t offset, size_t length);
+
     int32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
     static int CompareIncreasingTime(const void *, const void *);
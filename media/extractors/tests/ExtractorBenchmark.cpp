@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ExtractorBenchmark"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <datasource/FileSource.h>
+#include <media/stagefright/MediaBufferGroup.h>
+
+#include <MatroskaExtractor.h>
+#include <MPEG4Extractor.h>
+#include <SampleTable.h>
+
+using namespace android;
+
+// Resource directory of ExtractorUnitTest, can be changed with -P <path>.
+static std::string gRes = "/data/local/tmp/";
+static const char * const kMPEG4File = "crowd_508x240_25fps_hevc.mp4";
+static const char * const kMatroskaFileWithoutCues = "withoutcues.mkv";
+
+enum ReadMode {
+    kReadModePread = 0,
+    kReadModeMmap = 1,
+};
+
+// Opens the resource file. FileSource only maps files which cannot be truncated, so for
+// kReadModeMmap the file is copied into a memfd sealed against shrinking.
+static int openResource(const std::string &path, ReadMode mode) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || mode != kReadModeMmap) {
+        return fd;
+    }
+    int memFd = memfd_create("ExtractorBenchmark", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    char buffer[64 * 1024];
+    ssize_t n = 0;
+    while (memFd >= 0 && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (write(memFd, buffer, n) != n) {
+            n = -1;
+            break;
+        }
+    }
+    close(fd);
+    if (memFd >= 0 && (n < 0 || fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK) != 0)) {
+        close(memFd);
+        memFd = -1;
+    }
+    return memFd;
+}
+
+// Reads every track of the file with its own MPEG4Extractor, and returns the bytes read.
+static int64_t readAllTracks(CDataSource *source) {
+    int64_t bytes = 0;
+    MPEG4Extractor *extractor = new MPEG4Extractor(new DataSourceHelper(source));
+    for (size_t idx = 0; idx < extractor->countTracks(); ++idx) {
+        MediaTrackHelper *track = extractor->getTrack(idx);
+        if (track == nullptr) {
+            continue;
+        }
+        CMediaTrack *cTrack = wrap(track);
+        MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+        if (cTrack->start(track, bufferGroup->wrap()) == AMEDIA_OK) {
+            MediaBufferHelper *buffer = nullptr;
+            while (track->read(&buffer) == AMEDIA_OK) {
+                bytes += buffer->range_length();
+                buffer->release();
+                buffer = nullptr;
+            }
+            cTrack->stop(track);
+        }
+        delete bufferGroup;
+        delete track;
+        free(cTrack);
+    }
+    delete extractor;
+    return bytes;
+}
+
+// Reads all tracks of an MPEG4 file from range(1) threads sharing one FileSource, as
+// concurrent playback, thumbnail and metadata readers of a file do, with the read mode
+// in range(0).
+static void BM_FileSource_ConcurrentMPEG4Read(benchmark::State& state) {
+    const ReadMode mode = (ReadMode)state.range(0);
+    const size_t readers = state.range(1);
+    const std::string path = gRes + kMPEG4File;
+    const int fd = openResource(path, mode);
+    struct stat s;
+    if (fd < 0 || fstat(fd, &s) != 0) {
+        state.SkipWithError(("cannot open " + path).c_str());
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        sp<FileSource> source = new FileSource(dup(fd), 0, s.st_size);
+        if (mode == kReadModeMmap && source->enableMmap() != OK) {
+            state.SkipWithError("cannot map the file");
+            break;
+        }
+        CDataSource *cSource = source->wrap();
+        std::vector<std::thread> threads;
+        std::vector<int64_t> threadBytes(readers);
+        for (size_t i = 0; i < readers; ++i) {
+            threads.emplace_back([cSource, &threadBytes, i] {
+                threadBytes[i] = readAllTracks(cSource);
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (int64_t readerBytes : threadBytes) {
+            bytes += readerBytes;
+        }
+    }
+    state.SetBytesProcessed(bytes);
+    close(fd);
+}
+
+// Opens an MPEG4 file, gets the format of every track and reads its first sample, reading
+// with pread in range(0) == 0 and from views of a mapping of the file otherwise, and with
+// the loading of the sample tables deferred if range(1) != 0. Reports the heap used by the
+// open extractor.
+static void BM_MPEG4Extractor_Open(benchmark::State& state) {
+    const ReadMode mode = (ReadMode)state.range(0);
+    const bool defer = state.range(1) != 0;
+    const std::string path = gRes + kMPEG4File;
+    const int fd = openResource(path, mode);
+    struct stat s;
+    if (fd < 0 || fstat(fd, &s) != 0) {
+        state.SkipWithError(("cannot open " + path).c_str());
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    int64_t heapBytes = 0;
+    for (auto _ : state) {
+        sp<FileSource> source = new FileSource(dup(fd), 0, s.st_size);
+        if (mode == kReadModeMmap && source->enableMmap() != OK) {
+            state.SkipWithError("cannot map the file");
+            break;
+        }
+        const int64_t heapBefore = mallinfo().uordblks;
+        MPEG4Extractor *extractor = new MPEG4Extractor(new DataSourceHelper(source->wrap()));
+        extractor->setDeferSampleTableLoading(defer);
+        AMediaFormat *format = AMediaFormat_new();
+        for (size_t idx = 0; idx < extractor->countTracks(); ++idx) {
+            extractor->getTrackMetaData(format, idx, 0 /* flags */);
+            MediaTrackHelper *track = extractor->getTrack(idx);
+            if (track == nullptr) {
+                continue;
+            }
+            CMediaTrack *cTrack = wrap(track);
+            MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+            if (cTrack->start(track, bufferGroup->wrap()) == AMEDIA_OK) {
+                MediaBufferHelper *buffer = nullptr;
+                if (track->read(&buffer) == AMEDIA_OK) {
+                    buffer->release();
+                }
+                heapBytes = std::max(heapBytes, (int64_t)mallinfo().uordblks - heapBefore);
+                cTrack->stop(track);
+            }
+            delete bufferGroup;
+            delete track;
+            free(cTrack);
+        }
+        AMediaFormat_delete(format);
+        delete extractor;
+    }
+    state.counters["heap_bytes"] = heapBytes;
+    close(fd);
+}
+
+// A 2 hour AMR-NB track, with 50 samples per second in chunks of 10 samples, so that its
+// sample size and chunk offset tables are well over the default sample index budget.
+static constexpr uint32_t kLongTrackSamples = 2 * 3600 * 50;
+static constexpr uint32_t kLongTrackSamplesPerChunk = 10;
+static constexpr uint32_t kLongTrackSampleSize = 32;
+static constexpr uint32_t kLongTrackSampleDuration = 160;
+
+static void appendU16(std::vector<uint8_t> *data, uint16_t value) {
+    data->push_back(value >> 8);
+    data->push_back(value);
+}
+
+static void appendU32(std::vector<uint8_t> *data, uint32_t value) {
+    appendU16(data, value >> 16);
+    appendU16(data, value);
+}
+
+static std::vector<uint8_t> makeBox(const char *type, const std::vector<uint8_t> &payload,
+        uint32_t versionAndFlags = UINT32_MAX) {
+    std::vector<uint8_t> box;
+    const bool isFullBox = versionAndFlags != UINT32_MAX;
+    appendU32(&box, 8 + (isFullBox ? 4 : 0) + payload.size());
+    box.insert(box.end(), type, type + 4);
+    if (isFullBox) {
+        appendU32(&box, versionAndFlags);
+    }
+    box.insert(box.end(), payload.begin(), payload.end());
+    return box;
+}
+
+static std::vector<uint8_t> concat(std::initializer_list<std::vector<uint8_t>> boxes) {
+    std::vector<uint8_t> data;
+    for (const std::vector<uint8_t> &box : boxes) {
+        data.insert(data.end(), box.begin(), box.end());
+    }
+    return data;
+}
+
+// Writes the 2 hour track to a temporary file, and returns its descriptor or -1.
+static int createLongMPEG4File() {
+    FILE *file = tmpfile();
+    if (file == nullptr) {
+        return -1;
+    }
+    const std::vector<uint8_t> ftyp = makeBox("ftyp", {'3', 'g', 'p', '4', 0, 0, 0, 0,
+            'i', 's', 'o', 'm', '3', 'g', 'p', '4'});
+    const size_t mdatSize = 8 + (size_t)kLongTrackSamples * kLongTrackSampleSize;
+    const uint32_t chunks = kLongTrackSamples / kLongTrackSamplesPerChunk;
+    const uint32_t durationMs = kLongTrackSamples / 50 * 1000;
+
+    std::vector<uint8_t> mvhd, tkhd(80), mdhd, hdlr(21), samr(28), stts, stsc, stsz, stco;
+    appendU32(&mvhd, 0);  // creation time
+    appendU32(&mvhd, 0);  // modification time
+    appendU32(&mvhd, 1000);  // timescale
+    appendU32(&mvhd, durationMs);
+    appendU32(&mvhd, 0x00010000);  // rate
+    appendU16(&mvhd, 0x0100);  // volume
+    mvhd.resize(mvhd.size() + 10 + 36 + 24);  // reserved, matrix and pre-defined
+    appendU32(&mvhd, 2);  // next track ID
+    tkhd[11] = 1;  // track ID
+    appendU32(&mdhd, 0);  // creation time
+    appendU32(&mdhd, 0);  // modification time
+    appendU32(&mdhd, 8000);  // timescale
+    appendU32(&mdhd, kLongTrackSamples * kLongTrackSampleDuration);
+    appendU16(&mdhd, 0x55c4);  // "und"
+    appendU16(&mdhd, 0);
+    memcpy(&hdlr[4], "soun", 4);
+    samr[7] = 1;  // data reference index
+    samr[17] = 1;  // channel count
+    samr[19] = 16;  // sample size
+    samr[24] = 8000 >> 8;  // sample rate, 16.16 fixed point
+    samr[25] = 8000 & 0xff;
+    appendU32(&stts, 1);
+    appendU32(&stts, kLongTrackSamples);
+    appendU32(&stts, kLongTrackSampleDuration);
+    appendU32(&stsc, 1);
+    appendU32(&stsc, 1);
+    appendU32(&stsc, kLongTrackSamplesPerChunk);
+    appendU32(&stsc, 1);
+    appendU32(&stsz, 0);
+    appendU32(&stsz, kLongTrackSamples);
+    for (uint32_t i = 0; i < kLongTrackSamples; ++i) {
+        appendU32(&stsz, kLongTrackSampleSize);
+    }
+    appendU32(&stco, chunks);
+    for (uint32_t i = 0; i < chunks; ++i) {
+        appendU32(&stco, ftyp.size() + 8 + i * kLongTrackSamplesPerChunk * kLongTrackSampleSize);
+    }
+    std::vector<uint8_t> stsd;
+    appendU32(&stsd, 1);
+    stsd = concat({stsd, makeBox("samr", samr)});
+
+    const std::vector<uint8_t> stbl = makeBox("stbl", concat({
+            makeBox("stsd", stsd, 0), makeBox("stts", stts, 0), makeBox("stsc", stsc, 0),
+            makeBox("stsz", stsz, 0), makeBox("stco", stco, 0)}));
+    const std::vector<uint8_t> moov = makeBox("moov", concat({
+            makeBox("mvhd", mvhd, 0),
+            makeBox("trak", concat({
+                    makeBox("tkhd", tkhd, 7),
+                    makeBox("mdia", concat({
+                            makeBox("mdhd", mdhd, 0),
+                            makeBox("hdlr", hdlr, 0),
+                            makeBox("minf", concat({
+                                    makeBox("smhd", std::vector<uint8_t>(4), 0),
+                                    stbl}))}))}))}));
+
+    // every sample is a 12.2 kbps AMR frame of silence.
+    std::vector<uint8_t> mdat;
+    appendU32(&mdat, mdatSize);
+    mdat.insert(mdat.end(), {'m', 'd', 'a', 't'});
+    std::vector<uint8_t> frame(kLongTrackSampleSize);
+    frame[0] = 0x3c;
+    for (uint32_t i = 0; i < kLongTrackSamples; ++i) {
+        mdat.insert(mdat.end(), frame.begin(), frame.end());
+    }
+
+    const std::vector<uint8_t> *boxes[] = {&ftyp, &mdat, &moov};
+    for (const std::vector<uint8_t> *data : boxes) {
+        if (fwrite(data->data(), 1, data->size(), file) != data->size()) {
+            fclose(file);
+            return -1;
+        }
+    }
+    fflush(file);
+    const int fd = dup(fileno(file));
+    fclose(file);
+    return fd;
+}
+
+static int getLongMPEG4File() {
+    static const int fd = createLongMPEG4File();
+    return fd;
+}
+
+// Counts the reads from the source, including those of the sample data.
+class CountingDataSource : public DataSourceHelper {
+public:
+    CountingDataSource(CDataSource *source, int64_t *reads)
+        : DataSourceHelper(source), mReads(reads) {}
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        ++*mReads;
+        return DataSourceHelper::readAt(offset, data, size);
+    }
+
+private:
+    int64_t *mReads;
+};
+
+// Opens the 2 hour track with the sample index mode in range(0), and reads range(1)
+// samples from random positions, or every sample if range(1) is 0. Reports the reads from
+// the file and the heap used per sample read.
+static void BM_MPEG4Extractor_SampleIndex(benchmark::State& state) {
+    const uint32_t indexMode = state.range(0);
+    const size_t seeks = state.range(1);
+    const int fd = getLongMPEG4File();
+    if (fd < 0) {
+        state.SkipWithError("cannot create the 2 hour file");
+        return;
+    }
+    const off64_t size = lseek64(fd, 0, SEEK_END);
+
+    std::mt19937 random(0);
+    std::uniform_int_distribution<int64_t> seekTimeUs(
+            0, (int64_t)kLongTrackSamples * kLongTrackSampleDuration * 125 - 1);
+    int64_t reads = 0;
+    int64_t samples = 0;
+    int64_t heapBytes = 0;
+    for (auto _ : state) {
+        sp<FileSource> source = new FileSource(dup(fd), 0, size);
+        const int64_t heapBefore = mallinfo().uordblks;
+        MPEG4Extractor *extractor =
+                new MPEG4Extractor(new CountingDataSource(source->wrap(), &reads));
+        extractor->setSampleIndexMode(indexMode, SampleTable::kDefaultIndexBudget);
+        MediaTrackHelper *track = extractor->countTracks() > 0 ? extractor->getTrack(0) : nullptr;
+        if (track == nullptr) {
+            delete extractor;
+            state.SkipWithError("cannot get the track");
+            break;
+        }
+        CMediaTrack *cTrack = wrap(track);
+        MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+        if (cTrack->start(track, bufferGroup->wrap()) == AMEDIA_OK) {
+            MediaBufferHelper *buffer = nullptr;
+            if (seeks == 0) {
+                while (track->read(&buffer) == AMEDIA_OK) {
+                    buffer->release();
+                    ++samples;
+                }
+            } else {
+                for (size_t i = 0; i < seeks; ++i) {
+                    MediaTrackHelper::ReadOptions options(
+                            CMediaTrackReadOptions::SEEK | CMediaTrackReadOptions::SEEK_CLOSEST,
+                            seekTimeUs(random));
+                    if (track->read(&buffer, &options) == AMEDIA_OK) {
+                        buffer->release();
+                        ++samples;
+                    }
+                }
+            }
+            heapBytes = std::max(heapBytes, (int64_t)mallinfo().uordblks - heapBefore);
+            cTrack->stop(track);
+        }
+        delete bufferGroup;
+        delete track;
+        free(cTrack);
+        delete extractor;
+    }
+    state.SetItemsProcessed(samples);
+    state.counters["reads_per_sample"] = samples > 0 ? (double)reads / samples : 0.;
+    state.counters["heap_bytes"] = heapBytes;
+}
+
+// Opens a Matroska file without Cues and reads its first track from range(0) random positions.
+// Reports the reads from the file per seek.
+static void BM_MatroskaExtractor_RandomSeek(benchmark::State& state) {
+    const size_t seeks = state.range(0);
+    const std::string path = gRes + kMatroskaFileWithoutCues;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat s;
+    if (fd < 0 || fstat(fd, &s) != 0) {
+        state.SkipWithError(("cannot open " + path).c_str());
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    std::mt19937 random(0);
+    int64_t reads = 0;
+    int64_t totalSeeks = 0;
+    for (auto _ : state) {
+        sp<FileSource> source = new FileSource(dup(fd), 0, s.st_size);
+        MatroskaExtractor *extractor =
+                new MatroskaExtractor(new CountingDataSource(source->wrap(), &reads));
+        AMediaFormat *format = AMediaFormat_new();
+        int64_t durationUs = 0;
+        if (extractor->countTracks() > 0
+                && extractor->getTrackMetaData(format, 0, 0 /* flags */) == AMEDIA_OK) {
+            AMediaFormat_getInt64(format, AMEDIAFORMAT_KEY_DURATION, &durationUs);
+        }
+        AMediaFormat_delete(format);
+        MediaTrackHelper *track = extractor->countTracks() > 0 ? extractor->getTrack(0) : nullptr;
+        if (track == nullptr || durationUs <= 0) {
+            delete track;
+            delete extractor;
+            state.SkipWithError("cannot get the track");
+            break;
+        }
+        std::uniform_int_distribution<int64_t> seekTimeUs(0, durationUs - 1);
+        CMediaTrack *cTrack = wrap(track);
+        MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+        if (cTrack->start(track, bufferGroup->wrap()) == AMEDIA_OK) {
+            MediaBufferHelper *buffer = nullptr;
+            for (size_t i = 0; i < seeks; ++i) {
+                MediaTrackHelper::ReadOptions options(
+                        CMediaTrackReadOptions::SEEK | CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC,
+                        seekTimeUs(random));
+                if (track->read(&buffer, &options) == AMEDIA_OK) {
+                    buffer->release();
+                }
+            }
+            totalSeeks += seeks;
+            cTrack->stop(track);
+        }
+        delete bufferGroup;
+        delete track;
+        free(cTrack);
+        delete extractor;
+    }
+    state.SetItemsProcessed(totalSeeks);
+    state.counters["reads_per_seek"] = totalSeeks > 0 ? (double)reads / totalSeeks : 0.;
+    close(fd);
+}
+
+BENCHMARK(BM_MPEG4Extractor_Open)
+        ->ArgNames({"mmap", "defer"})
+        ->ArgsProduct({{kReadModePread, kReadModeMmap}, {0, 1}});
+
+BENCHMARK(BM_MPEG4Extractor_SampleIndex)
+        ->ArgNames({"mode", "seeks"})
+        ->ArgsProduct({{SampleTable::kIndexModeDirect, SampleTable::kIndexModeFull,
+                SampleTable::kIndexModeWindowed}, {0, 1000}})
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_FileSource_ConcurrentMPEG4Read)
+        ->ArgNames({"mmap", "readers"})
+        ->ArgsProduct({{kReadModePread, kReadModeMmap}, {1, 2, 4, 8}})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+BENCHMARK(BM_MatroskaExtractor_RandomSeek)
+        ->ArgNames({"seeks"})
+        ->Arg(1)->Arg(64)
+        ->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-P") {
+            gRes = argv[i + 1];
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -19,6 +19,10 @@
 #include <utils/Log.h>
 
 #include <inttypes.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <chrono>
 
 #include <datasource/FileSource.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -26,6 +30,8 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaDataUtils.h>
 #include <media/stagefright/foundation/OpusHeader.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+#include <media/stagefright/foundation/avc_utils.h>
 
 #include <AACExtractor.h>
 #include <AMRExtractor.h>
@@ -45,6 +51,7 @@
 using namespace android;
 
 #define OUTPUT_DUMP_FILE "/data/local/tmp/extractorOutput"
+#define MP3_NO_TOC_FILE "/data/local/tmp/extractorNoTocMp3.mp3"
 
 constexpr int32_t kMaxCount = 10;
 constexpr int32_t kAudioDefaultSampleDuration = 20000;                       // 20ms
@@ -829,6 +836,154 @@ TEST_P(ExtractorFunctionalityTest, MonkeySeekTest) {
     }
 }
 
+// FileSource that counts the reads from it.
+class CountingFileSource : public FileSource {
+  public:
+    explicit CountingFileSource(const char *filename) : FileSource(filename), mReads(0) {}
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        ++mReads;
+        return FileSource::readAt(offset, data, size);
+    }
+
+    int32_t mReads;
+};
+
+// Validates that the MP3 extractor seeks to the exact frame of a VBR stream without XING or
+// VBRI header, and how many reads and how long the seeks take once the frames are indexed.
+TEST(MP3ExtractorTest, FrameIndexSeekTest) {
+    // MPEG-1 Layer III, 44100 Hz, stereo, with the bitrate changing every frame
+    constexpr int32_t kNumFrames = 20000;
+    constexpr int32_t kSampleRate = 44100;
+    constexpr int32_t kSamplesPerFrame = 1152;
+    constexpr uint8_t kBitrateIndices[] = {1, 5, 9, 3, 7, 2, 8, 4, 6};
+    auto frameTimeUs = [](int64_t frame) {
+        return frame * kSamplesPerFrame * 1000000LL / kSampleRate;
+    };
+
+    FILE *fp = fopen(MP3_NO_TOC_FILE, "wb");
+    ASSERT_NE(fp, nullptr) << "Failed to open " << MP3_NO_TOC_FILE;
+    for (int32_t frame = 0; frame < kNumFrames; ++frame) {
+        const uint8_t bitrateIndex = kBitrateIndices[frame % sizeof(kBitrateIndices)];
+        const uint8_t header[4] = {0xff, 0xfb, (uint8_t)(bitrateIndex << 4), 0x00};
+        size_t frameSize = 0;
+        ASSERT_TRUE(GetMPEGAudioFrameSize(U32_AT(header), &frameSize));
+        // The payload tells the frames apart.
+        vector<uint8_t> data(frameSize, frame & 0x7f);
+        memcpy(data.data(), header, sizeof(header));
+        ASSERT_EQ(fwrite(data.data(), 1, frameSize, fp), frameSize);
+    }
+    fclose(fp);
+
+    sp<CountingFileSource> source = new CountingFileSource(MP3_NO_TOC_FILE);
+    ASSERT_EQ(source->initCheck(), OK) << "Failed to open " << MP3_NO_TOC_FILE;
+    MP3Extractor *extractor = new MP3Extractor(new DataSourceHelper(source->wrap()), nullptr);
+    ASSERT_EQ(extractor->countTracks(), 1) << "Failed to parse " << MP3_NO_TOC_FILE;
+
+    MediaTrackHelper *track = extractor->getTrack(0);
+    ASSERT_NE(track, nullptr) << "Failed to get track";
+    CMediaTrack *cTrack = wrap(track);
+    ASSERT_NE(cTrack, nullptr) << "Failed to get track wrapper";
+    MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+    ASSERT_EQ(OK, cTrack->start(track, bufferGroup->wrap())) << "Failed to start the track";
+
+    // Seeks with |mode| to |seekTimeUs| and checks that the frame read is |expectedFrame|.
+    auto seekAndCheck = [&](int64_t seekTimeUs, int32_t mode, int32_t expectedFrame) {
+        MediaTrackHelper::ReadOptions options(mode | CMediaTrackReadOptions::SEEK, seekTimeUs);
+        MediaBufferHelper *buffer = nullptr;
+        ASSERT_EQ(AMEDIA_OK, track->read(&buffer, &options)) << "Seek to " << seekTimeUs
+                                                             << " failed in mode " << mode;
+        int64_t timeUs = 0;
+        AMediaFormat_getInt64(buffer->meta_data(), AMEDIAFORMAT_KEY_TIME_US, &timeUs);
+        const uint8_t payload = ((const uint8_t *)buffer->data())[4];
+        buffer->release();
+        EXPECT_EQ(timeUs, frameTimeUs(expectedFrame))
+                << "Wrong timestamp for seek to " << seekTimeUs << " in mode " << mode;
+        EXPECT_EQ(payload, expectedFrame & 0x7f)
+                << "Wrong frame for seek to " << seekTimeUs << " in mode " << mode;
+    };
+
+    // The first seek to the last frame indexes the whole stream.
+    seekAndCheck(frameTimeUs(kNumFrames - 1), CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC,
+                 kNumFrames - 1);
+
+    srand(kRandomSeed);
+    constexpr int32_t kNumSeeks = 1000;
+    const int32_t readsBefore = source->mReads;
+    const auto start = std::chrono::steady_clock::now();
+    for (int32_t seekCount = 0; seekCount < kNumSeeks; seekCount++) {
+        const int32_t frame = rand() % (kNumFrames - 2) + 1;
+        const int64_t frameDurationUs = frameTimeUs(frame + 1) - frameTimeUs(frame);
+        const int64_t seekTimeUs = frameTimeUs(frame) + frameDurationUs / 4;
+        switch (seekCount % 4) {
+            case 0:
+                seekAndCheck(frameTimeUs(frame), CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC,
+                             frame);
+                break;
+            case 1:
+                seekAndCheck(seekTimeUs, CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC, frame);
+                break;
+            case 2:
+                seekAndCheck(seekTimeUs, CMediaTrackReadOptions::SEEK_NEXT_SYNC, frame + 1);
+                break;
+            default:
+                seekAndCheck(seekTimeUs, CMediaTrackReadOptions::SEEK_CLOSEST, frame);
+                break;
+        }
+        if (HasFatalFailure()) break;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    // A seek walks the headers of the few frames after the closest indexed one in one block,
+    // then the frame itself is read.
+    const double readsPerSeek = (double)(source->mReads - readsBefore) / kNumSeeks;
+    EXPECT_LE(readsPerSeek, 4) << "Too many reads per seek";
+    cout << "[   INFO   ] " << readsPerSeek << " reads and " << elapsed.count() / kNumSeeks
+         << " us per seek\n";
+
+    ASSERT_EQ(OK, cTrack->stop(track)) << "Failed to stop the track";
+    delete bufferGroup;
+    delete track;
+    free(cTrack);
+    delete extractor;
+    remove(MP3_NO_TOC_FILE);
+}
+
+// Validates that FileSource maps a file sealed against shrinking and provides views of it,
+// and reads files which can be truncated with pread64().
+TEST(FileSourceTest, MmapTest) {
+    constexpr size_t kSize = 3 * 4096 + 123;
+    constexpr off64_t kOffset = 5000;
+    vector<uint8_t> data(kSize);
+    for (size_t i = 0; i < kSize; ++i) {
+        data[i] = i * 7 + (i >> 8);
+    }
+    int fd = memfd_create("FileSourceTest", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ASSERT_GE(fd, 0) << "Failed to create memfd";
+    ASSERT_EQ(write(fd, data.data(), kSize), (ssize_t)kSize);
+
+    sp<FileSource> source = new FileSource(dup(fd), kOffset, kSize - kOffset);
+    ASSERT_EQ(source->initCheck(), OK);
+    EXPECT_EQ(source->enableMmap(), INVALID_OPERATION) << "Mapped a file which can shrink";
+    EXPECT_EQ(source->flags() & DataSourceBase::kCanProvideViews, 0u);
+    EXPECT_EQ(source->getView(0, 1), nullptr);
+
+    ASSERT_EQ(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK), 0) << "Failed to seal memfd";
+    source = new FileSource(fd, kOffset, kSize - kOffset);
+    ASSERT_EQ(source->enableMmap(), OK) << "Failed to map a sealed file";
+    EXPECT_NE(source->flags() & DataSourceBase::kCanProvideViews, 0u);
+    const uint8_t *view = (const uint8_t *)source->getView(100, kSize - kOffset - 100);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(memcmp(view, &data[kOffset + 100], kSize - kOffset - 100), 0);
+    EXPECT_EQ(source->getView(100, kSize - kOffset - 99), nullptr) << "View past the end";
+
+    uint8_t buffer[256];
+    EXPECT_EQ(source->readAt(kSize - kOffset - 10, buffer, sizeof(buffer)), 10);
+    EXPECT_EQ(memcmp(buffer, &data[kSize - 10], 10), 0);
+    EXPECT_EQ(source->readAt(kSize - kOffset, buffer, sizeof(buffer)), 0);
+}
+
 // Tests extractors for invalid tracks
 TEST_P(ExtractorFunctionalityTest, SanityTest) {
     if (mDisableTest) return;
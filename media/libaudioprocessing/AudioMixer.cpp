@@ -19,12 +19,14 @@
 //#define LOG_NDEBUG 0
 
 #include <sstream>
+#include <vector>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 #include <sys/types.h>
 
+#include <cutils/properties.h>
 #include <utils/Errors.h>
 #include <utils/Log.h>
 
@@ -309,21 +311,24 @@ void AudioMixer::Track::reconfigureBufferProviders()
 {
     // configure from upstream to downstream buffer providers.
     bufferProvider = mInputBufferProvider;
-    if (mAdjustChannelsBufferProvider.get() != nullptr) {
-        mAdjustChannelsBufferProvider->setBufferProvider(bufferProvider);
-        bufferProvider = mAdjustChannelsBufferProvider.get();
-    }
-    if (mReformatBufferProvider.get() != nullptr) {
-        mReformatBufferProvider->setBufferProvider(bufferProvider);
-        bufferProvider = mReformatBufferProvider.get();
-    }
-    if (mDownmixerBufferProvider.get() != nullptr) {
-        mDownmixerBufferProvider->setBufferProvider(bufferProvider);
-        bufferProvider = mDownmixerBufferProvider.get();
+    mChainedBufferProvider.reset(nullptr);
+    std::vector<CopyBufferProvider*> stages;
+    for (PassthruBufferProvider *provider : { mAdjustChannelsBufferProvider.get(),
+            mReformatBufferProvider.get(),
+            mDownmixerBufferProvider.get(),
+            mPostDownmixReformatBufferProvider.get() }) {
+        if (provider != nullptr) {
+            stages.push_back(static_cast<CopyBufferProvider*>(provider));
+        }
     }
-    if (mPostDownmixReformatBufferProvider.get() != nullptr) {
-        mPostDownmixReformatBufferProvider->setBufferProvider(bufferProvider);
-        bufferProvider = mPostDownmixReformatBufferProvider.get();
+    if (stages.size() > 1) {
+        // Run the conversions in a single pass rather than copying through each provider.
+        mChainedBufferProvider.reset(new ChainedCopyBufferProvider(stages, kCopyBufferFrameCount));
+        mChainedBufferProvider->setBufferProvider(bufferProvider);
+        bufferProvider = mChainedBufferProvider.get();
+    } else if (stages.size() == 1) {
+        stages[0]->setBufferProvider(bufferProvider);
+        bufferProvider = stages[0];
     }
     if (mTimestretchBufferProvider.get() != nullptr) {
         mTimestretchBufferProvider->setBufferProvider(bufferProvider);
@@ -471,8 +476,12 @@ bool AudioMixer::Track::setPlaybackRate(const AudioPlaybackRate &playbackRate)
         // TODO: Remove MONO_HACK. Resampler sees #channels after the downmixer
         // but if none exists, it is the channel count (1 for mono).
         const int timestretchChannelCount = getOutputChannelCount();
+        // af.timestretch.prealloc selects the preallocated time stretcher,
+        // which does not allocate on the mixer thread after construction.
+        static const bool preallocated = property_get_bool("af.timestretch.prealloc", false);
         mTimestretchBufferProvider.reset(new TimestretchBufferProvider(timestretchChannelCount,
-                mMixerInFormat, sampleRate, playbackRate));
+                mMixerInFormat, sampleRate, playbackRate,
+                preallocated ? kCopyBufferFrameCount : 0 /* bufferFrameCount */));
         reconfigureBufferProviders();
     } else {
         static_cast<TimestretchBufferProvider*>(mTimestretchBufferProvider.get())
@@ -492,6 +501,8 @@ void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider
     // reset order from downstream to upstream buffer providers.
     if (track->mTimestretchBufferProvider.get() != nullptr) {
         track->mTimestretchBufferProvider->reset();
+    } else if (track->mChainedBufferProvider.get() != nullptr) {
+        track->mChainedBufferProvider->reset();
     } else if (track->mPostDownmixReformatBufferProvider.get() != nullptr) {
         track->mPostDownmixReformatBufferProvider->reset();
     } else if (track->mDownmixerBufferProvider != nullptr) {
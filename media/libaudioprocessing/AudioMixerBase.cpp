@@ -19,8 +19,17 @@
 //#define LOG_NDEBUG 0
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
 #include <string.h>
+#include <thread>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 
 #include <audio_utils/primitives.h>
 #include <cutils/compiler.h>
@@ -52,6 +61,40 @@
 // TODO: remove BLOCKSIZE unit of processing - it isn't needed anymore.
 static constexpr int BLOCKSIZE = 16;
 
+// Adds in to out, for process__parallel(). The loop is vectorized by the compiler.
+template <typename T>
+static inline void accumulate(T * __restrict out, const T * __restrict in, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] += in[i];
+    }
+}
+
+// Returns true if the buffer holds only zero bytes, which is silence in all the
+// mixer input formats. Non-silent audio returns at the first non-zero block.
+static inline bool isAllZero(const void *buffer, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(buffer);
+    for (; size > 0 && ((uintptr_t)bytes & (sizeof(uint64_t) - 1)) != 0; --size) {
+        if (*bytes++ != 0) return false;
+    }
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(bytes);
+    for (; size >= 8 * sizeof(uint64_t); size -= 8 * sizeof(uint64_t), words += 8) {
+        if ((words[0] | words[1] | words[2] | words[3]
+                | words[4] | words[5] | words[6] | words[7]) != 0) {
+            return false;
+        }
+    }
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+        if (*words++ != 0) return false;
+    }
+    bytes = reinterpret_cast<const uint8_t *>(words);
+    for (; size > 0; --size) {
+        if (*bytes++ != 0) return false;
+    }
+    return true;
+}
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -139,6 +182,9 @@ status_t AudioMixerBase::create(
         // t->buffer.frameCount
         t->hook = NULL;
         t->mIn = NULL;
+        t->mInFrameSize = 0;
+        t->mInSilent = false;
+        t->mSkippedFrames = 0;
         t->sampleRate = mSampleRate;
         // setParameter(name, TRACK, MAIN_BUFFER, mixBuffer) is required before enable(name)
         t->mainBuffer = NULL;
@@ -601,6 +647,186 @@ std::string AudioMixerBase::trackNames() const
     return ss.str();
 }
 
+// A pool of worker threads mixing tracks together with the thread calling process().
+// The workers inherit the scheduling policy, priority and nice value of the mixer thread on
+// their first run, so they are real-time or urgent audio priority if the mixer thread is.
+// Work items are claimed through an atomic index tagged with the generation of the mix, and
+// wait() returns as soon as all the items are done. A worker that is late to wake up therefore
+// does not delay the mix, and cannot claim items of a later mix.
+class AudioMixerBase::WorkerPool {
+public:
+    using work_t = void (*)(void *cookie, size_t item, size_t worker);
+
+    WorkerPool(size_t workerCount, size_t tempSize) {
+        for (size_t i = 0; i <= workerCount; ++i) {
+            mTemps.emplace_back(new int32_t[tempSize]);
+        }
+        for (size_t i = 1; i <= workerCount; ++i) {
+            mThreads.emplace_back(&WorkerPool::threadLoop, this, i);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mExit = true;
+        }
+        mWorkCondition.notify_all();
+        for (auto &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    // number of threads including the thread calling process().
+    size_t getThreadCount() const { return mThreads.size() + 1; }
+
+    // temporary buffer of tempSize samples, for exclusive use of the worker.
+    int32_t *getTemp(size_t worker) const { return mTemps[worker].get(); }
+
+    // Starts running work on items [0, itemCount) on the workers.
+    // The calling thread is worker 0, and joins in with wait().
+    void start(work_t work, void *cookie, size_t itemCount) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (!mHasScheduling) {
+                (void)pthread_getschedparam(pthread_self(), &mPolicy, &mParam);
+                // applies to the calling thread only on Linux
+                errno = 0;
+                const int nice = getpriority(PRIO_PROCESS, 0 /* who */);
+                mHasNice = errno == 0;
+                mNice = nice;
+                mHasScheduling = true;
+            }
+            mWork = work;
+            mCookie = cookie;
+            mItemCount = itemCount;
+            ++mGeneration;
+            mDoneItems.store(0, std::memory_order_relaxed);
+            mNextItem.store(claim(mGeneration, 0 /* item */), std::memory_order_release);
+        }
+        mWorkCondition.notify_all();
+    }
+
+    // Runs the remaining items on the calling thread, then waits for the items claimed by the
+    // workers. Workers which have not claimed an item yet are not waited for.
+    void wait() {
+        // the current work is only changed by start(), on the calling thread.
+        doWork(0 /* worker */, mGeneration, mWork, mCookie, mItemCount);
+        std::unique_lock<std::mutex> lock(mLock);
+        mDoneCondition.wait(lock, [this] {
+            return mDoneItems.load(std::memory_order_acquire) == mItemCount;
+        });
+    }
+
+private:
+    // The generation in the upper half of mNextItem, and the next item in the lower half.
+    static uint64_t claim(uint64_t generation, size_t item) {
+        return generation << 32 | item;
+    }
+
+    void doWork(size_t worker, uint64_t generation, work_t work, void *cookie,
+            size_t itemCount) {
+        uint64_t next = mNextItem.load(std::memory_order_acquire);
+        while (true) {
+            const size_t item = next & UINT32_MAX;
+            if ((next >> 32) != (generation & UINT32_MAX) || item >= itemCount) {
+                return;  // no item left, or a later mix has started
+            }
+            if (!mNextItem.compare_exchange_weak(next, next + 1, std::memory_order_acquire)) {
+                continue;
+            }
+            work(cookie, item, worker);
+            if (mDoneItems.fetch_add(1, std::memory_order_acq_rel) + 1 == itemCount) {
+                std::lock_guard<std::mutex> lock(mLock);
+                mDoneCondition.notify_one();
+            }
+            next = mNextItem.load(std::memory_order_acquire);
+        }
+    }
+
+    void threadLoop(size_t worker) {
+        pthread_setname_np(pthread_self(), "AudioMixerWork");
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mWorkCondition.wait(lock, [&] { return mExit || mGeneration != generation; });
+            if (mExit) break;
+            if (generation == 0 && mPolicy != SCHED_OTHER) {
+                const int status = pthread_setschedparam(pthread_self(), mPolicy, &mParam);
+                ALOGW_IF(status != 0, "%s: cannot set policy %d priority %d for worker %zu: %d",
+                        __func__, mPolicy, mParam.sched_priority, worker, status);
+            } else if (generation == 0 && mHasNice) {
+                // The mixer thread is normally SCHED_OTHER at ANDROID_PRIORITY_URGENT_AUDIO,
+                // while the workers were created at the nice value of the thread that
+                // configured the mixer.
+                const int status = setpriority(PRIO_PROCESS, 0 /* who */, mNice);
+                ALOGW_IF(status != 0, "%s: cannot set nice %d for worker %zu: %d",
+                        __func__, mNice, worker, errno);
+            }
+            generation = mGeneration;
+            const work_t work = mWork;
+            void * const cookie = mCookie;
+            const size_t itemCount = mItemCount;
+            lock.unlock();
+            doWork(worker, generation, work, cookie, itemCount);
+            lock.lock();
+        }
+    }
+
+    std::vector<std::unique_ptr<int32_t[]>> mTemps;
+    std::vector<std::thread> mThreads;
+
+    std::mutex mLock;
+    std::condition_variable mWorkCondition;  // signals a new generation of work, or exit
+    std::condition_variable mDoneCondition;  // signals all items of the generation are done
+    uint64_t mGeneration = 0;                // incremented by start()
+    bool mExit = false;
+    bool mHasScheduling = false;             // mPolicy and mParam are set
+    int mPolicy = SCHED_OTHER;
+    sched_param mParam{};
+    bool mHasNice = false;                   // mNice is set
+    int mNice = 0;
+
+    // the current work, set by start() under mLock when mGeneration is incremented.
+    work_t mWork = nullptr;
+    void *mCookie = nullptr;
+    size_t mItemCount = 0;
+    std::atomic<uint64_t> mNextItem{0};      // see claim()
+    std::atomic<size_t> mDoneItems{0};       // items of the current generation done
+};
+
+AudioMixerBase::AudioMixerBase(size_t frameCount, uint32_t sampleRate)
+    : mSampleRate(sampleRate)
+    , mFrameCount(frameCount)
+{
+}
+
+AudioMixerBase::~AudioMixerBase() = default;
+
+void AudioMixerBase::setThreadCount(size_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = 1;
+    } else if (threadCount > kMaxThreadCount) {
+        ALOGW("%s: thread count %zu limited to %zu", __func__, threadCount, kMaxThreadCount);
+        threadCount = kMaxThreadCount;
+    }
+    if (threadCount == getThreadCount()) {
+        return;
+    }
+    mWorkerPool.reset();
+    if (threadCount > 1) {
+        mWorkerPool = std::make_unique<WorkerPool>(
+                threadCount - 1, MAX_NUM_CHANNELS * mFrameCount /* tempSize */);
+    }
+    invalidate();
+}
+
+size_t AudioMixerBase::getThreadCount() const
+{
+    return mWorkerPool ? mWorkerPool->getThreadCount() : 1;
+}
+
 void AudioMixerBase::process__validate()
 {
     // TODO: fix all16BitsStereNoResample logic to
@@ -625,6 +851,7 @@ void AudioMixerBase::process__validate()
         n |= NEEDS_CHANNEL_1 + t->channelCount - 1;
         if (t->doesResample()) {
             n |= NEEDS_RESAMPLE;
+            t->mResampler->setSkipSilence(mSkipSilence);
         }
         if (t->auxLevel != 0 && t->auxBuffer != NULL) {
             n |= NEEDS_AUX;
@@ -665,13 +892,19 @@ void AudioMixerBase::process__validate()
                 ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                         "Track %d needs downmix + resample", name);
             } else {
+                t->mInFrameSize = audio_bytes_per_frame(
+                        t->mMixerChannelCount, t->mMixerInFormat);
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) == NEEDS_CHANNEL_1){
+                    const bool monoExpand =
+                            isAudioChannelPositionMask(t->mMixerChannelMask)  // TODO: MONO_HACK
+                                    && t->channelMask == AUDIO_CHANNEL_OUT_MONO;
                     t->hook = TrackBase::getTrackHook(
-                            (isAudioChannelPositionMask(t->mMixerChannelMask)  // TODO: MONO_HACK
-                                    && t->channelMask == AUDIO_CHANNEL_OUT_MONO)
-                                ? TRACKTYPE_NORESAMPLEMONO : TRACKTYPE_NORESAMPLE,
+                            monoExpand ? TRACKTYPE_NORESAMPLEMONO : TRACKTYPE_NORESAMPLE,
                             t->mMixerChannelCount,
                             t->mMixerInFormat, t->mMixerFormat);
+                    if (monoExpand) {
+                        t->mInFrameSize = audio_bytes_per_sample(t->mMixerInFormat);
+                    }
                     all16BitsStereoNoResample = false;
                 }
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) >= NEEDS_CHANNEL_2){
@@ -717,6 +950,24 @@ void AudioMixerBase::process__validate()
                 }
             }
         }
+        if (mWorkerPool && mEnabled.size() >= kMinParallelTracks
+                && (mHook == &AudioMixerBase::process__genericResampling
+                        || mHook == &AudioMixerBase::process__genericNoResampling)) {
+            if (mOutputTemp.get() == nullptr) {
+                mOutputTemp.reset(new int32_t[MAX_NUM_CHANNELS * mFrameCount]);
+            }
+            // tracks in the order processed by the generic hooks.
+            mParallelTracks.clear();
+            for (const auto &pair : mGroups) {
+                for (const int name : pair.second) {
+                    mParallelTracks.push_back(mTracks[name].get());
+                }
+            }
+            while (mParallelOutputs.size() < mParallelTracks.size()) {
+                mParallelOutputs.emplace_back(new int32_t[MAX_NUM_CHANNELS * mFrameCount]);
+            }
+            mHook = &AudioMixerBase::process__parallel;
+        }
     }
 
     ALOGV("mixer configuration change: %zu "
@@ -1092,6 +1343,8 @@ void AudioMixerBase::process__genericNoResampling()
             t->bufferProvider->getNextBuffer(&t->buffer);
             t->frameCount = t->buffer.frameCount;
             t->mIn = t->buffer.raw;
+            t->mSkippedFrames = 0;
+            detectSilence(t.get());
         }
 
         int32_t *out = (int *)pair.first;
@@ -1113,9 +1366,14 @@ void AudioMixerBase::process__genericNoResampling()
                     }
                     size_t inFrames = (t->frameCount > outFrames)?outFrames:t->frameCount;
                     if (inFrames > 0) {
-                        (t.get()->*t->hook)(
-                                outTemp + (frameCount - outFrames) * t->mMixerChannelCount,
-                                inFrames, mResampleTemp.get() /* naked ptr */, aux);
+                        if (t->canSkipInput()) {
+                            t->mIn = (const uint8_t *)t->mIn + inFrames * t->mInFrameSize;
+                            t->mSkippedFrames += inFrames;
+                        } else {
+                            (t.get()->*t->hook)(
+                                    outTemp + (frameCount - outFrames) * t->mMixerChannelCount,
+                                    inFrames, mResampleTemp.get() /* naked ptr */, aux);
+                        }
                         t->frameCount -= inFrames;
                         outFrames -= inFrames;
                         if (CC_UNLIKELY(aux != NULL)) {
@@ -1132,6 +1390,7 @@ void AudioMixerBase::process__genericNoResampling()
                             break;
                         }
                         t->frameCount = t->buffer.frameCount;
+                        detectSilence(t.get());
                     }
                 }
             }
@@ -1150,6 +1409,9 @@ void AudioMixerBase::process__genericNoResampling()
         for (const int name : group) {
             const std::shared_ptr<TrackBase> &t = mTracks[name];
             t->bufferProvider->releaseBuffer(&t->buffer);
+            if (t->mSkippedFrames == mFrameCount) {
+                ++mSkippedTracks;
+            }
         }
     }
 }
@@ -1179,9 +1441,13 @@ void AudioMixerBase::process__genericResampling()
             // the resampler.
             if (t->needs & NEEDS_RESAMPLE) {
                 (t.get()->*t->hook)(outTemp, numFrames, mResampleTemp.get() /* naked ptr */, aux);
+                if (t->mResampler->getSkippedFrames() == numFrames) {
+                    ++mSkippedTracks;
+                }
             } else {
 
                 size_t outFrames = 0;
+                t->mSkippedFrames = 0;
 
                 while (outFrames < numFrames) {
                     t->buffer.frameCount = numFrames - outFrames;
@@ -1191,14 +1457,22 @@ void AudioMixerBase::process__genericResampling()
                     // been enabled for mixing.
                     if (t->mIn == nullptr) break;
 
-                    (t.get()->*t->hook)(
-                            outTemp + outFrames * t->mMixerChannelCount, t->buffer.frameCount,
-                            mResampleTemp.get() /* naked ptr */,
-                            aux != nullptr ? aux + outFrames : nullptr);
+                    detectSilence(t.get());
+                    if (t->canSkipInput()) {
+                        t->mSkippedFrames += t->buffer.frameCount;
+                    } else {
+                        (t.get()->*t->hook)(
+                                outTemp + outFrames * t->mMixerChannelCount,
+                                t->buffer.frameCount, mResampleTemp.get() /* naked ptr */,
+                                aux != nullptr ? aux + outFrames : nullptr);
+                    }
                     outFrames += t->buffer.frameCount;
 
                     t->bufferProvider->releaseBuffer(&t->buffer);
                 }
+                if (t->mSkippedFrames == numFrames) {
+                    ++mSkippedTracks;
+                }
             }
         }
         convertMixerFormat(t1->mainBuffer, t1->mMixerFormat,
@@ -1206,6 +1480,119 @@ void AudioMixerBase::process__genericResampling()
     }
 }
 
+// Generic code mixing tracks in parallel on the worker pool.
+//
+// Floating point addition is not associative, so the tracks are not summed into
+// partial mixes. Each track is mixed into its own zeroed buffer, by the same hook
+// as the serial code, and the track buffers are then added to the output in the
+// serial order. As x + 0 == x, and the hooks accumulate into the output with a
+// single addition per sample, the output is bit-identical to the serial code.
+void AudioMixerBase::process__parallel()
+{
+    ALOGVV("process__parallel\n");
+    mWorkerPool->start([](void *cookie, size_t item, size_t worker) {
+        AudioMixerBase * const mixer = static_cast<AudioMixerBase *>(cookie);
+        TrackBase * const t = mixer->mParallelTracks[item];
+        // tracks using an aux buffer accumulate into it, so they are mixed in order below.
+        if ((t->needs & NEEDS_AUX) == 0) {
+            mixer->mixTrack(t, mixer->mParallelOutputs[item].get(),
+                    mixer->mWorkerPool->getTemp(worker));
+        }
+    }, this, mParallelTracks.size());
+    for (size_t i = 0; i < mParallelTracks.size(); ++i) {
+        TrackBase * const t = mParallelTracks[i];
+        if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
+            mixTrack(t, mParallelOutputs[i].get(), mWorkerPool->getTemp(0 /* worker */));
+        }
+    }
+    mWorkerPool->wait();
+
+    int32_t * const outTemp = mOutputTemp.get(); // naked ptr
+    size_t i = 0;
+    for (const auto &pair : mGroups) {
+        const auto &group = pair.second;
+        const TrackBase * const t1 = mParallelTracks[i];
+        const size_t sampleCount = mFrameCount * t1->mMixerChannelCount;
+
+        memset(outTemp, 0, sizeof(*outTemp) * sampleCount);
+        for (size_t end = i + group.size(); i < end; ++i) {
+            const TrackBase * const t = mParallelTracks[i];
+            if (t->needs & NEEDS_MUTE) {
+                continue; // nothing was mixed
+            }
+            if (t->mSkippedFrames == mFrameCount) {
+                ++mSkippedTracks;
+                continue; // all silence
+            }
+            if (t1->mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                accumulate((float *)outTemp, (const float *)mParallelOutputs[i].get(),
+                        sampleCount);
+            } else {
+                accumulate(outTemp, mParallelOutputs[i].get(), sampleCount);
+            }
+        }
+        convertMixerFormat(t1->mainBuffer, t1->mMixerFormat,
+                outTemp, t1->mMixerInFormat, sampleCount);
+    }
+}
+
+void AudioMixerBase::mixTrack(TrackBase *t, int32_t *out, int32_t *temp)
+{
+    t->mSkippedFrames = 0;
+    if (t->needs & NEEDS_MUTE) {
+        // consume data.
+        for (size_t outFrames = 0; outFrames < mFrameCount; ) {
+            t->buffer.frameCount = mFrameCount - outFrames;
+            t->bufferProvider->getNextBuffer(&t->buffer);
+            if (t->buffer.raw == nullptr) break;
+            outFrames += t->buffer.frameCount;
+            t->bufferProvider->releaseBuffer(&t->buffer);
+        }
+        return;
+    }
+    memset(out, 0, sizeof(*out) * t->mMixerChannelCount * mFrameCount);
+    int32_t *aux = NULL;
+    if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
+        aux = t->auxBuffer;
+    }
+
+    // as in process__genericResampling().
+    if (t->needs & NEEDS_RESAMPLE) {
+        (t->*t->hook)(out, mFrameCount, temp, aux);
+        t->mSkippedFrames = t->mResampler->getSkippedFrames();
+        return;
+    }
+    for (size_t outFrames = 0; outFrames < mFrameCount; ) {
+        t->buffer.frameCount = mFrameCount - outFrames;
+        t->bufferProvider->getNextBuffer(&t->buffer);
+        t->mIn = t->buffer.raw;
+        // t->mIn == nullptr can happen if the track was flushed just after having
+        // been enabled for mixing.
+        if (t->mIn == nullptr) break;
+
+        detectSilence(t);
+        if (t->canSkipInput()) {
+            t->mSkippedFrames += t->buffer.frameCount;
+        } else {
+            (t->*t->hook)(out + outFrames * t->mMixerChannelCount, t->buffer.frameCount, temp,
+                    aux != nullptr ? aux + outFrames : nullptr);
+        }
+        outFrames += t->buffer.frameCount;
+
+        t->bufferProvider->releaseBuffer(&t->buffer);
+    }
+}
+
+void AudioMixerBase::detectSilence(TrackBase *t) const
+{
+    // a resampler consumes its input by itself and skips silence on its own,
+    // and a muted track is not mixed anyway.
+    t->mInSilent = mSkipSilence
+            && (t->needs & (NEEDS_MUTE | NEEDS_RESAMPLE)) == 0
+            && t->mIn != nullptr
+            && isAllZero(t->mIn, t->buffer.frameCount * t->mInFrameSize);
+}
+
 // one track, 16 bits stereo without resampling is the most common case
 void AudioMixerBase::process__oneTrack16BitsStereoNoResampling()
 {
@@ -1491,7 +1878,36 @@ void AudioMixerBase::TrackBase::track__Resample(TO* out, size_t outFrameCount, T
     ALOGVV("track__Resample\n");
     mResampler->setSampleRate(sampleRate);
     const bool ramp = needsRamp();
-    if (MIXTYPE == MIXTYPE_MONOEXPAND || MIXTYPE == MIXTYPE_STEREOEXPAND // custom volume handling
+
+    // A float volume ramp without aux may be applied by the resampler while it
+    // accumulates into out, instead of resampling to temp and mixing in a 2nd pass.
+    // Stereo mixes ramp both channels, multichannel mixes ramp volume[0]
+    // for all channels (see MIXTYPE_MONOVOL()), matching the resampler.
+    bool fusedRamp = false;
+    if constexpr (std::is_same_v<TI, float>
+            && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_STEREOVOL)) {
+        if (ramp && aux == NULL
+                && (mMixerChannelCount == FCC_2
+                        || (MIXTYPE == MIXTYPE_MULTI && mMixerChannelCount > FCC_2))) {
+            mResampler->setVolume(mPrevVolume[0], mPrevVolume[1]);
+            fusedRamp = mResampler->setVolumeRamp(mVolumeInc[0],
+                    mMixerChannelCount == FCC_2 ? mVolumeInc[1] : 0.f);
+        }
+    }
+
+    if (fusedRamp) {
+        mResampler->resample((int32_t*)out, outFrameCount, bufferProvider);
+
+        // advance the ramp as volumeRampMulti() does, for the full frame count.
+        for (size_t i = 0; i < outFrameCount; ++i) {
+            mPrevVolume[0] += mVolumeInc[0];
+            if (mMixerChannelCount == FCC_2) {
+                mPrevVolume[1] += mVolumeInc[1];
+            }
+        }
+        adjustVolumeRamp(false /* aux */, true /* useFloat */);
+    } else if (MIXTYPE == MIXTYPE_MONOEXPAND
+            || MIXTYPE == MIXTYPE_STEREOEXPAND // custom volume handling
             || ramp || aux != NULL) {
         // if ramp:        resample with unity gain to temp buffer and scale/mix in 2nd step.
         // if aux != NULL: resample with unity gain to temp buffer then apply send level.
@@ -1500,8 +1916,11 @@ void AudioMixerBase::TrackBase::track__Resample(TO* out, size_t outFrameCount, T
         memset(temp, 0, outFrameCount * mMixerChannelCount * sizeof(TO));
         mResampler->resample((int32_t*)temp, outFrameCount, bufferProvider);
 
-        volumeMix<MIXTYPE, std::is_same_v<TI, float> /* USEFLOATVOL */, true /* ADJUSTVOL */>(
-                out, outFrameCount, temp, aux, ramp);
+        // without a ramp, mixing the silence left in temp would not change out and aux.
+        if (ramp || mResampler->getSkippedFrames() != outFrameCount) {
+            volumeMix<MIXTYPE, std::is_same_v<TI, float> /* USEFLOATVOL */,
+                    true /* ADJUSTVOL */>(out, outFrameCount, temp, aux, ramp);
+        }
 
     } else { // constant volume gain
         mResampler->setVolume(mVolume[0], mVolume[1]);
@@ -23,6 +23,12 @@
 #include <dlfcn.h>
 #include <math.h>
 
+#include <algorithm>
+#include <future>
+#include <map>
+#include <mutex>
+#include <tuple>
+
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <utils/Log.h>
@@ -31,6 +37,7 @@
 #include "AudioResamplerFirOps.h" // USE_NEON, USE_SSE and USE_INLINE_ASSEMBLY defined here
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
+#include "AudioResamplerFirProcessAVX2.h"
 #include "AudioResamplerFirProcessSSE.h"
 #include "AudioResamplerFirGen.h" // requires math.h
 #include "AudioResamplerDyn.h"
@@ -42,6 +49,153 @@ constexpr size_t CACHE_LINE_SIZE = 64;
 
 namespace android {
 
+/*
+ * FilterBankCache is a process-wide cache of the designed filter banks.
+ *
+ * Many tracks use the same conversion (e.g. 44.1kHz to 48kHz), so the Kaiser
+ * windowed sinc design and the coefficient memory are shared between resamplers.
+ * The filter design depends only on the input and output sample rates, the quality
+ * and the coefficient type (the design properties are read-only), which form the key.
+ *
+ * Entries are weakly referenced, a filter bank is released when the last resampler
+ * using it is destroyed or changes to a different filter, so memory scales with the
+ * number of distinct conversions in use rather than with the number of tracks.
+ */
+class FilterBankCache {
+public:
+    enum CoefType {
+        COEF_TYPE_INT16,
+        COEF_TYPE_INT32,
+        COEF_TYPE_FLOAT,
+    };
+
+    struct Key {
+        int32_t inSampleRate;
+        int32_t outSampleRate;
+        AudioResampler::src_quality quality;
+        CoefType coefType;
+
+        bool operator<(const Key& other) const {
+            return std::tie(inSampleRate, outSampleRate, quality, coefType)
+                    < std::tie(other.inSampleRate, other.outSampleRate,
+                            other.quality, other.coefType);
+        }
+    };
+
+    static FilterBankCache& getInstance() {
+        static FilterBankCache instance;
+        return instance;
+    }
+
+    // Returns the cached filter bank for key, or the one returned by create()
+    // which is then added to the cache. T must have an mSizeInBytes member.
+    template<typename T, typename F>
+    std::shared_ptr<const T> get(const Key& key, F create) {
+        // The filter is designed without the lock held. Concurrent creations of the
+        // same filter bank wait for the design in flight, those of other keys do not.
+        std::promise<std::shared_ptr<const void>> designed;
+        std::shared_future<std::shared_ptr<const void>> inFlight;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            auto it = mFilterBanks.find(key);
+            if (it != mFilterBanks.end()) {
+                std::shared_ptr<const void> filterBank = it->second.filterBank.lock();
+                if (filterBank != nullptr) {
+                    ++mHits;
+                    return std::static_pointer_cast<const T>(filterBank);
+                }
+                inFlight = it->second.inFlight;
+            }
+            if (inFlight.valid()) {
+                ++mHits;
+            } else {
+                ++mMisses;
+
+                // remove the filter banks no longer in use.
+                for (auto entry = mFilterBanks.begin(); entry != mFilterBanks.end(); ) {
+                    if (entry->second.filterBank.expired()
+                            && !entry->second.inFlight.valid()) {
+                        entry = mFilterBanks.erase(entry);
+                    } else {
+                        ++entry;
+                    }
+                }
+                mFilterBanks[key] = { {}, 0, designed.get_future().share() };
+            }
+        }
+        if (inFlight.valid()) {
+            return std::static_pointer_cast<const T>(inFlight.get());
+        }
+
+        std::shared_ptr<const T> filterBank = create();
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mFilterBanks[key] = { filterBank, filterBank->mSizeInBytes, {} };
+        }
+        designed.set_value(filterBank);
+        return filterBank;
+    }
+
+    AudioResampler::FilterCacheStats getStats() {
+        std::lock_guard<std::mutex> lock(mLock);
+        AudioResampler::FilterCacheStats stats{};
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        for (const auto& entry : mFilterBanks) {
+            if (!entry.second.filterBank.expired()) {
+                ++stats.filterBanks;
+                stats.bytes += entry.second.sizeInBytes;
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::weak_ptr<const void> filterBank;
+        size_t sizeInBytes;
+        // valid while the filter bank is being designed
+        std::shared_future<std::shared_ptr<const void>> inFlight;
+    };
+
+    std::mutex mLock;
+    std::map<Key, Entry> mFilterBanks; // guarded by mLock
+    uint64_t mHits = 0;                // guarded by mLock
+    uint64_t mMisses = 0;              // guarded by mLock
+};
+
+template<typename TC>
+static constexpr FilterBankCache::CoefType getCoefType() {
+    return is_same<TC, int16_t>::value ? FilterBankCache::COEF_TYPE_INT16
+            : is_same<TC, int32_t>::value ? FilterBankCache::COEF_TYPE_INT32
+            : FilterBankCache::COEF_TYPE_FLOAT;
+}
+
+// static
+AudioResampler::FilterCacheStats AudioResampler::getFilterCacheStats()
+{
+    return FilterBankCache::getInstance().getStats();
+}
+
+// Returns true if the input samples are all zero, in which case the filter output
+// computed from them is zero too. Audible input returns at the first non-zero block.
+template<typename TI>
+static inline bool isSilence(const TI* in, size_t count)
+{
+    constexpr size_t kBlock = 16;
+    for (; count >= kBlock; count -= kBlock, in += kBlock) {
+        bool nonZero = false;
+        for (size_t i = 0; i < kBlock; ++i) {
+            nonZero |= in[i] != 0;
+        }
+        if (nonZero) return false;
+    }
+    for (; count > 0; --count) {
+        if (*in++ != 0) return false;
+    }
+    return true;
+}
+
 /*
  * InBuffer is a type agnostic input buffer.
  *
@@ -182,9 +336,10 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
         int inChannelCount, int32_t sampleRate, src_quality quality)
     : AudioResampler(inChannelCount, sampleRate, quality),
       mResampleFunc(0), mFilterSampleRate(0), mFilterQuality(DEFAULT_QUALITY),
-    mCoefBuffer(NULL)
+      mVolumeRamp(false), mSkipSilence(false), mSilentFrames(0), mSkippedFrames(0)
 {
     mVolumeSimd[0] = mVolumeSimd[1] = 0;
+    mVolumeIncSimd[0] = mVolumeIncSimd[1] = 0;
     // The AudioResampler base class assumes we are always ready for 1:1 resampling.
     // We reset mInSampleRate to 0, so setSampleRate() will calculate filters for
     // setSampleRate() for 1:1. (May be removed if precalculated filters are used.)
@@ -207,7 +362,6 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
 }
 
 template<typename TC, typename TI, typename TO>
@@ -230,6 +384,21 @@ void AudioResamplerDyn<TC, TI, TO>::setVolume(float left, float right)
         mVolumeSimd[0] = u4_28_from_float(clampFloatVol(left));
         mVolumeSimd[1] = u4_28_from_float(clampFloatVol(right));
     }
+    mVolumeIncSimd[0] = mVolumeIncSimd[1] = 0;
+    mVolumeRamp = false;
+}
+
+template<typename TC, typename TI, typename TO>
+bool AudioResamplerDyn<TC, TI, TO>::setVolumeRamp(float leftInc, float rightInc)
+{
+    // The integer volume is U4_28 and clamped to unity gain, so only float ramps.
+    if (!is_same<TO, float>::value) {
+        return false;
+    }
+    mVolumeIncSimd[0] = static_cast<TO>(leftInc);
+    mVolumeIncSimd[1] = static_cast<TO>(rightInc);
+    mVolumeRamp = leftInc != 0.f || rightInc != 0.f;
+    return true;
 }
 
 // TODO: update to C++11
@@ -239,7 +408,8 @@ template<typename T> T max(T a, T b) {return a > b ? a : b;}
 template<typename T> T absdiff(T a, T b) {return a > b ? a - b : b - a;}
 
 template<typename TC, typename TI, typename TO>
-void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
+std::shared_ptr<const typename AudioResamplerDyn<TC, TI, TO>::FilterBank>
+AudioResamplerDyn<TC, TI, TO>::createKaiserFir(const Constants &c,
         double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat)
 {
     // compute the normalized transition bandwidth
@@ -252,11 +422,12 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     } else { // downsample
         fcr = max(0.5 * tbwCheat * outSampleRate / inSampleRate - halfbw, halfbw);
     }
-    createKaiserFir(c, stopBandAtten, fcr);
+    return createKaiserFir(c, stopBandAtten, fcr);
 }
 
 template<typename TC, typename TI, typename TO>
-void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
+std::shared_ptr<const typename AudioResamplerDyn<TC, TI, TO>::FilterBank>
+AudioResamplerDyn<TC, TI, TO>::createKaiserFir(const Constants &c,
         double stopBandAtten, double fcr) {
     // compute the normalized transition bandwidth
     const double tbw = firKaiserTbw(c.mHalfNumCoefs, stopBandAtten);
@@ -265,14 +436,14 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
 
     // create buffer
     TC *coefs = nullptr;
+    const size_t sizeInBytes = (phases + 1) * halfLength * sizeof(TC);
     int ret = posix_memalign(
             reinterpret_cast<void **>(&coefs),
             CACHE_LINE_SIZE /* alignment */,
-            (phases + 1) * halfLength * sizeof(TC));
+            sizeInBytes);
     LOG_ALWAYS_FATAL_IF(ret != 0, "Cannot allocate buffer memory, ret %d", ret);
-    c.mFirCoefs = coefs;
-    free(mCoefBuffer);
-    mCoefBuffer = coefs;
+    auto filterBank = std::make_shared<FilterBank>(coefs);
+    filterBank->mSizeInBytes = sizeInBytes;
 
     // square the computed minimum passband value (extra safety).
     double attenuation =
@@ -283,11 +454,11 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     firKaiserGen(coefs, phases, halfLength, stopBandAtten, fcr, attenuation);
 
     // update the design criteria
-    mNormalizedCutoffFrequency = fcr;
-    mNormalizedTransitionBandwidth = tbw;
-    mFilterAttenuation = attenuation;
-    mStopbandAttenuationDb = stopBandAtten;
-    mPassbandRippleDb = computeWindowedSincPassbandRippleDb(stopBandAtten);
+    filterBank->mNormalizedCutoffFrequency = fcr;
+    filterBank->mNormalizedTransitionBandwidth = tbw;
+    filterBank->mFilterAttenuation = attenuation;
+    filterBank->mStopbandAttenuationDb = stopBandAtten;
+    filterBank->mPassbandRippleDb = computeWindowedSincPassbandRippleDb(stopBandAtten);
 
 #if 0
     // Keep this debug code in case an app causes resampler design issues.
@@ -311,6 +482,22 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     ALOGD("passband(%lf, %lf): %.8lf %.8lf %.8lf\n", 0., fp, passMin, passMax, passRipple);
     ALOGD("stopband(%lf, %lf): %.8lf %.3lf\n", fs, 0.5, stopMax, stopRipple);
 #endif
+    return filterBank;
+}
+
+template<typename TC, typename TI, typename TO>
+void AudioResamplerDyn<TC, TI, TO>::setFilterBank(
+        const std::shared_ptr<const FilterBank>& filterBank)
+{
+    mFilterBank = filterBank;
+    mConstants.mFirCoefs = filterBank->mFirCoefs;
+
+    // update the design criteria
+    mNormalizedCutoffFrequency = filterBank->mNormalizedCutoffFrequency;
+    mNormalizedTransitionBandwidth = filterBank->mNormalizedTransitionBandwidth;
+    mFilterAttenuation = filterBank->mFilterAttenuation;
+    mStopbandAttenuationDb = filterBank->mStopbandAttenuationDb;
+    mPassbandRippleDb = filterBank->mPassbandRippleDb;
 }
 
 // recursive gcd. Using objdump, it appears the tail recursion is converted to a while loop.
@@ -509,14 +696,17 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
             phases = 127;
         }
 
-        // create the filter
+        // create the filter, or share an identical one designed by another resampler.
         mConstants.set(phases, halfLength, inSampleRate, mSampleRate);
-        if (fcr > 0.) {
-            createKaiserFir(mConstants, stopBandAtten, fcr);
-        } else {
-            createKaiserFir(mConstants, stopBandAtten,
+        const FilterBankCache::Key key{
+                inSampleRate, mSampleRate, mFilterQuality, getCoefType<TC>()};
+        setFilterBank(FilterBankCache::getInstance().get<FilterBank>(key, [&]() {
+            if (fcr > 0.) {
+                return createKaiserFir(mConstants, stopBandAtten, fcr);
+            }
+            return createKaiserFir(mConstants, stopBandAtten,
                     inSampleRate, mSampleRate, tbwCheat);
-        }
+        }));
     } // End Kaiser filter
 
     // update phase and state based on the new filter.
@@ -650,6 +840,12 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
     // validate that inFrameCount is in signed 32 bit integer range.
     ALOG_ASSERT(0 <= inFrameCount && inFrameCount < (1U << 31));
 
+    // the filter output is zero once the frames it covers are all silence.
+    const size_t silentWindow = 2 * c.mHalfNumCoefs;
+    size_t silentFrames = mSilentFrames;
+    bool inSilent = false;  // the samples of mBuffer are all zero
+    mSkippedFrames = 0;
+
     //ALOGV("inFrameCount:%d  outFrameCount:%d"
     //        "  phaseIncrement:%u  phaseFraction:%u  phaseWrapLimit:%u",
     //        inFrameCount, outFrameCount, phaseIncrement, phaseFraction, phaseWrapLimit);
@@ -678,8 +874,11 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
                 // We are either at the end of playback or in an underrun situation.
                 // Reset buffer to prevent pop noise at the next buffer.
                 mInBuffer.reset();
+                silentFrames = kSilentStateFrames;
                 goto resample_exit;
             }
+            inSilent = mSkipSilence && isSilence(
+                    reinterpret_cast<const TI*>(mBuffer.raw), mBuffer.frameCount * CHANNELS);
             inFrameCount -= mBuffer.frameCount;
             if (phaseFraction >= phaseWrapLimit) { // read in data
                 mInBuffer.template readAdvance<CHANNELS>(
@@ -689,6 +888,8 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
                 phaseFraction -= phaseWrapLimit;
                 while (phaseFraction >= phaseWrapLimit) {
                     if (inputIndex >= mBuffer.frameCount) {
+                        silentFrames = inSilent ? std::min(silentFrames + inputIndex,
+                                kSilentStateFrames) : 0;
                         inputIndex = 0;
                         provider->releaseBuffer(&mBuffer);
                         break;
@@ -706,6 +907,42 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
         const int coefShift = c.mShift;
         const int halfNumCoefs = c.mHalfNumCoefs;
         const TO* const volumeSimd = mVolumeSimd;
+        const bool volumeRamp = mVolumeRamp;
+
+        if (CC_UNLIKELY(mSkipSilence && (inSilent || frameCount == 0))) {
+            // The input buffer is silence. Once the frames in the filter are all silence,
+            // the output frame is zero and is not computed. The input is still read into
+            // the filter state, and the phase and volume ramp advance as in the main loop.
+            while (outputIndex < outputSampleCount) {
+                if (silentFrames + inputIndex >= silentWindow) {
+                    ++mSkippedFrames;
+                } else {
+                    fir<CHANNELS, LOCKED, STRIDE>(
+                            &out[outputIndex],
+                            phaseFraction, phaseWrapLimit,
+                            coefShift, halfNumCoefs, coefs,
+                            impulse, volumeSimd);
+                }
+                if (CC_UNLIKELY(volumeRamp)) {
+                    mVolumeSimd[0] += mVolumeIncSimd[0];
+                    mVolumeSimd[1] += mVolumeIncSimd[1];
+                }
+
+                outputIndex += OUTPUT_CHANNELS;
+
+                phaseFraction += phaseIncrement;
+                while (phaseFraction >= phaseWrapLimit) {
+                    if (inputIndex >= frameCount) {
+                        goto done;  // need a new buffer
+                    }
+                    mInBuffer.template readAdvance<CHANNELS>(
+                            impulse, halfNumCoefs, in, inputIndex);
+                    inputIndex++;
+                    phaseFraction -= phaseWrapLimit;
+                }
+            }
+            goto done;
+        }
 
         // main processing loop
         while (CC_LIKELY(outputIndex < outputSampleCount)) {
@@ -725,6 +962,12 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
                     coefShift, halfNumCoefs, coefs,
                     impulse, volumeSimd);
 
+            // the volume ramp is applied per output frame, as in volumeRampMulti().
+            if (CC_UNLIKELY(volumeRamp)) {
+                mVolumeSimd[0] += mVolumeIncSimd[0];
+                mVolumeSimd[1] += mVolumeIncSimd[1];
+            }
+
             outputIndex += OUTPUT_CHANNELS;
 
             phaseFraction += phaseIncrement;
@@ -743,6 +986,7 @@ done:
         if (inputIndex > 0) {  // we've acquired a buffer (alternatively could check frameCount)
             ALOG_ASSERT(inputIndex == frameCount, "inputIndex(%zu) != frameCount(%zu)",
                     inputIndex, frameCount);  // must have been fully read.
+            silentFrames = inSilent ? std::min(silentFrames + frameCount, kSilentStateFrames) : 0;
             inputIndex = 0;
             provider->releaseBuffer(&mBuffer);
             ALOG_ASSERT(mBuffer.frameCount == 0);
@@ -758,6 +1002,7 @@ resample_exit:
     ALOG_ASSERT(mBuffer.frameCount == 0); // there must be no frames in the buffer
     mInBuffer.setImpulse(impulse);
     mPhaseFraction = phaseFraction;
+    mSilentFrames = silentFrames;
     return outputIndex / OUTPUT_CHANNELS;
 }
 
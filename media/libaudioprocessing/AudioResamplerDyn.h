@@ -18,9 +18,12 @@
 #define ANDROID_AUDIO_RESAMPLER_DYN_H
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <android/log.h>
 
+#include <memory>
+
 #include <media/AudioResampler.h>
 
 namespace android {
@@ -52,14 +55,21 @@ public:
 
     virtual void setVolume(float left, float right);
 
+    bool setVolumeRamp(float leftInc, float rightInc) override;
+
     virtual size_t resample(int32_t* out, size_t outFrameCount,
             AudioBufferProvider* provider);
 
     void reset() override {
         AudioResampler::reset();
         mInBuffer.reset();
+        mSilentFrames = kSilentStateFrames;
     }
 
+    void setSkipSilence(bool skipSilence) override { mSkipSilence = skipSilence; }
+
+    size_t getSkippedFrames() const override { return mSkippedFrames; }
+
     // Make available key design criteria for testing
     int getHalfLength() const {
         return mConstants.mHalfNumCoefs;
@@ -95,6 +105,26 @@ public:
 
 private:
 
+    // An immutable designed filter bank with its design criteria.
+    // Filter banks are shared between resamplers through a process-wide cache,
+    // see setSampleRate().
+    class FilterBank {
+    public:
+        explicit FilterBank(TC* firCoefs) : mFirCoefs(firCoefs) {}
+        ~FilterBank() { free(mFirCoefs); }
+
+        FilterBank(const FilterBank&) = delete;
+        FilterBank& operator=(const FilterBank&) = delete;
+
+        TC* const mFirCoefs;                 // polyphase filter bank, cache line aligned
+        size_t mSizeInBytes = 0;
+        double mStopbandAttenuationDb = 0.;
+        double mPassbandRippleDb = 0.;
+        double mNormalizedTransitionBandwidth = 0.;
+        double mFilterAttenuation = 0.;
+        double mNormalizedCutoffFrequency = 0.;
+    };
+
     class Constants { // stores the filter constants.
     public:
         Constants() :
@@ -147,10 +177,13 @@ private:
         size_t mStateCount; // size of state in units of TI.
     };
 
-    void createKaiserFir(Constants &c, double stopBandAtten,
-            int inSampleRate, int outSampleRate, double tbwCheat);
+    static std::shared_ptr<const FilterBank> createKaiserFir(const Constants &c,
+            double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat);
+
+    static std::shared_ptr<const FilterBank> createKaiserFir(const Constants &c,
+            double stopBandAtten, double fcr);
 
-    void createKaiserFir(Constants &c, double stopBandAtten, double fcr);
+    void setFilterBank(const std::shared_ptr<const FilterBank>& filterBank);
 
     template<int CHANNELS, bool LOCKED, int STRIDE>
     size_t resample(TO* out, size_t outFrameCount, AudioBufferProvider* provider);
@@ -166,7 +199,15 @@ private:
      resample_ABP_t mResampleFunc;     // called function for resampling
             int32_t mFilterSampleRate; // designed filter sample rate.
         src_quality mFilterQuality;    // designed filter quality.
-              void* mCoefBuffer;       // if a filter is created, this is not null
+    std::shared_ptr<const FilterBank> mFilterBank; // if a filter is created, this is not null
+                 TO mVolumeIncSimd[2];  // volume increment per output frame, float only.
+               bool mVolumeRamp;        // mVolumeSimd is ramped by mVolumeIncSimd.
+               bool mSkipSilence;       // see setSkipSilence().
+             size_t mSilentFrames;      // silent frames last read into mInBuffer, saturated.
+             size_t mSkippedFrames;     // see getSkippedFrames().
+
+    // mSilentFrames of a cleared mInBuffer, larger than any filter length.
+    static constexpr size_t kSilentStateFrames = 1 << 16;
 
     // Property selected design parameters.
               // This will enable fixed high quality resampling.
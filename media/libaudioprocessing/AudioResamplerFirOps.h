@@ -17,7 +17,7 @@
 #ifndef ANDROID_AUDIO_RESAMPLER_FIR_OPS_H
 #define ANDROID_AUDIO_RESAMPLER_FIR_OPS_H
 
-namespace android {
+// intrinsic headers must be included outside of the android namespace.
 
 #if defined(__arm__) && !defined(__thumb__)
 #define USE_INLINE_ASSEMBLY (true)
@@ -46,8 +46,22 @@ namespace android {
 #include <tmmintrin.h>
 #else
 #define USE_SSE (false)
-#define USE_AVX2(false)
+#define USE_AVX2 (false)
+#endif
+
+// AVX2/FMA kernels are compiled for all x86 targets with SSE and selected at runtime
+// if the host supports them, see AudioResamplerFirProcessAVX2.h.
+// If compiled with -mavx2 -mfma the runtime check is omitted.
+#if USE_SSE
+#ifndef USE_AVX2_DISPATCH
+#define USE_AVX2_DISPATCH (true)
 #endif
+#include <immintrin.h>
+#else
+#define USE_AVX2_DISPATCH (false)
+#endif
+
+namespace android {
 
 
 template<typename T, typename U>
@@ -62,6 +76,22 @@ struct is_same<T, T>  // partial specialization
     static const bool value = true;
 };
 
+#if USE_AVX2_DISPATCH
+static inline
+bool isAvx2FmaSupported()
+{
+#if USE_AVX2
+    return true;
+#else
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }();
+    return supported;
+#endif
+}
+#endif
+
 static inline
 int32_t mulRL(int left, int32_t in, uint32_t vRL)
 {
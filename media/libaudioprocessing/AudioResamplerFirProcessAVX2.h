@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H
+
+namespace android {
+
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+
+#if USE_AVX2_DISPATCH
+
+//
+// AVX2/FMA kernels for Process() and ProcessL() in AudioResamplerFirProcess.h
+//
+// The kernels are compiled with a function target attribute, so they are available
+// in the generic x86 build; isAvx2FmaSupported() selects them at runtime.
+// The float kernels are selected in AudioResamplerFirProcessSSE.h,
+// the int16_t kernels are selected here.
+//
+// The filter length requirements are the same as for the SSE and NEON versions:
+// halfNumCoefs must be a multiple of 8 (STRIDE 16).
+//
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+AVX2_TARGET
+static inline void ProcessAVX2Intrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS == 1 || CHANNELS == 2, "CHANNELS must be 1 or 2");
+
+    sP -= CHANNELS*(8-1);   // adjust sP for a loop iteration of eight
+
+    __m256 interp;
+    if (!FIXED) {
+        interp = _mm256_set1_ps(lerpP);
+    }
+
+    // coefficient permutations to match the sample order in memory.
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i dupLo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i dupHi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    const __m256i dupReverseLo = _mm256_setr_epi32(7, 7, 6, 6, 5, 5, 4, 4);
+    const __m256i dupReverseHi = _mm256_setr_epi32(3, 3, 2, 2, 1, 1, 0, 0);
+
+    // separate accumulators for the positive and negative side shorten the dependency chain.
+    __m256 accP = _mm256_setzero_ps();
+    __m256 accN = _mm256_setzero_ps();
+
+    do {
+        __m256 posCoef = _mm256_load_ps(coefsP);
+        __m256 negCoef = _mm256_load_ps(coefsN);
+        coefsP += 8;
+        coefsN += 8;
+
+        if (!FIXED) { // interpolate
+            __m256 posCoef1 = _mm256_load_ps(coefsP1);
+            __m256 negCoef1 = _mm256_load_ps(coefsN1);
+            coefsP1 += 8;
+            coefsN1 += 8;
+
+            // Calculate the final coefficient for interpolation
+            // posCoef = interp * (posCoef1 - posCoef) + posCoef
+            // negCoef = interp * (negCoef - negCoef1) + negCoef1
+            posCoef = _mm256_fmadd_ps(_mm256_sub_ps(posCoef1, posCoef), interp, posCoef);
+            negCoef = _mm256_fmadd_ps(_mm256_sub_ps(negCoef, negCoef1), interp, negCoef1);
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m256 posSamp = _mm256_loadu_ps(sP);
+            __m256 negSamp = _mm256_loadu_ps(sN);
+            sP -= 8;
+            sN += 8;
+
+            // reverse the positive coefficients rather than the samples
+            posCoef = _mm256_permutevar8x32_ps(posCoef, reverse);
+
+            accP = _mm256_fmadd_ps(posSamp, posCoef, accP);
+            accN = _mm256_fmadd_ps(negSamp, negCoef, accN);
+        } break;
+        case 2: {
+            __m256 posSamp0 = _mm256_loadu_ps(sP);
+            __m256 posSamp1 = _mm256_loadu_ps(sP+8);
+            __m256 negSamp0 = _mm256_loadu_ps(sN);
+            __m256 negSamp1 = _mm256_loadu_ps(sN+8);
+            sP -= 16;
+            sN += 16;
+
+            // samples stay interleaved, each coefficient is duplicated for L and R.
+            accP = _mm256_fmadd_ps(posSamp0,
+                    _mm256_permutevar8x32_ps(posCoef, dupReverseLo), accP);
+            accP = _mm256_fmadd_ps(posSamp1,
+                    _mm256_permutevar8x32_ps(posCoef, dupReverseHi), accP);
+            accN = _mm256_fmadd_ps(negSamp0,
+                    _mm256_permutevar8x32_ps(negCoef, dupLo), accN);
+            accN = _mm256_fmadd_ps(negSamp1,
+                    _mm256_permutevar8x32_ps(negCoef, dupHi), accN);
+        } break;
+        }
+    } while (count -= 8);
+
+    // combine and funnel down accumulator
+    __m256 acc = _mm256_add_ps(accP, accN);
+    __m128 outAccum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    outAccum = _mm_add_ps(outAccum, _mm_movehl_ps(outAccum, outAccum));
+    if (CHANNELS == 1) {
+        // duplicate accL to both L and R
+        outAccum = _mm_add_ps(outAccum, _mm_shuffle_ps(outAccum, outAccum, 0x11));
+    } // else for CHANNELS == 2, outAccum contains L and R in the lower two lanes.
+
+    // multiply by volume and save.
+    // not fused, so the output is the same as accumulating into a zeroed buffer first.
+    __m128 vLR = _mm_setzero_ps();
+    __m128 outSamp;
+    vLR = _mm_loadl_pi(vLR, reinterpret_cast<const __m64*>(volumeLR));
+    outSamp = _mm_loadl_pi(vLR, reinterpret_cast<__m64*>(out));
+    outSamp = _mm_add_ps(outSamp, _mm_mul_ps(outAccum, vLR));
+    _mm_storel_pi(reinterpret_cast<__m64*>(out), outSamp);
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+AVX2_TARGET
+static inline void ProcessAVX2Intrinsic(int32_t* out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* volumeLR,
+        uint32_t lerpP,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS == 1 || CHANNELS == 2, "CHANNELS must be 1 or 2");
+
+    sP -= CHANNELS*(8-1);   // adjust sP for a loop iteration of eight
+
+    __m256i interp;
+    if (!FIXED) {
+        interp = _mm256_set1_epi16(static_cast<int16_t>(lerpP));
+    }
+
+    // byte shuffles within each 128 bit lane:
+    // reverse the 16 bit words of the lower lane only, and
+    // deinterleave L R L R L R L R to L L L L R R R R in both lanes.
+    const __m256i reverseLo = _mm256_setr_epi8(
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i deinterleave = _mm256_setr_epi8(
+            0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+            0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+
+    __m256i acc = _mm256_setzero_si256();
+
+    do {
+        // lower lane has the positive, upper lane has the negative coefficients.
+        __m256i coef = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(coefsP))),
+                _mm_load_si128(reinterpret_cast<const __m128i*>(coefsN)), 1);
+        coefsP += 8;
+        coefsN += 8;
+
+        if (!FIXED) { // interpolate
+            __m256i coef1 = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(
+                            _mm_load_si128(reinterpret_cast<const __m128i*>(coefsP1))),
+                    _mm_load_si128(reinterpret_cast<const __m128i*>(coefsN1)), 1);
+            coefsP1 += 8;
+            coefsN1 += 8;
+
+            // Bit exact with interpolate<int16_t, uint32_t>():
+            // coef = (lerp * (coef_1 - coef_0) >> 15) + coef_0
+            // where (coef_0, coef_1) is (coefsP, coefsP1) or (coefsN1, coefsN).
+            // The low 16 bits of the 32 bit product shifted by 15 are assembled
+            // from the high and low halves of the 16 bit multiply.
+            __m256i coef0 = _mm256_blend_epi32(coef, coef1, 0xF0);
+            __m256i diff = _mm256_sub_epi16(_mm256_blend_epi32(coef1, coef, 0xF0), coef0);
+            __m256i productHi = _mm256_mulhi_epi16(diff, interp);
+            __m256i productLo = _mm256_mullo_epi16(diff, interp);
+            coef = _mm256_add_epi16(_mm256_or_si256(
+                    _mm256_slli_epi16(productHi, 1), _mm256_srli_epi16(productLo, 15)), coef0);
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m256i samp = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sP))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sN)), 1);
+            sP -= 8;
+            sN += 8;
+
+            // reverse the positive coefficients rather than the samples
+            coef = _mm256_shuffle_epi8(coef, reverseLo);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(samp, coef));
+        } break;
+        case 2: {
+            __m256i posSamp = _mm256_shuffle_epi8(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sP)), deinterleave);
+            __m256i negSamp = _mm256_shuffle_epi8(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sN)), deinterleave);
+            sP -= 16;
+            sN += 16;
+
+            // posCoef is c7 ... c0 to match the samples, negCoef is c0 ... c7.
+            // Each lane holds four frames, so repeat four coefficients for L and R.
+            __m128i posCoef = _mm_shuffle_epi8(
+                    _mm256_castsi256_si128(coef), _mm256_castsi256_si128(reverseLo));
+            __m128i negCoef = _mm256_extracti128_si256(coef, 1);
+            __m256i posCoefLR = _mm256_set_m128i(
+                    _mm_unpackhi_epi64(posCoef, posCoef), _mm_unpacklo_epi64(posCoef, posCoef));
+            __m256i negCoefLR = _mm256_set_m128i(
+                    _mm_unpackhi_epi64(negCoef, negCoef), _mm_unpacklo_epi64(negCoef, negCoef));
+
+            // accumulator lanes are L L R R L L R R
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(posSamp, posCoefLR));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(negSamp, negCoefLR));
+        } break;
+        }
+    } while (count -= 8);
+
+    // combine and funnel down accumulator
+    __m128i outAccum = _mm_add_epi32(
+            _mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    if (CHANNELS == 1) {
+        outAccum = _mm_add_epi32(outAccum, _mm_shuffle_epi32(outAccum, 0x4E));
+        outAccum = _mm_add_epi32(outAccum, _mm_shuffle_epi32(outAccum, 0xB1));
+        const int32_t l = _mm_cvtsi128_si32(outAccum);
+        out[0] += volumeAdjust(l, volumeLR[0]);
+        out[1] += volumeAdjust(l, volumeLR[1]);
+    } else if (CHANNELS == 2) {
+        outAccum = _mm_hadd_epi32(outAccum, outAccum);
+        out[0] += volumeAdjust(_mm_extract_epi32(outAccum, 0), volumeLR[0]);
+        out[1] += volumeAdjust(_mm_extract_epi32(outAccum, 1), volumeLR[1]);
+    }
+}
+
+/*
+ * Multichannel float kernel.
+ *
+ * Eight coefficients are loaded (and interpolated) at a time, then each is broadcast and
+ * multiplied with a whole frame, eight channels at a time with a masked load for the
+ * remaining channels. Two frames are processed per step on each side to keep four
+ * independent accumulator chains per block. The mono volume volumeLR[0] is applied
+ * to all channels as in ProcessBase().
+ */
+template <int CHANNELS, int STRIDE, bool FIXED>
+AVX2_TARGET
+static inline void ProcessAVX2MultiIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS > 2, "CHANNELS must be > 2");
+    constexpr int kBlocks = (CHANNELS + 7) / 8;
+    constexpr int kTail = CHANNELS - (kBlocks - 1) * 8; // channels in last block, 1 to 8.
+
+    const __m256i tailMask = _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(kTail), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    auto load = [&](const float* samples, int block) __attribute__((target("avx2,fma"))) {
+        if (block < kBlocks - 1 || kTail == 8) {
+            return _mm256_loadu_ps(samples + block * 8);
+        }
+        return _mm256_maskload_ps(samples + block * 8, tailMask);
+    };
+
+    __m256 interp;
+    if (!FIXED) {
+        interp = _mm256_set1_ps(lerpP);
+    }
+
+    __m256 accP0[kBlocks], accP1[kBlocks], accN0[kBlocks], accN1[kBlocks];
+    for (int b = 0; b < kBlocks; ++b) {
+        accP0[b] = accP1[b] = accN0[b] = accN1[b] = _mm256_setzero_ps();
+    }
+
+    do {
+        __m256 posCoef = _mm256_load_ps(coefsP);
+        __m256 negCoef = _mm256_load_ps(coefsN);
+        coefsP += 8;
+        coefsN += 8;
+
+        if (!FIXED) { // interpolate
+            __m256 posCoef1 = _mm256_load_ps(coefsP1);
+            __m256 negCoef1 = _mm256_load_ps(coefsN1);
+            coefsP1 += 8;
+            coefsN1 += 8;
+
+            posCoef = _mm256_fmadd_ps(_mm256_sub_ps(posCoef1, posCoef), interp, posCoef);
+            negCoef = _mm256_fmadd_ps(_mm256_sub_ps(negCoef, negCoef1), interp, negCoef1);
+        }
+
+        for (int i = 0; i < 8; i += 2) {
+            const __m256 posCoef0 = _mm256_permutevar8x32_ps(posCoef, _mm256_set1_epi32(i));
+            const __m256 posCoef1 = _mm256_permutevar8x32_ps(posCoef, _mm256_set1_epi32(i + 1));
+            const __m256 negCoef0 = _mm256_permutevar8x32_ps(negCoef, _mm256_set1_epi32(i));
+            const __m256 negCoef1 = _mm256_permutevar8x32_ps(negCoef, _mm256_set1_epi32(i + 1));
+            for (int b = 0; b < kBlocks; ++b) {
+                accP0[b] = _mm256_fmadd_ps(load(sP, b), posCoef0, accP0[b]);
+                accP1[b] = _mm256_fmadd_ps(load(sP - CHANNELS, b), posCoef1, accP1[b]);
+                accN0[b] = _mm256_fmadd_ps(load(sN, b), negCoef0, accN0[b]);
+                accN1[b] = _mm256_fmadd_ps(load(sN + CHANNELS, b), negCoef1, accN1[b]);
+            }
+            sP -= 2 * CHANNELS;
+            sN += 2 * CHANNELS;
+        }
+    } while (count -= 8);
+
+    // multiply by volume and save (not fused, as above).
+    const __m256 vol = _mm256_set1_ps(volumeLR[0]);
+    for (int b = 0; b < kBlocks; ++b) {
+        const __m256 acc = _mm256_add_ps(
+                _mm256_add_ps(accP0[b], accP1[b]), _mm256_add_ps(accN0[b], accN1[b]));
+        const __m256 outSamp = _mm256_add_ps(load(out, b), _mm256_mul_ps(acc, vol));
+        if (b < kBlocks - 1 || kTail == 8) {
+            _mm256_storeu_ps(out + b * 8, outSamp);
+        } else {
+            _mm256_maskstore_ps(out + b * 8, tailMask, outSamp);
+        }
+    }
+}
+
+#undef AVX2_TARGET
+
+template<>
+inline void ProcessL<1, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<1, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+    } else {
+        ProcessBase<1, 16, InterpNull>(out, count, coefsP, coefsN, sP, sN, 0, volumeLR);
+    }
+}
+
+template<>
+inline void ProcessL<2, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<2, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+    } else {
+        ProcessBase<2, 16, InterpNull>(out, count, coefsP, coefsN, sP, sN, 0, volumeLR);
+    }
+}
+
+template<>
+inline void Process<1, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<1, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+    } else {
+        ProcessBase<1, 16, InterpCompute>(out, count, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+    }
+}
+
+template<>
+inline void Process<2, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<2, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+    } else {
+        ProcessBase<2, 16, InterpCompute>(out, count, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+    }
+}
+
+#endif //USE_AVX2_DISPATCH
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H*/
@@ -1207,6 +1207,152 @@ inline void Process<2, 16>(float* const out,
             lerpP, coefsP1, coefsN1);
 }
 
+
+/*
+ * Multichannel float kernel for an even number of channels (4.0, 5.1, 7.1, 7.1.4).
+ *
+ * Four coefficients are loaded (and interpolated) at a time and then applied
+ * to four frames on each side, so each coefficient is read once per output frame
+ * for all channels. A frame is processed as four channel vectors plus a two channel
+ * tail. The mono volume volumeLR[0] is applied to all channels as in ProcessBase().
+ */
+template <int CHANNELS>
+static inline void ProcessNeonMultiAccumulate(float32x4_t (&acc)[CHANNELS / 4],
+        float32x2_t& accTail, const float* samples, float32x2_t coefs, const int lane)
+{
+    for (int b = 0; b < CHANNELS / 4; ++b) {
+        acc[b] = lane == 0
+                ? vmlaq_lane_f32(acc[b], vld1q_f32(samples + b * 4), coefs, 0)
+                : vmlaq_lane_f32(acc[b], vld1q_f32(samples + b * 4), coefs, 1);
+    }
+    if (CHANNELS & 2) {
+        accTail = lane == 0
+                ? vmla_lane_f32(accTail, vld1_f32(samples + CHANNELS - 2), coefs, 0)
+                : vmla_lane_f32(accTail, vld1_f32(samples + CHANNELS - 2), coefs, 1);
+    }
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static inline void ProcessNeonMultiIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS >= 4 && (CHANNELS & 1) == 0, "CHANNELS must be even and >= 4");
+
+    coefsP = (const float*)__builtin_assume_aligned(coefsP, 16);
+    coefsN = (const float*)__builtin_assume_aligned(coefsN, 16);
+
+    const float32x2_t interp = vdup_n_f32(lerpP);
+    if (!FIXED) {
+        coefsP1 = (const float*)__builtin_assume_aligned(coefsP1, 16);
+        coefsN1 = (const float*)__builtin_assume_aligned(coefsN1, 16);
+    }
+
+    float32x4_t accP[CHANNELS / 4];
+    float32x4_t accN[CHANNELS / 4];
+    for (int b = 0; b < CHANNELS / 4; ++b) {
+        accP[b] = vdupq_n_f32(0);
+        accN[b] = vdupq_n_f32(0);
+    }
+    float32x2_t accTailP = vdup_n_f32(0);
+    float32x2_t accTailN = vdup_n_f32(0);
+
+    do {
+        float32x4_t posCoef = vld1q_f32(coefsP);
+        coefsP += 4;
+        float32x4_t negCoef = vld1q_f32(coefsN);
+        coefsN += 4;
+
+        if (!FIXED) { // interpolate
+            float32x4_t posCoef1 = vld1q_f32(coefsP1);
+            coefsP1 += 4;
+            float32x4_t negCoef1 = vld1q_f32(coefsN1);
+            coefsN1 += 4;
+
+            posCoef1 = vsubq_f32(posCoef1, posCoef);
+            negCoef = vsubq_f32(negCoef, negCoef1);
+
+            posCoef = vmlaq_lane_f32(posCoef, posCoef1, interp, 0);
+            negCoef = vmlaq_lane_f32(negCoef1, negCoef, interp, 0);
+        }
+
+        // one frame per coefficient; sP decrements and sN increments by a frame.
+        const float32x2_t posCoefLo = vget_low_f32(posCoef);
+        const float32x2_t posCoefHi = vget_high_f32(posCoef);
+        const float32x2_t negCoefLo = vget_low_f32(negCoef);
+        const float32x2_t negCoefHi = vget_high_f32(negCoef);
+        ProcessNeonMultiAccumulate<CHANNELS>(accP, accTailP, sP, posCoefLo, 0);
+        ProcessNeonMultiAccumulate<CHANNELS>(accN, accTailN, sN, negCoefLo, 0);
+        ProcessNeonMultiAccumulate<CHANNELS>(accP, accTailP, sP - CHANNELS, posCoefLo, 1);
+        ProcessNeonMultiAccumulate<CHANNELS>(accN, accTailN, sN + CHANNELS, negCoefLo, 1);
+        ProcessNeonMultiAccumulate<CHANNELS>(accP, accTailP, sP - 2 * CHANNELS, posCoefHi, 0);
+        ProcessNeonMultiAccumulate<CHANNELS>(accN, accTailN, sN + 2 * CHANNELS, negCoefHi, 0);
+        ProcessNeonMultiAccumulate<CHANNELS>(accP, accTailP, sP - 3 * CHANNELS, posCoefHi, 1);
+        ProcessNeonMultiAccumulate<CHANNELS>(accN, accTailN, sN + 3 * CHANNELS, negCoefHi, 1);
+        sP -= 4 * CHANNELS;
+        sN += 4 * CHANNELS;
+    } while (count -= 4);
+
+    // multiply by volume and save
+    const float32x2_t vol = vld1_dup_f32(volumeLR);
+    for (int b = 0; b < CHANNELS / 4; ++b) {
+        const float32x4_t acc = vaddq_f32(accP[b], accN[b]);
+        vst1q_f32(out + b * 4, vmlaq_lane_f32(vld1q_f32(out + b * 4), acc, vol, 0));
+    }
+    if (CHANNELS & 2) {
+        float* const outTail = out + CHANNELS - 2;
+        const float32x2_t acc = vadd_f32(accTailP, accTailN);
+        vst1_f32(outTail, vmla_f32(vld1_f32(outTail), acc, vol));
+    }
+}
+
+// Multichannel specializations.
+#pragma push_macro("PROCESS_NEON_MULTI")
+#undef PROCESS_NEON_MULTI
+#define PROCESS_NEON_MULTI(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultiIntrinsic<CHANNELS, 16, true>(out, count, coefsP, coefsN, sP, sN, \
+            volumeLR, 0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/); \
+} \
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultiIntrinsic<CHANNELS, 16, false>(out, count, coefsP, coefsN, sP, sN, \
+            volumeLR, lerpP, coefsP1, coefsN1); \
+}
+
+PROCESS_NEON_MULTI(4)
+PROCESS_NEON_MULTI(6)
+PROCESS_NEON_MULTI(8)
+PROCESS_NEON_MULTI(12)
+
+#pragma pop_macro("PROCESS_NEON_MULTI")
+
 #endif //USE_NEON
 
 } // namespace android
@@ -19,7 +19,8 @@
 
 namespace android {
 
-// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h,
+// AudioResamplerFirProcessAVX2.h
 
 #if USE_SSE
 
@@ -32,6 +33,7 @@ namespace android {
 
 //
 // SSEx specializations are enabled for Process() and ProcessL() in AudioResamplerFirProcess.h
+// If the host supports AVX2/FMA, the wider kernels in AudioResamplerFirProcessAVX2.h are used.
 //
 
 template <int CHANNELS, int STRIDE, bool FIXED>
@@ -163,16 +165,117 @@ static inline void ProcessSSEIntrinsic(float* out,
         outAccum = _mm_hadd_ps(accL, accR);
         outAccum = _mm_hadd_ps(outAccum, outAccum);
     }
-    #if USE_AVX2
-    outSamp = _mm_fmadd_ps(outAccum, vLR,outSamp);
-    #else
+    // not fused, so the output is the same as accumulating into a zeroed buffer first.
     outAccum = _mm_mul_ps(outAccum, vLR);
     outSamp = _mm_add_ps(outSamp, outAccum);
-    #endif
 
     _mm_storel_pi(reinterpret_cast<__m64*>(out), outSamp);
 }
 
+/*
+ * Multichannel float kernel for an even number of channels (4.0, 5.1, 7.1, 7.1.4).
+ *
+ * Four coefficients are loaded (and interpolated) at a time and then applied
+ * to four frames on each side, so each coefficient is read once per output frame
+ * for all channels. A frame is processed as four channel vectors plus a two channel
+ * tail. The mono volume volumeLR[0] is applied to all channels as in ProcessBase().
+ */
+template <int CHANNELS>
+static inline void ProcessSSEMultiAccumulate(__m128 (&acc)[(CHANNELS + 3) / 4],
+        const float* samples, __m128 coef)
+{
+    for (int b = 0; b < CHANNELS / 4; ++b) {
+        acc[b] = _mm_add_ps(acc[b], _mm_mul_ps(_mm_loadu_ps(samples + b * 4), coef));
+    }
+    if (CHANNELS & 2) {
+        const __m128 samp = _mm_castpd_ps(
+                _mm_load_sd(reinterpret_cast<const double*>(samples + CHANNELS - 2)));
+        acc[CHANNELS / 4] = _mm_add_ps(acc[CHANNELS / 4], _mm_mul_ps(samp, coef));
+    }
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static inline void ProcessSSEMultiIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS > 2 && (CHANNELS & 1) == 0, "CHANNELS must be even and > 2");
+    constexpr int kBlocks = (CHANNELS + 3) / 4;
+
+    __m128 interp;
+    if (!FIXED) {
+        interp = _mm_set1_ps(lerpP);
+    }
+
+    __m128 accP[kBlocks];
+    __m128 accN[kBlocks];
+    for (int b = 0; b < kBlocks; ++b) {
+        accP[b] = _mm_setzero_ps();
+        accN[b] = _mm_setzero_ps();
+    }
+
+    do {
+        __m128 posCoef = _mm_load_ps(coefsP);
+        __m128 negCoef = _mm_load_ps(coefsN);
+        coefsP += 4;
+        coefsN += 4;
+
+        if (!FIXED) { // interpolate
+            __m128 posCoef1 = _mm_load_ps(coefsP1);
+            __m128 negCoef1 = _mm_load_ps(coefsN1);
+            coefsP1 += 4;
+            coefsN1 += 4;
+
+            // posCoef = interp * (posCoef1 - posCoef) + posCoef
+            // negCoef = interp * (negCoef - negCoef1) + negCoef1
+            posCoef1 = _mm_mul_ps(_mm_sub_ps(posCoef1, posCoef), interp);
+            negCoef = _mm_mul_ps(_mm_sub_ps(negCoef, negCoef1), interp);
+            posCoef = _mm_add_ps(posCoef1, posCoef);
+            negCoef = _mm_add_ps(negCoef, negCoef1);
+        }
+
+        // one frame per coefficient; sP decrements and sN increments by a frame.
+        ProcessSSEMultiAccumulate<CHANNELS>(accP, sP, _mm_shuffle_ps(posCoef, posCoef, 0x00));
+        ProcessSSEMultiAccumulate<CHANNELS>(accN, sN, _mm_shuffle_ps(negCoef, negCoef, 0x00));
+        ProcessSSEMultiAccumulate<CHANNELS>(accP, sP - CHANNELS,
+                _mm_shuffle_ps(posCoef, posCoef, 0x55));
+        ProcessSSEMultiAccumulate<CHANNELS>(accN, sN + CHANNELS,
+                _mm_shuffle_ps(negCoef, negCoef, 0x55));
+        ProcessSSEMultiAccumulate<CHANNELS>(accP, sP - 2 * CHANNELS,
+                _mm_shuffle_ps(posCoef, posCoef, 0xAA));
+        ProcessSSEMultiAccumulate<CHANNELS>(accN, sN + 2 * CHANNELS,
+                _mm_shuffle_ps(negCoef, negCoef, 0xAA));
+        ProcessSSEMultiAccumulate<CHANNELS>(accP, sP - 3 * CHANNELS,
+                _mm_shuffle_ps(posCoef, posCoef, 0xFF));
+        ProcessSSEMultiAccumulate<CHANNELS>(accN, sN + 3 * CHANNELS,
+                _mm_shuffle_ps(negCoef, negCoef, 0xFF));
+        sP -= 4 * CHANNELS;
+        sN += 4 * CHANNELS;
+    } while (count -= 4);
+
+    // multiply by volume and save
+    const __m128 vol = _mm_set1_ps(volumeLR[0]);
+    for (int b = 0; b < CHANNELS / 4; ++b) {
+        const __m128 acc = _mm_mul_ps(_mm_add_ps(accP[b], accN[b]), vol);
+        _mm_storeu_ps(out + b * 4, _mm_add_ps(_mm_loadu_ps(out + b * 4), acc));
+    }
+    if (CHANNELS & 2) {
+        float* const outTail = out + CHANNELS - 2;
+        const __m128 acc = _mm_mul_ps(
+                _mm_add_ps(accP[CHANNELS / 4], accN[CHANNELS / 4]), vol);
+        __m128 outSamp = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<__m64*>(outTail));
+        _mm_storel_pi(reinterpret_cast<__m64*>(outTail), _mm_add_ps(outSamp, acc));
+    }
+}
+
 template<>
 inline void ProcessL<1, 16>(float* const out,
         int count,
@@ -182,6 +285,13 @@ inline void ProcessL<1, 16>(float* const out,
         const float* sN,
         const float* const volumeLR)
 {
+#if USE_AVX2_DISPATCH
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<1, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+        return;
+    }
+#endif
     ProcessSSEIntrinsic<1, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
 }
@@ -195,6 +305,13 @@ inline void ProcessL<2, 16>(float* const out,
         const float* sN,
         const float* const volumeLR)
 {
+#if USE_AVX2_DISPATCH
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<2, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+        return;
+    }
+#endif
     ProcessSSEIntrinsic<2, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
 }
@@ -211,6 +328,13 @@ inline void Process<1, 16>(float* const out,
         float lerpP,
         const float* const volumeLR)
 {
+#if USE_AVX2_DISPATCH
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<1, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        return;
+    }
+#endif
     ProcessSSEIntrinsic<1, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             lerpP, coefsP1, coefsN1);
 }
@@ -227,10 +351,68 @@ inline void Process<2, 16>(float* const out,
         float lerpP,
         const float* const volumeLR)
 {
+#if USE_AVX2_DISPATCH
+    if (isAvx2FmaSupported()) {
+        ProcessAVX2Intrinsic<2, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        return;
+    }
+#endif
     ProcessSSEIntrinsic<2, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             lerpP, coefsP1, coefsN1);
 }
 
+// Multichannel specializations.
+#pragma push_macro("PROCESS_SSE_MULTI")
+#undef PROCESS_SSE_MULTI
+#if USE_AVX2_DISPATCH
+#define PROCESS_SSE_MULTI_KERNEL(CHANNELS, FIXED, ...) \
+    if (isAvx2FmaSupported()) { \
+        ProcessAVX2MultiIntrinsic<CHANNELS, 16, FIXED>(__VA_ARGS__); \
+    } else { \
+        ProcessSSEMultiIntrinsic<CHANNELS, 16, FIXED>(__VA_ARGS__); \
+    }
+#else
+#define PROCESS_SSE_MULTI_KERNEL(CHANNELS, FIXED, ...) \
+    ProcessSSEMultiIntrinsic<CHANNELS, 16, FIXED>(__VA_ARGS__);
+#endif
+#define PROCESS_SSE_MULTI(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    PROCESS_SSE_MULTI_KERNEL(CHANNELS, true, out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/) \
+} \
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    PROCESS_SSE_MULTI_KERNEL(CHANNELS, false, out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            lerpP, coefsP1, coefsN1) \
+}
+
+PROCESS_SSE_MULTI(4)
+PROCESS_SSE_MULTI(6)
+PROCESS_SSE_MULTI(8)
+PROCESS_SSE_MULTI(12)
+
+#undef PROCESS_SSE_MULTI_KERNEL
+#pragma pop_macro("PROCESS_SSE_MULTI")
+
 #endif //USE_SSE
 
 } // namespace android
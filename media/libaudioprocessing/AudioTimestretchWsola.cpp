@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioTimestretchWsola"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include <audio_utils/primitives.h>
+#include <utils/Log.h>
+
+#include "AudioTimestretchWsola.h"
+
+namespace android {
+
+// The synthesis hop (and crossfade) is 10 ms. The search range of +/- 7.5 ms
+// covers a pitch period down to about 67 Hz. The coarse search runs at about 8 kHz.
+static constexpr uint32_t kHopsPerSecond = 100;
+static constexpr uint32_t kCoarseSampleRate = 8000;
+
+// Dot product with independent partial sums, so the loop vectorizes
+// without requiring reassociation of floating point adds.
+static inline float dotProduct(const float* a, const float* b, size_t count) {
+    float acc0 = 0.f, acc1 = 0.f, acc2 = 0.f, acc3 = 0.f;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+        acc2 += a[i + 2] * b[i + 2];
+        acc3 += a[i + 3] * b[i + 3];
+    }
+    float sum = (acc0 + acc1) + (acc2 + acc3);
+    for (; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Normalized correlation, without the (constant) energy of the reference.
+static inline float similarity(float correlation, float energy) {
+    return correlation / sqrtf(std::max(energy, 0.f) + 1e-9f);
+}
+
+static inline void copyIn(float* dst, const float* src, size_t count) {
+    memcpy(dst, src, count * sizeof(*dst));
+}
+
+static inline void copyIn(float* dst, const int16_t* src, size_t count) {
+    memcpy_to_float_from_i16(dst, src, count);
+}
+
+static inline void copyOut(float* dst, const float* src, size_t count) {
+    memcpy(dst, src, count * sizeof(*dst));
+}
+
+static inline void copyOut(int16_t* dst, const float* src, size_t count) {
+    memcpy_to_i16_from_float(dst, src, count);
+}
+
+AudioTimestretchWsola::AudioTimestretchWsola(
+        uint32_t channelCount, uint32_t sampleRate, size_t frameCount)
+    : mChannelCount(channelCount)
+    , mHop(std::max(sampleRate / kHopsPerSecond, 16u))
+    , mSearch(mHop * 3 / 4)
+    , mDecimation(std::max(sampleRate / kCoarseSampleRate, 1u))
+    , mInputCapacity(2 * mSearch + 2 * mHop + 1 + frameCount)
+    , mAnalysisHop(mHop)
+    , mInput(mInputCapacity * channelCount)
+    , mTail(mHop * channelCount)
+    , mOutput(mHop * channelCount)
+    , mWindow(mHop)
+    , mMonoTail(mHop)
+    , mMonoInput(2 * mSearch + mHop)
+    , mCoarseTail(mHop / mDecimation)
+    , mCoarseInput((2 * mSearch + mHop) / mDecimation)
+{
+    ALOGV("AudioTimestretchWsola(%p)(%u, %u, %zu) hop:%zu search:%zu decimation:%zu",
+            this, channelCount, sampleRate, frameCount, mHop, mSearch, mDecimation);
+    for (size_t i = 0; i < mHop; ++i) {
+        mWindow[i] = 0.5f - 0.5f * cosf(M_PI * (i + 0.5f) / mHop);
+    }
+    reset();
+}
+
+void AudioTimestretchWsola::setSpeed(float speed)
+{
+    mAnalysisHop = mHop * (double)speed;
+}
+
+void AudioTimestretchWsola::reset()
+{
+    // The search region of the first steps may extend before the first source frame,
+    // so start with mSearch frames of silence before the nominal position.
+    std::fill(mInput.begin(), mInput.begin() + mSearch * mChannelCount, 0.f);
+    mInputBegin = 0;
+    mInputEnd = mSearch;
+    mInputPosition = mSearch;
+    mSkipFrames = 0;
+    mOutputOffset = 0;
+    mOutputFrames = 0;
+    mFirst = true;
+}
+
+template <typename T>
+void AudioTimestretchWsola::process(T* dst, size_t* dstFrames, const T* src, size_t* srcFrames)
+{
+    const size_t dstDesired = *dstFrames;
+    const size_t srcAvailable = *srcFrames;
+    size_t written = 0;
+    size_t consumed = 0;
+
+    for (;;) {
+        if (mOutputFrames > 0) {
+            const size_t frames = std::min(mOutputFrames, dstDesired - written);
+            copyOut(dst + written * mChannelCount,
+                    &mOutput[mOutputOffset * mChannelCount], frames * mChannelCount);
+            written += frames;
+            mOutputOffset += frames;
+            mOutputFrames -= frames;
+        }
+        if (written == dstDesired) {
+            break;
+        }
+        if (canStep()) {
+            step();
+            continue;
+        }
+
+        // need more source data.
+        const size_t skip = std::min(mSkipFrames, srcAvailable - consumed);
+        mSkipFrames -= skip;
+        consumed += skip;
+        if (consumed == srcAvailable) {
+            break;
+        }
+        if (mInputBegin > 0) {
+            memmove(&mInput[0], &mInput[mInputBegin * mChannelCount],
+                    (mInputEnd - mInputBegin) * mChannelCount * sizeof(float));
+            mInputEnd -= mInputBegin;
+            mInputBegin = 0;
+        }
+        const size_t frames = std::min(mInputCapacity - mInputEnd, srcAvailable - consumed);
+        LOG_ALWAYS_FATAL_IF(frames == 0, "input buffer full without enough data for a step");
+        copyIn(&mInput[mInputEnd * mChannelCount], src + consumed * mChannelCount,
+                frames * mChannelCount);
+        mInputEnd += frames;
+        consumed += frames;
+    }
+    *dstFrames = written;
+    *srcFrames = consumed;
+}
+
+bool AudioTimestretchWsola::canStep() const
+{
+    // the segment chosen may start up to mSearch frames after the nominal position,
+    // and we need the segment and its continuation.
+    return mInputEnd - mInputBegin >= (size_t)lround(mInputPosition) + mSearch + 2 * mHop;
+}
+
+void AudioTimestretchWsola::step()
+{
+    const size_t position = (size_t)lround(mInputPosition);
+    const size_t start = mFirst ? position : position - mSearch + findBestOffset();
+    const float* const segment = &mInput[(mInputBegin + start) * mChannelCount];
+    const size_t samples = mHop * mChannelCount;
+
+    if (mFirst) {
+        memcpy(&mOutput[0], segment, samples * sizeof(float));
+        mFirst = false;
+    } else {
+        // crossfade from the continuation of the previous segment to the new segment.
+        for (size_t i = 0; i < mHop; ++i) {
+            const float gain = mWindow[i];
+            for (size_t j = i * mChannelCount; j < (i + 1) * mChannelCount; ++j) {
+                mOutput[j] = mTail[j] + (segment[j] - mTail[j]) * gain;
+            }
+        }
+    }
+    mOutputOffset = 0;
+    mOutputFrames = mHop;
+
+    // save the continuation of the new segment for the next step.
+    memcpy(&mTail[0], segment + samples, samples * sizeof(float));
+    for (size_t i = 0; i < mHop; ++i) {
+        float sum = 0.f;
+        for (size_t j = 0; j < mChannelCount; ++j) {
+            sum += mTail[i * mChannelCount + j];
+        }
+        mMonoTail[i] = sum;
+    }
+    for (size_t i = 0; i < mCoarseTail.size(); ++i) {
+        mCoarseTail[i] = std::accumulate(mMonoTail.data() + i * mDecimation,
+                mMonoTail.data() + (i + 1) * mDecimation, 0.f);
+    }
+
+    mInputPosition += mAnalysisHop;
+    discardInput();
+}
+
+size_t AudioTimestretchWsola::findBestOffset()
+{
+    // the search region starts mSearch frames before the nominal position.
+    const size_t regionStart = mInputBegin + (size_t)lround(mInputPosition) - mSearch;
+    const float* const region = &mInput[regionStart * mChannelCount];
+    for (size_t i = 0; i < mMonoInput.size(); ++i) {
+        float sum = 0.f;
+        for (size_t j = 0; j < mChannelCount; ++j) {
+            sum += region[i * mChannelCount + j];
+        }
+        mMonoInput[i] = sum;
+    }
+    for (size_t i = 0; i < mCoarseInput.size(); ++i) {
+        mCoarseInput[i] = std::accumulate(mMonoInput.data() + i * mDecimation,
+                mMonoInput.data() + (i + 1) * mDecimation, 0.f);
+    }
+
+    // coarse search over the decimated signal, with a running energy.
+    // Prefer the nominal position if nothing is more similar (e.g. silence).
+    const size_t coarseLength = mCoarseTail.size();
+    const size_t coarseOffsets = 2 * mSearch / mDecimation + 1;
+    const size_t nominal = mSearch / mDecimation;
+    float energy = dotProduct(&mCoarseInput[0], &mCoarseInput[0], coarseLength);
+    size_t best = nominal;
+    float bestSimilarity = -INFINITY;
+    for (size_t i = 0; i < coarseOffsets; ++i) {
+        if (i > 0) {
+            const float in = mCoarseInput[i + coarseLength - 1];
+            const float out = mCoarseInput[i - 1];
+            energy += in * in - out * out;
+        }
+        const float s = similarity(
+                dotProduct(&mCoarseTail[0], &mCoarseInput[i], coarseLength), energy);
+        if (s > bestSimilarity || (s == bestSimilarity && i == nominal)) {
+            bestSimilarity = s;
+            best = i;
+        }
+    }
+    if (mDecimation == 1) {
+        return best;
+    }
+
+    // refine at the full rate around the coarse result.
+    const size_t center = best * mDecimation;
+    const size_t first = center > mDecimation ? center - mDecimation : 0;
+    const size_t last = std::min(center + mDecimation, 2 * mSearch);
+    best = center;
+    bestSimilarity = -INFINITY;
+    energy = dotProduct(&mMonoInput[first], &mMonoInput[first], mHop);
+    for (size_t i = first; i <= last; ++i) {
+        if (i > first) {
+            const float in = mMonoInput[i + mHop - 1];
+            const float out = mMonoInput[i - 1];
+            energy += in * in - out * out;
+        }
+        const float s = similarity(dotProduct(&mMonoTail[0], &mMonoInput[i], mHop), energy);
+        if (s > bestSimilarity || (s == bestSimilarity && i == center)) {
+            bestSimilarity = s;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void AudioTimestretchWsola::discardInput()
+{
+    // keep mSearch frames before the nominal position for the next search.
+    const double position = floor(mInputPosition);
+    if (position <= mSearch) {
+        return;
+    }
+    const size_t discard = (size_t)position - mSearch;
+    const size_t available = mInputEnd - mInputBegin;
+    if (discard >= available) {
+        mSkipFrames += discard - available;
+        mInputBegin = 0;
+        mInputEnd = 0;
+    } else {
+        mInputBegin += discard;
+    }
+    mInputPosition -= discard;
+}
+
+template void AudioTimestretchWsola::process(
+        float* dst, size_t* dstFrames, const float* src, size_t* srcFrames);
+template void AudioTimestretchWsola::process(
+        int16_t* dst, size_t* dstFrames, const int16_t* src, size_t* srcFrames);
+
+} // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TIMESTRETCH_WSOLA_H
+#define ANDROID_AUDIO_TIMESTRETCH_WSOLA_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+namespace android {
+
+/* AudioTimestretchWsola
+ *
+ * Waveform similarity overlap-add (WSOLA) time stretcher for interleaved PCM.
+ *
+ * Each step takes a segment of the input near its nominal analysis position, chosen
+ * to best match the continuation of the previous segment, and crossfades it with
+ * that continuation to produce a hop of output. The nominal analysis position
+ * advances by the hop times the speed, so the output duration is the input
+ * duration divided by the speed. The pitch is unchanged.
+ *
+ * All buffers are allocated on construction. process() and setSpeed()
+ * never allocate and are safe to call on a real-time thread.
+ *
+ * Processing is done in float; int16_t data is converted on input and output.
+ */
+class AudioTimestretchWsola {
+public:
+    // frameCount is the number of source frames buffered in addition to the
+    // analysis window; larger values reduce the number of calls needed to consume
+    // large source buffers. The memory used is fixed by the constructor arguments.
+    AudioTimestretchWsola(uint32_t channelCount, uint32_t sampleRate, size_t frameCount);
+
+    AudioTimestretchWsola(const AudioTimestretchWsola&) = delete;
+    AudioTimestretchWsola& operator=(const AudioTimestretchWsola&) = delete;
+
+    void setSpeed(float speed);
+
+    // discards all buffered input and output.
+    void reset();
+
+    // processes frames, see TimestretchBufferProvider::processFrames().
+    // dst is where to place the data
+    // dstFrames [in/out] is the desired frames (return with actual placed in dst)
+    // src is the source data
+    // srcFrames [in/out] is the available source frames (return with consumed)
+    // T is float or int16_t.
+    template <typename T>
+    void process(T* dst, size_t* dstFrames, const T* src, size_t* srcFrames);
+
+    size_t getHopFrameCount() const { return mHop; }
+
+private:
+    bool canStep() const;
+    void step();                // produces mHop frames into mOutput
+    size_t findBestOffset();    // returns the offset from the start of the search region
+    void discardInput();
+
+    const uint32_t      mChannelCount;
+    const size_t        mHop;           // synthesis hop and crossfade length in frames
+    const size_t        mSearch;        // maximum offset searched around the nominal position
+    const size_t        mDecimation;    // decimation of the coarse correlation search
+    const size_t        mInputCapacity; // in frames
+
+    double              mAnalysisHop;   // mHop * speed
+    bool                mFirst;         // no previous segment to crossfade with
+
+    std::vector<float>  mInput;         // buffered source frames
+    size_t              mInputBegin;    // first valid frame in mInput
+    size_t              mInputEnd;      // one past the last valid frame in mInput
+    double              mInputPosition; // nominal analysis position relative to mInputBegin
+    size_t              mSkipFrames;    // source frames to skip before the next input
+
+    std::vector<float>  mTail;          // continuation of the previous segment, mHop frames
+    std::vector<float>  mOutput;        // output of the last step, mHop frames
+    size_t              mOutputOffset;  // first unread frame in mOutput
+    size_t              mOutputFrames;  // unread frames in mOutput
+
+    std::vector<float>  mWindow;        // crossfade fade-in gains, mHop entries
+    std::vector<float>  mMonoTail;      // channel sum of mTail
+    std::vector<float>  mMonoInput;     // channel sum of the search region
+    std::vector<float>  mCoarseTail;    // decimated mMonoTail
+    std::vector<float>  mCoarseInput;   // decimated mMonoInput
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_TIMESTRETCH_WSOLA_H
@@ -31,6 +31,8 @@
 #include <system/audio_effects/effect_downmix.h>
 #include <utils/Log.h>
 
+#include "AudioTimestretchWsola.h"
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
 #endif
@@ -424,8 +426,69 @@ void ClampFloatBufferProvider::copyFrames(void *dst, const void *src, size_t fra
                                              FLOAT_NOMINAL_RANGE_HEADROOM);
 }
 
+// Frames converted by each stage of a ChainedCopyBufferProvider at a time.
+// Both halves of the scratch buffer for 8 channels of float fit in 16 KB.
+static constexpr size_t kChainedBlockFrameCount = 256;
+
+static size_t maxStageFrameSize(const std::vector<CopyBufferProvider*> &stages)
+{
+    size_t frameSize = 0;
+    for (const CopyBufferProvider *stage : stages) {
+        frameSize = std::max({frameSize, stage->getInputFrameSize(), stage->getOutputFrameSize()});
+    }
+    return frameSize;
+}
+
+ChainedCopyBufferProvider::ChainedCopyBufferProvider(
+        const std::vector<CopyBufferProvider*> &stages, size_t bufferFrameCount) :
+        CopyBufferProvider(
+                stages.front()->getInputFrameSize(),
+                stages.back()->getOutputFrameSize(),
+                bufferFrameCount),
+        mStages(stages),
+        mBlockFrameCount(std::min(kChainedBlockFrameCount, bufferFrameCount)),
+        mScratchSize(mBlockFrameCount * maxStageFrameSize(stages)),
+        mScratch(new uint8_t[2 * mScratchSize])
+{
+    ALOGV("ChainedCopyBufferProvider(%p)(%zu stages, %zu)",
+            this, stages.size(), bufferFrameCount);
+    LOG_ALWAYS_FATAL_IF(bufferFrameCount == 0, "Requires local buffer");
+}
+
+status_t ChainedCopyBufferProvider::getNextBuffer(AudioBufferProvider::Buffer *pBuffer)
+{
+    pBuffer->frameCount = limitFrameCount(pBuffer->frameCount);
+    return CopyBufferProvider::getNextBuffer(pBuffer);
+}
+
+size_t ChainedCopyBufferProvider::limitFrameCount(size_t frameCount) const
+{
+    for (const CopyBufferProvider *stage : mStages) {
+        frameCount = stage->limitFrameCount(frameCount);
+    }
+    return frameCount;
+}
+
+void ChainedCopyBufferProvider::copyFrames(void *dst, const void *src, size_t frames)
+{
+    const size_t lastStage = mStages.size() - 1;
+    for (size_t offset = 0; offset < frames; offset += mBlockFrameCount) {
+        const size_t count = std::min(mBlockFrameCount, frames - offset);
+        const void *in = (const uint8_t*)src + offset * mInputFrameSize;
+        for (size_t i = 0; i < lastStage; ++i) {
+            // alternate between the halves of the scratch buffer.
+            void *out = mScratch.get() + (i & 1) * mScratchSize;
+            mStages[i]->copyFrames(out, in, count);
+            in = out;
+        }
+        mStages[lastStage]->copyFrames(
+                (uint8_t*)dst + offset * mOutputFrameSize, in, count);
+    }
+}
+
 TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
-        audio_format_t format, uint32_t sampleRate, const AudioPlaybackRate &playbackRate) :
+        audio_format_t format, uint32_t sampleRate, const AudioPlaybackRate &playbackRate,
+        size_t bufferFrameCount) :
         mChannelCount(channelCount),
         mFormat(format),
         mSampleRate(sampleRate),
@@ -433,24 +496,37 @@ TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         mLocalBufferFrameCount(0),
         mLocalBufferData(NULL),
         mRemaining(0),
-        mSonicStream(sonicCreateStream(sampleRate, mChannelCount)),
+        mPreallocated(bufferFrameCount != 0),
+        mSonicStream(mPreallocated ? NULL : sonicCreateStream(sampleRate, mChannelCount)),
         mFallbackFailErrorShown(false),
         mAudioPlaybackRateValid(false)
 {
-    LOG_ALWAYS_FATAL_IF(mSonicStream == NULL,
-            "TimestretchBufferProvider can't allocate Sonic stream");
+    if (mPreallocated) {
+        (void)posix_memalign(&mLocalBufferData, 32, bufferFrameCount * mFrameSize);
+        LOG_ALWAYS_FATAL_IF(mLocalBufferData == NULL,
+                "TimestretchBufferProvider can't allocate local buffer");
+        mLocalBufferFrameCount = bufferFrameCount;
+        mWsola = std::make_unique<AudioTimestretchWsola>(
+                mChannelCount, sampleRate, bufferFrameCount);
+    } else {
+        LOG_ALWAYS_FATAL_IF(mSonicStream == NULL,
+                "TimestretchBufferProvider can't allocate Sonic stream");
+    }
 
     setPlaybackRate(playbackRate);
-    ALOGV("TimestretchBufferProvider(%p)(%u, %#x, %u %f %f %d %d)",
+    ALOGV("TimestretchBufferProvider(%p)(%u, %#x, %u %f %f %d %d %zu)",
             this, channelCount, format, sampleRate, playbackRate.mSpeed,
-            playbackRate.mPitch, playbackRate.mStretchMode, playbackRate.mFallbackMode);
+            playbackRate.mPitch, playbackRate.mStretchMode, playbackRate.mFallbackMode,
+            bufferFrameCount);
     mBuffer.frameCount = 0;
 }
 
 TimestretchBufferProvider::~TimestretchBufferProvider()
 {
     ALOGV("~TimestretchBufferProvider(%p)", this);
-    sonicDestroyStream(mSonicStream);
+    if (mSonicStream != NULL) {
+        sonicDestroyStream(mSonicStream);
+    }
     if (mBuffer.frameCount != 0) {
         mTrackBufferProvider->releaseBuffer(&mBuffer);
     }
@@ -466,6 +542,11 @@ status_t TimestretchBufferProvider::getNextBuffer(
     // BYPASS
     //return mTrackBufferProvider->getNextBuffer(pBuffer);
 
+    // a preallocated local buffer is never resized, return at most its size.
+    if (mPreallocated && pBuffer->frameCount > mLocalBufferFrameCount) {
+        pBuffer->frameCount = mLocalBufferFrameCount;
+    }
+
     // check if previously processed data is sufficient.
     if (pBuffer->frameCount <= mRemaining) {
         ALOGV("previous sufficient");
@@ -557,6 +638,10 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
 void TimestretchBufferProvider::reset()
 {
     mRemaining = 0;
+    if (mWsola != nullptr) {
+        // discard the input buffered before the reset, which would otherwise be output after it
+        mWsola->reset();
+    }
 }
 
 void TimestretchBufferProvider::setBufferProvider(AudioBufferProvider *p) {
@@ -573,7 +658,11 @@ status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &pla
 {
     mPlaybackRate = playbackRate;
     mFallbackFailErrorShown = false;
-    sonicSetSpeed(mSonicStream, mPlaybackRate.mSpeed);
+    if (mWsola != nullptr) {
+        mWsola->setSpeed(mPlaybackRate.mSpeed);
+    } else {
+        sonicSetSpeed(mSonicStream, mPlaybackRate.mSpeed);
+    }
     //TODO: pitch is ignored for now
     //TODO: optimize: if parameters are the same, don't do any extra computation.
 
@@ -628,6 +717,17 @@ void TimestretchBufferProvider::processFrames(void *dstBuffer, size_t *dstFrames
                 break;
             }
         }
+    } else if (mWsola != nullptr) {
+        switch (mFormat) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            mWsola->process((float*)dstBuffer, dstFrames, (const float*)srcBuffer, srcFrames);
+            break;
+        case AUDIO_FORMAT_PCM_16_BIT:
+            mWsola->process((int16_t*)dstBuffer, dstFrames, (const int16_t*)srcBuffer, srcFrames);
+            break;
+        default:
+            LOG_ALWAYS_FATAL("invalid format %#x for TimestretchBufferProvider", mFormat);
+        }
     } else {
         switch (mFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
@@ -684,16 +784,22 @@ AdjustChannelsBufferProvider::AdjustChannelsBufferProvider(
 }
 
 status_t AdjustChannelsBufferProvider::getNextBuffer(AudioBufferProvider::Buffer* pBuffer)
+{
+    pBuffer->frameCount = limitFrameCount(pBuffer->frameCount);
+    return CopyBufferProvider::getNextBuffer(pBuffer);
+}
+
+size_t AdjustChannelsBufferProvider::limitFrameCount(size_t frameCount) const
 {
     if (mContractedBuffer != nullptr) {
         // Restrict frame count only when it is needed to save contracted frames.
         const size_t outFramesLeft = mFrameCount - mContractedWrittenFrames;
-        if (outFramesLeft < pBuffer->frameCount) {
+        if (outFramesLeft < frameCount) {
             // Restrict the frame count so that we don't write over the size of the output buffer.
-            pBuffer->frameCount = outFramesLeft;
+            return outFramesLeft;
         }
     }
-    return CopyBufferProvider::getNextBuffer(pBuffer);
+    return frameCount;
 }
 
 void AdjustChannelsBufferProvider::copyFrames(void *dst, const void *src, size_t frames)
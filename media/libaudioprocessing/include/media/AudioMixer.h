@@ -77,6 +77,7 @@ private:
             // Ensure the order of destruction of buffer providers as they
             // release the upstream provider in the destructor.
             mTimestretchBufferProvider.reset(nullptr);
+            mChainedBufferProvider.reset(nullptr);
             mPostDownmixReformatBufferProvider.reset(nullptr);
             mDownmixerBufferProvider.reset(nullptr);
             mReformatBufferProvider.reset(nullptr);
@@ -120,6 +121,9 @@ private:
          * 5) mPostDownmixReformatBufferProvider: If not NULL, performs reformatting from
          *    the downmixer requirements to the mixer engine input requirements.
          * 6) mTimestretchBufferProvider: Adds timestretching for playback rate
+         *
+         * If more than one of 2) to 5) is needed, mChainedBufferProvider runs their
+         * conversions in a single pass and 6) fetches from it instead.
          */
         AudioBufferProvider* mInputBufferProvider;    // externally provided buffer provider.
         std::unique_ptr<PassthruBufferProvider> mAdjustChannelsBufferProvider;
@@ -127,6 +131,7 @@ private:
         std::unique_ptr<PassthruBufferProvider> mDownmixerBufferProvider;
         std::unique_ptr<PassthruBufferProvider> mPostDownmixReformatBufferProvider;
         std::unique_ptr<PassthruBufferProvider> mTimestretchBufferProvider;
+        std::unique_ptr<PassthruBufferProvider> mChainedBufferProvider;
 
         audio_format_t mDownmixRequiresFormat;  // required downmixer format
                                                 // AUDIO_FORMAT_PCM_16_BIT if 16 bit necessary
@@ -18,6 +18,7 @@
 #ifndef ANDROID_AUDIO_MIXER_BASE_H
 #define ANDROID_AUDIO_MIXER_BASE_H
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -87,12 +88,9 @@ public:
         AUXLEVEL        = 0x4210,
     };
 
-    AudioMixerBase(size_t frameCount, uint32_t sampleRate)
-        : mSampleRate(sampleRate)
-        , mFrameCount(frameCount) {
-    }
+    AudioMixerBase(size_t frameCount, uint32_t sampleRate);
 
-    virtual ~AudioMixerBase() {}
+    virtual ~AudioMixerBase();
 
     virtual bool isValidFormat(audio_format_t format) const;
     virtual bool isValidChannelMask(audio_channel_mask_t channelMask) const;
@@ -127,7 +125,17 @@ public:
 
     void        process() {
         preProcess();
-        (this->*mHook)();
+        const process_hook_t hook = mHook;
+        mSkippedTracks = 0;
+        (this->*hook)();
+        // process__validate() calls process() again with the hook it selected.
+        if (hook != &AudioMixerBase::process__validate) {
+            mLastSkippedTracks.store(mSkippedTracks, std::memory_order_relaxed);
+            mTotalSkippedTracks.store(mTotalSkippedTracks.load(std::memory_order_relaxed)
+                    + mSkippedTracks, std::memory_order_relaxed);
+            mProcessCount.store(mProcessCount.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+        }
         postProcess();
     }
 
@@ -135,6 +143,45 @@ public:
 
     std::string trackNames() const;
 
+    // Set the number of threads used to mix tracks, including the thread calling process().
+    // When greater than 1, threadCount - 1 worker threads are created, and the tracks are
+    // mixed in parallel once at least kMinParallelTracks tracks are enabled.
+    // The output is bit-identical to mixing on a single thread.
+    // 0 or 1 (the default) mixes all tracks on the thread calling process().
+    // The thread count is limited to kMaxThreadCount.
+    void        setThreadCount(size_t threadCount);
+
+    size_t      getThreadCount() const;
+
+    static constexpr size_t kMinParallelTracks = 4;
+    static constexpr size_t kMaxThreadCount = 8;
+
+    // Enable or disable skipping tracks which supply only silence (enabled by default).
+    // A track buffer of zero samples is not mixed unless the track is ramping volume,
+    // which leaves the output unchanged. The resampler of a resampling track consumes
+    // the input itself, to keep its phase and filter state, but does not filter it
+    // while the filter holds only silence (see AudioResampler::setSkipSilence()).
+    void        setSkipSilence(bool skipSilence) {
+        mSkipSilence = skipSilence;
+        invalidate();
+    }
+
+    struct SilenceStats {
+        uint64_t periods;            // process() calls
+        uint64_t skippedTracks;      // tracks skipped over all periods
+        uint32_t lastSkippedTracks;  // tracks skipped in the last period
+    };
+
+    // Statistics of the tracks skipped for silence, may be called from any thread.
+    // A track is counted as skipped in a period if none of its frames were mixed.
+    SilenceStats getSilenceStats() const {
+        return {
+            mProcessCount.load(std::memory_order_relaxed),
+            mTotalSkippedTracks.load(std::memory_order_relaxed),
+            mLastSkippedTracks.load(std::memory_order_relaxed),
+        };
+    }
+
   protected:
     // Set kUseNewMixer to true to use the new mixer engine always. Otherwise the
     // original code will be used for stereo sinks, the new mixer for everything else.
@@ -217,7 +264,9 @@ public:
         virtual uint32_t getOutputChannelCount() { return channelCount; }
         virtual uint32_t getMixerChannelCount() { return mMixerChannelCount; }
 
-        bool        needsRamp() { return (volumeInc[0] | volumeInc[1] | auxInc) != 0; }
+        bool        needsRamp() const { return (volumeInc[0] | volumeInc[1] | auxInc) != 0; }
+        // true if the mix of the current input buffer may be skipped, see setSkipSilence().
+        bool        canSkipInput() const { return mInSilent && !needsRamp(); }
         bool        setResampler(uint32_t trackSampleRate, uint32_t devSampleRate);
         bool        doesResample() const { return mResampler.get() != nullptr; }
         void        recreateResampler(uint32_t devSampleRate);
@@ -290,6 +339,10 @@ public:
         audio_channel_mask_t mMixerChannelMask;
         uint32_t             mMixerChannelCount;
 
+        size_t         mInFrameSize;    // input frame size of the non-resampling hooks
+        bool           mInSilent;       // the current input buffer holds only silence
+        size_t         mSkippedFrames;  // frames skipped for silence in this process()
+
       protected:
 
         // hooks
@@ -331,6 +384,7 @@ public:
     void process__nop();
     void process__genericNoResampling();
     void process__genericResampling();
+    void process__parallel();
     void process__oneTrack16BitsStereoNoResampling();
 
     template <int MIXTYPE, typename TO, typename TI, typename TA>
@@ -363,6 +417,31 @@ public:
 
     // track smart pointers, by name, in increasing order of name.
     std::map<int /* name */, std::shared_ptr<TrackBase>> mTracks;
+
+  private:
+    class WorkerPool;
+
+    // Sets t->mInSilent for the buffer just acquired from the track buffer provider.
+    void detectSilence(TrackBase *t) const;
+
+    // Mixes the track into its own zeroed output buffer, for process__parallel().
+    void mixTrack(TrackBase *t, int32_t *out, int32_t *temp);
+
+    // Worker threads for process__parallel(), nullptr if mixing on a single thread.
+    std::unique_ptr<WorkerPool> mWorkerPool;
+
+    // Enabled tracks in process order (by main buffer group, then name), each with the
+    // output buffer for its contribution, for process__parallel().
+    std::vector<TrackBase *> mParallelTracks;
+    std::vector<std::unique_ptr<int32_t[]>> mParallelOutputs;
+
+    bool mSkipSilence = true;
+    size_t mSkippedTracks = 0;  // tracks skipped in the current process()
+
+    // published by process() for getSilenceStats().
+    std::atomic<uint32_t> mLastSkippedTracks{0};
+    std::atomic<uint64_t> mTotalSkippedTracks{0};
+    std::atomic<uint64_t> mProcessCount{0};
 };
 
 }  // namespace android
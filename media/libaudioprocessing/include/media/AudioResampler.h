@@ -54,12 +54,33 @@ public:
     static AudioResampler* create(audio_format_t format, int inChannelCount,
             int32_t sampleRate, src_quality quality=DEFAULT_QUALITY);
 
+    // Statistics of the process-wide cache of filter banks shared by the
+    // DYN_LOW_QUALITY, DYN_MED_QUALITY and DYN_HIGH_QUALITY resamplers.
+    struct FilterCacheStats {
+        uint64_t hits;      // filter banks reused from the cache
+        uint64_t misses;    // filter banks designed
+        size_t filterBanks; // filter banks currently in use
+        size_t bytes;       // coefficient memory of the filter banks in use
+    };
+
+    static FilterCacheStats getFilterCacheStats();
+
     virtual ~AudioResampler();
 
     virtual void init() = 0;
     virtual void setSampleRate(int32_t inSampleRate);
     virtual void setVolume(float left, float right);
 
+    // Ramps the volume set by setVolume() by leftInc and rightInc after each output
+    // frame of the following resample() calls, until the next setVolume().
+    // This allows the caller to resample, apply a volume ramp and mix in a single pass.
+    //
+    // Returns false if the resampler does not support volume ramps,
+    // in which case the volume remains constant.
+    virtual bool setVolumeRamp(float /* leftInc */, float /* rightInc */) {
+        return false;
+    }
+
     // Resample int16_t samples from provider and accumulate into 'out'.
     // A mono provider delivers a sequence of samples.
     // A stereo provider delivers a sequence of interleaved pairs of samples.
@@ -80,6 +101,15 @@ public:
     virtual void reset();
     virtual size_t getUnreleasedFrames() const { return mInputIndex; }
 
+    // Enables skipping the filter while all the input frames it covers are silence.
+    // The input is still consumed and the phase advances, so the output is unchanged.
+    // Only the dynamic resampler skips, the others ignore this.
+    virtual void setSkipSilence(bool /* skipSilence */) {}
+
+    // Returns the number of output frames of the last resample() call for which
+    // the filter was skipped.
+    virtual size_t getSkippedFrames() const { return 0; }
+
     // called from destructor, so must not be virtual
     src_quality getQuality() const { return mQuality; }
 
@@ -20,6 +20,9 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <memory>
+#include <vector>
+
 #include <audio_utils/ChannelMix.h>
 #include <media/AudioBufferProvider.h>
 #include <media/AudioResamplerPublic.h>
@@ -33,6 +36,7 @@ typedef struct sonicStreamStruct *sonicStream;
 
 namespace android {
 
+class AudioTimestretchWsola;
 class EffectBufferHalInterface;
 class EffectHalInterface;
 class EffectsFactoryHalInterface;
@@ -87,6 +91,13 @@ public:
     // of the internal buffers.
     virtual void copyFrames(void *dst, const void *src, size_t frames) = 0;
 
+    // returns the number of frames, at most frameCount, that copyFrames() may
+    // convert next. Derived classes override this if their output is bounded.
+    virtual size_t limitFrameCount(size_t frameCount) const { return frameCount; }
+
+    size_t getInputFrameSize() const { return mInputFrameSize; }
+    size_t getOutputFrameSize() const { return mOutputFrameSize; }
+
 protected:
     const size_t         mInputFrameSize;
     const size_t         mOutputFrameSize;
@@ -191,12 +202,43 @@ protected:
     const uint32_t       mChannelCount;
 };
 
+// ChainedCopyBufferProvider derives from CopyBufferProvider to run a chain of
+// CopyBufferProvider stages in a single pass, instead of each stage fetching from
+// the previous stage into its own buffer.
+// The stages convert blocks of frames through a small scratch buffer, so the
+// intermediate data stays in cache, and only the last stage writes to the buffer
+// returned by getNextBuffer(). The stages are not owned, and their buffers
+// and upstream providers are not used. Only the first stage may write
+// more than frames * outputFrameSize bytes in copyFrames().
+class ChainedCopyBufferProvider : public CopyBufferProvider {
+public:
+    ChainedCopyBufferProvider(const std::vector<CopyBufferProvider*> &stages,
+            size_t bufferFrameCount);
+    //Overrides
+    void copyFrames(void *dst, const void *src, size_t frames) override;
+    size_t limitFrameCount(size_t frameCount) const override;
+    status_t getNextBuffer(Buffer *buffer) override;
+
+protected:
+    const std::vector<CopyBufferProvider*> mStages;
+    const size_t         mBlockFrameCount;  // frames converted by each stage at a time
+    const size_t         mScratchSize;      // bytes in each half of the scratch buffer
+    std::unique_ptr<uint8_t[]> mScratch;    // two halves, for stage output and input
+};
+
 // TimestretchBufferProvider derives from PassthruBufferProvider for time stretching
+//
+// By default it uses Sonic, which may allocate memory while processing.
+// If bufferFrameCount is not zero, the provider preallocates its buffers and
+// uses a WSOLA time stretcher with memory fixed on construction instead, so
+// getNextBuffer() never allocates. getNextBuffer() then returns at most
+// bufferFrameCount frames.
 class TimestretchBufferProvider : public PassthruBufferProvider {
 public:
     TimestretchBufferProvider(int32_t channelCount,
             audio_format_t format, uint32_t sampleRate,
-            const AudioPlaybackRate &playbackRate);
+            const AudioPlaybackRate &playbackRate,
+            size_t bufferFrameCount = 0);
     virtual ~TimestretchBufferProvider();
 
     // Overrides AudioBufferProvider methods
@@ -230,8 +272,10 @@ private:
     void                *mLocalBufferData;        // internally allocated buffer for data returned
                                                   // to caller
     size_t               mRemaining;              // remaining data in local buffer
+    const bool           mPreallocated;           // local buffer is never resized
     sonicStream          mSonicStream;            // handle to sonic timestretch object
     //FIXME: this dependency should be abstracted out
+    std::unique_ptr<AudioTimestretchWsola> mWsola; // used instead of sonic if preallocated
     bool                 mFallbackFailErrorShown; // log fallback error only once
     bool                 mAudioPlaybackRateValid; // flag for current parameters validity
 };
@@ -260,6 +304,7 @@ public:
     //Overrides
     status_t getNextBuffer(Buffer* pBuffer) override;
     void copyFrames(void *dst, const void *src, size_t frames) override;
+    size_t limitFrameCount(size_t frameCount) const override;
     void reset() override;
 
     void clearContractedFrames() { mContractedWrittenFrames = 0; }
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <benchmark/benchmark.h>
+#include <media/AudioBufferProvider.h>
+#include <media/BufferProviders.h>
+
+using namespace android;
+
+// Benchmarks the track conversion chains built by AudioMixer, pulling a mixer
+// period through either the individual CopyBufferProviders linked together,
+// or a ChainedCopyBufferProvider running the same stages in a single pass.
+//
+// Reported counters:
+// buffer_bytes: bytes per frame read from and written to provider buffers.
+// scratch_bytes: bytes per frame passed between stages through the
+//                (cache resident) scratch buffer of the chained provider.
+// time_per_frame: time to convert one frame.
+
+static constexpr size_t kCopyBufferFrameCount = 256; // as used by AudioMixer
+static constexpr size_t kFrameCount = 960;           // 20 ms mix period
+
+// An endless provider of noise of any format and channel count.
+class LoopProvider : public AudioBufferProvider {
+public:
+    LoopProvider(audio_format_t format, uint32_t channelCount)
+        : mFrameSize(audio_bytes_per_frame(channelCount, format))
+        , mData(kLoopFrameCount * mFrameSize) {
+        std::vector<float> noise(kLoopFrameCount * channelCount);
+        srand48(42);
+        for (auto &sample : noise) {
+            sample = drand48() - 0.5;
+        }
+        memcpy_by_audio_format(mData.data(), format,
+                noise.data(), AUDIO_FORMAT_PCM_FLOAT, noise.size());
+    }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        const size_t available = kLoopFrameCount - mIndex;
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->raw = &mData[mIndex * mFrameSize];
+        return OK;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mIndex += buffer->frameCount;
+        if (mIndex >= kLoopFrameCount) {
+            mIndex = 0;
+        }
+        buffer->frameCount = 0;
+        buffer->raw = nullptr;
+    }
+
+private:
+    static constexpr size_t kLoopFrameCount = 4096;
+    const size_t mFrameSize;
+    std::vector<uint8_t> mData;
+    size_t mIndex = 0;
+};
+
+enum Chain {
+    CHAIN_51_INT16,      // 5.1 int16: reformat to float, then downmix to stereo
+    CHAIN_51_FLOAT,      // 5.1 float: clamp, then downmix to stereo
+    CHAIN_71_REMIX,      // 7.1 int16: remix to stereo, then reformat to float
+    CHAIN_HAPTIC_INT16,  // stereo + haptic int16: contract haptic, then reformat to float
+};
+
+struct ChainConfig {
+    audio_format_t inputFormat;
+    uint32_t inputChannelCount;
+    std::vector<std::unique_ptr<CopyBufferProvider>> stages;
+    bool valid = true;
+};
+
+static std::unique_ptr<CopyBufferProvider> createChannelMix(ChainConfig &config) {
+    auto channelMix = std::make_unique<ChannelMixBufferProvider>(AUDIO_CHANNEL_OUT_5POINT1,
+            AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_FLOAT, kCopyBufferFrameCount);
+    config.valid = config.valid && channelMix->isValid();
+    return channelMix;
+}
+
+static ChainConfig createChain(Chain chain) {
+    ChainConfig config;
+    switch (chain) {
+    case CHAIN_51_INT16:
+        config.inputFormat = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputChannelCount = 6;
+        config.stages.emplace_back(new ReformatBufferProvider(6,
+                AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT, kCopyBufferFrameCount));
+        config.stages.push_back(createChannelMix(config));
+        break;
+    case CHAIN_51_FLOAT:
+        config.inputFormat = AUDIO_FORMAT_PCM_FLOAT;
+        config.inputChannelCount = 6;
+        config.stages.emplace_back(new ClampFloatBufferProvider(6, kCopyBufferFrameCount));
+        config.stages.push_back(createChannelMix(config));
+        break;
+    case CHAIN_71_REMIX:
+        config.inputFormat = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputChannelCount = 8;
+        config.stages.emplace_back(new RemixBufferProvider(AUDIO_CHANNEL_OUT_7POINT1,
+                AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_16_BIT, kCopyBufferFrameCount));
+        config.stages.emplace_back(new ReformatBufferProvider(2,
+                AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT, kCopyBufferFrameCount));
+        break;
+    case CHAIN_HAPTIC_INT16:
+        config.inputFormat = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputChannelCount = 3;
+        config.stages.emplace_back(new AdjustChannelsBufferProvider(
+                AUDIO_FORMAT_PCM_16_BIT, 3, 2, kFrameCount));
+        config.stages.emplace_back(new ReformatBufferProvider(2,
+                AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT, kCopyBufferFrameCount));
+        break;
+    }
+    return config;
+}
+
+// Links the stages of the chain to the source, returns the last provider.
+static AudioBufferProvider* linkChain(ChainConfig &config, bool chained,
+        AudioBufferProvider *source, std::unique_ptr<PassthruBufferProvider> *chainedProvider) {
+    if (chained) {
+        std::vector<CopyBufferProvider*> stages;
+        for (const auto &stage : config.stages) {
+            stages.push_back(stage.get());
+        }
+        chainedProvider->reset(new ChainedCopyBufferProvider(stages, kCopyBufferFrameCount));
+        (*chainedProvider)->setBufferProvider(source);
+        return chainedProvider->get();
+    }
+    AudioBufferProvider *provider = source;
+    for (const auto &stage : config.stages) {
+        stage->setBufferProvider(provider);
+        provider = stage.get();
+    }
+    return provider;
+}
+
+// Pulls kFrameCount frames, optionally saving them to output.
+static void pull(AudioBufferProvider *provider, size_t frameSize,
+        std::vector<uint8_t> *output = nullptr) {
+    for (size_t frames = 0; frames < kFrameCount; ) {
+        AudioBufferProvider::Buffer buffer;
+        buffer.frameCount = kFrameCount - frames;
+        provider->getNextBuffer(&buffer);
+        if (output != nullptr) {
+            output->insert(output->end(), (uint8_t*)buffer.raw,
+                    (uint8_t*)buffer.raw + buffer.frameCount * frameSize);
+        }
+        benchmark::DoNotOptimize(buffer.raw);
+        frames += buffer.frameCount;
+        provider->releaseBuffer(&buffer);
+    }
+}
+
+template <Chain CHAIN, bool CHAINED>
+static void BM_BufferProviderChain(benchmark::State& state) {
+    ChainConfig config = createChain(CHAIN);
+    if (!config.valid) {
+        state.SkipWithError("ChannelMix not supported");
+        return;
+    }
+    const size_t outputFrameSize = config.stages.back()->getOutputFrameSize();
+
+    // verify the chained provider output matches the linked providers.
+    {
+        ChainConfig reference = createChain(CHAIN);
+        LoopProvider referenceSource(config.inputFormat, config.inputChannelCount);
+        LoopProvider source(config.inputFormat, config.inputChannelCount);
+        std::unique_ptr<PassthruBufferProvider> chainedProvider;
+        std::vector<uint8_t> expected;
+        std::vector<uint8_t> actual;
+        pull(linkChain(reference, false, &referenceSource, nullptr), outputFrameSize, &expected);
+        pull(linkChain(config, CHAINED, &source, &chainedProvider), outputFrameSize, &actual);
+        chainedProvider.reset();
+        config.stages.clear();
+        reference.stages.clear();
+        if (expected != actual) {
+            state.SkipWithError("chained output differs");
+            return;
+        }
+    }
+    config = createChain(CHAIN);
+
+    LoopProvider source(config.inputFormat, config.inputChannelCount);
+    std::unique_ptr<PassthruBufferProvider> chainedProvider;
+    AudioBufferProvider *provider = linkChain(config, CHAINED, &source, &chainedProvider);
+    while (state.KeepRunning()) {
+        pull(provider, outputFrameSize);
+        benchmark::ClobberMemory();
+    }
+
+    // the chained provider passes data between stages in its scratch buffer.
+    size_t stageBytes = 0;
+    for (const auto &stage : config.stages) {
+        stageBytes += stage->getInputFrameSize() + stage->getOutputFrameSize();
+    }
+    const size_t bufferBytes = CHAINED ? config.stages.front()->getInputFrameSize()
+            + config.stages.back()->getOutputFrameSize() : stageBytes;
+    const size_t scratchBytes = stageBytes - bufferBytes;
+    state.counters["buffer_bytes"] = bufferBytes;
+    state.counters["scratch_bytes"] = scratchBytes;
+    state.counters["time_per_frame"] = benchmark::Counter(kFrameCount,
+            benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.SetItemsProcessed(state.iterations() * kFrameCount);
+
+    // release upstream buffers before the source goes away.
+    chainedProvider.reset();
+    config.stages.clear();
+}
+
+#define BENCHMARK_CHAIN(CHAIN) \
+    BENCHMARK_TEMPLATE(BM_BufferProviderChain, CHAIN, false /* CHAINED */); \
+    BENCHMARK_TEMPLATE(BM_BufferProviderChain, CHAIN, true /* CHAINED */)
+
+BENCHMARK_CHAIN(CHAIN_51_INT16);
+BENCHMARK_CHAIN(CHAIN_51_FLOAT);
+BENCHMARK_CHAIN(CHAIN_71_REMIX);
+BENCHMARK_CHAIN(CHAIN_HAPTIC_INT16);
+
+BENCHMARK_MAIN();
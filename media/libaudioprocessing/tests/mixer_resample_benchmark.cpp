@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <log/log.h>
+#include <media/AudioBufferProvider.h>
+#include <media/AudioResampler.h>
+
+#include "../AudioMixerOps.h"
+
+using namespace android;
+
+// Benchmarks mixing resampled float tracks with a volume ramp, as done by
+// AudioMixerBase::TrackBase::track__Resample() for each track of a mix.
+//
+// The two pass path resamples each track with unity gain to a temporary buffer,
+// then applies the volume ramp and accumulates into the mix with volumeRampMulti().
+// The fused path has the resampler apply the volume ramp while it accumulates
+// directly into the mix buffer.
+
+// An endless stereo sine provider.
+class LoopProvider : public AudioBufferProvider {
+public:
+    LoopProvider(uint32_t channelCount, uint32_t sampleRate)
+        : mChannelCount(channelCount)
+        , mData(kFrameCount * channelCount) {
+        for (size_t i = 0; i < kFrameCount; ++i) {
+            const float value = sinf(2 * M_PI * 997. * i / sampleRate) * 0.5f;
+            for (size_t j = 0; j < channelCount; ++j) {
+                mData[i * channelCount + j] = value;
+            }
+        }
+    }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        const size_t available = kFrameCount - mIndex;
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->raw = &mData[mIndex * mChannelCount];
+        return OK;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mIndex += buffer->frameCount;
+        if (mIndex >= kFrameCount) {
+            mIndex = 0;
+        }
+        buffer->frameCount = 0;
+        buffer->raw = nullptr;
+    }
+
+private:
+    static constexpr size_t kFrameCount = 4096;
+    const uint32_t mChannelCount;
+    std::vector<float> mData;
+    size_t mIndex = 0;
+};
+
+struct MixTrack {
+    std::unique_ptr<AudioResampler> resampler;
+    std::unique_ptr<LoopProvider> provider;
+};
+
+template <bool FUSED>
+static void BM_MixResampledTracks(benchmark::State& state) {
+    constexpr uint32_t kChannelCount = FCC_2;
+    constexpr uint32_t kInSampleRate = 44100;
+    constexpr uint32_t kOutSampleRate = 48000;
+    constexpr size_t kFrameCount = 960; // 20 ms mix period
+    const size_t trackCount = state.range(0);
+
+    std::vector<MixTrack> tracks(trackCount);
+    for (auto &track : tracks) {
+        track.resampler.reset(AudioResampler::create(AUDIO_FORMAT_PCM_FLOAT,
+                kChannelCount, kOutSampleRate, AudioResampler::DYN_LOW_QUALITY));
+        track.resampler->setSampleRate(kInSampleRate);
+        track.provider = std::make_unique<LoopProvider>(kChannelCount, kInSampleRate);
+    }
+    std::vector<float> mix(kFrameCount * kChannelCount);
+    std::vector<float> temp(kFrameCount * kChannelCount);
+    const float volumeInc[FCC_2] = { 1e-5f, -1e-5f };
+
+    while (state.KeepRunning()) {
+        memset(mix.data(), 0, mix.size() * sizeof(float));
+        for (auto &track : tracks) {
+            float volume[FCC_2] = { 0.25f, 0.75f };
+            if (FUSED) {
+                track.resampler->setVolume(volume[0], volume[1]);
+                track.resampler->setVolumeRamp(volumeInc[0], volumeInc[1]);
+                track.resampler->resample(
+                        reinterpret_cast<int32_t*>(mix.data()), kFrameCount,
+                        track.provider.get());
+            } else {
+                track.resampler->setVolume(
+                        AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+                memset(temp.data(), 0, temp.size() * sizeof(float));
+                track.resampler->resample(
+                        reinterpret_cast<int32_t*>(temp.data()), kFrameCount,
+                        track.provider.get());
+                float auxLevel = 0.f;
+                volumeRampMulti<MIXTYPE_MULTI, kChannelCount>(mix.data(), kFrameCount,
+                        temp.data(), (float *)nullptr /* aux */, volume, volumeInc,
+                        &auxLevel, 0.f /* auxInc */);
+            }
+        }
+        benchmark::DoNotOptimize(mix.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * trackCount * kFrameCount);
+}
+
+static void MixTrackArgs(benchmark::internal::Benchmark* b) {
+    for (int tracks : { 8, 16, 32 }) {
+        b->Arg(tracks);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_MixResampledTracks, false /* FUSED */)->Apply(MixTrackArgs);
+BENCHMARK_TEMPLATE(BM_MixResampledTracks, true /* FUSED */)->Apply(MixTrackArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_mixer_tests"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <gtest/gtest.h>
+#include <log/log.h>
+#include <media/AudioBufferProvider.h>
+#include <media/AudioMixer.h>
+
+using namespace android;
+
+static constexpr uint32_t kSampleRate = 48000;
+static constexpr size_t kFrameCount = 960;  // 20 ms mix period
+static constexpr uint32_t kMixerChannelCount = 2;
+static constexpr size_t kPeriods = 50;
+
+// Provides an endless noise signal of any format and channel count,
+// which is silent for the first silentFrames of every kLoopFrameCount frames.
+class NoiseProvider : public AudioBufferProvider {
+public:
+    static constexpr size_t kLoopFrameCount = 4096;
+
+    NoiseProvider(audio_format_t format, uint32_t channelCount, long seed, size_t silentFrames)
+        : mFrameSize(audio_bytes_per_frame(channelCount, format))
+        , mData(kLoopFrameCount * mFrameSize) {
+        std::vector<float> noise(kLoopFrameCount * channelCount);
+        srand48(seed);
+        for (size_t i = 0; i < noise.size(); ++i) {
+            noise[i] = i < silentFrames * channelCount ? 0.f : drand48() - 0.5;
+        }
+        memcpy_by_audio_format(mData.data(), format,
+                noise.data(), AUDIO_FORMAT_PCM_FLOAT, noise.size());
+    }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        // return odd sized buffers to exercise the buffer handling of the mixer.
+        const size_t available = std::min(kLoopFrameCount - mIndex, (size_t)331);
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->raw = &mData[mIndex * mFrameSize];
+        return OK;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mIndex += buffer->frameCount;
+        if (mIndex >= kLoopFrameCount) {
+            mIndex = 0;
+        }
+        buffer->frameCount = 0;
+        buffer->raw = nullptr;
+    }
+
+private:
+    const size_t mFrameSize;
+    std::vector<uint8_t> mData;
+    size_t mIndex = 0;
+};
+
+struct TrackConfig {
+    audio_format_t format;
+    uint32_t channelCount;
+    uint32_t sampleRate;
+    bool aux;
+    bool muted;
+    int group;            // index of the main buffer
+    size_t silentFrames;  // see NoiseProvider
+};
+
+static constexpr size_t kSilent = NoiseProvider::kLoopFrameCount;
+
+static const TrackConfig kTrackConfigs[] = {
+    { AUDIO_FORMAT_PCM_FLOAT,   2, 48000, false, false, 0, 0 },
+    { AUDIO_FORMAT_PCM_16_BIT,  2, 48000, false, false, 0, 0 },
+    { AUDIO_FORMAT_PCM_FLOAT,   1, 44100, false, false, 0, kSilent },
+    { AUDIO_FORMAT_PCM_FLOAT,   2, 44100, true,  false, 0, 2048 },
+    { AUDIO_FORMAT_PCM_16_BIT,  1, 48000, false, false, 1, kSilent },
+    { AUDIO_FORMAT_PCM_FLOAT,   6, 48000, false, false, 0, 1500 },
+    { AUDIO_FORMAT_PCM_FLOAT,   2, 48000, false, true,  0, 0 },
+    { AUDIO_FORMAT_PCM_16_BIT,  2, 22050, true,  false, 1, 0 },
+    { AUDIO_FORMAT_PCM_FLOAT,   2, 96000, false, false, 0, 0 },
+    { AUDIO_FORMAT_PCM_16_BIT,  2, 48000, false, false, 1, 3000 },
+    { AUDIO_FORMAT_PCM_FLOAT,   2, 48000, true,  false, 1, kSilent },
+};
+
+// Mixes kPeriods periods of the tracks in kTrackConfigs with threadCount threads,
+// returning the float main buffers and aux buffer of all periods.
+static std::vector<float> mix(size_t threadCount, bool resample, bool skipSilence = true,
+        AudioMixer::SilenceStats *silenceStats = nullptr) {
+    constexpr size_t kGroups = 2;
+    const size_t mainSamples = kFrameCount * kMixerChannelCount;
+    std::vector<float> output(kPeriods * (kGroups * mainSamples + kFrameCount));
+    std::vector<std::unique_ptr<NoiseProvider>> providers;
+
+    AudioMixer mixer(kFrameCount, kSampleRate);
+    mixer.setThreadCount(threadCount);
+    EXPECT_EQ(threadCount, mixer.getThreadCount());
+    mixer.setSkipSilence(skipSilence);
+    for (size_t i = 0; i < std::size(kTrackConfigs); ++i) {
+        const TrackConfig &config = kTrackConfigs[i];
+        const int name = i;
+        const audio_channel_mask_t channelMask =
+                audio_channel_out_mask_from_count(config.channelCount);
+        const status_t status =
+                mixer.create(name, channelMask, config.format, AUDIO_SESSION_OUTPUT_MIX);
+        EXPECT_EQ(OK, status) << "track " << i;
+        if (status != OK) return {};
+        providers.emplace_back(
+                new NoiseProvider(config.format, config.channelCount, i, config.silentFrames));
+        mixer.setBufferProvider(name, providers.back().get());
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)AUDIO_FORMAT_PCM_FLOAT);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)audio_channel_out_mask_from_count(kMixerChannelCount));
+        if (resample) {
+            mixer.setParameter(name, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                    (void *)(uintptr_t)config.sampleRate);
+        }
+        float volume = config.muted ? 0.f : 0.1f * (i + 1);
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &volume);
+        volume *= 0.5f;
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &volume);
+        if (config.aux) {
+            float auxLevel = 0.25f;
+            mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::AUXLEVEL, &auxLevel);
+        }
+        mixer.enable(name);
+    }
+
+    for (size_t period = 0; period < kPeriods; ++period) {
+        float *out = &output[period * (kGroups * mainSamples + kFrameCount)];
+        float *aux = out + kGroups * mainSamples;
+        for (size_t i = 0; i < std::size(kTrackConfigs); ++i) {
+            const TrackConfig &config = kTrackConfigs[i];
+            const int name = i;
+            mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                    out + config.group * mainSamples);
+            if (config.aux) {
+                mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::AUX_BUFFER, aux);
+            }
+            // ramp the volumes every few periods.
+            if (period % 8 == 4 && !config.muted) {
+                float volume = 0.05f * (period % 5 + i + 1);
+                mixer.setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME0,
+                        &volume);
+                mixer.setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME1,
+                        &volume);
+                if (config.aux) {
+                    mixer.setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::AUXLEVEL,
+                            &volume);
+                }
+            }
+        }
+        mixer.process();
+    }
+    if (silenceStats != nullptr) {
+        *silenceStats = mixer.getSilenceStats();
+    }
+    return output;
+}
+
+static void testParallel(bool resample) {
+    const std::vector<float> expected = mix(1 /* threadCount */, resample);
+    for (size_t threadCount : { 2, 3, 4, 8 }) {
+        const std::vector<float> actual = mix(threadCount, resample);
+        ASSERT_EQ(expected.size(), actual.size());
+        // bit-identical, not just close.
+        EXPECT_EQ(0, memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)))
+                << "threadCount " << threadCount;
+    }
+}
+
+TEST(audioflinger_mixer, parallel_no_resampling) {
+    testParallel(false /* resample */);
+}
+
+TEST(audioflinger_mixer, parallel_resampling) {
+    testParallel(true /* resample */);
+}
+
+static void testSkipSilence(bool resample) {
+    AudioMixer::SilenceStats stats;
+    const std::vector<float> expected =
+            mix(1 /* threadCount */, resample, false /* skipSilence */, &stats);
+    EXPECT_EQ(kPeriods, stats.periods);
+    EXPECT_EQ(0u, stats.skippedTracks);
+    for (size_t threadCount : { 1, 4 }) {
+        const std::vector<float> actual =
+                mix(threadCount, resample, true /* skipSilence */, &stats);
+        ASSERT_EQ(expected.size(), actual.size());
+        // bit-identical, not just close.
+        EXPECT_EQ(0, memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)))
+                << "threadCount " << threadCount;
+        EXPECT_EQ(kPeriods, stats.periods);
+        // the silent tracks are skipped, except in the periods where their volume
+        // ramps (period % 8 == 4), and the first period of the resampled one, which
+        // starts with an empty filter.
+        const size_t silentTracks = 3;
+        const size_t rampPeriods = (kPeriods + 3) / 8;
+        EXPECT_GE(stats.skippedTracks, silentTracks * (kPeriods - rampPeriods) - resample)
+                << "threadCount " << threadCount;
+        EXPECT_GE(stats.lastSkippedTracks, silentTracks);
+    }
+}
+
+TEST(audioflinger_mixer, skip_silence_no_resampling) {
+    testSkipSilence(false /* resample */);
+}
+
+TEST(audioflinger_mixer, skip_silence_resampling) {
+    testSkipSilence(true /* resample */);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <type_traits>
+#include <log/log.h>
+
+#include <../AudioResamplerFirOps.h>
+#include <../AudioResamplerFirProcess.h>
+#include <../AudioResamplerFirProcessAVX2.h>
+#include <../AudioResamplerFirProcessSSE.h>
+#include <benchmark/benchmark.h>
+
+using namespace android;
+
+// Benchmarks a single polyphase dot product (one output frame) of the resampler
+// filter kernels, as called by fir() for each output frame.
+
+enum KernelType {
+    KERNEL_GENERIC, // ProcessBase()
+    KERNEL_SSE,     // ProcessSSEIntrinsic() and ProcessSSEMultiIntrinsic(), float only
+    KERNEL_AVX2,    // ProcessAVX2Intrinsic() and ProcessAVX2MultiIntrinsic()
+};
+
+template <typename T>
+static T randomValue() {
+    const double value = drand48() - 0.5;
+    if constexpr (std::is_same_v<T, int16_t>) {
+        return static_cast<int16_t>(value * 32767.);
+    } else {
+        return static_cast<T>(value);
+    }
+}
+
+// TC = coefficient type, TI = input type, TO = output type, TL = lerp type
+template <int KERNEL, int CHANNELS, bool LOCKED, typename TC, typename TI, typename TO,
+        typename TL>
+static void BM_ResamplerKernel(benchmark::State& state) {
+    constexpr int kHalfNumCoefs = 32;
+    constexpr int kOutChannels = CHANNELS < 2 ? 2 : CHANNELS;
+
+    if constexpr (KERNEL == KERNEL_SSE) {
+#if !USE_SSE
+        state.SkipWithError("SSE kernels not compiled");
+        return;
+#endif
+    }
+    if constexpr (KERNEL == KERNEL_AVX2) {
+#if USE_AVX2_DISPATCH
+        if (!isAvx2FmaSupported()) {
+            state.SkipWithError("AVX2/FMA not supported");
+            return;
+        }
+#else
+        state.SkipWithError("AVX2 kernels not compiled");
+        return;
+#endif
+    }
+
+    alignas(64) TC coefs[4 * kHalfNumCoefs];
+    TI samples[(2 * kHalfNumCoefs + 2) * CHANNELS];
+    for (auto &coef : coefs) {
+        coef = randomValue<TC>();
+    }
+    for (auto &sample : samples) {
+        sample = randomValue<TI>();
+    }
+    const TI* const sP = samples + kHalfNumCoefs * CHANNELS;
+    const TI* const sN = sP + CHANNELS;
+    const TC* const coefsP = coefs;
+    const TC* const coefsP1 = coefs + kHalfNumCoefs;
+    const TC* const coefsN = coefs + 2 * kHalfNumCoefs;
+    const TC* const coefsN1 = coefs + 3 * kHalfNumCoefs;
+    // fractional phase, see fir().
+    const TL lerpP = LOCKED ? 0 : std::is_floating_point_v<TL> ? TL(0.375) : TL(0x3000);
+    // unity gain, integer volumes are U4_28.
+    const TO unity = std::is_floating_point_v<TO> ? TO(1) : TO(1 << 28);
+    alignas(8) TO volumeLR[2] = { unity, unity };
+    TO out[kOutChannels]{};
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(coefs);
+        benchmark::DoNotOptimize(samples);
+        benchmark::DoNotOptimize(out);
+        if constexpr (KERNEL == KERNEL_GENERIC) {
+            if (LOCKED) {
+                ProcessBase<CHANNELS, 16, InterpNull>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            } else {
+                ProcessBase<CHANNELS, 16, InterpCompute>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            }
+        }
+#if USE_SSE
+        if constexpr (KERNEL == KERNEL_SSE) {
+            if constexpr (CHANNELS > 2) {
+                ProcessSSEMultiIntrinsic<CHANNELS, 16, LOCKED>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            } else {
+                ProcessSSEIntrinsic<CHANNELS, 16, LOCKED>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            }
+        }
+#endif
+#if USE_AVX2_DISPATCH
+        if constexpr (KERNEL == KERNEL_AVX2) {
+            if constexpr (CHANNELS > 2) {
+                ProcessAVX2MultiIntrinsic<CHANNELS, 16, LOCKED>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            } else {
+                ProcessAVX2Intrinsic<CHANNELS, 16, LOCKED>(out,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            }
+        }
+#endif
+        benchmark::ClobberMemory();
+    }
+    (void)coefsP1;
+    (void)coefsN1;
+    state.SetItemsProcessed(state.iterations()); // output frames
+}
+
+#define BENCHMARK_FLOAT(KERNEL, CHANNELS) \
+    BENCHMARK_TEMPLATE(BM_ResamplerKernel, KERNEL, CHANNELS, true, \
+            float, float, float, float); \
+    BENCHMARK_TEMPLATE(BM_ResamplerKernel, KERNEL, CHANNELS, false, \
+            float, float, float, float)
+
+#define BENCHMARK_INT16(KERNEL, CHANNELS) \
+    BENCHMARK_TEMPLATE(BM_ResamplerKernel, KERNEL, CHANNELS, true, \
+            int16_t, int16_t, int32_t, uint32_t); \
+    BENCHMARK_TEMPLATE(BM_ResamplerKernel, KERNEL, CHANNELS, false, \
+            int16_t, int16_t, int32_t, uint32_t)
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 1);
+BENCHMARK_FLOAT(KERNEL_SSE, 1);
+BENCHMARK_FLOAT(KERNEL_AVX2, 1);
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 2);
+BENCHMARK_FLOAT(KERNEL_SSE, 2);
+BENCHMARK_FLOAT(KERNEL_AVX2, 2);
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 4);
+BENCHMARK_FLOAT(KERNEL_SSE, 4);
+BENCHMARK_FLOAT(KERNEL_AVX2, 4);
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 6);
+BENCHMARK_FLOAT(KERNEL_SSE, 6);
+BENCHMARK_FLOAT(KERNEL_AVX2, 6);
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 8);
+BENCHMARK_FLOAT(KERNEL_SSE, 8);
+BENCHMARK_FLOAT(KERNEL_AVX2, 8);
+
+BENCHMARK_FLOAT(KERNEL_GENERIC, 12);
+BENCHMARK_FLOAT(KERNEL_SSE, 12);
+BENCHMARK_FLOAT(KERNEL_AVX2, 12);
+
+BENCHMARK_INT16(KERNEL_GENERIC, 1);
+BENCHMARK_INT16(KERNEL_AVX2, 1);
+
+BENCHMARK_INT16(KERNEL_GENERIC, 2);
+BENCHMARK_INT16(KERNEL_AVX2, 2);
+
+BENCHMARK_MAIN();
@@ -28,8 +28,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -40,6 +42,11 @@
 #include <media/AudioResampler.h>
 #include "../AudioResamplerDyn.h"
 #include "../AudioResamplerFirGen.h"
+#include "../AudioResamplerFirOps.h"
+#include "../AudioResamplerFirProcess.h"
+#include "../AudioResamplerFirProcessNeon.h"
+#include "../AudioResamplerFirProcessAVX2.h"
+#include "../AudioResamplerFirProcessSSE.h"
 #include "test_utils.h"
 
 template <typename T>
@@ -371,6 +378,23 @@ TEST(audioflinger_resampler, bufferincrement_interpolatedphase_multi_float) {
     }
 }
 
+TEST(audioflinger_resampler, bufferincrement_multichannel_layouts_float) {
+    // only dynamic quality
+    static const enum android::AudioResampler::src_quality kQualityArray[] = {
+            android::AudioResampler::DYN_LOW_QUALITY,
+            android::AudioResampler::DYN_MED_QUALITY,
+            android::AudioResampler::DYN_HIGH_QUALITY,
+    };
+
+    // 4.0, 5.1, 7.1 and 7.1.4 use the vectorized multichannel kernels.
+    for (size_t channels : { 4, 6, 8, 12 }) {
+        for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+            testBufferIncrement(channels, true, 48000, 32000, kQualityArray[i]);
+            testBufferIncrement(channels, true, 22050, 48000, kQualityArray[i]);
+        }
+    }
+}
+
 /* Simple aliasing test
  *
  * This checks stopband response of the chirp signal to make sure frequencies
@@ -543,6 +567,16 @@ TEST(audioflinger_resampler, stopbandresponse_float_multichannel) {
         testStopbandDownconversion<float, float>(
                 8, 48000, 22101, 7000, 15000, kQualityArray[i]);
     }
+
+    // 5.1 and 7.1.4 have a channel count that is not a multiple of the vector width.
+    for (size_t channels : { 6, 12 }) {
+        for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+            testStopbandDownconversion<float, float>(
+                    channels, 48000, 32000, 12000, 20000, kQualityArray[i]);
+            testStopbandDownconversion<float, float>(
+                    channels, 48000, 22101, 7000, 15000, kQualityArray[i]);
+        }
+    }
 }
 
 // Selected downsampling responses for various frequencies relating to hearing aid.
@@ -601,3 +635,369 @@ TEST(audioflinger_resampler, generalresponse) {
         }
     }
 }
+
+/* Filter bank cache test
+ *
+ * Resamplers with the same conversion share one designed filter bank,
+ * which is released when the last resampler using it is destroyed.
+ */
+TEST(audioflinger_resampler, filterbankcache) {
+    using ResamplerType = android::AudioResamplerDyn<float, float, float>;
+    auto createResampler = [](int32_t inSampleRate, int32_t outSampleRate) {
+        std::unique_ptr<ResamplerType> resampler(
+                static_cast<ResamplerType *>(
+                        android::AudioResampler::create(
+                                AUDIO_FORMAT_PCM_FLOAT,
+                                2 /* channels */,
+                                outSampleRate,
+                                android::AudioResampler::DYN_HIGH_QUALITY)));
+        resampler->setSampleRate(inSampleRate);
+        return resampler;
+    };
+
+    // use an unusual conversion so other tests do not hold the filter bank.
+    const android::AudioResampler::FilterCacheStats initial =
+            android::AudioResampler::getFilterCacheStats();
+    auto first = createResampler(44099, 47999);
+    const android::AudioResampler::FilterCacheStats designed =
+            android::AudioResampler::getFilterCacheStats();
+    EXPECT_LT(initial.misses, designed.misses);
+
+    auto second = createResampler(44099, 47999);
+    const android::AudioResampler::FilterCacheStats shared =
+            android::AudioResampler::getFilterCacheStats();
+    EXPECT_EQ(designed.misses, shared.misses);
+    EXPECT_LT(designed.hits, shared.hits);
+    EXPECT_EQ(first->getFilterCoefs(), second->getFilterCoefs());
+    EXPECT_EQ(first->getPhases(), second->getPhases());
+    EXPECT_EQ(first->getHalfLength(), second->getHalfLength());
+    EXPECT_EQ(first->getNormalizedCutoffFrequency(), second->getNormalizedCutoffFrequency());
+
+    // a different quality or conversion is designed separately.
+    auto other = createResampler(22049, 47999);
+    EXPECT_NE(first->getFilterCoefs(), other->getFilterCoefs());
+
+    first.reset();
+    second.reset();
+    other.reset();
+    const android::AudioResampler::FilterCacheStats released =
+            android::AudioResampler::getFilterCacheStats();
+    EXPECT_GT(shared.filterBanks, released.filterBanks);
+    EXPECT_GT(shared.bytes, released.bytes);
+}
+
+/* Concurrent filter bank cache test
+ *
+ * Resamplers created concurrently for the same conversion design its filter bank once,
+ * the others wait for that design rather than designing their own.
+ */
+TEST(audioflinger_resampler, filterbankcache_concurrent) {
+    using ResamplerType = android::AudioResamplerDyn<float, float, float>;
+    constexpr size_t kThreads = 8;
+    std::vector<std::unique_ptr<ResamplerType>> resamplers(kThreads);
+
+    // use an unusual conversion so other tests do not hold the filter bank.
+    const android::AudioResampler::FilterCacheStats initial =
+            android::AudioResampler::getFilterCacheStats();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&resamplers, i] {
+            resamplers[i].reset(static_cast<ResamplerType *>(
+                    android::AudioResampler::create(
+                            AUDIO_FORMAT_PCM_FLOAT,
+                            2 /* channels */,
+                            47997,
+                            android::AudioResampler::DYN_HIGH_QUALITY)));
+            resamplers[i]->setSampleRate(44097);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const android::AudioResampler::FilterCacheStats shared =
+            android::AudioResampler::getFilterCacheStats();
+    EXPECT_EQ(initial.misses + 1, shared.misses);
+    EXPECT_EQ(initial.hits + kThreads - 1, shared.hits);
+    for (size_t i = 1; i < kThreads; ++i) {
+        EXPECT_EQ(resamplers[0]->getFilterCoefs(), resamplers[i]->getFilterCoefs());
+    }
+}
+
+/* Volume ramp test
+ *
+ * A float resampler applying a volume ramp must match resampling with unity gain
+ * followed by the per frame volume ramp of the mixer (volumeRampMulti()).
+ */
+void testVolumeRamp(size_t channels, unsigned inputFreq, unsigned outputFreq)
+{
+    SignalProvider provider;
+    provider.setChirp<float>(channels, 0., outputFreq / 2., outputFreq, outputFreq / 2000.);
+    const size_t outputFrames = 1000;
+    const size_t outputChannels = channels < 2 ? 2 : channels;
+    const float volume[2] = { 0.25f, 0.75f };
+    const float volumeInc[2] = { 1e-4f, -1e-4f };
+
+    // reference: unity gain then volume ramp, volume[0] only for multichannel.
+    std::unique_ptr<android::AudioResampler> resampler(android::AudioResampler::create(
+            AUDIO_FORMAT_PCM_FLOAT, channels, outputFreq,
+            android::AudioResampler::DYN_MED_QUALITY));
+    resampler->setSampleRate(inputFreq);
+    resampler->setVolume(android::AudioResampler::UNITY_GAIN_FLOAT,
+            android::AudioResampler::UNITY_GAIN_FLOAT);
+    std::vector<float> reference(outputFrames * outputChannels);
+    resampler->resample(reinterpret_cast<int32_t*>(reference.data()), outputFrames, &provider);
+    float vol[2] = { volume[0], volume[1] };
+    for (size_t i = 0; i < outputFrames; ++i) {
+        for (size_t j = 0; j < outputChannels; ++j) {
+            reference[i * outputChannels + j] *= outputChannels == 2 ? vol[j] : vol[0];
+        }
+        vol[0] += volumeInc[0];
+        vol[1] += volumeInc[1];
+    }
+
+    // test: volume ramp applied by the resampler.
+    provider.reset();
+    resampler.reset(android::AudioResampler::create(
+            AUDIO_FORMAT_PCM_FLOAT, channels, outputFreq,
+            android::AudioResampler::DYN_MED_QUALITY));
+    resampler->setSampleRate(inputFreq);
+    resampler->setVolume(volume[0], volume[1]);
+    ASSERT_TRUE(resampler->setVolumeRamp(volumeInc[0], volumeInc[1]));
+    std::vector<float> test(outputFrames * outputChannels);
+    resampler->resample(reinterpret_cast<int32_t*>(test.data()), outputFrames, &provider);
+
+    for (size_t i = 0; i < test.size(); ++i) {
+        ASSERT_NEAR(reference[i], test[i], 1e-6) << "channels:" << channels << " index:" << i;
+    }
+}
+
+TEST(audioflinger_resampler, volumeramp_float) {
+    testVolumeRamp(1, 44100, 48000);
+    testVolumeRamp(2, 44100, 48000);
+    testVolumeRamp(2, 48000, 44100);
+    testVolumeRamp(6, 22050, 48000);
+}
+
+/* Silence skipping test
+ *
+ * A resampler skipping the filter on silent input must produce the same output,
+ * bit for bit, as a resampler filtering it, and leave the same filter state and
+ * phase for the audio after the silence.
+ */
+class SilentGapProvider : public SignalProvider {
+public:
+    // Silences frames [begin, end) of the signal.
+    void silence(size_t begin, size_t end) {
+        memset(static_cast<uint8_t *>(mAddr) + begin * mFrameSize, 0,
+                (end - begin) * mFrameSize);
+    }
+};
+
+template <typename T>
+void testSkipSilence(size_t channels, unsigned inputFreq, unsigned outputFreq,
+        android::AudioResampler::src_quality quality)
+{
+    const audio_format_t format = std::is_same<T, float>::value
+            ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    const size_t outputChannels = channels < 2 ? 2 : channels;
+    const size_t outputFrames = outputFreq;  // 1 second
+    constexpr size_t kPeriodFrames = 192;
+    std::vector<int32_t> output[2];
+    size_t skippedFrames[2] = {};
+
+    for (int skip = 0; skip < 2; ++skip) {
+        SilentGapProvider provider;
+        provider.setChirp<T>(channels, 0., inputFreq / 2., inputFreq, 1.1 /* time */);
+        provider.silence(inputFreq / 10, inputFreq / 2);
+        provider.silence(inputFreq * 6 / 10, inputFreq * 6 / 10 + 20);
+
+        std::unique_ptr<android::AudioResampler> resampler(
+                android::AudioResampler::create(format, channels, outputFreq, quality));
+        resampler->setSampleRate(inputFreq);
+        resampler->setVolume(0.5f, 0.75f);
+        resampler->setSkipSilence(skip != 0);
+        output[skip].resize(outputFrames * outputChannels);  // float or int32_t samples
+        for (size_t i = 0; i < outputFrames; i += kPeriodFrames) {
+            const size_t frames = std::min(kPeriodFrames, outputFrames - i);
+            resampler->resample(&output[skip][i * outputChannels], frames, &provider);
+            skippedFrames[skip] += resampler->getSkippedFrames();
+        }
+    }
+    EXPECT_EQ(0u, skippedFrames[0]);
+    // most of the 0.4 second gap is skipped, the short one is too short to be.
+    EXPECT_GT(skippedFrames[1], outputFrames * 3 / 10);
+    EXPECT_LT(skippedFrames[1], outputFrames * 4 / 10);
+    EXPECT_EQ(0, memcmp(output[0].data(), output[1].data(),
+            output[0].size() * sizeof(output[0][0])))
+            << "channels:" << channels << " " << inputFreq << " -> " << outputFreq;
+}
+
+TEST(audioflinger_resampler, skipsilence) {
+    testSkipSilence<float>(1, 44100, 48000, android::AudioResampler::DYN_MED_QUALITY);
+    testSkipSilence<float>(2, 44100, 48000, android::AudioResampler::DYN_MED_QUALITY);
+    testSkipSilence<float>(2, 48000, 44100, android::AudioResampler::DYN_HIGH_QUALITY);
+    testSkipSilence<float>(6, 22050, 48000, android::AudioResampler::DYN_LOW_QUALITY);
+    testSkipSilence<int16_t>(2, 44100, 48000, android::AudioResampler::DYN_MED_QUALITY);
+    testSkipSilence<int16_t>(2, 96000, 48000, android::AudioResampler::DYN_HIGH_QUALITY);
+}
+
+#if USE_AVX2_DISPATCH
+// TC = filter coefficient type, TI = input type, TO = output type, TL = lerp type
+// The AVX2 kernel is compared against the generic ProcessBase() implementation
+// on random data, for both locked (LOCKED) and interpolated phase.
+template <int CHANNELS, bool LOCKED, typename TC, typename TI, typename TO, typename TL>
+void testAvx2Kernel(TL lerpP, const TO (&volumeLR)[2], double tolerance)
+{
+    constexpr int kHalfNumCoefs = 32;
+    constexpr int kOutChannels = CHANNELS < 2 ? 2 : CHANNELS;
+    constexpr int kTrials = 100;
+
+    // two adjacent polyphases for each side, see fir().
+    alignas(64) TC coefs[4 * kHalfNumCoefs];
+    TI samples[(2 * kHalfNumCoefs + 2) * CHANNELS];
+    const TI* const sP = samples + kHalfNumCoefs * CHANNELS;
+    const TI* const sN = sP + CHANNELS;
+    const TC* const coefsP = coefs;
+    const TC* const coefsP1 = coefs + kHalfNumCoefs;
+    const TC* const coefsN = coefs + 2 * kHalfNumCoefs;
+    const TC* const coefsN1 = coefs + 3 * kHalfNumCoefs;
+
+    for (int trial = 0; trial < kTrials; ++trial) {
+        for (auto &coef : coefs) {
+            coef = convertValue<TC>(drand48() - 0.5);
+        }
+        for (auto &sample : samples) {
+            sample = convertValue<TI>(drand48() - 0.5);
+        }
+        TO reference[kOutChannels]{};
+        TO test[kOutChannels]{};
+        if (LOCKED) {
+            android::ProcessBase<CHANNELS, 16, android::InterpNull>(reference,
+                    kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            if constexpr (CHANNELS > 2) {
+                android::ProcessAVX2MultiIntrinsic<CHANNELS, 16, true>(test,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            } else {
+                android::ProcessAVX2Intrinsic<CHANNELS, 16, true>(test,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            }
+        } else {
+            android::ProcessBase<CHANNELS, 16, android::InterpCompute>(reference,
+                    kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            if constexpr (CHANNELS > 2) {
+                android::ProcessAVX2MultiIntrinsic<CHANNELS, 16, false>(test,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            } else {
+                android::ProcessAVX2Intrinsic<CHANNELS, 16, false>(test,
+                        kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR, lerpP,
+                        coefsP1, coefsN1);
+            }
+        }
+        for (int i = 0; i < kOutChannels; ++i) {
+            ASSERT_NEAR(reference[i], test[i], tolerance)
+                    << "channels:" << CHANNELS << " locked:" << LOCKED << " index:" << i;
+        }
+    }
+}
+
+/* AVX2 kernel test
+ *
+ * The int16_t kernels are bit exact with the generic implementation,
+ * the float kernels differ only in the order of accumulation.
+ */
+TEST(audioflinger_resampler, avx2kernel_float) {
+    if (!android::isAvx2FmaSupported()) {
+        GTEST_SKIP() << "AVX2/FMA not supported on this host";
+    }
+    const float volume[2] = { 0.75f, 0.5f };
+    testAvx2Kernel<1, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<1, false, float, float, float>(0.3f, volume, 1e-5);
+    testAvx2Kernel<2, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<2, false, float, float, float>(0.7f, volume, 1e-5);
+    testAvx2Kernel<4, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<4, false, float, float, float>(0.1f, volume, 1e-5);
+    testAvx2Kernel<6, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<6, false, float, float, float>(0.5f, volume, 1e-5);
+    testAvx2Kernel<8, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<8, false, float, float, float>(0.9f, volume, 1e-5);
+    testAvx2Kernel<12, true, float, float, float>(0.f, volume, 1e-5);
+    testAvx2Kernel<12, false, float, float, float>(0.2f, volume, 1e-5);
+}
+
+TEST(audioflinger_resampler, avx2kernel_int16) {
+    if (!android::isAvx2FmaSupported()) {
+        GTEST_SKIP() << "AVX2/FMA not supported on this host";
+    }
+    // U4_28 volume, see AudioResamplerDyn::setVolume().
+    const int32_t volume[2] = { 0x0c000000, 0x08000000 };
+    testAvx2Kernel<1, true, int16_t, int16_t, int32_t>(0u, volume, 0.);
+    testAvx2Kernel<1, false, int16_t, int16_t, int32_t>(0x1234u, volume, 0.);
+    testAvx2Kernel<2, true, int16_t, int16_t, int32_t>(0u, volume, 0.);
+    testAvx2Kernel<2, false, int16_t, int16_t, int32_t>(0x7654u, volume, 0.);
+}
+#endif // USE_AVX2_DISPATCH
+
+// The multichannel float kernels selected by fir() through ProcessL() and Process()
+// (NEON, SSE or AVX2 depending on the platform) are compared against the generic
+// ProcessBase() implementation on random data.
+template <int CHANNELS, bool LOCKED>
+void testMultichannelKernel(float lerpP)
+{
+    constexpr int kHalfNumCoefs = 32;
+    constexpr int kTrials = 100;
+    const float volumeLR[2] = { 0.75f, 0.5f };
+
+    // two adjacent polyphases for each side, see fir().
+    alignas(64) float coefs[4 * kHalfNumCoefs];
+    float samples[(2 * kHalfNumCoefs + 2) * CHANNELS];
+    const float* const sP = samples + kHalfNumCoefs * CHANNELS;
+    const float* const sN = sP + CHANNELS;
+    const float* const coefsP = coefs;
+    const float* const coefsP1 = coefs + kHalfNumCoefs;
+    const float* const coefsN = coefs + 2 * kHalfNumCoefs;
+    const float* const coefsN1 = coefs + 3 * kHalfNumCoefs;
+
+    for (int trial = 0; trial < kTrials; ++trial) {
+        for (auto &coef : coefs) {
+            coef = drand48() - 0.5;
+        }
+        for (auto &sample : samples) {
+            sample = drand48() - 0.5;
+        }
+        // the kernels accumulate into the output.
+        float reference[CHANNELS];
+        float test[CHANNELS];
+        for (int i = 0; i < CHANNELS; ++i) {
+            reference[i] = test[i] = drand48() - 0.5;
+        }
+        if (LOCKED) {
+            android::ProcessBase<CHANNELS, 16, android::InterpNull>(reference,
+                    kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            android::ProcessL<CHANNELS, 16>(test,
+                    kHalfNumCoefs, coefsP, coefsN, sP, sN, volumeLR);
+        } else {
+            android::ProcessBase<CHANNELS, 16, android::InterpCompute>(reference,
+                    kHalfNumCoefs, coefsP, coefsN, sP, sN, lerpP, volumeLR);
+            android::Process<CHANNELS, 16>(test,
+                    kHalfNumCoefs, coefsP, coefsN, coefsP1, coefsN1, sP, sN, lerpP, volumeLR);
+        }
+        for (int i = 0; i < CHANNELS; ++i) {
+            ASSERT_NEAR(reference[i], test[i], 1e-5)
+                    << "channels:" << CHANNELS << " locked:" << LOCKED << " index:" << i;
+        }
+    }
+}
+
+TEST(audioflinger_resampler, multichannelkernel_float) {
+    testMultichannelKernel<4, true>(0.f);
+    testMultichannelKernel<4, false>(0.1f);
+    testMultichannelKernel<6, true>(0.f);
+    testMultichannelKernel<6, false>(0.5f);
+    testMultichannelKernel<8, true>(0.f);
+    testMultichannelKernel<8, false>(0.9f);
+    testMultichannelKernel<12, true>(0.f);
+    testMultichannelKernel<12, false>(0.3f);
+}
@@ -35,9 +35,13 @@
 
 using namespace android;
 
+static constexpr size_t kMixerFrameCount = 320; // typical numbers may range from 240 or 960
+static constexpr int kBenchmarkPasses = 5;      // the fastest pass is reported
+
 static void usage(const char* name) {
     fprintf(stderr, "Usage: %s [-f] [-m] [-c channels]"
                     " [-s sample-rate] [-o <output-file>] [-a <aux-buffer-file>] [-P csv]"
+                    " [-j threads]"
                     " (<input-file> | <command>)+\n", name);
     fprintf(stderr, "    -f    enable floating point input track by default\n");
     fprintf(stderr, "    -m    enable floating point mixer output\n");
@@ -46,6 +50,8 @@ static void usage(const char* name) {
     fprintf(stderr, "    -o    <output-file> WAV file, pcm16 (or float if -m specified)\n");
     fprintf(stderr, "    -a    <aux-buffer-file>\n");
     fprintf(stderr, "    -P    # frames provided per call to resample() in CSV format\n");
+    fprintf(stderr, "    -j    # threads to mix with; if more than 1, benchmark the mix\n");
+    fprintf(stderr, "          against a single thread and report the speedup\n");
     fprintf(stderr, "    <input-file> is a WAV file\n");
     fprintf(stderr, "    <command> can be 'sine:[(i|f),]<channels>,<frequency>,<samplerate>'\n");
     fprintf(stderr, "                     'chirp:[(i|f),]<channels>,<samplerate>'\n");
@@ -90,6 +96,108 @@ const char *parseFormat(const char *s, bool *useFloat) {
     return s;
 }
 
+// Mixes the providers into the output and aux buffers on threadCount threads.
+// Returns the time spent in AudioMixer::process(), and the number of frames produced
+// in outputFrames.
+static int64_t mix(std::vector<SignalProvider>& providers,
+        const std::vector<audio_format_t>& formats, size_t threadCount,
+        bool useMixerFloat, bool useRamp, uint32_t outputSampleRate, uint32_t outputChannels,
+        void *outputAddr, void *auxAddr, size_t *outputFrames) {
+    const size_t outputFrameSize = outputChannels
+            * (useMixerFloat ? sizeof(float) : sizeof(int16_t));
+    const audio_channel_mask_t outputChannelMask =
+            audio_channel_out_mask_from_count(outputChannels);
+    const size_t auxFrameSize = sizeof(int32_t); // Q4.27 always
+
+    // create the mixer.
+    AudioMixer *mixer = new AudioMixer(kMixerFrameCount, outputSampleRate);
+    mixer->setThreadCount(threadCount);
+    audio_format_t mixerFormat = useMixerFloat
+            ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    float f = AudioMixer::UNITY_GAIN_FLOAT / providers.size(); // normalize volume by # tracks
+    static float f0; // zero
+
+    // set up the tracks.
+    for (size_t i = 0; i < providers.size(); ++i) {
+        //printf("track %d out of %d\n", i, providers.size());
+        providers[i].reset();
+        audio_channel_mask_t channelMask =
+                audio_channel_out_mask_from_count(providers[i].getNumChannels());
+        const int name = i;
+        const status_t status = mixer->create(
+                name, channelMask, formats[i], AUDIO_SESSION_OUTPUT_MIX);
+        LOG_ALWAYS_FATAL_IF(status != OK);
+        mixer->setBufferProvider(name, &providers[i]);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                (void *)outputAddr);
+        mixer->setParameter(
+                name,
+                AudioMixer::TRACK,
+                AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)mixerFormat);
+        mixer->setParameter(
+                name,
+                AudioMixer::TRACK,
+                AudioMixer::FORMAT,
+                (void *)(uintptr_t)formats[i]);
+        mixer->setParameter(
+                name,
+                AudioMixer::TRACK,
+                AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)outputChannelMask);
+        mixer->setParameter(
+                name,
+                AudioMixer::TRACK,
+                AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)channelMask);
+        mixer->setParameter(
+                name,
+                AudioMixer::RESAMPLE,
+                AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)providers[i].getSampleRate());
+        if (useRamp) {
+            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &f0);
+            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &f0);
+            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME0, &f);
+            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME1, &f);
+        } else {
+            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &f);
+            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &f);
+        }
+        if (auxAddr) {
+            mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::AUX_BUFFER,
+                    (void *) auxAddr);
+            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::AUXLEVEL, &f0);
+            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::AUXLEVEL, &f);
+        }
+        mixer->enable(name);
+    }
+
+    // pump the mixer to process data.
+    int64_t processNs = 0;
+    size_t i;
+    for (i = 0; i < *outputFrames - kMixerFrameCount; i += kMixerFrameCount) {
+        for (size_t j = 0; j < providers.size(); ++j) {
+            const int name = j;
+            mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                    (char *) outputAddr + i * outputFrameSize);
+            if (auxAddr) {
+                mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::AUX_BUFFER,
+                        (char *) auxAddr + i * auxFrameSize);
+            }
+        }
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        mixer->process();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        processNs += (end.tv_sec - start.tv_sec) * 1000000000LL + end.tv_nsec - start.tv_nsec;
+    }
+    *outputFrames = i; // reset output frames to the data actually produced.
+
+    delete mixer;
+    return processNs;
+}
+
 int main(int argc, char* argv[]) {
     const char* const progname = argv[0];
     bool useInputFloat = false;
@@ -100,11 +208,11 @@ int main(int argc, char* argv[]) {
     std::vector<int> Pvalues;
     const char* outputFilename = NULL;
     const char* auxFilename = NULL;
-    std::vector<int32_t> names;
+    size_t threadCount = 1;
     std::vector<SignalProvider> providers;
     std::vector<audio_format_t> formats;
 
-    for (int ch; (ch = getopt(argc, argv, "fmc:s:o:a:P:")) != -1;) {
+    for (int ch; (ch = getopt(argc, argv, "fmc:s:o:a:P:j:")) != -1;) {
         switch (ch) {
         case 'f':
             useInputFloat = true;
@@ -130,6 +238,9 @@ int main(int argc, char* argv[]) {
                 return EXIT_FAILURE;
             }
             break;
+        case 'j':
+            threadCount = atoi(optarg);
+            break;
         case '?':
         default:
             usage(progname);
@@ -147,7 +258,6 @@ int main(int argc, char* argv[]) {
     size_t outputFrames = 0;
 
     // create providers for each track
-    names.resize(argc);
     providers.resize(argc);
     formats.resize(argc);
     for (int i = 0; i < argc; ++i) {
@@ -215,8 +325,6 @@ int main(int argc, char* argv[]) {
     const size_t outputFrameSize = outputChannels
             * (useMixerFloat ? sizeof(float) : sizeof(int16_t));
     const size_t outputSize = outputFrames * outputFrameSize;
-    const audio_channel_mask_t outputChannelMask =
-            audio_channel_out_mask_from_count(outputChannels);
     void *outputAddr = NULL;
     (void) posix_memalign(&outputAddr, 32, outputSize);
     memset(outputAddr, 0, outputSize);
@@ -230,84 +338,56 @@ int main(int argc, char* argv[]) {
         memset(auxAddr, 0, auxSize);
     }
 
-    // create the mixer.
-    const size_t mixerFrameCount = 320; // typical numbers may range from 240 or 960
-    AudioMixer *mixer = new AudioMixer(mixerFrameCount, outputSampleRate);
-    audio_format_t mixerFormat = useMixerFloat
-            ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
-    float f = AudioMixer::UNITY_GAIN_FLOAT / providers.size(); // normalize volume by # tracks
-    static float f0; // zero
-
-    // set up the tracks.
-    for (size_t i = 0; i < providers.size(); ++i) {
-        //printf("track %d out of %d\n", i, providers.size());
-        audio_channel_mask_t channelMask =
-                audio_channel_out_mask_from_count(providers[i].getNumChannels());
-        const int name = i;
-        const status_t status = mixer->create(
-                name, channelMask, formats[i], AUDIO_SESSION_OUTPUT_MIX);
-        LOG_ALWAYS_FATAL_IF(status != OK);
-        names[i] = name;
-        mixer->setBufferProvider(name, &providers[i]);
-        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
-                (void *)outputAddr);
-        mixer->setParameter(
-                name,
-                AudioMixer::TRACK,
-                AudioMixer::MIXER_FORMAT,
-                (void *)(uintptr_t)mixerFormat);
-        mixer->setParameter(
-                name,
-                AudioMixer::TRACK,
-                AudioMixer::FORMAT,
-                (void *)(uintptr_t)formats[i]);
-        mixer->setParameter(
-                name,
-                AudioMixer::TRACK,
-                AudioMixer::MIXER_CHANNEL_MASK,
-                (void *)(uintptr_t)outputChannelMask);
-        mixer->setParameter(
-                name,
-                AudioMixer::TRACK,
-                AudioMixer::CHANNEL_MASK,
-                (void *)(uintptr_t)channelMask);
-        mixer->setParameter(
-                name,
-                AudioMixer::RESAMPLE,
-                AudioMixer::SAMPLE_RATE,
-                (void *)(uintptr_t)providers[i].getSampleRate());
-        if (useRamp) {
-            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &f0);
-            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &f0);
-            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME0, &f);
-            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME1, &f);
-        } else {
-            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &f);
-            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &f);
-        }
+    if (threadCount > 1) {
+        // benchmark mode: compare the multithreaded mix with the single threaded mix.
+        void *referenceAddr = NULL;
+        (void) posix_memalign(&referenceAddr, 32, outputSize);
+        void *referenceAuxAddr = NULL;
         if (auxFilename) {
-            mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::AUX_BUFFER,
-                    (void *) auxAddr);
-            mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::AUXLEVEL, &f0);
-            mixer->setParameter(name, AudioMixer::RAMP_VOLUME, AudioMixer::AUXLEVEL, &f);
+            (void) posix_memalign(&referenceAuxAddr, 32, auxSize);
         }
-        mixer->enable(name);
-    }
-
-    // pump the mixer to process data.
-    size_t i;
-    for (i = 0; i < outputFrames - mixerFrameCount; i += mixerFrameCount) {
-        for (size_t j = 0; j < names.size(); ++j) {
-            mixer->setParameter(names[j], AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
-                    (char *) outputAddr + i * outputFrameSize);
-            if (auxFilename) {
-                mixer->setParameter(names[j], AudioMixer::TRACK, AudioMixer::AUX_BUFFER,
-                        (char *) auxAddr + i * auxFrameSize);
+        int64_t serialNs = INT64_MAX;
+        int64_t parallelNs = INT64_MAX;
+        size_t frames;
+        for (int pass = 0; pass < kBenchmarkPasses; ++pass) {
+            memset(referenceAddr, 0, outputSize);
+            if (referenceAuxAddr) {
+                memset(referenceAuxAddr, 0, auxSize);
             }
+            frames = outputFrames;
+            serialNs = std::min(serialNs, mix(providers, formats, 1 /* threadCount */,
+                    useMixerFloat, useRamp, outputSampleRate, outputChannels,
+                    referenceAddr, referenceAuxAddr, &frames));
+            memset(outputAddr, 0, outputSize);
+            if (auxAddr) {
+                memset(auxAddr, 0, auxSize);
+            }
+            frames = outputFrames;
+            parallelNs = std::min(parallelNs, mix(providers, formats, threadCount,
+                    useMixerFloat, useRamp, outputSampleRate, outputChannels,
+                    outputAddr, auxAddr, &frames));
         }
-        mixer->process();
+        outputFrames = frames;
+        const size_t periods = outputFrames / kMixerFrameCount;
+        printf("%zu tracks, %zu periods of %zu frames\n",
+                providers.size(), periods, kMixerFrameCount);
+        printf("1 thread: %.2f us/period\n", serialNs * 1e-3 / periods);
+        printf("%zu threads: %.2f us/period\n", threadCount, parallelNs * 1e-3 / periods);
+        printf("speedup: %.2fx\n", (double)serialNs / parallelNs);
+        const bool identical = memcmp(referenceAddr, outputAddr, outputSize) == 0
+                && (auxAddr == NULL || memcmp(referenceAuxAddr, auxAddr, auxSize) == 0);
+        printf("output %s\n", identical ? "identical" : "DIFFERS");
+        free(referenceAddr);
+        free(referenceAuxAddr);
+        if (!identical) {
+            free(outputAddr);
+            free(auxAddr);
+            return EXIT_FAILURE;
+        }
+    } else {
+        mix(providers, formats, 1 /* threadCount */, useMixerFloat, useRamp,
+                outputSampleRate, outputChannels, outputAddr, auxAddr, &outputFrames);
     }
-    outputFrames = i; // reset output frames to the data actually produced.
 
     // write to files
     writeFile(outputFilename, outputAddr,
@@ -320,7 +400,6 @@ int main(int argc, char* argv[]) {
         writeFile(auxFilename, auxAddr, outputSampleRate, 1, outputFrames, false);
     }
 
-    delete mixer;
     free(outputAddr);
     free(auxAddr);
     return EXIT_SUCCESS;
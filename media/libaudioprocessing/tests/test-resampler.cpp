@@ -46,7 +46,7 @@ static int usage(const char* name) {
     fprintf(stderr,"    -f    enable filter profiling\n");
     fprintf(stderr,"    -F    enable floating point -q {dlq|dmq|dhq} only");
     fprintf(stderr,"    -v    verbose : log buffer provider calls\n");
-    fprintf(stderr,"    -c    # channels (1-2 for lq|mq|hq; 1-8 for dlq|dmq|dhq)\n");
+    fprintf(stderr,"    -c    # channels (1-2 for lq|mq|hq; 1-%d for dlq|dmq|dhq)\n", FCC_LIMIT);
     fprintf(stderr,"    -q    resampler quality\n");
     fprintf(stderr,"              dq  : default quality\n");
     fprintf(stderr,"              lq  : low quality\n");
@@ -180,7 +180,7 @@ int main(int argc, char* argv[]) {
     }
 
     if (channels < 1
-            || channels > (quality < AudioResampler::DYN_LOW_QUALITY ? 2 : 8)) {
+            || channels > (quality < AudioResampler::DYN_LOW_QUALITY ? FCC_2 : FCC_LIMIT)) {
         fprintf(stderr, "invalid number of audio channels %d\n", channels);
         return -1;
     }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/AudioBufferProvider.h>
+#include <media/BufferProviders.h>
+
+using namespace android;
+
+// Benchmarks TimestretchBufferProvider pulling a mixer period of stereo float
+// data, as done by the AudioMixer for a track with a playback speed.
+// The default provider uses Sonic; the preallocated provider uses the
+// WSOLA time stretcher.
+
+// An endless sine provider.
+class LoopProvider : public AudioBufferProvider {
+public:
+    LoopProvider(uint32_t channelCount, uint32_t sampleRate)
+        : mChannelCount(channelCount)
+        , mData(kFrameCount * channelCount) {
+        for (size_t i = 0; i < kFrameCount; ++i) {
+            const float value = sinf(2 * M_PI * 220. * i / sampleRate) * 0.5f;
+            for (size_t j = 0; j < channelCount; ++j) {
+                mData[i * channelCount + j] = value;
+            }
+        }
+    }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        const size_t available = kFrameCount - mIndex;
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->raw = &mData[mIndex * mChannelCount];
+        return OK;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mIndex += buffer->frameCount;
+        if (mIndex >= kFrameCount) {
+            mIndex = 0;
+        }
+        buffer->frameCount = 0;
+        buffer->raw = nullptr;
+    }
+
+private:
+    static constexpr size_t kFrameCount = 4800; // multiple of the 220 Hz period
+    const uint32_t mChannelCount;
+    std::vector<float> mData;
+    size_t mIndex = 0;
+};
+
+template <bool PREALLOCATED>
+static void BM_Timestretch(benchmark::State& state) {
+    constexpr uint32_t kChannelCount = 2;
+    constexpr uint32_t kSampleRate = 48000;
+    constexpr size_t kFrameCount = 960; // 20 ms mix period
+    AudioPlaybackRate playbackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+    playbackRate.mSpeed = state.range(0) / 100.f;
+
+    LoopProvider source(kChannelCount, kSampleRate);
+    TimestretchBufferProvider provider(kChannelCount, AUDIO_FORMAT_PCM_FLOAT, kSampleRate,
+            playbackRate, PREALLOCATED ? kFrameCount : 0 /* bufferFrameCount */);
+    provider.setBufferProvider(&source);
+
+    while (state.KeepRunning()) {
+        for (size_t frames = 0; frames < kFrameCount; ) {
+            AudioBufferProvider::Buffer buffer;
+            buffer.frameCount = kFrameCount - frames;
+            provider.getNextBuffer(&buffer);
+            benchmark::DoNotOptimize(buffer.raw);
+            frames += buffer.frameCount;
+            provider.releaseBuffer(&buffer);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kFrameCount);
+}
+
+static void SpeedArgs(benchmark::internal::Benchmark* b) {
+    for (int percent : { 100, 125, 150, 200 }) {
+        b->Arg(percent);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Timestretch, false /* PREALLOCATED */)->Apply(SpeedArgs);
+BENCHMARK_TEMPLATE(BM_Timestretch, true /* PREALLOCATED */)->Apply(SpeedArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_timestretch_tests"
+
+#include <math.h>
+#include <string.h>
+
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+#include <media/AudioBufferProvider.h>
+#include <media/BufferProviders.h>
+
+using namespace android;
+
+static constexpr uint32_t kSampleRate = 48000;
+static constexpr uint32_t kChannelCount = 2;
+static constexpr size_t kBufferFrameCount = 1024; // for the preallocated provider
+
+// Provides an endless sine wave, and counts the frames consumed.
+template <typename T>
+class SineProvider : public AudioBufferProvider {
+public:
+    explicit SineProvider(double frequency)
+        : mFrequency(frequency)
+        , mData(kFrameCount * kChannelCount) { }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        if (buffer->frameCount > kFrameCount) {
+            buffer->frameCount = kFrameCount;
+        }
+        for (size_t i = 0; i < buffer->frameCount; ++i) {
+            const double value =
+                    0.5 * sin(2 * M_PI * mFrequency * (mConsumed + i) / kSampleRate);
+            for (size_t j = 0; j < kChannelCount; ++j) {
+                if constexpr (std::is_same_v<T, int16_t>) {
+                    mData[i * kChannelCount + j] = lrint(value * 32767.);
+                } else {
+                    mData[i * kChannelCount + j] = value;
+                }
+            }
+        }
+        buffer->raw = mData.data();
+        return OK;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mConsumed += buffer->frameCount;
+        buffer->frameCount = 0;
+        buffer->raw = nullptr;
+    }
+
+    size_t getConsumed() const { return mConsumed; }
+
+private:
+    static constexpr size_t kFrameCount = 4096;
+    const double mFrequency;
+    std::vector<T> mData;
+    size_t mConsumed = 0;
+};
+
+// Pulls outputFrames from the time stretcher, converted to float.
+template <typename T>
+static void pull(TimestretchBufferProvider* provider, size_t outputFrames,
+        std::vector<float>* output) {
+    output->clear();
+    while (output->size() < outputFrames * kChannelCount) {
+        AudioBufferProvider::Buffer buffer;
+        buffer.frameCount = std::min(outputFrames - output->size() / kChannelCount,
+                (size_t)480);
+        EXPECT_EQ(OK, provider->getNextBuffer(&buffer));
+        if (buffer.frameCount == 0) {
+            ADD_FAILURE() << "no frames returned";
+            break;
+        }
+        const T* data = static_cast<const T*>(buffer.raw);
+        for (size_t i = 0; i < buffer.frameCount * kChannelCount; ++i) {
+            output->push_back(std::is_same_v<T, int16_t> ? data[i] / 32768.f : data[i]);
+        }
+        provider->releaseBuffer(&buffer);
+    }
+}
+
+// Pulls outputFrames from a new time stretcher, converted to float.
+// Returns the source frames consumed.
+template <typename T>
+static size_t timestretch(float speed, double frequency, bool preallocated,
+        size_t outputFrames, std::vector<float>* output) {
+    constexpr audio_format_t format = std::is_same_v<T, int16_t>
+            ? AUDIO_FORMAT_PCM_16_BIT : AUDIO_FORMAT_PCM_FLOAT;
+    AudioPlaybackRate playbackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+    playbackRate.mSpeed = speed;
+    SineProvider<T> source(frequency);
+    TimestretchBufferProvider provider(kChannelCount, format, kSampleRate, playbackRate,
+            preallocated ? kBufferFrameCount : 0);
+    provider.setBufferProvider(&source);
+    pull<T>(&provider, outputFrames, output);
+    return source.getConsumed();
+}
+
+// Returns the signal to noise ratio in dB of the first channel of a time stretched
+// sine, fitting the sine to each block, as time stretching changes the phase.
+static double sineSnr(const std::vector<float>& output, double frequency, size_t skipFrames) {
+    constexpr size_t kBlockFrames = 1024;
+    const double w = 2 * M_PI * frequency / kSampleRate;
+    const size_t frames = output.size() / kChannelCount;
+    double signal = 0.;
+    double noise = 0.;
+    for (size_t block = skipFrames; block + kBlockFrames <= frames; block += kBlockFrames) {
+        // least squares fit of a * sin(w * i) + b * cos(w * i)
+        double ss = 0., cc = 0., sc = 0., ys = 0., yc = 0.;
+        for (size_t i = block; i < block + kBlockFrames; ++i) {
+            const double s = sin(w * i);
+            const double c = cos(w * i);
+            const double y = output[i * kChannelCount];
+            ss += s * s;
+            cc += c * c;
+            sc += s * c;
+            ys += y * s;
+            yc += y * c;
+        }
+        const double det = ss * cc - sc * sc;
+        const double a = (ys * cc - yc * sc) / det;
+        const double b = (yc * ss - ys * sc) / det;
+        for (size_t i = block; i < block + kBlockFrames; ++i) {
+            const double fit = a * sin(w * i) + b * cos(w * i);
+            const double error = output[i * kChannelCount] - fit;
+            signal += fit * fit;
+            noise += error * error;
+        }
+    }
+    return 10. * log10(signal / noise);
+}
+
+template <typename T>
+static void testWsolaVsSonic(float speed, double frequency) {
+    constexpr size_t kOutputFrames = kSampleRate * 2;
+    constexpr size_t kSkipFrames = kSampleRate / 10; // startup latency
+    std::vector<float> sonic;
+    std::vector<float> wsola;
+    const size_t sonicConsumed =
+            timestretch<T>(speed, frequency, false /* preallocated */, kOutputFrames, &sonic);
+    const size_t wsolaConsumed =
+            timestretch<T>(speed, frequency, true /* preallocated */, kOutputFrames, &wsola);
+
+    // both consume the source at the playback speed, apart from startup latency.
+    const double sonicSpeed = (double)sonicConsumed / kOutputFrames;
+    const double wsolaSpeed = (double)wsolaConsumed / kOutputFrames;
+    EXPECT_NEAR(speed, sonicSpeed, speed * 0.05);
+    EXPECT_NEAR(speed, wsolaSpeed, speed * 0.05);
+
+    // the preallocated time stretcher should not sound worse than Sonic.
+    const double sonicSnr = sineSnr(sonic, frequency, kSkipFrames);
+    const double wsolaSnr = sineSnr(wsola, frequency, kSkipFrames);
+    ALOGD("speed %f frequency %f: sonic speed %f snr %f  wsola speed %f snr %f",
+            speed, frequency, sonicSpeed, sonicSnr, wsolaSpeed, wsolaSnr);
+    EXPECT_GT(wsolaSnr, 25.);
+    EXPECT_GT(wsolaSnr, sonicSnr - 10.);
+}
+
+TEST(audioflinger_timestretch, wsola_vs_sonic_float) {
+    for (float speed : { 0.5f, 1.25f, 1.5f, 2.f, 3.f }) {
+        for (double frequency : { 220., 997. }) {
+            testWsolaVsSonic<float>(speed, frequency);
+        }
+    }
+}
+
+TEST(audioflinger_timestretch, wsola_vs_sonic_int16) {
+    for (float speed : { 0.75f, 1.5f }) {
+        testWsolaVsSonic<int16_t>(speed, 440.);
+    }
+}
+
+TEST(audioflinger_timestretch, wsola_normal_speed_float) {
+    // at normal speed the output matches the input.
+    constexpr double kFrequency = 997.;
+    constexpr size_t kOutputFrames = kSampleRate;
+    std::vector<float> output;
+    timestretch<float>(1.f, kFrequency, true /* preallocated */, kOutputFrames, &output);
+    for (size_t i = 0; i < kOutputFrames; ++i) {
+        const float expected = 0.5 * sin(2 * M_PI * kFrequency * i / kSampleRate);
+        ASSERT_NEAR(expected, output[i * kChannelCount], 1e-5) << "frame " << i;
+    }
+}
+
+TEST(audioflinger_timestretch, preallocated_buffer_limit) {
+    AudioPlaybackRate playbackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+    playbackRate.mSpeed = 1.5f;
+    SineProvider<float> source(440.);
+    TimestretchBufferProvider provider(kChannelCount, AUDIO_FORMAT_PCM_FLOAT, kSampleRate,
+            playbackRate, kBufferFrameCount);
+    provider.setBufferProvider(&source);
+
+    // requests larger than the preallocated buffer are shortened, not reallocated.
+    for (int i = 0; i < 10; ++i) {
+        AudioBufferProvider::Buffer buffer;
+        buffer.frameCount = kBufferFrameCount * 4;
+        ASSERT_EQ(OK, provider.getNextBuffer(&buffer));
+        EXPECT_GT(buffer.frameCount, 0u);
+        EXPECT_LE(buffer.frameCount, kBufferFrameCount);
+        provider.releaseBuffer(&buffer);
+    }
+}
+
+TEST(audioflinger_timestretch, wsola_reset_float) {
+    constexpr float kSpeed = 1.5f;
+    constexpr size_t kOutputFrames = kSampleRate / 2;
+    AudioPlaybackRate playbackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+    playbackRate.mSpeed = kSpeed;
+    TimestretchBufferProvider provider(kChannelCount, AUDIO_FORMAT_PCM_FLOAT, kSampleRate,
+            playbackRate, kBufferFrameCount);
+    std::vector<float> output;
+    SineProvider<float> before(220.);
+    provider.setBufferProvider(&before);
+    pull<float>(&provider, kOutputFrames, &output);
+
+    // after a reset, nothing from the previous source is output.
+    provider.reset();
+    SineProvider<float> after(997.);
+    provider.setBufferProvider(&after);
+    pull<float>(&provider, kOutputFrames, &output);
+
+    std::vector<float> expected;
+    timestretch<float>(kSpeed, 997., true /* preallocated */, kOutputFrames, &expected);
+    ASSERT_EQ(expected.size(), output.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(expected[i], output[i]) << "sample " << i;
+    }
+}
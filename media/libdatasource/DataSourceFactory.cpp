@@ -110,7 +110,13 @@ sp<DataSource> DataSourceFactory::CreateFromURI(
 
 sp<DataSource> DataSourceFactory::CreateFromFd(int fd, int64_t offset, int64_t length) {
     sp<FileSource> source = new FileSource(fd, offset, length);
-    return source->initCheck() != OK ? nullptr : source;
+    if (source->initCheck() != OK) {
+        return nullptr;
+    }
+    // Files which cannot be truncated, such as those of the read-only partitions, are
+    // read from a mapping. Other files are left to pread64().
+    (void)source->enableMmap();
+    return source;
 }
 
 sp<DataSource> DataSourceFactory::CreateMediaHTTP(const sp<MediaHTTPService> &httpService) {
@@ -23,9 +23,13 @@
 #include <media/stagefright/FoundationUtils.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <fcntl.h>
+#include <linux/fs.h>
 
 namespace android {
 
@@ -33,7 +37,10 @@ FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
       mLength(-1),
-      mName("<null>") {
+      mName("<null>"),
+      mMapBase(nullptr),
+      mMapSize(0),
+      mMapData(nullptr) {
 
     if (filename) {
         mName = String8::format("FileSource(%s)", filename);
@@ -52,7 +59,10 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
     : mFd(fd),
       mOffset(offset),
       mLength(length),
-      mName("<null>") {
+      mName("<null>"),
+      mMapBase(nullptr),
+      mMapSize(0),
+      mMapData(nullptr) {
     ALOGV("fd=%d (%s), offset=%lld, length=%lld",
             fd, nameForFd(fd).c_str(), (long long) offset, (long long) length);
 
@@ -90,6 +100,11 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
 }
 
 FileSource::~FileSource() {
+    if (mMapBase != nullptr) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = nullptr;
+        mMapData = nullptr;
+    }
     if (mFd >= 0) {
         ::close(mFd);
         mFd = -1;
@@ -105,7 +120,8 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
+    // mFd, mOffset and mLength do not change after construction and readAt_l() does not
+    // use the file position, so concurrent reads need no lock.
     if (mLength >= 0) {
         if (offset < 0) {
             return UNKNOWN_ERROR;
@@ -122,18 +138,85 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 }
 
 ssize_t FileSource::readAt_l(off64_t offset, void *data, size_t size) {
-    off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-    if (result == -1) {
-        ALOGE("seek to %lld failed", (long long)(offset + mOffset));
-        return UNKNOWN_ERROR;
+    if (mMapData != nullptr) {
+        if (offset < 0 || offset > mLength || (uint64_t)size > (uint64_t)(mLength - offset)) {
+            return UNKNOWN_ERROR;
+        }
+        memcpy(data, mMapData + offset, size);
+        return size;
     }
 
-    return ::read(mFd, data, size);
+    ssize_t result;
+    do {
+        result = pread64(mFd, data, size, offset + mOffset);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        ALOGE("read at %lld failed (%s)", (long long)(offset + mOffset), strerror(errno));
+    }
+    return result;
 }
 
-status_t FileSource::getSize(off64_t *size) {
-    Mutex::Autolock autoLock(mLock);
+const void *FileSource::getView(off64_t offset, size_t size) {
+    if (mMapData == nullptr
+            || offset < 0 || offset > mLength || (uint64_t)size > (uint64_t)(mLength - offset)) {
+        return nullptr;
+    }
+    return mMapData + offset;
+}
 
+// Whether the file can be truncated while it is mapped, after which reading the mapping past
+// the new end of the file raises SIGBUS. Sealed memfds, immutable and fs-verity files, and
+// files on read-only mounts such as the platform partitions cannot shrink.
+static bool canShrink(int fd) {
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals >= 0 && (seals & F_SEAL_SHRINK)) {
+        return false;
+    }
+    int attrs = 0;
+    if (ioctl(fd, FS_IOC_GETFLAGS, &attrs) == 0
+            && (attrs & (FS_IMMUTABLE_FL | FS_VERITY_FL))) {
+        return false;
+    }
+    struct statvfs vfs;
+    if (fstatvfs(fd, &vfs) == 0 && (vfs.f_flag & ST_RDONLY)) {
+        return false;
+    }
+    return true;
+}
+
+status_t FileSource::enableMmap() {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+    if (mMapData != nullptr) {
+        return OK;
+    }
+
+    // on 32-bit processes, leave the address space to the codecs.
+    static constexpr int64_t kMaxMapSize =
+            sizeof(void *) >= sizeof(int64_t) ? INT64_MAX : (int64_t)256 << 20;
+    struct stat s;
+    if (fstat(mFd, &s) != 0 || !S_ISREG(s.st_mode) || mLength <= 0
+            || mLength > kMaxMapSize || canShrink(mFd)) {
+        ALOGV("not mapping %s", mName.c_str());
+        return INVALID_OPERATION;
+    }
+
+    const int64_t pageSize = sysconf(_SC_PAGESIZE);
+    const int64_t mapOffset = mOffset - mOffset % pageSize;
+    const size_t mapSize = mLength + (mOffset - mapOffset);
+    void *base = mmap64(nullptr, mapSize, PROT_READ, MAP_SHARED, mFd, mapOffset);
+    if (base == MAP_FAILED) {
+        ALOGW("failed to map %s (%s)", mName.c_str(), strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    mMapBase = base;
+    mMapSize = mapSize;
+    mMapData = (const uint8_t *)base + (mOffset - mapOffset);
+    return OK;
+}
+
+status_t FileSource::getSize(off64_t *size) {
     if (mFd < 0) {
         return NO_INIT;
     }
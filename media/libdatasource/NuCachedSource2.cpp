@@ -299,7 +299,9 @@ status_t NuCachedSource2::getSize(off64_t *size) {
 
 uint32_t NuCachedSource2::flags() {
     // Remove HTTP related flags since NuCachedSource2 is not HTTP-based.
-    uint32_t flags = mSource->flags() & ~(kWantsPrefetching | kIsHTTPBasedSource);
+    // Cached pages are recycled as the source is read, so it cannot provide views either.
+    uint32_t flags = mSource->flags()
+            & ~(kWantsPrefetching | kIsHTTPBasedSource | kCanProvideViews);
     return (flags | kIsCachingDataSource);
 }
 
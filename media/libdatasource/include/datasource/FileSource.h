@@ -38,16 +38,29 @@ public:
 
     virtual status_t getSize(off64_t *size);
 
+    // Maps the source into memory, so that readAt() copies from the mapping instead of
+    // reading from the fd, and getView() returns views of the mapping. Only regular files
+    // that cannot be truncated while they are mapped are mapped: sealed memfds, immutable
+    // and fs-verity files, and files on read-only mounts. Returns INVALID_OPERATION for
+    // other sources, which are then read with pread64(). Must be called before the source
+    // is read from.
+    status_t enableMmap();
+
     virtual uint32_t flags() {
-        return kIsLocalFileSource;
+        return kIsLocalFileSource | (mMapData != nullptr ? kCanProvideViews : 0);
     }
 
+    // Returns a view of the mapping, see enableMmap().
+    virtual const void *getView(off64_t offset, size_t size);
+
     virtual String8 toString() {
         return mName;
     }
 
 protected:
     virtual ~FileSource();
+    // Reads from the mapping or with pread64(), so it does not need mLock. The read must
+    // have been clamped to mLength.
     virtual ssize_t readAt_l(off64_t offset, void *data, size_t size);
 
     int mFd;
@@ -57,6 +70,9 @@ protected:
 
 private:
     String8 mName;
+    void *mMapBase;           // page aligned start of the mapping, or nullptr
+    size_t mMapSize;
+    const uint8_t *mMapData;  // the source at mOffset within the mapping
 
     FileSource(const FileSource &);
     FileSource &operator=(const FileSource &);
@@ -68,8 +68,6 @@ ssize_t PlayerServiceFileSource::readAt(off64_t offset, void *data, size_t size)
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset < 0) {
             return UNKNOWN_ERROR;
@@ -85,12 +83,22 @@ ssize_t PlayerServiceFileSource::readAt(off64_t offset, void *data, size_t size)
 
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
+        // the DRM cache is shared by all readers.
+        Mutex::Autolock autoLock(mLock);
         return readAtDRM_l(offset, data, size);
    } else {
         return readAt_l(offset, data, size);
     }
 }
 
+const void *PlayerServiceFileSource::getView(off64_t offset, size_t size) {
+    if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
+            == mDecryptHandle->decryptApiType) {
+        return NULL;
+    }
+    return FileSource::getView(offset, size);
+}
+
 sp<DecryptHandle> PlayerServiceFileSource::DrmInitialization(const char *mime) {
     if (getuid() == AID_MEDIA_EX) {
        return NULL; // no DRM in media extractor
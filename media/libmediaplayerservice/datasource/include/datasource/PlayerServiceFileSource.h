@@ -37,6 +37,9 @@ public:
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    // Views of the file would bypass the decryption of DRM protected files.
+    virtual const void *getView(off64_t offset, size_t size);
+
     static bool requiresDrm(int fd, int64_t offset, int64_t length, const char *mime);
 
 protected:
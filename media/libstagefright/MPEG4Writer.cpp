@@ -22,6 +22,7 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
@@ -72,6 +73,10 @@ static const uint8_t kNalUnitTypePicParamSet = 0x08;
 static const int64_t kInitialDelayTimeUs     = 700000LL;
 static const int64_t kMaxMetadataSize = 0x4000000LL;   // 64MB max per-frame metadata size
 static const int64_t kMaxCttsOffsetTimeUs = 30 * 60 * 1000000LL;  // 30 minutes
+// Sample flags of fragments, ISO/IEC 14496-12 8.8.3.1
+static const uint32_t kSyncSampleFlags = 0x02000000;     // sample_depends_on = 2
+static const uint32_t kNonSyncSampleFlags = 0x01010000;  // sample_depends_on = 1, non sync
+static const size_t kWriteStagingBufferAlignment = 4096;
 static const size_t kESDSScratchBufferSize = 10;  // kMaxAtomSize in Mpeg4Extractor 64MB
 
 static const char kMetaKey_Version[]    = "com.android.version";
@@ -153,6 +158,7 @@ public:
     void writeTrackHeader();
     int64_t getMinCttsOffsetTimeUs();
     void bufferChunk(int64_t timestampUs);
+    void bufferFragment(int64_t timestampUs);
     bool isAvc() const { return mIsAvc; }
     bool isHevc() const { return mIsHevc; }
     bool isHeic() const { return mIsHeic; }
@@ -339,6 +345,8 @@ private:
     List<MediaBuffer *> mChunkSamples;
 
     bool mSamplesHaveSameSize;
+    uint32_t mNumSamples;
+    uint32_t mNumSyncSamples;
     ListTableEntries<uint32_t, 1> *mStszTableEntries;
     ListTableEntries<off64_t, 1> *mCo64TableEntries;
     ListTableEntries<uint32_t, 3> *mStscTableEntries;
@@ -351,6 +359,10 @@ private:
     int64_t mMinCttsOffsetTicks;
     int64_t mMaxCttsOffsetTicks;
 
+    // Samples of the current fragment in fragmented mode, in place of the sample tables.
+    std::vector<FragmentSample> mFragmentSamples;
+    int64_t mFragmentDecodeTicks;  // Decoding time of the current fragment
+
     // Save the last 10 frames' timestamp and frame type for debug.
     struct TimestampDebugHelperEntry {
         int64_t pts;
@@ -560,6 +572,15 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
     mDone = false;
     mThread = 0;
     mDriftTimeUs = 0;
+    mFragmentSequenceNumber = 0;
+    mFragmentedMoovWritten = false;
+    mMehdOffset = 0;
+    mFragmentIndex.clear();
+    mBatchingWrites = false;
+    mWriteStagingBuffer = NULL;
+    mTotalChunkWriteDuration = std::chrono::microseconds::zero();
+    mNumChunksWritten = 0;
+    mNumWriteCalls = 0;
 
     // Following variables only need to be set for the first recording session.
     // And they will stay the same for all the recording sessions.
@@ -573,6 +594,8 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
         mAreGeoTagsAvailable = false;
         mSwitchPending = false;
         mIsFileSizeLimitExplicitlyRequested = false;
+        mFragmentDurationUs = 0;
+        mWriteStagingBufferSize = 0;
     }
 
     // Verify mFd is seekable
@@ -623,7 +646,7 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
-    snprintf(buffer, SIZE, "       frames encoded : %d\n", mStszTableEntries->count());
+    snprintf(buffer, SIZE, "       frames encoded : %d\n", mNumSamples);
     result.append(buffer);
     snprintf(buffer, SIZE, "       duration encoded : %" PRId64 " us\n", mTrackDurationUs);
     result.append(buffer);
@@ -998,6 +1021,15 @@ status_t MPEG4Writer::start(MetaData *param) {
         return err;
     }
 
+    if (mFragmentDurationUs > 0) {
+        if (mHasFileLevelMeta) {
+            ALOGE("Fragmented mode is not supported for image tracks");
+            return ERROR_UNSUPPORTED;
+        }
+        // The moov box goes ahead of the fragments, so there is no space to reserve for it.
+        mStreamableFile = false;
+    }
+
     ALOGV("muxer starting: mHasMoovBox %d, mHasFileLevelMeta %d",
             mHasMoovBox, mHasFileLevelMeta);
 
@@ -1053,7 +1085,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     seekOrPostError(mFd, mMdatOffset, SEEK_SET);
-    write("\x00\x00\x00\x01mdat????????", 16);
+    if (mFragmentDurationUs == 0) {
+        write("\x00\x00\x00\x01mdat????????", 16);
+    }
 
     /* Confirm whether the writing of the initial file atoms, ftyp and free,
      * are written to the file properly by posting kWhatNoIOErrorSoFar to the
@@ -1183,6 +1217,39 @@ void MPEG4Writer::printWriteDurations() {
         mWriteDurationPQ.pop();
     }
     ALOGD("%s", writeDurationsString.c_str());
+
+    if (mNumChunksWritten == 0) {
+        return;
+    }
+    std::string chunkDurationsString = std::to_string(mNumChunksWritten) + " chunks in " +
+            std::to_string(mNumWriteCalls) + " write calls, average chunk write duration:" +
+            std::to_string(mTotalChunkWriteDuration.count() / mNumChunksWritten) +
+            ", top " + std::to_string(mChunkWriteDurationPQ.size()) +
+            " chunk write durations(microseconds):";
+    i = 0;
+    while (!mChunkWriteDurationPQ.empty()) {
+        chunkDurationsString += " #" + std::to_string(++i) + ":" +
+                std::to_string(mChunkWriteDurationPQ.top().count());
+        mChunkWriteDurationPQ.pop();
+    }
+    ALOGD("%s", chunkDurationsString.c_str());
+}
+
+void MPEG4Writer::addWriteDuration(std::chrono::microseconds duration) {
+    ++mNumWriteCalls;
+    mWriteDurationPQ.emplace(duration);
+    if (mWriteDurationPQ.size() > kWriteDurationsCount) {
+        mWriteDurationPQ.pop();
+    }
+}
+
+void MPEG4Writer::addChunkWriteDuration(std::chrono::microseconds duration) {
+    ++mNumChunksWritten;
+    mTotalChunkWriteDuration += duration;
+    mChunkWriteDurationPQ.emplace(duration);
+    if (mChunkWriteDurationPQ.size() > kWriteDurationsCount) {
+        mChunkWriteDurationPQ.pop();
+    }
 }
 
 status_t MPEG4Writer::release() {
@@ -1226,6 +1293,8 @@ status_t MPEG4Writer::release() {
     mStarted = false;
     free(mInMemoryCache);
     mInMemoryCache = NULL;
+    free(mWriteStagingBuffer);
+    mWriteStagingBuffer = NULL;
 
     printWriteDurations();
 
@@ -1348,12 +1417,23 @@ status_t MPEG4Writer::reset(bool stopSource, bool waitForAnyPreviousCallToComple
         return mResetStatus;
     }
 
-    // Fix up the size of the 'mdat' chunk.
-    seekOrPostError(mFd, mMdatOffset + 8, SEEK_SET);
-    uint64_t size = mOffset - mMdatOffset;
-    size = hton64(size);
-    writeOrPostError(mFd, &size, 8);
-    seekOrPostError(mFd, mOffset, SEEK_SET);
+    if (mFragmentDurationUs > 0) {
+        // The moov box and the fragments are in the file already. Fill in the duration, and
+        // index the fragments.
+        seekOrPostError(mFd, mMehdOffset + 12, SEEK_SET);
+        uint64_t duration = (maxDurationUs * mTimeScale + 5E5) / 1E6;
+        duration = hton64(duration);
+        writeOrPostError(mFd, &duration, 8);
+        seekOrPostError(mFd, mOffset, SEEK_SET);
+        writeMfraBox();
+    } else {
+        // Fix up the size of the 'mdat' chunk.
+        seekOrPostError(mFd, mMdatOffset + 8, SEEK_SET);
+        uint64_t size = mOffset - mMdatOffset;
+        size = hton64(size);
+        writeOrPostError(mFd, &size, 8);
+        seekOrPostError(mFd, mOffset, SEEK_SET);
+    }
     mMdatEndOffset = mOffset;
 
     // Construct file-level meta and moov box now
@@ -1376,7 +1456,7 @@ status_t MPEG4Writer::reset(bool stopSource, bool waitForAnyPreviousCallToComple
         }
     }
 
-    if (mHasMoovBox) {
+    if (mHasMoovBox && mFragmentDurationUs == 0) {
         writeMoovBox(maxDurationUs);
         // mWriteBoxToMemory could be set to false in
         // MPEG4Writer::write() method
@@ -1489,10 +1569,11 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
     }
     writeMoovLevelMetaBox();
     // Loop through all the tracks to get the global time offset if there is
-    // any ctts table appears in a video track.
+    // any ctts table appears in a video track. Fragments have signed composition
+    // offsets instead.
     int64_t minCttsOffsetTimeUs = kMaxCttsOffsetTimeUs;
     for (List<Track *>::iterator it = mTracks.begin();
-        it != mTracks.end(); ++it) {
+        it != mTracks.end() && mFragmentDurationUs == 0; ++it) {
         if (!(*it)->isHeic()) {
             minCttsOffsetTimeUs =
                 std::min(minCttsOffsetTimeUs, (*it)->getMinCttsOffsetTimeUs());
@@ -1513,9 +1594,67 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
             (*it)->writeTrackHeader();
         }
     }
+    if (mFragmentDurationUs > 0) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    // The duration is filled in at the end.
+    mMehdOffset = mOffset;
+    beginBox("mehd");
+    writeInt32(1 << 24);  // version=1, flags=0
+    writeInt64(0);        // fragment duration
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin(); it != mTracks.end(); ++it) {
+        beginBox("trex");
+        writeInt32(0);  // version=0, flags=0
+        writeInt32((*it)->getTrackId().getId());
+        writeInt32(1);  // default sample description index
+        writeInt32(0);  // default sample duration
+        writeInt32(0);  // default sample size
+        writeInt32(0);  // default sample flags
+        endBox();  // trex
+    }
+    endBox();  // mvex
+}
+
+void MPEG4Writer::writeMfraBox() {
+    const off64_t mfraOffset = mOffset;
+    beginBox("mfra");
+    for (List<Track *>::iterator it = mTracks.begin(); it != mTracks.end(); ++it) {
+        // time and moof_offset, followed by 1-byte traf, trun and sample numbers
+        std::vector<uint8_t> entries;
+        for (const FragmentIndexEntry &entry : mFragmentIndex) {
+            if (entry.mTrack != *it) {
+                continue;
+            }
+            uint8_t data[19];
+            uint64_t value = hton64(entry.mDecodeTicks);
+            memcpy(data, &value, 8);
+            value = hton64(entry.mMoofOffset);
+            memcpy(data + 8, &value, 8);
+            data[16] = data[17] = data[18] = 1;
+            entries.insert(entries.end(), data, data + sizeof(data));
+        }
+        beginBox("tfra");
+        writeInt32(1 << 24);  // version=1, flags=0
+        writeInt32((*it)->getTrackId().getId());
+        writeInt32(0);        // 1-byte traf, trun and sample numbers
+        writeInt32(entries.size() / 19);
+        write(entries.data(), entries.size());
+        endBox();  // tfra
+    }
+    const uint32_t mfraSize = mOffset + 16 - mfraOffset;  // up to the end of mfro
+    beginBox("mfro");
+    writeInt32(0);  // version=0, flags=0
+    writeInt32(mfraSize);
+    endBox();  // mfro
+    endBox();  // mfra
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -1546,6 +1685,9 @@ void MPEG4Writer::writeFtypBox(MetaData *param) {
             writeFourcc("mp42");
         }
     }
+    if (mFragmentDurationUs > 0) {
+        writeFourcc("iso6");
+    }
 
     endBox();
 }
@@ -1583,6 +1725,25 @@ status_t MPEG4Writer::setInterleaveDuration(uint32_t durationUs) {
     return OK;
 }
 
+status_t MPEG4Writer::setFragmentDuration(uint32_t durationUs) {
+    if (mStarted) {
+        ALOGE("Fragment duration must be set before start");
+        return INVALID_OPERATION;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
+status_t MPEG4Writer::setWriteStagingBufferSize(uint32_t bytes) {
+    if (mStarted) {
+        ALOGE("Write staging buffer size must be set before start");
+        return INVALID_OPERATION;
+    }
+    // Whole pages, as for O_DIRECT
+    mWriteStagingBufferSize = align(bytes, kWriteStagingBufferAlignment);
+    return OK;
+}
+
 void MPEG4Writer::lock() {
     mLock.lock();
 }
@@ -1610,26 +1771,36 @@ off64_t MPEG4Writer::addSample_l(
         ALOGV("mOffset:%lld, mMaxOffsetAppend:%lld, bytesWritten:%lld", (long long)mOffset,
                   (long long)mMaxOffsetAppend, (long long)*bytesWritten);
         mMaxOffsetAppend = std::max(mOffset, mMaxOffsetAppend);
+        // The batch goes to the file position before the seek.
+        flushWriteBatch();
         seekOrPostError(mFd, mMaxOffsetAppend, SEEK_SET);
         return offset;
     }
 
     ALOGV("mOffset:%lld, mMaxOffsetAppend:%lld", (long long)mOffset, (long long)mMaxOffsetAppend);
 
+    // Write a sample of many NAL units in one go, if it is not part of a chunk.
+    const bool batchSample = !mBatchingWrites;
+    if (batchSample) {
+        beginWriteBatch();
+    }
     if (usePrefix) {
         addMultipleLengthPrefixedSamples_l(buffer);
     } else {
         if (tiffHdrOffset > 0) {
             tiffHdrOffset = htonl(tiffHdrOffset);
-            writeOrPostError(mFd, &tiffHdrOffset, 4);  // exif_tiff_header_offset field
+            batchFieldOrWrite(&tiffHdrOffset, 4);  // exif_tiff_header_offset field
             mOffset += 4;
         }
 
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(),
-                         buffer->range_length());
+        batchOrWrite((const uint8_t*)buffer->data() + buffer->range_offset(),
+                     buffer->range_length());
 
         mOffset += buffer->range_length();
     }
+    if (batchSample) {
+        endWriteBatch();
+    }
     *bytesWritten = mOffset - old_offset;
 
     ALOGV("mOffset:%lld, old_offset:%lld, bytesWritten:%lld", (long long)mOffset,
@@ -1687,8 +1858,8 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
         x[1] = (length >> 16) & 0xff;
         x[2] = (length >> 8) & 0xff;
         x[3] = length & 0xff;
-        writeOrPostError(mFd, &x, 4);
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(), length);
+        batchFieldOrWrite(&x, 4);
+        batchOrWrite((const uint8_t*)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 4;
     } else {
         ALOGV("mUse2ByteNalLength");
@@ -1697,8 +1868,8 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
         uint8_t x[2];
         x[0] = length >> 8;
         x[1] = length & 0xff;
-        writeOrPostError(mFd, &x, 2);
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(), length);
+        batchFieldOrWrite(&x, 2);
+        batchOrWrite((const uint8_t*)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 2;
     }
 }
@@ -1745,12 +1916,7 @@ void MPEG4Writer::writeOrPostError(int fd, const void* buf, size_t count) {
     auto beforeTP = std::chrono::high_resolution_clock::now();
     ssize_t bytesWritten = ::write(fd, buf, count);
     auto afterTP = std::chrono::high_resolution_clock::now();
-    auto writeDuration =
-            std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP).count();
-    mWriteDurationPQ.emplace(writeDuration);
-    if (mWriteDurationPQ.size() > kWriteDurationsCount) {
-        mWriteDurationPQ.pop();
-    }
+    addWriteDuration(std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP));
 
     /* Write as much as possible during stop() execution when there was an error
      * (mWriteSeekErr == true) in the previous call to write() or lseek64().
@@ -1768,6 +1934,109 @@ void MPEG4Writer::writeOrPostError(int fd, const void* buf, size_t count) {
     WARN_UNLESS(msg->post() == OK, "writeOrPostError:error posting ERROR_IO");
 }
 
+void MPEG4Writer::writevOrPostError(int fd, const struct iovec *iov, size_t iovcnt) {
+    while (iovcnt > 0 && mWriteSeekErr == false) {
+        const int count = std::min(iovcnt, (size_t)IOV_MAX);
+        size_t bytes = 0;
+        for (int i = 0; i < count; ++i) {
+            bytes += iov[i].iov_len;
+        }
+
+        auto beforeTP = std::chrono::high_resolution_clock::now();
+        ssize_t bytesWritten = ::writev(fd, iov, count);
+        auto afterTP = std::chrono::high_resolution_clock::now();
+        addWriteDuration(
+                std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP));
+
+        if (bytesWritten != (ssize_t)bytes) {
+            // As for writeOrPostError(), a short write is an error.
+            mWriteSeekErr = true;
+            ALOGE("writevOrPostError bytesWritten:%zd, count:%zu, error:%s(%d)", bytesWritten,
+                  bytes, std::strerror(errno), errno);
+            sp<AMessage> msg = new AMessage(kWhatIOError, mReflector);
+            msg->setInt32("err", ERROR_IO);
+            WARN_UNLESS(msg->post() == OK, "writevOrPostError:error posting ERROR_IO");
+            return;
+        }
+        iov += count;
+        iovcnt -= count;
+    }
+}
+
+void MPEG4Writer::beginWriteBatch() {
+    CHECK(!mBatchingWrites);
+    mBatchingWrites = true;
+}
+
+void MPEG4Writer::endWriteBatch() {
+    CHECK(mBatchingWrites);
+    flushWriteBatch();
+    mBatchingWrites = false;
+}
+
+void MPEG4Writer::flushWriteBatch() {
+    if (mWriteBatch.empty()) {
+        return;
+    }
+    if (mWriteStagingBufferSize > 0 && mWriteStagingBuffer == NULL) {
+        if (posix_memalign((void **)&mWriteStagingBuffer, kWriteStagingBufferAlignment,
+                           mWriteStagingBufferSize) != 0) {
+            ALOGW("Failed to allocate a write staging buffer of %" PRIu32 " bytes",
+                  mWriteStagingBufferSize);
+            mWriteStagingBuffer = NULL;
+            mWriteStagingBufferSize = 0;
+        }
+    }
+    if (mWriteStagingBuffer != NULL) {
+        // Fill up the staging buffer, and write it out whenever it is full.
+        size_t staged = 0;
+        for (const struct iovec &iov : mWriteBatch) {
+            const uint8_t *data = (const uint8_t *)iov.iov_base;
+            size_t size = iov.iov_len;
+            while (size > 0) {
+                const size_t copy = std::min(size, mWriteStagingBufferSize - staged);
+                memcpy(mWriteStagingBuffer + staged, data, copy);
+                staged += copy;
+                data += copy;
+                size -= copy;
+                if (staged == mWriteStagingBufferSize) {
+                    writeOrPostError(mFd, mWriteStagingBuffer, staged);
+                    staged = 0;
+                }
+            }
+        }
+        if (staged > 0) {
+            writeOrPostError(mFd, mWriteStagingBuffer, staged);
+        }
+    } else {
+        writevOrPostError(mFd, mWriteBatch.data(), mWriteBatch.size());
+    }
+    mWriteBatch.clear();
+    mWriteBatchFields.clear();
+}
+
+void MPEG4Writer::batchOrWrite(const void *buf, size_t count) {
+    if (!mBatchingWrites) {
+        writeOrPostError(mFd, buf, count);
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+    mWriteBatch.push_back({const_cast<void *>(buf), count});
+}
+
+void MPEG4Writer::batchFieldOrWrite(const void *field, size_t count) {
+    if (!mBatchingWrites) {
+        writeOrPostError(mFd, field, count);
+        return;
+    }
+    CHECK_LE(count, sizeof(mWriteBatchFields.back()));
+    mWriteBatchFields.emplace_back();
+    memcpy(mWriteBatchFields.back().data(), field, count);
+    batchOrWrite(mWriteBatchFields.back().data(), count);
+}
+
 void MPEG4Writer::seekOrPostError(int fd, off64_t offset, int whence) {
     if (mWriteSeekErr == true)
         return;
@@ -2172,6 +2441,8 @@ MPEG4Writer::Track::Track(
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
       mSamplesHaveSameSize(true),
+      mNumSamples(0),
+      mNumSyncSamples(0),
       mStszTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
       mCo64TableEntries(new ListTableEntries<off64_t, 1>(1000)),
       mStscTableEntries(new ListTableEntries<uint32_t, 3>(1000)),
@@ -2182,6 +2453,7 @@ MPEG4Writer::Track::Track(
       mMinCttsOffsetTimeUs(0),
       mMinCttsOffsetTicks(0),
       mMaxCttsOffsetTicks(0),
+      mFragmentDecodeTicks(0),
       mDoviProfile(0),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
@@ -2258,6 +2530,10 @@ void MPEG4Writer::Track::resetInternal() {
     mTrackDurationUs = 0;
     mEstimatedTrackSizeBytes = 0;
     mSamplesHaveSameSize = false;
+    mNumSamples = 0;
+    mNumSyncSamples = 0;
+    mFragmentSamples.clear();
+    mFragmentDecodeTicks = 0;
     if (mStszTableEntries != NULL) {
         delete mStszTableEntries;
         mStszTableEntries = new ListTableEntries<uint32_t, 1>(1000);
@@ -2318,6 +2594,10 @@ void MPEG4Writer::Track::addOneStscTableEntry(
 }
 
 void MPEG4Writer::Track::addOneStssTableEntry(size_t sampleId) {
+    if (mOwner->fragmentDuration() > 0) {
+        // Fragmented files flag the sync samples in the trun boxes instead.
+        return;
+    }
     mStssTableEntries->add(htonl(sampleId));
 }
 
@@ -2330,7 +2610,8 @@ void MPEG4Writer::Track::addOneSttsTableEntry(size_t sampleCount, int32_t delta)
 }
 
 void MPEG4Writer::Track::addOneCttsTableEntry(size_t sampleCount, int32_t sampleOffset) {
-    if (!mIsVideo) {
+    // Fragmented files carry the composition offsets in the trun boxes instead.
+    if (!mIsVideo || mOwner->fragmentDuration() > 0) {
         return;
     }
     mCttsTableEntries->add(htonl(sampleCount));
@@ -2738,10 +3019,20 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     ALOGV("writeChunkToFile: %" PRId64 " from %s track",
         chunk->mTimeStampUs, chunk->mTrack->getTrackType());
 
-    int32_t isFirstSample = true;
-    while (!chunk->mSamples.empty()) {
-        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+    auto beforeTP = std::chrono::high_resolution_clock::now();
+    if (mFragmentDurationUs > 0) {
+        writeFragmentToFile(chunk);
+        addChunkWriteDuration(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::high_resolution_clock::now() - beforeTP));
+        return;
+    }
 
+    // The samples and their length prefixes are written in one batch, so the buffers are
+    // released once they are all written.
+    beginWriteBatch();
+    int32_t isFirstSample = true;
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
         uint32_t tiffHdrOffset;
         if (!(*it)->meta_data().findInt32(
                 kKeyExifTiffOffset, (int32_t*)&tiffHdrOffset)) {
@@ -2759,12 +3050,111 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
             chunk->mTrack->addChunkOffset(offset);
             isFirstSample = false;
         }
+    }
+    endWriteBatch();
 
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
         (*it)->release();
         (*it) = NULL;
-        chunk->mSamples.erase(it);
     }
     chunk->mSamples.clear();
+    addChunkWriteDuration(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - beforeTP));
+}
+
+void MPEG4Writer::writeFragmentToFile(Chunk* chunk) {
+    const std::vector<FragmentSample> &samples = chunk->mFragmentSamples;
+    CHECK_EQ(samples.size(), chunk->mSamples.size());
+
+    enum {
+        kDataOffsetPresent                  = 0x01,
+        kSampleDurationPresent              = 0x100,
+        kSampleSizePresent                  = 0x200,
+        kSampleFlagsPresent                 = 0x400,
+        kSampleCompositionTimeOffsetPresent = 0x800,
+    };
+    uint32_t trunFlags = kDataOffsetPresent | kSampleDurationPresent | kSampleSizePresent;
+    uint64_t samplesSize = 0;
+    for (const FragmentSample &sample : samples) {
+        if (sample.mFlags != 0) {
+            trunFlags |= kSampleFlagsPresent;
+        }
+        if (sample.mCompositionOffset != 0) {
+            trunFlags |= kSampleCompositionTimeOffsetPresent;
+        }
+        samplesSize += sample.mSize;
+    }
+    const uint32_t mdatHeaderSize = (samplesSize + 8 > UINT32_MAX) ? 16 : 8;
+
+    // Samples of the trun box, in network byte order
+    std::vector<uint32_t> entries;
+    for (const FragmentSample &sample : samples) {
+        entries.push_back(htonl(sample.mDuration));
+        entries.push_back(htonl(sample.mSize));
+        if (trunFlags & kSampleFlagsPresent) {
+            entries.push_back(htonl(sample.mFlags));
+        }
+        if (trunFlags & kSampleCompositionTimeOffsetPresent) {
+            entries.push_back(htonl(sample.mCompositionOffset));
+        }
+    }
+    // moof (8) + mfhd (16) + traf (8) + tfhd (16) + tfdt (20) + trun (20 + entries)
+    const uint32_t moofSize = 88 + entries.size() * 4;
+
+    const off64_t moofOffset = mOffset;
+    beginBox("moof");
+        beginBox("mfhd");
+        writeInt32(0);  // version=0, flags=0
+        writeInt32(++mFragmentSequenceNumber);
+        endBox();  // mfhd
+        beginBox("traf");
+            beginBox("tfhd");
+            writeInt32(0x020000);  // version=0, flags=default-base-is-moof
+            writeInt32(chunk->mTrack->getTrackId().getId());
+            endBox();  // tfhd
+            beginBox("tfdt");
+            writeInt32(1 << 24);  // version=1, flags=0
+            writeInt64(chunk->mBaseDecodeTicks);
+            endBox();  // tfdt
+            beginBox("trun");
+            writeInt32((1 << 24) | trunFlags);  // version=1 for signed composition offsets
+            writeInt32(samples.size());
+            writeInt32(moofSize + mdatHeaderSize);  // data offset
+            write(entries.data(), entries.size() * 4);
+            endBox();  // trun
+        endBox();  // traf
+    endBox();  // moof
+    CHECK_EQ(mOffset - moofOffset, (off64_t)moofSize);
+    mFragmentIndex.push_back({chunk->mTrack, chunk->mBaseDecodeTicks, moofOffset});
+
+    if (mdatHeaderSize == 16) {
+        writeInt32(1);
+        writeFourcc("mdat");
+        writeInt64(samplesSize + 16);
+    } else {
+        writeInt32(samplesSize + 8);
+        writeFourcc("mdat");
+    }
+    const off64_t samplesOffset = mOffset;
+    const bool usePrefix = chunk->mTrack->usePrefix();
+    beginWriteBatch();
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
+        size_t bytesWritten;
+        addSample_l(*it, usePrefix, 0 /* tiffHdrOffset */, &bytesWritten);
+    }
+    endWriteBatch();
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
+        (*it)->release();
+        (*it) = NULL;
+    }
+    chunk->mSamples.clear();
+    if (mOffset - samplesOffset != (off64_t)samplesSize) {
+        ALOGE("%s fragment has %" PRId64 " bytes of samples, expected %" PRIu64,
+              chunk->mTrack->getTrackType(), (int64_t)(mOffset - samplesOffset), samplesSize);
+    }
 }
 
 void MPEG4Writer::writeAllChunks() {
@@ -2785,6 +3175,17 @@ void MPEG4Writer::writeAllChunks() {
 bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     ALOGV("findChunkToWrite");
 
+    if (mFragmentDurationUs > 0 && !mFragmentedMoovWritten && !mDone) {
+        // The moov box ahead of the fragments describes all the tracks, so wait for every
+        // track to have a fragment, or to have ended.
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            if (it->mChunks.empty() && !it->mTrack->reachedEOS()) {
+                return false;
+            }
+        }
+    }
+
     int64_t minTimestampUs = 0x7FFFFFFFFFFFFFFFLL;
     Track *track = NULL;
     for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
@@ -2848,18 +3249,30 @@ void MPEG4Writer::threadFunc() {
         // In real time recording mode, write without holding the lock in order
         // to reduce the blocking time for media track threads.
         // Otherwise, hold the lock until the existing chunks get written to the
-        // file.
+        // file. The moov box of a fragmented file is written without the lock too,
+        // as the track headers take it.
         if (chunkFound) {
-            if (mIsRealTimeRecording) {
+            const bool writeMoov = mFragmentDurationUs > 0 && !mFragmentedMoovWritten;
+            if (mIsRealTimeRecording || writeMoov) {
                 mLock.unlock();
             }
+            if (writeMoov) {
+                writeMoovBox(0 /* durationUs */);
+                mFragmentedMoovWritten = true;
+            }
             writeChunkToFile(&chunk);
-            if (mIsRealTimeRecording) {
+            if (mIsRealTimeRecording || writeMoov) {
                 mLock.lock();
             }
         }
     }
 
+    if (mFragmentDurationUs > 0 && !mFragmentedMoovWritten) {
+        mLock.unlock();
+        writeMoovBox(0 /* durationUs */);
+        mFragmentedMoovWritten = true;
+        mLock.lock();
+    }
     writeAllChunks();
     ALOGV("threadFunc mOffset:%lld, mMaxOffsetAppend:%lld", (long long)mOffset,
           (long long)mMaxOffsetAppend);
@@ -3438,8 +3851,10 @@ void MPEG4Writer::Track::dumpTimeStamps() {
 status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
+    const int64_t fragmentDurationUs = mOwner->fragmentDuration();
     const bool hasMultipleTracks = (mOwner->numTracks() > 1);
     int64_t chunkTimestampUs = 0;
+    int64_t fragmentTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nActualFrames = 0;        // frames containing non-CSD data (non-0 length)
     int32_t nZeroLengthFrames = 0;
@@ -3610,6 +4025,13 @@ status_t MPEG4Writer::Track::threadEntry() {
         }
         if (!buffer->meta_data().findInt64(kKeySampleFileOffset, &sampleFileOffset)) {
             sampleFileOffset = -1;
+        } else if (fragmentDurationUs > 0) {
+            ALOGE("Samples at file offsets are not supported in fragmented mode");
+            buffer->release();
+            buffer = nullptr;
+            mSource->stop();
+            mIsMalformed = true;
+            break;
         }
         int64_t lastSample = -1;
         if (!buffer->meta_data().findInt64(kKeyLastSampleIndexInChunk, &lastSample)) {
@@ -3710,7 +4132,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         }
 ////////////////////////////////////////////////////////////////////////////////
         if (!mIsHeic) {
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mFirstSampleTimeRealUs = systemTime() / 1000;
                 if (timestampUs < 0 && mFirstSampleStartOffsetUs == 0) {
                     mFirstSampleStartOffsetUs = -timestampUs;
@@ -3804,7 +4226,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                     break;
                 }
 
-                if (mStszTableEntries->count() == 0) {
+                if (mNumSamples == 0) {
                     // Force the first ctts table entry to have one single entry
                     // so that we can do adjustment for the initial track start
                     // time offset easily in writeCttsBox().
@@ -3822,7 +4244,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 }
 
                 // Update ctts time offset range
-                if (mStszTableEntries->count() == 0) {
+                if (mNumSamples == 0) {
                     mMinCttsOffsetTicks = currCttsOffsetTimeTicks;
                     mMaxCttsOffsetTicks = currCttsOffsetTimeTicks;
                 } else {
@@ -3888,9 +4310,33 @@ status_t MPEG4Writer::Track::threadEntry() {
                     timestampUs += deltaUs;
                 }
             }
-            mStszTableEntries->add(htonl(sampleSize));
+            ++mNumSamples;
+            if (fragmentDurationUs > 0) {
+                // Now that the previous sample's duration is known, the current fragment
+                // can end with it. Video fragments start with a sync frame.
+                if (!mFragmentSamples.empty()) {
+                    mFragmentSamples.back().mDuration = currDurationTicks;
+                    if (timestampUs - fragmentTimestampUs >= fragmentDurationUs &&
+                            (isSync || !mIsVideo)) {
+                        bufferFragment(fragmentTimestampUs);
+                    }
+                }
+                if (mFragmentSamples.empty()) {
+                    fragmentTimestampUs = timestampUs;
+                }
+                FragmentSample sample;
+                sample.mSize = sampleSize;
+                sample.mDuration = 0;
+                sample.mFlags = (isSync || !mIsVideo) ? kSyncSampleFlags : kNonSyncSampleFlags;
+                // Unlike the ctts table, the offsets are signed and need no adjustment later.
+                sample.mCompositionOffset = !mIsVideo ? 0 :
+                        currCttsOffsetTimeTicks - kMaxCttsOffsetTimeUs * mTimeScale / 1000000LL;
+                mFragmentSamples.push_back(sample);
+            } else {
+                mStszTableEntries->add(htonl(sampleSize));
+            }
 
-            if (mStszTableEntries->count() > 2) {
+            if (fragmentDurationUs == 0 && mNumSamples > 2) {
 
                 // Force the first sample to have its own stts entry so that
                 // we can adjust its value later to maintain the A/V sync.
@@ -3902,7 +4348,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 }
             }
             if (mSamplesHaveSameSize) {
-                if (mStszTableEntries->count() >= 2 && previousSampleSize != sampleSize) {
+                if (mNumSamples >= 2 && previousSampleSize != sampleSize) {
                     mSamplesHaveSameSize = false;
                 }
                 previousSampleSize = sampleSize;
@@ -3914,7 +4360,8 @@ status_t MPEG4Writer::Track::threadEntry() {
             lastTimestampUs = timestampUs;
 
             if (isSync != 0) {
-                addOneStssTableEntry(mStszTableEntries->count());
+                ++mNumSyncSamples;
+                addOneStssTableEntry(mNumSamples);
             }
 
             if (mTrackingProgressStatus) {
@@ -3924,6 +4371,11 @@ status_t MPEG4Writer::Track::threadEntry() {
                 trackProgressStatus(timestampUs);
             }
         }
+        if (fragmentDurationUs > 0) {
+            // Buffered until the fragment ends, see above.
+            mChunkSamples.push_back(copy);
+            continue;
+        }
         if (!hasMultipleTracks) {
             size_t bytesWritten;
             off64_t offset = mOwner->addSample_l(
@@ -3979,16 +4431,27 @@ status_t MPEG4Writer::Track::threadEntry() {
     mOwner->trackProgressStatus(mTrackId.getId(), -1, err);
 
     // Add final entries only for non-empty tracks.
-    if (mStszTableEntries->count() > 0) {
+    if (mNumSamples > 0) {
         if (mIsHeic) {
             if (!mChunkSamples.empty()) {
                 bufferChunk(0);
                 ++nChunks;
             }
+        } else if (fragmentDurationUs > 0) {
+            // Last fragment. As for the stts table below, the last sample lasts as long as
+            // the EOS buffer tells, or else as long as the previous one.
+            if (mNumSamples == 1 && lastSampleDurationUs < 0) {
+                lastDurationUs = 0;  // A single sample's duration
+                lastDurationTicks = 0;
+            }
+            mFragmentSamples.back().mDuration =
+                    lastSampleDurationUs >= 0 ? lastSampleDurationTicks : lastDurationTicks;
+            bufferFragment(fragmentTimestampUs);
+            mTrackDurationUs += lastSampleDurationUs >= 0 ? lastSampleDurationUs : lastDurationUs;
         } else {
             // Last chunk
             if (!hasMultipleTracks) {
-                addOneStscTableEntry(1, mStszTableEntries->count());
+                addOneStscTableEntry(1, mNumSamples);
             } else if (!mChunkSamples.empty()) {
                 addOneStscTableEntry(++nChunks, mChunkSamples.size());
                 bufferChunk(timestampUs);
@@ -3997,7 +4460,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             // We don't really know how long the last frame lasts, since
             // there is no frame time after it, just repeat the previous
             // frame's duration.
-            if (mStszTableEntries->count() == 1) {
+            if (mNumSamples == 1) {
                 if (lastSampleDurationUs >= 0) {
                     addOneSttsTableEntry(sampleCount, lastSampleDurationTicks);
                 } else {
@@ -4032,7 +4495,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     sendTrackSummary(hasMultipleTracks);
 
     ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), trackName);
+            count, nZeroLengthFrames, mNumSamples, trackName);
     if (mIsAudio) {
         ALOGI("Audio track drift time: %" PRId64 " us", mOwner->getDriftTimeUs());
     }
@@ -4053,26 +4516,26 @@ bool MPEG4Writer::Track::isTrackMalFormed() {
         mOwner->mStartMeta->findInt32(kKeyEmptyTrackMalFormed, &emptyTrackMalformed) &&
         emptyTrackMalformed) {
         // MediaRecorder(sets kKeyEmptyTrackMalFormed by default) report empty tracks as malformed.
-        if (!mIsHeic && mStszTableEntries->count() == 0) {  // no samples written
+        if (!mIsHeic && mNumSamples == 0) {  // no samples written
             ALOGE("The number of recorded samples is 0");
             mIsMalformed = true;
             return true;
         }
-        if (mIsVideo && mStssTableEntries->count() == 0) {  // no sync frames for video
+        if (mIsVideo && mNumSyncSamples == 0) {  // no sync frames for video
             ALOGE("There are no sync frames for video track");
             mIsMalformed = true;
             return true;
         }
     } else {
         // Through MediaMuxer, empty tracks can be added. No sync frames for video.
-        if (mIsVideo && mStszTableEntries->count() > 0 && mStssTableEntries->count() == 0) {
+        if (mIsVideo && mNumSamples > 0 && mNumSyncSamples == 0) {
             ALOGE("There are no sync frames for video track");
             mIsMalformed = true;
             return true;
         }
     }
     // Don't check for CodecSpecificData when track is empty.
-    if (mStszTableEntries->count() > 0 && OK != checkCodecSpecificData()) {
+    if (mNumSamples > 0 && OK != checkCodecSpecificData()) {
         // No codec specific data.
         mIsMalformed = true;
         return true;
@@ -4100,7 +4563,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -4206,6 +4669,19 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+void MPEG4Writer::Track::bufferFragment(int64_t timestampUs) {
+    ALOGV("bufferFragment");
+
+    Chunk chunk(this, timestampUs, mChunkSamples);
+    chunk.mFragmentSamples.swap(mFragmentSamples);
+    chunk.mBaseDecodeTicks = mFragmentDecodeTicks;
+    for (const FragmentSample &sample : chunk.mFragmentSamples) {
+        mFragmentDecodeTicks += sample.mDuration;
+    }
+    mOwner->bufferChunk(chunk);
+    mChunkSamples.clear();
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs + getStartTimeOffsetTimeUs() + mOwner->getStartTimeOffsetBFramesUs();
 }
@@ -4326,7 +4802,7 @@ int64_t MPEG4Writer::Track::getMinCttsOffsetTimeUs() {
 void MPEG4Writer::Track::writeStblBox() {
     mOwner->beginBox("stbl");
     // Add subboxes for only non-empty and well-formed tracks.
-    if (mStszTableEntries->count() > 0 && !isTrackMalFormed()) {
+    if (mNumSamples > 0 && !isTrackMalFormed()) {
         mOwner->beginBox("stsd");
         mOwner->writeInt32(0);               // version=0, flags=0
         mOwner->writeInt32(1);               // entry count
@@ -4339,7 +4815,8 @@ void MPEG4Writer::Track::writeStblBox() {
         }
         mOwner->endBox();  // stsd
         writeSttsBox();
-        if (mIsVideo) {
+        // The tables are empty for fragmented files, where no stss box means all sync samples.
+        if (mIsVideo && mOwner->fragmentDuration() == 0) {
             writeCttsBox();
             writeStssBox();
         }
@@ -4710,7 +5187,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId.getId()); // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The moov box of a fragmented file has no samples, see the mehd box for the duration.
+    int64_t trakDurationUs = mOwner->fragmentDuration() > 0 ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -4808,7 +5286,20 @@ void MPEG4Writer::Track::writeEdtsBox() {
     int64_t trackStartTimeUs = movieStartTimeUs + trackStartOffsetUs;
     ALOGV("trackStartTimeUs:%" PRId64, trackStartTimeUs);
 
-    if (movieStartOffsetBFramesUs == 0) {
+    if (mOwner->fragmentDuration() > 0) {
+        // The track duration is not known when the moov box of a fragmented file is written,
+        // so the last edit list entry has a zero duration, which covers the whole track.
+        if (trackStartOffsetUs > 0) {
+            uint32_t segDuration = (trackStartOffsetUs * mvhdTimeScale + 5E5) / 1E6;
+            ALOGV("Empty edit list entry");
+            addOneElstTableEntry(segDuration, -1, 1, 0);
+            addOneElstTableEntry(0, 0, 1, 0);
+        } else if (mFirstSampleStartOffsetUs > 0) {
+            ALOGV("Normal edit list entry");
+            int32_t mediaTime = (mFirstSampleStartOffsetUs * mTimeScale + 5E5) / 1E6;
+            addOneElstTableEntry(0, mediaTime, 1, 0);
+        }
+    } else if (movieStartOffsetBFramesUs == 0) {
         // No B frames in any tracks.
         if (trackStartOffsetUs > 0) {
             // Track with positive start offset.
@@ -4913,7 +5404,7 @@ void MPEG4Writer::Track::writeEdtsBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->fragmentDuration() > 0 ? 0 : getDurationUs();
     int64_t mdhdDuration = (trakDurationUs * mTimeScale + 5E5) / 1E6;
     mOwner->beginBox("mdhd");
 
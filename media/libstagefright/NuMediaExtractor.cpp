@@ -141,6 +141,8 @@ status_t NuMediaExtractor::setDataSource(int fd, off64_t offset, off64_t size) {
     if (err != OK) {
         return err;
     }
+    // maps the file if it cannot be truncated, see FileSource::enableMmap().
+    (void)fileSource->enableMmap();
 
     // Initialize MediaExtractor using the file source
     return initMediaExtractor(fileSource);
@@ -23,6 +23,8 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
@@ -70,7 +72,10 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextEventSeq(0),
+      mWakeUpUs(INT64_MIN),
+      mWakeupSlackUs(0),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -85,6 +90,11 @@ void ALooper::setName(const char *name) {
     mName = name;
 }
 
+void ALooper::setWakeupSlackUs(int64_t slackUs) {
+    Mutex::Autolock autoLock(mLock);
+    mWakeupSlackUs = std::max(slackUs, (int64_t)0);
+}
+
 ALooper::handler_id ALooper::registerHandler(const sp<AHandler> &handler) {
     return gLooperRoster.registerHandler(this, handler);
 }
@@ -177,20 +187,20 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
-
     Event event;
     event.mWhenUs = whenUs;
+    event.mSeq = mNextEventSeq++;
     event.mMessage = msg;
 
-    if (it == mEventQueue.begin()) {
+    mEventQueue.push_back(std::move(event));
+    std::push_heap(mEventQueue.begin(), mEventQueue.end());
+
+    // The looper checks the queue before waiting, so it only needs a signal if it is
+    // waiting, and would wake up too late for this event. Events due now are never
+    // delayed by the slack.
+    if (whenUs < mWakeUpUs && (delayUs <= 0 || mWakeUpUs - whenUs > mWakeupSlackUs)) {
         mQueueChangedCondition.signal();
     }
-
-    mEventQueue.insert(it, event);
 }
 
 bool ALooper::loop() {
@@ -202,24 +212,32 @@ bool ALooper::loop() {
             return false;
         }
         if (mEventQueue.empty()) {
+            mWakeUpUs = INT64_MAX;
             mQueueChangedCondition.wait(mLock);
+            mWakeUpUs = INT64_MIN;
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = mEventQueue.front().mWhenUs;
         int64_t nowUs = GetNowUs();
 
         if (whenUs > nowUs) {
+            // wake up as late as the slack allows, to deliver more events at once.
             int64_t delayUs = whenUs - nowUs;
-            if (delayUs > INT64_MAX / 1000) {
+            if (delayUs > INT64_MAX / 1000 - mWakeupSlackUs) {
                 delayUs = INT64_MAX / 1000;
+            } else {
+                delayUs += mWakeupSlackUs;
             }
+            mWakeUpUs = nowUs + delayUs;
             mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            mWakeUpUs = INT64_MIN;
 
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        std::pop_heap(mEventQueue.begin(), mEventQueue.end());
+        event = std::move(mEventQueue.back());
+        mEventQueue.pop_back();
     }
 
     event.mMessage->deliver();
@@ -94,6 +94,7 @@ void AMessage::clear() {
         freeItemValue(&item);
     }
     mItems.clear();
+    mItemIndex.clear();
 }
 
 void AMessage::freeItemValue(Item *item) {
@@ -150,20 +151,55 @@ static void reportStats() {
 }
 #endif
 
+// FNV-1a hash of an item name.
+static inline uint32_t hashName(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
 inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 #ifdef DUMP_STATS
+    size_t checks = 0;
     size_t memchecks = 0;
 #endif
-    size_t i = 0;
-    for (; i < mItems.size(); i++) {
-        if (len != mItems[i].mNameLength) {
-            continue;
+    size_t i = mItems.size();
+    if (mItemIndex.empty()) {
+        for (i = 0; i < mItems.size(); i++) {
+#ifdef DUMP_STATS
+            ++checks;
+#endif
+            if (len != mItems[i].mNameLength) {
+                continue;
+            }
+#ifdef DUMP_STATS
+            ++memchecks;
+#endif
+            if (!memcmp(mItems[i].mName, name, len)) {
+                break;
+            }
         }
+    } else {
+        // the index is at most half full, so there is always an empty slot.
+        const uint32_t hash = hashName(name, len);
+        const size_t mask = mItemIndex.size() - 1;
+        for (size_t slot = hash & mask; mItemIndex[slot] != 0; slot = (slot + 1) & mask) {
+            const Item &item = mItems[mItemIndex[slot] - 1];
 #ifdef DUMP_STATS
-        ++memchecks;
+            ++checks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
-            break;
+            if (hash != item.mNameHash || len != item.mNameLength) {
+                continue;
+            }
+#ifdef DUMP_STATS
+            ++memchecks;
+#endif
+            if (!memcmp(item.mName, name, len)) {
+                i = mItemIndex[slot] - 1;
+                break;
+            }
         }
     }
 #ifdef DUMP_STATS
@@ -172,18 +208,60 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
         ++gFindItemCalls;
         gAverageNumItems += mItems.size();
         gAverageNumMemChecks += memchecks;
-        gAverageNumChecks += i;
+        gAverageNumChecks += checks;
         reportStats();
     }
 #endif
     return i;
 }
 
+void AMessage::insertItemIndex(size_t i) {
+    static_assert(kMaxNumItems < UINT16_MAX, "item index must fit mItemIndex");
+    const Item &item = mItems[i];
+    const size_t mask = mItemIndex.size() - 1;
+    size_t slot = item.mNameHash & mask;
+    for (; mItemIndex[slot] != 0; slot = (slot + 1) & mask) {
+        const Item &other = mItems[mItemIndex[slot] - 1];
+        if (item.mNameHash == other.mNameHash && item.mNameLength == other.mNameLength
+                && !memcmp(item.mName, other.mName, item.mNameLength)) {
+            return; // like a linear search, find the first item with this name.
+        }
+    }
+    mItemIndex[slot] = i + 1;
+}
+
+void AMessage::rebuildItemIndex() {
+    mItemIndex.clear();
+    if (mItems.size() < kMinIndexedItems) {
+        return;
+    }
+    size_t slots = 4 * kMinIndexedItems;
+    while (slots < 2 * mItems.size()) {
+        slots *= 2;
+    }
+    mItemIndex.resize(slots, 0);
+    for (size_t i = 0; i < mItems.size(); ++i) {
+        insertItemIndex(i);
+    }
+}
+
+void AMessage::indexLastItem() {
+    if (mItems.size() < kMinIndexedItems) {
+        return;
+    }
+    if (mItemIndex.size() < 2 * mItems.size()) {
+        rebuildItemIndex(); // first item indexed, or the index would be more than half full
+    } else {
+        insertItemIndex(mItems.size() - 1);
+    }
+}
+
 // assumes item's name was uninitialized or NULL
 void AMessage::Item::setName(const char *name, size_t len) {
     mNameLength = len;
     mName = new char[len + 1];
     memcpy((void*)mName, name, len + 1);
+    mNameHash = hashName(name, len);
 }
 
 AMessage::Item::Item(const char *name, size_t len)
@@ -205,6 +283,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         i = mItems.size();
         // place a 'blank' item at the end - this is of type kTypeInt32
         mItems.emplace_back(name, len);
+        indexLastItem();
         item = &mItems[i];
     }
 
@@ -480,6 +559,7 @@ bool AMessage::senderAwaitsResponse(sp<AReplyToken> *replyToken) {
 sp<AMessage> AMessage::dup() const {
     sp<AMessage> msg = new AMessage(mWhat, mHandler.promote());
     msg->mItems = mItems;
+    msg->mItemIndex = mItemIndex; // same names at the same indices
 
 #ifdef DUMP_STATS
     {
@@ -763,6 +843,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
         item->setName(name, strlen(name));
     }
 
+    msg->rebuildItemIndex();
     return msg;
 }
 
@@ -1013,6 +1094,7 @@ status_t AMessage::setEntryNameAt(size_t index, const char *name) {
     delete[] mItems[index].mName;
     mItems[index].mName = nullptr;
     mItems[index].setName(name, len);
+    rebuildItemIndex();
     return OK;
 }
 
@@ -1087,6 +1169,7 @@ status_t AMessage::removeEntryAt(size_t index) {
         mItems[lastIndex].mType = kTypeInt32;
     }
     mItems.pop_back();
+    rebuildItemIndex();
     return OK;
 }
 
@@ -26,6 +26,8 @@
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 
+#include <vector>
+
 namespace android {
 
 struct AHandler;
@@ -52,6 +54,12 @@ struct ALooper : public RefBase {
 
     status_t stop();
 
+    // Allows delayed messages to be delivered up to slackUs late, so that messages due at
+    // close times are delivered after a single wakeup of the looper thread. Messages
+    // are never delivered early, and messages which are already due are delivered
+    // immediately. The default slack of 0 delivers all messages as soon as they are due.
+    void setWakeupSlackUs(int64_t slackUs);
+
     static int64_t GetNowUs();
 
     const char *getName() const {
@@ -66,7 +74,13 @@ private:
 
     struct Event {
         int64_t mWhenUs;
+        uint64_t mSeq;   // order of posting, to deliver events of equal mWhenUs in order
         sp<AMessage> mMessage;
+
+        // ordering of mEventQueue: the event to deliver first is at the top of the heap.
+        bool operator<(const Event &other) const {
+            return mWhenUs != other.mWhenUs ? mWhenUs > other.mWhenUs : mSeq > other.mSeq;
+        }
     };
 
     Mutex mLock;
@@ -74,7 +88,15 @@ private:
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // binary heap of events, ordered by Event::operator<().
+    std::vector<Event> mEventQueue;
+    uint64_t mNextEventSeq;
+
+    // time the looper thread wakes up while it waits for the next event, or INT64_MIN
+    // when it is not waiting. A post() signals the looper for events due now, and for
+    // delayed events when it would wake up more than mWakeupSlackUs after they are due.
+    int64_t mWakeUpUs;
+    int64_t mWakeupSlackUs;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -304,16 +304,37 @@ private:
         const char *mName;
         size_t      mNameLength;
         Type mType;
+        uint32_t    mNameHash; // hash of mName for mItemIndex
         void setName(const char *name, size_t len);
-        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32) { }
+        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32), mNameHash(0) { }
         Item(const char *name, size_t length);
     };
 
     enum {
-        kMaxNumItems = 256
+        kMaxNumItems = 256,
+        kMinIndexedItems = 16, // messages with fewer items are searched linearly
     };
     std::vector<Item> mItems;
 
+    /**
+     * Open addressing hash table of mItems by name, using linear probing and a load factor of
+     * at most 1/2. Each slot holds the index of an item plus one, or 0 if the slot is empty.
+     *
+     * The index is built once the message holds kMinIndexedItems items, and is kept up to date
+     * by all the methods modifying mItems, so that lookups do not modify the message. It is
+     * empty for smaller messages.
+     */
+    std::vector<uint16_t> mItemIndex;
+
+    /** Rebuilds mItemIndex for all items, or clears it if there are too few items. */
+    void rebuildItemIndex();
+
+    /** Adds the last item of mItems to mItemIndex, building or growing mItemIndex as needed. */
+    void indexLastItem();
+
+    /** Adds item |i| to mItemIndex, unless an item with the same name is already present. */
+    void insertItemIndex(size_t i);
+
     /**
      * Allocates an item with the given key |name|. If the key already exists, the corresponding
      * item value is freed. Otherwise a new item is added.
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <utils/Mutex.h>
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+// Counts the messages received, and records how late the delayed messages were delivered.
+struct CountingHandler : public AHandler {
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        int64_t dueUs;
+        const int64_t latenessUs =
+                msg->findInt64("due", &dueUs) ? ALooper::GetNowUs() - dueUs : 0;
+        Mutex::Autolock autoLock(mLock);
+        mLatenessUs.push_back(latenessUs);
+        if (++mReceived >= mExpected) {
+            mCondition.signal();
+        }
+    }
+
+    void expect(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        mReceived = 0;
+        mExpected = count;
+        mLatenessUs.clear();
+    }
+
+    void wait() {
+        Mutex::Autolock autoLock(mLock);
+        while (mReceived < mExpected) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    size_t mReceived = 0;
+    size_t mExpected = 0;
+    std::vector<int64_t> mLatenessUs;
+};
+
+// Posts range(0) messages with random delays to a looper which is not started, so the
+// queue grows to range(0) messages. This measures the cost of queueing a delayed message.
+static void BM_ALooper_PostDelayed(benchmark::State& state) {
+    const size_t count = state.range(0);
+    sp<CountingHandler> handler = new CountingHandler;
+    srand48(0);
+    std::vector<int64_t> delaysUs;
+    for (size_t i = 0; i < count; ++i) {
+        delaysUs.push_back(1000000 + lrand48() % 1000000);
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        sp<ALooper> looper = new ALooper;
+        looper->registerHandler(handler);
+        std::vector<sp<AMessage>> messages;
+        for (size_t i = 0; i < count; ++i) {
+            messages.push_back(new AMessage(0, handler));
+        }
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < count; ++i) {
+            messages[i]->post(delaysUs[i]);
+        }
+
+        state.PauseTiming();
+        looper->unregisterHandler(handler->id());
+        looper.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+// Posts range(0) messages to a running looper and waits until they are all delivered.
+static void BM_ALooper_PostDeliver(benchmark::State& state) {
+    const size_t count = state.range(0);
+    sp<CountingHandler> handler = new CountingHandler;
+    sp<ALooper> looper = new ALooper;
+    looper->setName("ALooper_benchmark");
+    looper->registerHandler(handler);
+    looper->start();
+    const sp<AMessage> msg = new AMessage(0, handler);
+    for (auto _ : state) {
+        handler->expect(count);
+        for (size_t i = 0; i < count; ++i) {
+            msg->post();
+        }
+        handler->wait();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+}
+
+// Posts 100 messages with random delays of up to 20ms, spread over 20ms, and reports how
+// late they were delivered, with a wakeup slack of range(0) us.
+static void BM_ALooper_DelayedLatency(benchmark::State& state) {
+    constexpr size_t kCount = 100;
+    constexpr int64_t kMaxDelayUs = 20000;
+    sp<CountingHandler> handler = new CountingHandler;
+    sp<ALooper> looper = new ALooper;
+    looper->setName("ALooper_benchmark");
+    looper->setWakeupSlackUs(state.range(0));
+    looper->registerHandler(handler);
+    looper->start();
+    srand48(0);
+
+    double sum = 0.;
+    double sumSquares = 0.;
+    int64_t maxLatenessUs = 0;
+    size_t samples = 0;
+    for (auto _ : state) {
+        handler->expect(kCount);
+        for (size_t i = 0; i < kCount; ++i) {
+            const int64_t delayUs = lrand48() % kMaxDelayUs;
+            sp<AMessage> msg = new AMessage(0, handler);
+            msg->setInt64("due", ALooper::GetNowUs() + delayUs);
+            msg->post(delayUs);
+            usleep(kMaxDelayUs / kCount);
+        }
+        handler->wait();
+        for (int64_t latenessUs : handler->mLatenessUs) {
+            sum += latenessUs;
+            sumSquares += (double)latenessUs * latenessUs;
+            maxLatenessUs = std::max(maxLatenessUs, latenessUs);
+            ++samples;
+        }
+    }
+    const double mean = sum / samples;
+    state.counters["lateness_mean_us"] = mean;
+    state.counters["lateness_stddev_us"] = sqrt(std::max(sumSquares / samples - mean * mean, 0.));
+    state.counters["lateness_max_us"] = maxLatenessUs;
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+}
+
+BENCHMARK(BM_ALooper_PostDelayed)->Arg(16)->Arg(64)->Arg(256)->Arg(1024)->Arg(4096);
+BENCHMARK(BM_ALooper_PostDeliver)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_ALooper_DelayedLatency)->Arg(0)->Arg(1000)->Arg(5000)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
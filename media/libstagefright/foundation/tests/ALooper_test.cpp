@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ALooper_test"
+
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/Mutex.h>
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+// Records the order and time of the messages received.
+struct RecordingHandler : public AHandler {
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        Mutex::Autolock autoLock(mLock);
+        int32_t value = -1;
+        msg->findInt32("value", &value);
+        mValues.push_back(value);
+        mTimesUs.push_back(ALooper::GetNowUs());
+        if (msg->what() == kWhatBlock) {
+            // blocks the looper until released.
+            while (!mReleased) {
+                mCondition.wait(mLock);
+            }
+        }
+        mCondition.broadcast();
+    }
+
+    void release() {
+        Mutex::Autolock autoLock(mLock);
+        mReleased = true;
+        mCondition.broadcast();
+    }
+
+    void waitForMessages(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mValues.size() < count) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    static constexpr uint32_t kWhatBlock = 'blck';
+
+    Mutex mLock;
+    Condition mCondition;
+    bool mReleased = false;
+    std::vector<int32_t> mValues;
+    std::vector<int64_t> mTimesUs;
+};
+
+class ALooperTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mLooper = new ALooper;
+        mLooper->setName("ALooper_test");
+        mHandler = new RecordingHandler;
+        mLooper->registerHandler(mHandler);
+        ASSERT_EQ(OK, mLooper->start());
+    }
+
+    void TearDown() override {
+        mLooper->unregisterHandler(mHandler->id());
+        mLooper->stop();
+    }
+
+    sp<AMessage> message(int32_t value, uint32_t what = 0) {
+        sp<AMessage> msg = new AMessage(what, mHandler);
+        msg->setInt32("value", value);
+        return msg;
+    }
+
+    sp<ALooper> mLooper;
+    sp<RecordingHandler> mHandler;
+};
+
+TEST_F(ALooperTest, DeliversInTimeOrder) {
+    constexpr int32_t kMessages = 50;
+    for (int32_t i = 0; i < kMessages; ++i) {
+        // post in reverse order of delivery time
+        message(i)->post((kMessages - i) * 1000ll);
+    }
+    mHandler->waitForMessages(kMessages);
+    for (int32_t i = 0; i < kMessages; ++i) {
+        EXPECT_EQ(kMessages - 1 - i, mHandler->mValues[i]);
+    }
+}
+
+TEST_F(ALooperTest, DeliversInPostOrderWhenDue) {
+    constexpr int32_t kMessages = 200;
+    // block the looper so that the messages are all due when it resumes.
+    message(-1, RecordingHandler::kWhatBlock)->post();
+    for (int32_t i = 0; i < kMessages; ++i) {
+        message(i)->post();
+    }
+    mHandler->release();
+    mHandler->waitForMessages(kMessages + 1);
+    for (int32_t i = 0; i < kMessages; ++i) {
+        EXPECT_EQ(i, mHandler->mValues[i + 1]);
+    }
+}
+
+TEST_F(ALooperTest, SlackDoesNotDeliverEarly) {
+    constexpr int64_t kSlackUs = 20000;
+    constexpr int32_t kMessages = 20;
+    mLooper->setWakeupSlackUs(kSlackUs);
+
+    std::vector<int64_t> dueUs;
+    for (int32_t i = 0; i < kMessages; ++i) {
+        const int64_t delayUs = 5000 + i * 1000;
+        dueUs.push_back(ALooper::GetNowUs() + delayUs);
+        message(i)->post(delayUs);
+    }
+    // a message which is due is delivered without waiting for the slack.
+    const int64_t postUs = ALooper::GetNowUs();
+    message(kMessages)->post();
+
+    mHandler->waitForMessages(kMessages + 1);
+    ASSERT_EQ(kMessages, mHandler->mValues[0]);
+    EXPECT_LT(mHandler->mTimesUs[0] - postUs, kSlackUs);
+    for (int32_t i = 0; i < kMessages; ++i) {
+        EXPECT_EQ(i, mHandler->mValues[i + 1]);
+        EXPECT_GE(mHandler->mTimesUs[i + 1], dueUs[i]);
+    }
+}
+
+TEST_F(ALooperTest, SlackDoesNotDelayDueMessages) {
+    constexpr int64_t kSlackUs = 200000;
+    mLooper->setWakeupSlackUs(kSlackUs);
+
+    // the looper waits up to the slack past this message
+    message(0)->post(10000);
+    usleep(50000);
+    // then a message which is due is posted before the looper wakes up
+    const int64_t postUs = ALooper::GetNowUs();
+    message(1)->post();
+
+    mHandler->waitForMessages(2);
+    ASSERT_EQ(1, mHandler->mValues[1]);
+    EXPECT_LT(mHandler->mTimesUs[1] - postUs, kSlackUs / 4);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+using namespace android;
+
+// Keys of a video decoder output format as configured by CCodec, in the order they are set.
+static const char * const kFormatKeys[] = {
+    "mime", "width", "height", "stride", "slice-height", "color-format",
+    "crop-left", "crop-top", "crop-right", "crop-bottom", "color-range",
+    "color-standard", "color-transfer", "sar-width", "sar-height", "max-width",
+    "max-height", "frame-rate", "priority", "operating-rate", "profile", "level",
+    "bitrate", "bitrate-mode", "max-input-size", "rotation-degrees", "hdr-static-info",
+    "hdr10-plus-info", "low-latency", "tunnel-peek", "android._dataspace",
+    "android._color-format", "android._video-scaling", "android._num-input-buffers",
+    "android._num-output-buffers", "android._prepend-sps-pps-to-idr-frames",
+    "android._hdr-editing", "csd-0", "csd-1", "csd-2", "durationUs", "track-id",
+    "language", "display-width", "display-height", "channel-count", "sample-rate",
+    "pcm-encoding", "aac-profile", "is-adts", "encoder-delay", "encoder-padding",
+    "vendor.qti-ext-dec-picture-order.enable", "vendor.qti-ext-dec-low-latency.enable",
+    "vendor.qti-ext-extradata-enable.types", "vendor.hw-video-decoder.secure",
+    "vendor.hw-video-decoder.dither", "vendor.hw-video-decoder.fps",
+    "vendor.hw-video-decoder.adaptive", "vendor.hw-video-decoder.thumbnail",
+    "max-pts-gap-to-encoder", "max-fps-to-encoder", "capture-rate",
+    "create-input-buffers-suspended",
+};
+
+static std::vector<std::string> formatKeys(size_t count) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < count; ++i) {
+        keys.emplace_back(i < std::size(kFormatKeys)
+                ? std::string(kFormatKeys[i]) : "vendor.key-" + std::to_string(i));
+    }
+    return keys;
+}
+
+static sp<AMessage> makeFormat(const std::vector<std::string> &keys) {
+    sp<AMessage> format = new AMessage;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i == 0) {
+            format->setString(keys[i].c_str(), "video/avc");
+        } else if (i % 5 == 0) {
+            format->setInt64(keys[i].c_str(), i);
+        } else {
+            format->setInt32(keys[i].c_str(), i);
+        }
+    }
+    return format;
+}
+
+// Builds a format of range(0) keys.
+static void BM_AMessage_Set(benchmark::State& state) {
+    const std::vector<std::string> keys = formatKeys(state.range(0));
+    for (auto _ : state) {
+        sp<AMessage> format = makeFormat(keys);
+        benchmark::DoNotOptimize(format.get());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Looks up every key of a format of range(0) keys, as MediaCodec does on format queries.
+static void BM_AMessage_Find(benchmark::State& state) {
+    const std::vector<std::string> keys = formatKeys(state.range(0));
+    const sp<AMessage> format = makeFormat(keys);
+    for (auto _ : state) {
+        for (const std::string &key : keys) {
+            benchmark::DoNotOptimize(format->findEntryByName(key.c_str()));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Looks up keys which are not in a format of range(0) keys.
+static void BM_AMessage_FindMissing(benchmark::State& state) {
+    const std::vector<std::string> keys = formatKeys(state.range(0));
+    const sp<AMessage> format = makeFormat(keys);
+    const char * const missing[] = { "bitrate-min", "csd-3", "vendor.missing", "x" };
+    for (auto _ : state) {
+        for (const char *key : missing) {
+            int32_t value;
+            benchmark::DoNotOptimize(format->findInt32(key, &value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(missing));
+}
+
+// Duplicates a format of range(0) keys.
+static void BM_AMessage_Dup(benchmark::State& state) {
+    const sp<AMessage> format = makeFormat(formatKeys(state.range(0)));
+    for (auto _ : state) {
+        sp<AMessage> copy = format->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+// Duplicates a format of range(0) keys and updates a few keys, as done per output buffer.
+static void BM_AMessage_DupUpdate(benchmark::State& state) {
+    const sp<AMessage> format = makeFormat(formatKeys(state.range(0)));
+    int32_t i = 0;
+    for (auto _ : state) {
+        sp<AMessage> copy = format->dup();
+        copy->setInt32("width", ++i);
+        copy->setInt32("height", i);
+        copy->setInt32("crop-right", i);
+        copy->setInt32("crop-bottom", i);
+        int32_t value;
+        benchmark::DoNotOptimize(copy->findInt32("color-format", &value));
+    }
+}
+
+static void FormatSizes(benchmark::internal::Benchmark* b) {
+    for (int keys : { 4, 8, 16, 24, 32, 48, 64, 128 }) {
+        b->Arg(keys);
+    }
+}
+
+BENCHMARK(BM_AMessage_Set)->Apply(FormatSizes);
+BENCHMARK(BM_AMessage_Find)->Apply(FormatSizes);
+BENCHMARK(BM_AMessage_FindMissing)->Apply(FormatSizes);
+BENCHMARK(BM_AMessage_Dup)->Apply(FormatSizes);
+BENCHMARK(BM_AMessage_DupUpdate)->Apply(FormatSizes);
+
+BENCHMARK_MAIN();
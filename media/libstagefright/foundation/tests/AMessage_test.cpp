@@ -17,6 +17,8 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "AData_test"
 
+#include <string>
+
 #include <gtest/gtest.h>
 #include <utils/RefBase.h>
 
@@ -123,3 +125,71 @@ TEST(AMessage_tests, item_manipulation) {
 
 }
 
+
+TEST(AMessage_tests, large_message) {
+  // enough items for the message to index them by name
+  constexpr int32_t kItems = 100;
+  sp<AMessage> m1 = new AMessage();
+  for (int32_t i = 0; i < kItems; ++i) {
+    m1->setInt32(("key-" + std::to_string(i)).c_str(), i);
+  }
+  ASSERT_EQ((size_t)kItems, m1->countEntries());
+
+  int32_t i32;
+  for (int32_t i = 0; i < kItems; ++i) {
+    const std::string name = "key-" + std::to_string(i);
+    EXPECT_TRUE(m1->findInt32(name.c_str(), &i32)) << name;
+    EXPECT_EQ(i, i32);
+    // entries stay in insertion order
+    AMessage::Type type;
+    EXPECT_STREQ(name.c_str(), m1->getEntryNameAt(i, &type));
+  }
+  EXPECT_FALSE(m1->findInt32("key-", &i32));
+  EXPECT_FALSE(m1->findInt32("key-100", &i32));
+
+  // overwriting an item keeps its position
+  m1->setInt32("key-7", 70);
+  EXPECT_EQ((size_t)kItems, m1->countEntries());
+  EXPECT_EQ(7u, m1->findEntryByName("key-7"));
+  EXPECT_TRUE(m1->findInt32("key-7", &i32));
+  EXPECT_EQ(70, i32);
+
+  // removal moves the last item into the removed position
+  EXPECT_EQ(OK, m1->removeEntryByName("key-3"));
+  EXPECT_FALSE(m1->findInt32("key-3", &i32));
+  EXPECT_EQ(3u, m1->findEntryByName("key-99"));
+  EXPECT_TRUE(m1->findInt32("key-99", &i32));
+  EXPECT_EQ(99, i32);
+
+  // rename
+  EXPECT_EQ(ALREADY_EXISTS, m1->setEntryNameAt(4, "key-5"));
+  EXPECT_EQ(OK, m1->setEntryNameAt(4, "renamed"));
+  EXPECT_FALSE(m1->findInt32("key-4", &i32));
+  EXPECT_TRUE(m1->findInt32("renamed", &i32));
+  EXPECT_EQ(4, i32);
+
+  // dup keeps order and lookups
+  sp<AMessage> m2 = m1->dup();
+  ASSERT_EQ(m1->countEntries(), m2->countEntries());
+  for (size_t i = 0; i < m1->countEntries(); ++i) {
+    AMessage::Type type1, type2;
+    const char *name = m1->getEntryNameAt(i, &type1);
+    EXPECT_STREQ(name, m2->getEntryNameAt(i, &type2));
+    EXPECT_EQ(i, m2->findEntryByName(name));
+  }
+  m2->setInt32("added", 1);
+  EXPECT_TRUE(m2->findInt32("added", &i32));
+  EXPECT_FALSE(m1->findInt32("added", &i32));
+
+  // shrinking the message below the index threshold keeps items findable
+  while (m1->countEntries() > 1) {
+    EXPECT_EQ(OK, m1->removeEntryAt(0));
+  }
+  AMessage::Type type;
+  const char *name = m1->getEntryNameAt(0, &type);
+  EXPECT_EQ(0u, m1->findEntryByName(name));
+
+  m1->clear();
+  EXPECT_EQ(0u, m1->countEntries());
+  EXPECT_FALSE(m1->findInt32("key-1", &i32));
+}
@@ -35,6 +35,8 @@ public:
         kIsCachingDataSource   = 4,
         kIsHTTPBasedSource     = 8,
         kIsLocalFileSource     = 16,
+        // getView() can return views of the source.
+        kCanProvideViews       = 32,
     };
 
     DataSourceBase() {}
@@ -152,6 +154,13 @@ public:
         return 0;
     }
 
+    // Returns a pointer to size bytes of the source at offset, which stays valid for the
+    // lifetime of the source, or NULL if the source cannot provide them without copying,
+    // in which case readAt() must be used.
+    virtual const void *getView(off64_t /*offset*/, size_t /*size*/) {
+        return NULL;
+    }
+
     virtual void close() {};
 
     virtual status_t getAvailableSize(off64_t /*offset*/, off64_t * /*size*/) {
@@ -19,6 +19,7 @@
 #define MPEG4_WRITER_H_
 
 #include <stdio.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
@@ -26,8 +27,11 @@
 #include <map>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <array>
+#include <deque>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 namespace android {
 
@@ -63,11 +67,23 @@ public:
     inline size_t write(const void *ptr, size_t size, size_t nmemb);
     // Write to file system by calling ::write() or post error message to looper on failure.
     void writeOrPostError(int fd, const void *buf, size_t count);
+    // Write to file system by calling ::writev() or post error message to looper on failure.
+    void writevOrPostError(int fd, const struct iovec *iov, size_t iovcnt);
     // Seek in the file by calling ::lseek64() or post error message to looper on failure.
     void seekOrPostError(int fd, off64_t offset, int whence);
     void endBox();
     uint32_t interleaveDuration() const { return mInterleaveDurationUs; }
     status_t setInterleaveDuration(uint32_t duration);
+    uint32_t fragmentDuration() const { return mFragmentDurationUs; }
+    // Writes a fragmented file, with a moov ahead of moof/mdat fragments of at least
+    // |durationUs| each, and an mfra index at the end. Each fragment holds one track, and video
+    // fragments start at sync frames. Must be called before start(); 0 (the default) writes
+    // a regular file.
+    status_t setFragmentDuration(uint32_t durationUs);
+    // Copies the samples of each chunk into a page aligned buffer of |bytes| and writes it out
+    // in full buffers, instead of handing the sample buffers to ::writev(). Must be called
+    // before start(); 0 (the default) disables the staging buffer.
+    status_t setWriteStagingBufferSize(uint32_t bytes);
     int32_t getTimeScale() const { return mTimeScale; }
 
     status_t setGeoData(int latitudex10000, int longitudex10000);
@@ -117,6 +133,10 @@ private:
     bool mStreamableFile;
     off64_t mMoovExtraSize;
     uint32_t mInterleaveDurationUs;
+    uint32_t mFragmentDurationUs;
+    uint32_t mFragmentSequenceNumber;
+    bool mFragmentedMoovWritten;
+    off64_t mMehdOffset;  // Offset of the 'mehd' box, which gets the duration at the end.
     int32_t mTimeScale;
     int64_t mStartTimestampUs;
     int32_t mStartTimeOffsetBFramesUs;  // Longest offset needed for reordering tracks with B Frames
@@ -132,8 +152,24 @@ private:
     // Queue to hold top long write durations
     std::priority_queue<std::chrono::microseconds, std::vector<std::chrono::microseconds>,
                         std::greater<std::chrono::microseconds>> mWriteDurationPQ;
+    // Queue to hold top long chunk write durations, and the total to average them
+    std::priority_queue<std::chrono::microseconds, std::vector<std::chrono::microseconds>,
+                        std::greater<std::chrono::microseconds>> mChunkWriteDurationPQ;
+    std::chrono::microseconds mTotalChunkWriteDuration;
+    uint32_t mNumChunksWritten;
+    uint32_t mNumWriteCalls;
     const uint8_t kWriteDurationsCount = 5;
 
+    // Writes of the samples of a chunk, coalesced into as few system calls as possible.
+    // The buffers of the samples must stay valid until the batch is flushed.
+    bool mBatchingWrites;
+    std::vector<struct iovec> mWriteBatch;
+    // Copies of the NAL length prefixes and other small fields of the batch. A deque keeps
+    // the entries in place as it grows.
+    std::deque<std::array<uint8_t, 4>> mWriteBatchFields;
+    uint32_t mWriteStagingBufferSize;
+    uint8_t *mWriteStagingBuffer;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<MPEG4Writer> > mReflector;
 
@@ -160,17 +196,40 @@ private:
     int64_t estimateFileLevelMetaSize(MetaData *params);
     void writeCachedBoxToFile(const char *type);
     void printWriteDurations();
+    void addWriteDuration(std::chrono::microseconds duration);
+    void addChunkWriteDuration(std::chrono::microseconds duration);
+
+    // Batches the writes of addSample_l() until endWriteBatch().
+    void beginWriteBatch();
+    void endWriteBatch();
+    void flushWriteBatch();
+    // Writes |count| bytes, or adds them to the current batch.
+    void batchOrWrite(const void *buf, size_t count);
+    // As batchOrWrite(), but copies up to 4 bytes to the batch.
+    void batchFieldOrWrite(const void *field, size_t count);
+
+    // A sample of a fragment, as described in the 'trun' box.
+    struct FragmentSample {
+        uint32_t mSize;
+        uint32_t mDuration;           // In the track time scale
+        uint32_t mFlags;              // Sample flags, ISO/IEC 14496-12 8.8.3.1
+        int32_t  mCompositionOffset;  // In the track time scale
+    };
 
     struct Chunk {
         Track               *mTrack;        // Owner
         int64_t             mTimeStampUs;   // Timestamp of the 1st sample
         List<MediaBuffer *> mSamples;       // Sample data
 
+        // Only for a fragment of a fragmented file
+        std::vector<FragmentSample> mFragmentSamples;
+        int64_t             mBaseDecodeTicks;  // Decoding time of the 1st sample
+
         // Convenient constructor
-        Chunk(): mTrack(NULL), mTimeStampUs(0) {}
+        Chunk(): mTrack(NULL), mTimeStampUs(0), mBaseDecodeTicks(0) {}
 
         Chunk(Track *track, int64_t timeUs, List<MediaBuffer *> samples)
-            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples) {
+            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples), mBaseDecodeTicks(0) {
         }
 
     };
@@ -192,6 +251,14 @@ private:
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
 
+    // Fragmented file index, written to the 'mfra' box at the end
+    struct FragmentIndexEntry {
+        Track   *mTrack;
+        int64_t mDecodeTicks;   // Decoding time of the 1st sample of the fragment
+        off64_t mMoofOffset;
+    };
+    std::vector<FragmentIndexEntry> mFragmentIndex;
+
     // HEIF writing
     typedef key_value_pair_t< const char *, Vector<uint16_t> > ItemRefs;
     typedef struct _ItemInfo {
@@ -259,6 +326,9 @@ private:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    // Write the given fragment as a 'moof' and an 'mdat' box.
+    void writeFragmentToFile(Chunk* chunk);
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -308,6 +378,8 @@ private:
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    void writeMvexBox();
+    void writeMfraBox();
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
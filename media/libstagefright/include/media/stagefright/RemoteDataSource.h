@@ -17,6 +17,9 @@
 #ifndef REMOTE_DATA_SOURCE_H_
 #define REMOTE_DATA_SOURCE_H_
 
+#include <mutex>
+#include <set>
+
 #include <android/IDataSource.h>
 #include <binder/IMemory.h>
 #include <binder/MemoryDealer.h>
@@ -37,7 +40,24 @@ public:
         return new RemoteDataSource(source);
     }
 
+    // Returns the source |source| wraps if it is a RemoteDataSource of this process, which
+    // then reads the source directly instead of through the shared memory, and can get
+    // views of it. Returns nullptr for other sources.
+    static sp<DataSource> getLocalSource(const sp<IDataSource> &source) {
+        std::lock_guard<std::mutex> lock(sInstancesLock);
+        if (source.get() == nullptr || sInstances.count(source.get()) == 0) {
+            return nullptr;
+        }
+        RemoteDataSource *remote = static_cast<RemoteDataSource *>(source.get());
+        Mutex::Autolock sourceLock(remote->mLock);
+        return remote->mSource;
+    }
+
     virtual ~RemoteDataSource() {
+        {
+            std::lock_guard<std::mutex> lock(sInstancesLock);
+            sInstances.erase(this);
+        }
         close();
     }
     virtual sp<IMemory> getIMemory() {
@@ -82,7 +102,8 @@ public:
             ALOGE("getSize() failed, mSource is nullptr");
             return 0;
         }
-        return mSource->flags();
+        // views are only valid in this process.
+        return mSource->flags() & ~DataSourceBase::kCanProvideViews;
     }
     virtual String8 toString()  {
         return mName;
@@ -98,6 +119,10 @@ private:
     String8 mName;
     Mutex mLock;
 
+    // the RemoteDataSources of this process, for getLocalSource()
+    static inline std::mutex sInstancesLock;
+    static inline std::set<const IDataSource *> sInstances;
+
     explicit RemoteDataSource(const sp<DataSource> &source) {
         Mutex::Autolock lock(mLock);
         mSource = source;
@@ -107,6 +132,8 @@ private:
             ALOGE("Failed to allocate memory!");
         }
         mName = String8::format("RemoteDataSource(%s)", mSource->toString().string());
+        std::lock_guard<std::mutex> instancesLock(sInstancesLock);
+        sInstances.insert(this);
     }
 
     DISALLOW_EVIL_CONSTRUCTORS(RemoteDataSource);
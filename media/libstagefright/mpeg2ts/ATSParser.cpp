@@ -44,6 +44,7 @@
 #include <utils/Vector.h>
 
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 using hardware::hidl_string;
@@ -59,6 +60,8 @@ typedef hidl::memory::V1_0::IMemory TMemory;
     do { unsigned tmp = y; ALOGV(x, tmp); } while (0)
 
 static const size_t kTSPacketSize = 188;
+static const uint8_t kTSSyncByte = 0x47;
+static const size_t kNumPIDs = 0x2000;
 
 struct ATSParser::Program : public RefBase {
     Program(ATSParser *parser, unsigned programNumber, unsigned programMapPID,
@@ -77,6 +80,10 @@ struct ATSParser::Program : public RefBase {
             unsigned random_access_indicator,
             ABitReader *br, status_t *err, SyncEvent *event);
 
+    // Add the streams of this program to the PID table of the parser, for
+    // PIDs that are not already taken.
+    void addStreamsByPID(std::vector<Stream *> *streamsByPID) const;
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -345,6 +352,15 @@ bool ATSParser::Program::parsePID(
     return true;
 }
 
+void ATSParser::Program::addStreamsByPID(std::vector<Stream *> *streamsByPID) const {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        unsigned pid = mStreams.keyAt(i);
+        if (pid < streamsByPID->size() && (*streamsByPID)[pid] == NULL) {
+            (*streamsByPID)[pid] = mStreams.valueAt(i).get();
+        }
+    }
+}
+
 void ATSParser::Program::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -1874,6 +1890,7 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetUs(0LL),
       mLastRecoveredPTS(-1LL),
       mNumTSPacketsParsed(0),
+      mStreamsByPIDValid(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
     mCasManager = new CasManager();
@@ -1889,8 +1906,50 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size,
         return BAD_VALUE;
     }
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br, event);
+    return parseTS((const uint8_t *)data, event);
+}
+
+// Returns the offset of the first sync byte in |data| that is followed by
+// another one a packet later, or |size| if there is none.
+static size_t findTSPacketStart(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        // memchr() is vectorized by the C library.
+        const uint8_t *sync =
+                (const uint8_t *)memchr(data + offset, kTSSyncByte, size - offset);
+        if (sync == NULL) {
+            return size;
+        }
+        offset = sync - data;
+        if (offset + kTSPacketSize >= size || data[offset + kTSPacketSize] == kTSSyncByte) {
+            return offset;
+        }
+        ++offset;
+    }
+    return size;
+}
+
+status_t ATSParser::feedTSPackets(const void *data, size_t size, size_t *consumed) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    size_t offset = 0;
+    status_t err = OK;
+    while (offset + kTSPacketSize <= size) {
+        if (ptr[offset] != kTSSyncByte) {
+            size_t skipped = findTSPacketStart(ptr + offset, size - offset);
+            ALOGW("lost TS sync, skipping %zu bytes", skipped);
+            offset += skipped;
+            continue;
+        }
+        err = parseTS(ptr + offset, NULL /* event */);
+        if (err != OK) {
+            break;
+        }
+        offset += kTSPacketSize;
+    }
+    if (consumed != NULL) {
+        *consumed = offset;
+    }
+    return err;
 }
 
 status_t ATSParser::setMediaCas(const sp<ICas> &cas) {
@@ -2068,6 +2127,10 @@ status_t ATSParser::parsePID(
         if (!section->isCRCOkay()) {
             return BAD_VALUE;
         }
+
+        // Programs, streams and sections only change while parsing PSI.
+        mStreamsByPIDValid = false;
+
         ABitReader sectionBits(section->data(), section->size());
 
         if (PID == 0) {
@@ -2132,52 +2195,47 @@ status_t ATSParser::parsePID(
 }
 
 status_t ATSParser::parseAdaptationField(
-        ABitReader *br, unsigned PID, unsigned *random_access_indicator) {
+        const uint8_t *packet, unsigned PID, unsigned *random_access_indicator,
+        size_t *payloadOffset) {
     *random_access_indicator = 0;
-    unsigned adaptation_field_length = br->getBits(8);
+    unsigned adaptation_field_length = packet[4];
 
     if (adaptation_field_length > 0) {
-        if (adaptation_field_length * 8 > br->numBitsLeft()) {
+        if (adaptation_field_length > kTSPacketSize - 5) {
             ALOGV("Adaptation field should be included in a single TS packet.");
             return ERROR_MALFORMED;
         }
 
-        unsigned discontinuity_indicator = br->getBits(1);
+        unsigned discontinuity_indicator = packet[5] >> 7;
 
         if (discontinuity_indicator) {
             ALOGV("PID 0x%04x: discontinuity_indicator = 1 (!!!)", PID);
         }
 
-        *random_access_indicator = br->getBits(1);
+        *random_access_indicator = (packet[5] >> 6) & 1;
         if (*random_access_indicator) {
             ALOGV("PID 0x%04x: random_access_indicator = 1", PID);
         }
 
-        unsigned elementary_stream_priority_indicator = br->getBits(1);
+        unsigned elementary_stream_priority_indicator = (packet[5] >> 5) & 1;
         if (elementary_stream_priority_indicator) {
             ALOGV("PID 0x%04x: elementary_stream_priority_indicator = 1", PID);
         }
 
-        unsigned PCR_flag = br->getBits(1);
-
-        size_t numBitsRead = 4;
+        unsigned PCR_flag = (packet[5] >> 4) & 1;
 
         if (PCR_flag) {
             if (adaptation_field_length * 8 < 52) {
                 return ERROR_MALFORMED;
             }
-            br->skipBits(4);
-            uint64_t PCR_base = br->getBits(32);
-            PCR_base = (PCR_base << 1) | br->getBits(1);
-
-            br->skipBits(6);
-            unsigned PCR_ext = br->getBits(9);
+            const uint8_t *pcr = &packet[6];
+            uint64_t PCR_base = ((uint64_t)U32_AT(pcr) << 1) | (pcr[4] >> 7);
+            unsigned PCR_ext = ((pcr[4] & 1) << 8) | pcr[5];
 
             // The number of bytes from the start of the current
             // MPEG2 transport stream packet up and including
             // the final byte of this PCR_ext field.
-            size_t byteOffsetFromStartOfTSPacket =
-                (188 - br->numBitsLeft() / 8);
+            size_t byteOffsetFromStartOfTSPacket = 12;
 
             uint64_t PCR = PCR_base * 300 + PCR_ext;
 
@@ -2192,44 +2250,54 @@ status_t ATSParser::parseAdaptationField(
             for (size_t i = 0; i < mPrograms.size(); ++i) {
                 updatePCR(PID, PCR, byteOffsetFromStart);
             }
-
-            numBitsRead += 52;
         }
-
-        br->skipBits(adaptation_field_length * 8 - numBitsRead);
     }
+
+    *payloadOffset = 5 + adaptation_field_length;
     return OK;
 }
 
-status_t ATSParser::parseTS(ABitReader *br, SyncEvent *event) {
+void ATSParser::updateStreamsByPID() {
+    mStreamsByPID.assign(kNumPIDs, NULL);
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.itemAt(i)->addStreamsByPID(&mStreamsByPID);
+    }
+    // PSI sections take precedence, see parsePID().
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        mStreamsByPID[mPSISections.keyAt(i)] = NULL;
+    }
+    mStreamsByPIDValid = true;
+}
+
+status_t ATSParser::parseTS(const uint8_t *packet, SyncEvent *event) {
     ALOGV("---");
 
-    unsigned sync_byte = br->getBits(8);
-    if (sync_byte != 0x47u) {
+    unsigned sync_byte = packet[0];
+    if (sync_byte != kTSSyncByte) {
         ALOGE("[error] parseTS: return error as sync_byte=0x%x", sync_byte);
         return BAD_VALUE;
     }
 
-    if (br->getBits(1)) {  // transport_error_indicator
+    if (packet[1] & 0x80) {  // transport_error_indicator
         // silently ignore.
         return OK;
     }
 
-    unsigned payload_unit_start_indicator = br->getBits(1);
+    unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
     ALOGV("payload_unit_start_indicator = %u", payload_unit_start_indicator);
 
-    MY_LOGV("transport_priority = %u", br->getBits(1));
+    ALOGV("transport_priority = %u", (packet[1] >> 5) & 1);
 
-    unsigned PID = br->getBits(13);
+    unsigned PID = U16_AT(&packet[1]) & 0x1fff;
     ALOGV("PID = 0x%04x", PID);
 
-    unsigned transport_scrambling_control = br->getBits(2);
+    unsigned transport_scrambling_control = packet[3] >> 6;
     ALOGV("transport_scrambling_control = %u", transport_scrambling_control);
 
-    unsigned adaptation_field_control = br->getBits(2);
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
     ALOGV("adaptation_field_control = %u", adaptation_field_control);
 
-    unsigned continuity_counter = br->getBits(4);
+    unsigned continuity_counter = packet[3] & 0x0f;
     ALOGV("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
@@ -2237,16 +2305,32 @@ status_t ATSParser::parseTS(ABitReader *br, SyncEvent *event) {
     status_t err = OK;
 
     unsigned random_access_indicator = 0;
+    size_t payloadOffset = 4;
     if (adaptation_field_control == 2 || adaptation_field_control == 3) {
-        err = parseAdaptationField(br, PID, &random_access_indicator);
+        err = parseAdaptationField(packet, PID, &random_access_indicator, &payloadOffset);
     }
     if (err == OK) {
         if (adaptation_field_control == 1 || adaptation_field_control == 3) {
-            err = parsePID(br, PID, continuity_counter,
-                    payload_unit_start_indicator,
-                    transport_scrambling_control,
-                    random_access_indicator,
-                    event);
+            ABitReader br(packet + payloadOffset, kTSPacketSize - payloadOffset);
+
+            if (!mStreamsByPIDValid) {
+                updateStreamsByPID();
+            }
+            Stream *stream = mStreamsByPID[PID];
+            if (stream != NULL) {
+                err = stream->parse(
+                        continuity_counter,
+                        payload_unit_start_indicator,
+                        transport_scrambling_control,
+                        random_access_indicator,
+                        &br, event);
+            } else {
+                err = parsePID(&br, PID, continuity_counter,
+                        payload_unit_start_indicator,
+                        transport_scrambling_control,
+                        random_access_indicator,
+                        event);
+            }
         }
     }
 
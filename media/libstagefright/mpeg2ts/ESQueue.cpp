@@ -36,12 +36,74 @@
 #include <inttypes.h>
 #include <netinet/in.h>
 
+#include <algorithm>
+
 #ifdef ENABLE_CRYPTO
 #include "HlsSampleDecryptor.h"
 #endif
 
 namespace android {
 
+namespace {
+
+// An access unit referring to bytes that were already consumed from the queue's buffer.
+// It keeps that buffer alive, and the queue never moves or overwrites the bytes of a buffer
+// that is still referenced by a slice.
+struct AccessUnitSlice : public ABuffer {
+    AccessUnitSlice(const sp<ABuffer> &storage, size_t offset, size_t size)
+        : ABuffer(storage->data() + offset, size),
+          mStorage(storage) {
+    }
+
+private:
+    sp<ABuffer> mStorage;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AccessUnitSlice);
+};
+
+}  // namespace
+
+// Appends |size| bytes to the range of |buffer|. Consumed bytes at the front are reclaimed
+// by moving the remaining data only when it fills at most half of the buffer, so that each
+// byte is moved a bounded number of times. Otherwise, or if access units still refer to the
+// buffer, the data moves to a new buffer of twice the needed size.
+static void appendToBuffer(sp<ABuffer> &buffer, const void *data, size_t size) {
+    size_t bufferSize = (buffer == NULL ? 0 : buffer->size());
+    size_t neededSize = bufferSize + size;
+    if (buffer == NULL || buffer->offset() + neededSize > buffer->capacity()) {
+        if (buffer != NULL && buffer->getStrongCount() == 1
+                && neededSize <= buffer->capacity() / 2) {
+            memmove(buffer->base(), buffer->data(), bufferSize);
+            buffer->setRange(0, bufferSize);
+        } else {
+            size_t capacity = (2 * neededSize + 65535) & ~65535;
+
+            ALOGV("resizing buffer to size %zu", capacity);
+
+            sp<ABuffer> newBuffer = new ABuffer(capacity);
+            if (bufferSize > 0) {
+                memcpy(newBuffer->data(), buffer->data(), bufferSize);
+            }
+            newBuffer->setRange(0, bufferSize);
+
+            buffer = newBuffer;
+        }
+    }
+
+    memcpy(buffer->data() + buffer->size(), data, size);
+    buffer->setRange(buffer->offset(), buffer->size() + size);
+}
+
+// Drops the first |size| bytes of the range of |buffer| without moving the rest.
+static void consumeBuffer(const sp<ABuffer> &buffer, size_t size) {
+    if (size == buffer->size() && buffer->getStrongCount() == 1) {
+        // Nothing is left and no access unit refers to the buffer, rewind it.
+        buffer->setRange(0, 0);
+        return;
+    }
+    buffer->setRange(buffer->offset() + size, buffer->size() - size);
+}
+
 ElementaryStreamQueue::ElementaryStreamQueue(Mode mode, uint32_t flags)
     : mMode(mode),
       mFlags(flags),
@@ -69,13 +131,13 @@ sp<MetaData> ElementaryStreamQueue::getFormat() {
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
-        mBuffer->setRange(0, 0);
+        consumeBuffer(mBuffer, mBuffer->size());
     }
 
     mRangeInfos.clear();
 
     if (mScrambledBuffer != NULL) {
-        mScrambledBuffer->setRange(0, 0);
+        consumeBuffer(mScrambledBuffer, mScrambledBuffer->size());
     }
     mScrambledRangeInfos.clear();
 
@@ -667,25 +729,7 @@ status_t ElementaryStreamQueue::appendData(
         }
     }
 
-    size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
-
-        ALOGV("resizing buffer to size %zu", neededSize);
-
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mBuffer != NULL) {
-            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
-            buffer->setRange(0, mBuffer->size());
-        } else {
-            buffer->setRange(0, 0);
-        }
-
-        mBuffer = buffer;
-    }
-
-    memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    appendToBuffer(mBuffer, data, size);
 
     RangeInfo info;
     info.mLength = size;
@@ -713,24 +757,7 @@ void ElementaryStreamQueue::appendScrambledData(
         return;
     }
 
-    size_t neededSize = (mScrambledBuffer == NULL ? 0 : mScrambledBuffer->size()) + size;
-    if (mScrambledBuffer == NULL || neededSize > mScrambledBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
-
-        ALOGI("resizing scrambled buffer to size %zu", neededSize);
-
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mScrambledBuffer != NULL) {
-            memcpy(buffer->data(), mScrambledBuffer->data(), mScrambledBuffer->size());
-            buffer->setRange(0, mScrambledBuffer->size());
-        } else {
-            buffer->setRange(0, 0);
-        }
-
-        mScrambledBuffer = buffer;
-    }
-    memcpy(mScrambledBuffer->data() + mScrambledBuffer->size(), data, size);
-    mScrambledBuffer->setRange(0, mScrambledBuffer->size() + size);
+    appendToBuffer(mScrambledBuffer, data, size);
 
     ScrambledRangeInfo scrambledInfo;
     scrambledInfo.mLength = size;
@@ -787,9 +814,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
     // range on mBuffer. Note that the leading clear bytes includes the
     // PES header portion, while mBuffer doesn't.
     if ((int32_t)leadingClearBytes > pesOffset) {
-        mBuffer->setRange(0, leadingClearBytes - pesOffset);
+        mBuffer->setRange(mBuffer->offset(),
+                std::min(leadingClearBytes - pesOffset, mBuffer->size()));
     } else {
-        mBuffer->setRange(0, 0);
+        mBuffer->setRange(mBuffer->offset(), 0);
     }
 
     // Try to parse formats, and if unavailable set up a dummy format.
@@ -845,7 +873,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
                 0, mCasSessionId.data(), mCasSessionId.size());
     }
 
-    mBuffer->setRange(0, 0);
+    consumeBuffer(mBuffer, mBuffer->size());
 
     // copy into scrambled access unit
     sp<ABuffer> scrambledAccessUnit = ABuffer::CreateAsCopy(
@@ -865,11 +893,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
     scrambledAccessUnit->meta()->setBuffer("encBytes", encSizes);
     scrambledAccessUnit->meta()->setInt32("pesOffset", pesOffset);
 
-    memmove(mScrambledBuffer->data(),
-            mScrambledBuffer->data() + scrambledLength,
-            mScrambledBuffer->size() - scrambledLength);
-
-    mScrambledBuffer->setRange(0, mScrambledBuffer->size() - scrambledLength);
+    consumeBuffer(mScrambledBuffer, scrambledLength);
 
     ALOGV("[stream %d] dequeued scrambled AU: timeUs=%lld, size=%zu",
             mMode, (long long)timeUs, scrambledAccessUnit->size());
@@ -890,15 +914,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        consumeBuffer(mBuffer, info.mLength);
 
         if (mFormat == NULL) {
             mFormat = new MetaData;
@@ -993,18 +1012,12 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitEAC3() {
     }
     mAUIndex++;
 
-    sp<ABuffer> accessUnit = new ABuffer(syncStartPos + payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data(), syncStartPos + payloadSize);
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, syncStartPos + payloadSize);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    consumeBuffer(mBuffer, syncStartPos + payloadSize);
 
     return accessUnit;
 }
@@ -1057,18 +1070,12 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC4() {
     }
     mAUIndex++;
 
-    sp<ABuffer> accessUnit = new ABuffer(syncStartPos + payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data(), syncStartPos + payloadSize);
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, syncStartPos + payloadSize);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    consumeBuffer(mBuffer, syncStartPos + payloadSize);
     return accessUnit;
 }
 
@@ -1114,28 +1121,26 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data() + 4, payloadSize);
-
     int64_t timeUs = fetchTimestamp(payloadSize + 4);
     if (timeUs < 0LL) {
         ALOGE("Negative timeUs");
         return NULL;
     }
+
+    // The samples are swapped in place, the queue is done with these bytes.
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 4, payloadSize);
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    int16_t *ptr = (int16_t *)accessUnit->data();
+    uint8_t *ptr = accessUnit->data();
     for (size_t i = 0; i < payloadSize / sizeof(int16_t); ++i) {
-        ptr[i] = ntohs(ptr[i]);
+        uint16_t sample;
+        memcpy(&sample, ptr + i * sizeof(sample), sizeof(sample));
+        sample = ntohs(sample);
+        memcpy(ptr + i * sizeof(sample), &sample, sizeof(sample));
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
+    consumeBuffer(mBuffer, 4 + payloadSize);
 
     return accessUnit;
 }
@@ -1276,12 +1281,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
 
     int64_t timeUs = fetchTimestamp(offset);
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
-    memcpy(accessUnit->data(), mBuffer->data(), offset);
-
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, offset);
+    consumeBuffer(mBuffer, offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
@@ -1386,7 +1387,24 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+
+            // Clear nal units that are already laid out like that in the buffer, as most
+            // muxers write them, are returned as a slice of the buffer instead of a copy.
+            bool isLaidOut = (mSampleDecryptor == NULL);
+            for (size_t i = 0; isLaidOut && i < nals.size(); ++i) {
+                const NALPosition &pos = nals.itemAt(i);
+                isLaidOut = pos.nalOffset >= 4
+                        && !memcmp(mBuffer->data() + pos.nalOffset - 4, "\x00\x00\x00\x01", 4)
+                        && (i == 0 || pos.nalOffset == nals.itemAt(i - 1).nalOffset
+                                + nals.itemAt(i - 1).nalSize + 4);
+            }
+
+            sp<ABuffer> accessUnit;
+            if (isLaidOut) {
+                accessUnit = new AccessUnitSlice(mBuffer, nals.itemAt(0).nalOffset - 4, auSize);
+            } else {
+                accessUnit = new ABuffer(auSize);
+            }
             sp<ABuffer> sei;
 
             if (seiCount > 0) {
@@ -1425,7 +1443,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                 out.append(tmp);
 #endif
 
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+                if (!isLaidOut) {
+                    memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+                }
 
                 if (mSampleDecryptor != NULL && (nalType == 1 || nalType == 5)) {
                     uint8_t *nalData = mBuffer->data() + pos.nalOffset;
@@ -1449,9 +1469,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                     shrunkBytes += thisShrunkBytes;
                 }
                 else {
-                    memcpy(accessUnit->data() + dstOffset + 4,
-                            mBuffer->data() + pos.nalOffset,
-                            pos.nalSize);
+                    if (!isLaidOut) {
+                        memcpy(accessUnit->data() + dstOffset + 4,
+                                mBuffer->data() + pos.nalOffset,
+                                pos.nalSize);
+                    }
 
                     dstOffset += pos.nalSize + 4;
                     //ALOGV("dequeueAccessUnitH264 [%d] %d @%d",
@@ -1466,11 +1488,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consumeBuffer(mBuffer, nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             if (timeUs < 0LL) {
@@ -1539,7 +1557,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
                 header, &frameSize, &samplingRate, &numChannels,
                 &bitrate, &numSamples)) {
         ALOGE("Failed to get audio frame size");
-        mBuffer->setRange(0, 0);
+        consumeBuffer(mBuffer, mBuffer->size());
         return NULL;
     }
 
@@ -1549,14 +1567,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
-
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, frameSize);
+    consumeBuffer(mBuffer, frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     if (timeUs < 0LL) {
@@ -1679,11 +1691,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consumeBuffer(mBuffer, offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -1712,11 +1724,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consumeBuffer(mBuffer, offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -1752,14 +1761,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, offset);
+                consumeBuffer(mBuffer, offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0LL) {
@@ -1951,12 +1954,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, offset);
+                    consumeBuffer(mBuffer, offset);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0LL) {
@@ -1992,10 +1991,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consumeBuffer(mBuffer, offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -2022,12 +2021,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMetadata() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(size);
+    sp<ABuffer> accessUnit = new AccessUnitSlice(mBuffer, 0, size);
     int64_t timeUs = fetchTimestamp(size);
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
-    memcpy(accessUnit->data(), mBuffer->data(), size);
-    mBuffer->setRange(0, 0);
+    consumeBuffer(mBuffer, size);
 
     if (mFormat == NULL) {
         mFormat = new MetaData;
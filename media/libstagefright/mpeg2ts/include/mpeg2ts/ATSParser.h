@@ -122,6 +122,14 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Feed all the complete TS packets in data into the parser, skipping to
+    // the next sync byte whenever the data is not packet aligned. Parsing
+    // stops at the first packet that fails. If consumed is not NULL, it is set
+    // to the number of bytes before that packet, or before the trailing bytes
+    // that do not make a complete packet.
+    status_t feedTSPackets(
+            const void *data, size_t size, size_t *consumed = NULL);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -240,10 +248,18 @@ private:
         SyncEvent *event);
 
     status_t parseAdaptationField(
-            ABitReader *br, unsigned PID, unsigned *random_access_indicator);
+            const uint8_t *packet, unsigned PID, unsigned *random_access_indicator,
+            size_t *payloadOffset);
 
     // see feedTSPacket().
-    status_t parseTS(ABitReader *br, SyncEvent *event);
+    status_t parseTS(const uint8_t *packet, SyncEvent *event);
+
+    // Streams indexed by PID, for the PIDs that go straight to a stream.
+    // Rebuilt after PSI sections changed the programs.
+    std::vector<Stream *> mStreamsByPID;
+    bool mStreamsByPIDValid;
+
+    void updateStreamsByPID();
 
     void updatePCR(unsigned PID, uint64_t PCR, uint64_t byteOffsetFromStart);
 
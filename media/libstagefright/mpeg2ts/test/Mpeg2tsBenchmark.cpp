@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Mpeg2tsBenchmark"
+#include <utils/Log.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <mpeg2ts/ATSParser.h>
+#include <mpeg2ts/ESQueue.h>
+
+using namespace android;
+
+constexpr size_t kTSPacketSize = 188;
+constexpr uint8_t kTSSyncByte = 0x47;
+
+// Resource directory of Mpeg2tsUnitTest, can be changed with -P <path>.
+static std::string gRes = "/data/local/tmp/";
+
+struct PesPayload {
+    std::vector<uint8_t> data;
+    int64_t timeUs;
+};
+
+// Strips the header of a complete PES packet and adds its payload to |payloads|.
+static void addPesPayload(const std::vector<uint8_t> &pes, std::vector<PesPayload> *payloads) {
+    if (pes.size() < 9) {
+        return;
+    }
+    size_t headerSize = 9 + pes[8];
+    if (headerSize > pes.size()) {
+        return;
+    }
+    int64_t timeUs = 0;
+    if ((pes[7] & 0x80) && headerSize >= 14) {
+        const uint8_t *pts = &pes[9];
+        uint64_t ticks = ((uint64_t)(pts[0] & 0x0e) << 29) | ((uint64_t)pts[1] << 22)
+                | ((uint64_t)(pts[2] & 0xfe) << 14) | ((uint64_t)pts[3] << 7) | (pts[4] >> 1);
+        timeUs = ticks * 100 / 9;
+    }
+    payloads->push_back({std::vector<uint8_t>(pes.begin() + headerSize, pes.end()), timeUs});
+}
+
+// Collects the PES payloads of the first stream with the given |streamId| in a TS file, in
+// the units ATSParser hands them to its ElementaryStreamQueue.
+static bool readPesPayloads(const std::string &path, uint8_t streamId,
+                            std::vector<PesPayload> *payloads) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+
+    int32_t pid = -1;
+    std::vector<uint8_t> pes;
+    uint8_t packet[kTSPacketSize];
+    while (fread(packet, 1, kTSPacketSize, fp) == kTSPacketSize) {
+        if (packet[0] != kTSSyncByte) {
+            break;
+        }
+        bool payloadUnitStart = (packet[1] & 0x40) != 0;
+        int32_t packetPid = ((packet[1] & 0x1f) << 8) | packet[2];
+        unsigned adaptationFieldControl = (packet[3] >> 4) & 3;
+        size_t offset = 4;
+        if (adaptationFieldControl & 2) {
+            offset += 1 + packet[4];
+        }
+        if (!(adaptationFieldControl & 1) || offset >= kTSPacketSize) {
+            continue;
+        }
+        const uint8_t *payload = &packet[offset];
+        size_t payloadSize = kTSPacketSize - offset;
+
+        if (pid < 0 && payloadUnitStart && payloadSize >= 4 && payload[0] == 0x00
+                && payload[1] == 0x00 && payload[2] == 0x01 && payload[3] == streamId) {
+            pid = packetPid;
+        }
+        if (packetPid != pid) {
+            continue;
+        }
+        if (payloadUnitStart) {
+            addPesPayload(pes, payloads);
+            pes.clear();
+        }
+        pes.insert(pes.end(), payload, payload + payloadSize);
+    }
+    addPesPayload(pes, payloads);
+    fclose(fp);
+    return !payloads->empty();
+}
+
+// Feeds the stream with |streamId| in |fileName| through an ElementaryStreamQueue and dequeues
+// all of its access units. Up to range(0) access units are held at a time, like
+// AnotherPacketSource does until the decoder consumes them.
+static void BM_ESQueue_Throughput(benchmark::State &state, const char *fileName,
+                                  uint8_t streamId, ElementaryStreamQueue::Mode mode) {
+    std::vector<PesPayload> payloads;
+    if (!readPesPayloads(gRes + fileName, streamId, &payloads)) {
+        state.SkipWithError("Failed to read the input file");
+        return;
+    }
+    const size_t numHeldAccessUnits = state.range(0);
+
+    int64_t bytes = 0;
+    int64_t accessUnits = 0;
+    for (auto _ : state) {
+        ElementaryStreamQueue queue(mode);
+        std::deque<sp<ABuffer>> heldAccessUnits;
+        auto drain = [&]() {
+            sp<ABuffer> accessUnit;
+            while ((accessUnit = queue.dequeueAccessUnit()) != nullptr) {
+                ++accessUnits;
+                heldAccessUnits.push_back(accessUnit);
+                while (heldAccessUnits.size() > numHeldAccessUnits) {
+                    heldAccessUnits.pop_front();
+                }
+            }
+        };
+        for (const PesPayload &payload : payloads) {
+            if (queue.appendData(payload.data.data(), payload.data.size(), payload.timeUs)
+                    != OK) {
+                continue;
+            }
+            bytes += payload.data.size();
+            drain();
+        }
+        queue.signalEOS();
+        drain();
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["accessUnits"] =
+            benchmark::Counter(accessUnits, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_CAPTURE(BM_ESQueue_Throughput, H264, "crowd_1920x1080_25fps_6700kbps_h264.ts",
+                  0xe0, ElementaryStreamQueue::H264)
+        ->Arg(0)->Arg(32);
+BENCHMARK_CAPTURE(BM_ESQueue_Throughput, AAC, "segment000001.ts",
+                  0xc0, ElementaryStreamQueue::AAC)
+        ->Arg(0)->Arg(32);
+BENCHMARK_CAPTURE(BM_ESQueue_Throughput, MPEGAudio, "bbb_44100hz_2ch_128kbps_mp3_5mins.ts",
+                  0xc0, ElementaryStreamQueue::MPEG_AUDIO)
+        ->Arg(0)->Arg(32);
+
+// Reads the whole of a TS file, dropping trailing bytes that do not make a complete packet.
+static bool readTSPackets(const std::string &path, std::vector<uint8_t> *data) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    uint8_t packet[kTSPacketSize];
+    while (fread(packet, 1, kTSPacketSize, fp) == kTSPacketSize) {
+        data->insert(data->end(), packet, packet + kTSPacketSize);
+    }
+    fclose(fp);
+    return !data->empty();
+}
+
+// Demuxes |fileName| with ATSParser, one packet at a time with feedTSPacket() if range(0) is 0,
+// or all at once with feedTSPackets() otherwise.
+static void BM_ATSParser_Feed(benchmark::State &state, const char *fileName) {
+    std::vector<uint8_t> data;
+    if (!readTSPackets(gRes + fileName, &data)) {
+        state.SkipWithError("Failed to read the input file");
+        return;
+    }
+    const bool batched = state.range(0) != 0;
+
+    int64_t packets = 0;
+    for (auto _ : state) {
+        sp<ATSParser> parser = new ATSParser;
+        status_t err = OK;
+        if (batched) {
+            err = parser->feedTSPackets(data.data(), data.size());
+        } else {
+            for (size_t offset = 0; err == OK && offset < data.size(); offset += kTSPacketSize) {
+                err = parser->feedTSPacket(data.data() + offset, kTSPacketSize);
+            }
+        }
+        if (err != OK) {
+            state.SkipWithError("Failed to parse the input file");
+            return;
+        }
+        parser->signalEOS(ERROR_END_OF_STREAM);
+        packets += data.size() / kTSPacketSize;
+    }
+    state.SetBytesProcessed(packets * kTSPacketSize);
+    state.counters["packets"] = benchmark::Counter(packets, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_CAPTURE(BM_ATSParser_Feed, H264, "crowd_1920x1080_25fps_6700kbps_h264.ts")
+        ->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_ATSParser_Feed, AudioVideo, "segment000001.ts")
+        ->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_ATSParser_Feed, MPEGAudio, "bbb_44100hz_2ch_128kbps_mp3_5mins.ts")
+        ->Arg(0)->Arg(1);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-P") {
+            gRes = argv[i + 1];
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
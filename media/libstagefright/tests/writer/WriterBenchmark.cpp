@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <media/mediarecorder.h>
+#include <media/stagefright/MPEG4Writer.h>
+#include <media/stagefright/MediaAdapter.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+static const char kOutputFile[] = "/data/local/tmp/writer_benchmark.mp4";
+
+// SPS and PPS of a 240x180 AVC stream
+static const uint8_t kAvcSps[] = {
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x0d, 0xac, 0xd9, 0x41, 0x41, 0xfa, 0x10, 0x00, 0x00,
+    0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x03, 0x20, 0xf1, 0x42, 0x99, 0x60,
+};
+static const uint8_t kAvcPps[] = {
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0,
+};
+// AAC LC, 44100 Hz, stereo
+static const uint8_t kAacCsd[] = { 0x12, 0x10 };
+
+static constexpr int64_t kVideoFrameDurationUs = 16667;  // 60 fps
+static constexpr int64_t kAudioFrameDurationUs = 23220;  // 1024 samples at 44100 Hz
+static constexpr size_t kAudioFrameSize = 400;
+
+static sp<MediaAdapter> makeSource(const char *mime, bool isAudio) {
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", mime);
+    if (isAudio) {
+        format->setInt32("channel-count", 2);
+        format->setInt32("sample-rate", 44100);
+        format->setBuffer("csd-0", ABuffer::CreateAsCopy(kAacCsd, sizeof(kAacCsd)));
+    } else {
+        format->setInt32("width", 240);
+        format->setInt32("height", 180);
+        format->setBuffer("csd-0", ABuffer::CreateAsCopy(kAvcSps, sizeof(kAvcSps)));
+        format->setBuffer("csd-1", ABuffer::CreateAsCopy(kAvcPps, sizeof(kAvcPps)));
+    }
+    sp<MetaData> meta = new MetaData;
+    convertMessageToMetaData(format, meta);
+    return new MediaAdapter(meta);
+}
+
+// Builds an access unit of |numNals| start code delimited NAL units, of |size| bytes in all.
+static std::vector<uint8_t> makeAccessUnit(size_t numNals, size_t size, bool isSync) {
+    std::vector<uint8_t> data(size, 0xa5);
+    const size_t nalSize = size / numNals;
+    for (size_t i = 0; i < numNals; ++i) {
+        uint8_t *nal = data.data() + i * nalSize;
+        nal[0] = nal[1] = nal[2] = 0;
+        nal[3] = 1;
+        nal[4] = isSync ? 0x65 : 0x41;  // IDR or non-IDR slice
+    }
+    return data;
+}
+
+static status_t pushFrame(const sp<MediaAdapter> &source, const std::vector<uint8_t> &data,
+                          int64_t timeUs, bool isSync) {
+    MediaBuffer *buffer = new MediaBuffer(data.size());
+    memcpy(buffer->data(), data.data(), data.size());
+    // Released in MediaAdapter::signalBufferReturned().
+    buffer->add_ref();
+    buffer->meta_data().setInt64(kKeyTime, timeUs);
+    buffer->meta_data().setInt64(kKeyDecodingTime, timeUs);
+    if (isSync) {
+        buffer->meta_data().setInt32(kKeyIsSyncFrame, true);
+    }
+    return source->pushBuffer(buffer);
+}
+
+// Records 2 seconds of 60 fps AVC video, whose frames have range(0) NAL units each, and AAC
+// audio. The writer stages its writes in a buffer of range(1) KB, or uses writev() if 0.
+static void BM_MPEG4Writer_Record(benchmark::State& state) {
+    const size_t numNals = state.range(0);
+    const uint32_t stagingBufferSize = state.range(1) * 1024;
+    constexpr size_t kNumVideoFrames = 120;
+    constexpr size_t kVideoFrameSize = 64 * 1024;
+    const std::vector<uint8_t> syncFrame = makeAccessUnit(numNals, kVideoFrameSize, true);
+    const std::vector<uint8_t> frame = makeAccessUnit(numNals, kVideoFrameSize, false);
+    const std::vector<uint8_t> audioFrame(kAudioFrameSize, 0x21);
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        int fd = open(kOutputFile, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            state.SkipWithError("Failed to open the output file");
+            return;
+        }
+        sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+        sp<MediaAdapter> video = makeSource(MEDIA_MIMETYPE_VIDEO_AVC, false /* isAudio */);
+        sp<MediaAdapter> audio = makeSource(MEDIA_MIMETYPE_AUDIO_AAC, true /* isAudio */);
+        writer->addSource(video);
+        writer->addSource(audio);
+        writer->setWriteStagingBufferSize(stagingBufferSize);
+        sp<MetaData> meta = new MetaData;
+        meta->setInt32(kKeyFileType, output_format::OUTPUT_FORMAT_MPEG_4);
+        meta->setInt32(kKeyRealTimeRecording, false);
+        if (writer->start(meta.get()) != OK) {
+            state.SkipWithError("Failed to start the writer");
+            close(fd);
+            return;
+        }
+
+        int64_t audioTimeUs = 0;
+        for (size_t i = 0; i < kNumVideoFrames; ++i) {
+            const int64_t videoTimeUs = i * kVideoFrameDurationUs;
+            const bool isSync = (i % 60) == 0;
+            pushFrame(video, isSync ? syncFrame : frame, videoTimeUs, isSync);
+            for (; audioTimeUs <= videoTimeUs; audioTimeUs += kAudioFrameDurationUs) {
+                pushFrame(audio, audioFrame, audioTimeUs, true /* isSync */);
+                bytes += audioFrame.size();
+            }
+            bytes += frame.size();
+        }
+        video->stop();
+        audio->stop();
+        writer->stop();
+        writer.clear();
+        close(fd);
+    }
+    unlink(kOutputFile);
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_MPEG4Writer_Record)
+        ->Args({1, 0})->Args({1, 256})
+        ->Args({8, 0})->Args({8, 256})
+        ->Args({64, 0})->Args({64, 256})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -25,6 +25,7 @@
 #include <iostream>
 
 #include <media/NdkMediaExtractor.h>
+#include <media/stagefright/foundation/ByteUtils.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
@@ -300,6 +301,76 @@ int32_t WriterTest::addWriterSource(bool isAudio, configFormat params, int32_t i
     return result;
 }
 
+// Reads the header of the box at the current position of the stream.
+static bool readBoxHeader(ifstream &stream, uint64_t *size, string *type, uint32_t *headerSize) {
+    uint8_t header[16];
+    stream.read((char *)header, 8);
+    if (stream.gcount() != 8) return false;
+    *size = U32_AT(header);
+    type->assign((char *)header + 4, 4);
+    *headerSize = 8;
+    if (*size == 1) {
+        stream.read((char *)header + 8, 8);
+        if (stream.gcount() != 8) return false;
+        *size = U64_AT(header + 8);
+        *headerSize = 16;
+    }
+    return *size >= *headerSize;
+}
+
+// Checks the top level boxes of a fragmented file: a moov box with an mvex box is followed by
+// moof/mdat pairs, and the file ends with an mfra box.
+static void validateFragmentedFile(const string &fileName, int32_t *numFragments) {
+    ifstream stream(fileName, ios::binary);
+    ASSERT_TRUE(stream.is_open()) << "Failed to open " << fileName;
+
+    vector<string> types;
+    vector<uint64_t> offsets;
+    vector<uint64_t> sizes;
+    uint64_t offset = 0;
+    uint64_t size;
+    string type;
+    uint32_t headerSize;
+    while (stream.seekg(offset) && readBoxHeader(stream, &size, &type, &headerSize)) {
+        types.push_back(type);
+        offsets.push_back(offset);
+        sizes.push_back(size);
+        offset += size;
+    }
+    stream.clear();
+    stream.seekg(0, ios::end);
+    ASSERT_EQ(offset, (uint64_t)stream.tellg()) << "Boxes do not cover the whole file";
+
+    ASSERT_GE(types.size(), 5) << "Too few boxes in a fragmented file";
+    ASSERT_EQ(types[0], "ftyp");
+    ASSERT_EQ(types[1], "moov");
+    bool hasMvex = false;
+    for (uint64_t childOffset = offsets[1] + 8; childOffset < offsets[1] + sizes[1];
+         childOffset += size) {
+        stream.seekg(childOffset);
+        ASSERT_TRUE(readBoxHeader(stream, &size, &type, &headerSize)) << "Malformed moov box";
+        hasMvex |= (type == "mvex");
+    }
+    ASSERT_TRUE(hasMvex) << "No mvex box in the moov box";
+
+    *numFragments = 0;
+    for (size_t i = 2; i + 1 < types.size(); i += 2) {
+        ASSERT_EQ(types[i], "moof") << "Unexpected box at " << offsets[i];
+        ASSERT_EQ(types[i + 1], "mdat") << "Unexpected box at " << offsets[i + 1];
+        ++*numFragments;
+    }
+    ASSERT_EQ(types.back(), "mfra");
+
+    // The mfro box at the end of the mfra box records the size of the mfra box.
+    uint8_t mfro[16];
+    stream.seekg(offset - sizeof(mfro));
+    stream.read((char *)mfro, sizeof(mfro));
+    ASSERT_EQ(stream.gcount(), sizeof(mfro));
+    ASSERT_EQ(U32_AT(mfro), sizeof(mfro));
+    ASSERT_EQ(memcmp(mfro + 4, "mfro", 4), 0) << "No mfro box at the end of the file";
+    ASSERT_EQ(U32_AT(mfro + 12), sizes.back()) << "mfro does not match the size of mfra";
+}
+
 void getFileDetails(string &inputFilePath, string &info, configFormat &params, bool &isAudio,
                     inputId inpId) {
     int32_t inputDataSize = sizeof(kInputData) / sizeof(kInputData[0]);
@@ -896,6 +967,132 @@ TEST_P(WriteFunctionalityTest, Mpeg4WriterTest) {
     close(fd);
 }
 
+// Writes a fragmented file with MPEG4Writer, and reads it back with the extractor.
+TEST_P(WriteFunctionalityTest, Mpeg4FragmentedWriterTest) {
+    if (mDisableTest) return;
+    if (mWriterName != standardWriters::MPEG4) return;
+    inputId inpId[] = {get<1>(GetParam()), get<2>(GetParam())};
+    // Fragmented files do not support the image items of HEIF.
+    if (inpId[0] == HEIC_1 || inpId[1] == HEIC_1) return;
+    ALOGV("Validates the fragmented output of MPEG4 writer");
+
+    string outputFile = OUTPUT_FILE_NAME;
+    int32_t fd =
+            open(outputFile.c_str(), O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0) << "Failed to open output file to dump writer's data";
+
+    int32_t status = createWriter(fd);
+    ASSERT_EQ((status_t)OK, status) << "Failed to create writer for mpeg4 output format";
+    ASSERT_NE(inpId[0], UNUSED_ID) << "Test expects first inputId to be a valid id";
+
+    int32_t numTracks = 1;
+    if (inpId[1] != UNUSED_ID) {
+        numTracks++;
+    }
+
+    size_t fileSize[numTracks];
+    configFormat param[numTracks];
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        string inputFile = gEnv->getRes();
+        string inputInfo = gEnv->getRes();
+        bool isAudio;
+        getFileDetails(inputFile, inputInfo, param[idx], isAudio, inpId[idx]);
+        ASSERT_NE(inputFile.compare(gEnv->getRes()), 0) << "No input file specified";
+
+        struct stat buf;
+        status = stat(inputFile.c_str(), &buf);
+        ASSERT_EQ(status, 0) << "Failed to get properties of input file:" << inputFile;
+        fileSize[idx] = buf.st_size;
+
+        ASSERT_NO_FATAL_FAILURE(getInputBufferInfo(inputFile, inputInfo, idx));
+        status = addWriterSource(isAudio, param[idx], idx);
+        ASSERT_EQ((status_t)OK, status) << "Failed to add source for mpeg4 Writer";
+    }
+
+    sp<MPEG4Writer> mp4writer = static_cast<MPEG4Writer *>(mWriter.get());
+    status = mp4writer->setFragmentDuration(kDefaultFragmentDurationUs);
+    ASSERT_EQ((status_t)OK, status) << "setFragmentDuration failed";
+
+    status = mWriter->start(mFileMeta.get());
+    ASSERT_EQ((status_t)OK, status) << "Could not start the writer";
+    ASSERT_EQ((status_t)INVALID_OPERATION, mp4writer->setFragmentDuration(0))
+            << "Fragment duration changed while writing";
+
+    float interval = get<3>(GetParam());
+    int32_t loopCount = 0;
+    int32_t offset[kMaxTrackCount]{};
+    while (loopCount < ceil(1.0 / interval)) {
+        for (int32_t idx = 0; idx < numTracks; idx++) {
+            size_t range = mBufferInfo[idx].size() * interval;
+            status = sendBuffersToWriter(mInputStream[idx], mBufferInfo[idx], mInputFrameId[idx],
+                                         mCurrentTrack[idx], offset[idx], range);
+            ASSERT_EQ((status_t)OK, status) << "mpeg4 writer failed";
+            offset[idx] += range;
+        }
+        loopCount++;
+    }
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        mCurrentTrack[idx]->stop();
+    }
+    status = mWriter->stop();
+    ASSERT_EQ((status_t)OK, status) << "Failed to stop the writer";
+    mp4writer.clear();
+    close(fd);
+
+    int32_t numFragments = 0;
+    ASSERT_NO_FATAL_FAILURE(validateFragmentedFile(outputFile, &numFragments));
+    ASSERT_GE(numFragments, numTracks) << "Every track should have at least one fragment";
+
+    configFormat extractorParams[numTracks];
+    vector<BufferInfo> extractorBufferInfo[numTracks];
+    int32_t trackCount = -1;
+
+    AMediaExtractor *extractor = AMediaExtractor_new();
+    ASSERT_NE(extractor, nullptr) << "Failed to create extractor";
+    ASSERT_NO_FATAL_FAILURE(setupExtractor(extractor, outputFile, trackCount));
+    ASSERT_EQ(trackCount, numTracks)
+            << "Tracks reported by extractor does not match with input number of tracks";
+
+    // The duration of a fragmented file is in the mehd box, which is updated on stop.
+    AMediaFormat *fileFormat = AMediaExtractor_getFileFormat(extractor);
+    ASSERT_NE(fileFormat, nullptr) << "File format is NULL";
+    int64_t durationUs = 0;
+    ASSERT_TRUE(AMediaFormat_getInt64(fileFormat, AMEDIAFORMAT_KEY_DURATION, &durationUs))
+            << "Extractor did not report the duration";
+    ASSERT_GT(durationUs, 0) << "Invalid duration of a fragmented file";
+    AMediaFormat_delete(fileFormat);
+
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        char *inputBuffer = (char *)malloc(fileSize[idx]);
+        ASSERT_NE(inputBuffer, nullptr)
+                << "Failed to allocate the buffer of size " << fileSize[idx];
+        mInputStream[idx].seekg(0, mInputStream[idx].beg);
+        mInputStream[idx].read(inputBuffer, fileSize[idx]);
+        ASSERT_EQ(mInputStream[idx].gcount(), fileSize[idx]);
+
+        uint8_t *extractedBuffer = (uint8_t *)malloc(fileSize[idx]);
+        ASSERT_NE(extractedBuffer, nullptr)
+                << "Failed to allocate the buffer of size " << fileSize[idx];
+        size_t bytesExtracted = 0;
+
+        ASSERT_NO_FATAL_FAILURE(extract(extractor, extractorParams[idx], extractorBufferInfo[idx],
+                                        extractedBuffer, fileSize[idx], &bytesExtracted, idx));
+        ASSERT_GT(bytesExtracted, 0) << "Total bytes extracted by extractor cannot be zero";
+        ASSERT_EQ(extractorBufferInfo[idx].size(), mBufferInfo[idx].size())
+                << "Number of samples extracted does not match with the input";
+
+        ASSERT_NO_FATAL_FAILURE(
+                compareParams(param[idx], extractorParams[idx], extractorBufferInfo[idx], idx));
+
+        ASSERT_EQ(memcmp(extractedBuffer, (uint8_t *)inputBuffer, bytesExtracted), 0)
+                << "Extracted bit stream does not match with input bit stream";
+
+        free(inputBuffer);
+        free(extractedBuffer);
+    }
+    AMediaExtractor_delete(extractor);
+}
+
 class ListenerTest
     : public WriterTest,
       public ::testing::TestWithParam<tuple<
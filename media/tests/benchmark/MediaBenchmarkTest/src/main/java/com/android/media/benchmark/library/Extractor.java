@@ -145,11 +145,14 @@ public class Extractor {
      */
     public int extractSample(int currentTrack) {
         int status;
+        long sTime = mStats.getCurTime();
         status = selectExtractorTrack(currentTrack);
         if (status == -1) {
             Log.e(TAG, "Failed to select track");
             return -1;
         }
+        long eTime = mStats.getCurTime();
+        mStats.setTrackSetupTime(mStats.getTimeDiff(sTime, eTime));
         mStats.setStartTime();
         while (true) {
             int readSampleSize = getFrameSample();
@@ -31,6 +31,7 @@ public class Stats {
     private static final String TAG = "Stats";
     private long mInitTimeNs;
     private long mDeInitTimeNs;
+    private long mTrackSetupTimeNs;
     private long mStartTimeNs;
     private ArrayList<Integer> mFrameSizes;
     private ArrayList<Long> mInputTimer;
@@ -42,6 +43,7 @@ public class Stats {
         mOutputTimer = new ArrayList<>();
         mInitTimeNs = 0;
         mDeInitTimeNs = 0;
+        mTrackSetupTimeNs = 0;
     }
 
     public long getCurTime() { return System.nanoTime(); }
@@ -50,6 +52,8 @@ public class Stats {
 
     public void setDeInitTime(long deInitTime) { mDeInitTimeNs = deInitTime; }
 
+    public void setTrackSetupTime(long trackSetupTime) { mTrackSetupTimeNs = trackSetupTime; }
+
     public void setStartTime() { mStartTimeNs = System.nanoTime(); }
 
     public void addFrameSize(int size) { mFrameSizes.add(size); }
@@ -76,6 +80,8 @@ public class Stats {
 
     public long getDeInitTime() { return mDeInitTimeNs; }
 
+    public long getTrackSetupTime() { return mTrackSetupTimeNs; }
+
     public long getTimeDiff(long sTime, long eTime) { return (eTime - sTime); }
 
     private long getTotalTime() {
@@ -108,7 +114,7 @@ public class Stats {
                 "currentTime, fileName, operation, componentName, NDK/SDK, sync/async, setupTime, "
                         + "destroyTime, minimumTime, maximumTime, "
                         + "averageTime, timeToProcess1SecContent, totalBytesProcessedPerSec, "
-                        + "timeToFirstFrame, totalSizeInBytes, totalTime\n";
+                        + "timeToFirstFrame, totalSizeInBytes, totalTime, trackSetupTime\n";
         out.write(statsHeader.getBytes());
         out.close();
         return true;
@@ -167,7 +173,8 @@ public class Stats {
         rowData += (size * 1000000000) / totalTimeTakenNs + ", ";
         rowData += timeToFirstFrameNs + ", ";
         rowData += size + ", ";
-        rowData += totalTimeTakenNs + "\n";
+        rowData += totalTimeTakenNs + ", ";
+        rowData += mTrackSetupTimeNs + "\n";
 
         File outputFile = new File(statsFile);
         FileOutputStream out = new FileOutputStream(outputFile, true);
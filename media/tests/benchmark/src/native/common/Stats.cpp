@@ -77,7 +77,8 @@ void Stats::dumpStatistics(string operation, string inputReference, int64_t dura
     rowData.append(to_string(bytesPerSec) + ", ");
     rowData.append(to_string(timeToFirstFrameNs) + ", ");
     rowData.append(to_string(size) + ",");
-    rowData.append(to_string(totalTimeTakenNs) + ",\n");
+    rowData.append(to_string(totalTimeTakenNs) + ",");
+    rowData.append(to_string(mTrackSetupTimeNs) + ",\n");
 
     ofstream out(statsFile, ios::out | ios::app);
     if(out.bad()) {
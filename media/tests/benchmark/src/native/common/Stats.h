@@ -54,6 +54,7 @@ class Stats {
     Stats() {
         mInitTimeNs = 0;
         mDeInitTimeNs = 0;
+        mTrackSetupTimeNs = 0;
     }
 
     ~Stats() {
@@ -63,6 +64,7 @@ class Stats {
   private:
     nsecs_t mInitTimeNs;
     nsecs_t mDeInitTimeNs;
+    nsecs_t mTrackSetupTimeNs;
     nsecs_t mStartTimeNs;
     std::vector<int32_t> mFrameSizes;
     std::vector<nsecs_t> mInputTimer;
@@ -75,6 +77,8 @@ class Stats {
 
     void setDeInitTime(nsecs_t deInitTime) { mDeInitTimeNs = deInitTime; }
 
+    void setTrackSetupTime(nsecs_t trackSetupTime) { mTrackSetupTimeNs = trackSetupTime; }
+
     void setStartTime() { mStartTimeNs = systemTime(CLOCK_MONOTONIC); }
 
     void addFrameSize(int32_t size) { mFrameSizes.push_back(size); }
@@ -95,6 +99,8 @@ class Stats {
 
     nsecs_t getDeInitTime() { return mDeInitTimeNs; }
 
+    nsecs_t getTrackSetupTime() { return mTrackSetupTimeNs; }
+
     nsecs_t getTimeDiff(nsecs_t sTime, nsecs_t eTime) { return (eTime - sTime); }
 
     nsecs_t getTotalTime() {
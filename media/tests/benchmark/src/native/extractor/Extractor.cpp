@@ -82,8 +82,12 @@ int32_t Extractor::setupTrackFormat(int32_t trackId) {
 }
 
 int32_t Extractor::extract(int32_t trackId) {
+    // Selecting the track may parse its sample tables, which is reported on its own.
+    int64_t sTime = mStats->getCurTime();
     int32_t status = setupTrackFormat(trackId);
     if (status != AMEDIA_OK) return status;
+    int64_t eTime = mStats->getCurTime();
+    mStats->setTrackSetupTime(mStats->getTimeDiff(sTime, eTime));
 
     int32_t idx = 0;
     AMediaCodecBufferInfo frameInfo;
@@ -88,7 +88,8 @@ bool BenchmarkTestEnvironment::writeStatsHeader() {
     char statsHeader[] =
         "currentTime, fileName, operation, componentName, NDK/SDK, sync/async, setupTime, "
         "destroyTime, minimumTime, maximumTime, averageTime, timeToProcess1SecContent, "
-        "totalBytesProcessedPerSec, timeToFirstFrame, totalSizeInBytes, totalTime\n";
+        "totalBytesProcessedPerSec, timeToFirstFrame, totalSizeInBytes, totalTime, "
+        "trackSetupTime\n";
     FILE *fpStats = fopen(statsFile.c_str(), "w");
     if(!fpStats) {
         return false;
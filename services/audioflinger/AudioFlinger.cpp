@@ -60,6 +60,7 @@
 #include "NBAIO_Tee.h"
 #include "PropertyUtils.h"
 
+#include <media/AudioResampler.h>
 #include <media/AudioResamplerPublic.h>
 
 #include <system/audio_effects/effect_visualizer.h>
@@ -793,6 +794,14 @@ void AudioFlinger::dumpInternals(int fd, const Vector<String16>& args __unused)
                             hardwareStatus,
                             (uint32_t)(mStandbyTimeInNsecs / 1000000));
     result.append(buffer);
+
+    const AudioResampler::FilterCacheStats filterCacheStats =
+            AudioResampler::getFilterCacheStats();
+    result.appendFormat("Resampler filter cache: hits %llu  misses %llu"
+            "  filter banks %zu  bytes %zu\n",
+            (unsigned long long)filterCacheStats.hits,
+            (unsigned long long)filterCacheStats.misses,
+            filterCacheStats.filterBanks, filterCacheStats.bytes);
     write(fd, result.string(), result.size());
 }
 
@@ -301,6 +301,15 @@ static void sFastTrackMultiplierInit()
     }
 }
 
+// Number of threads the normal mixer uses to mix tracks, see AudioMixer::setThreadCount().
+// Mixing on more than one thread is opt-in, for devices with many simultaneous tracks.
+static size_t getMixerThreadCount()
+{
+    static const int32_t threadCount =
+            property_get_int32("af.mixer.threads", 1 /* default_value */);
+    return threadCount > 1 ? threadCount : 1;
+}
+
 // ----------------------------------------------------------------------------
 
 #ifdef ADD_BATTERY_DATA
@@ -4801,6 +4810,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    mAudioMixer->setThreadCount(getMixerThreadCount());
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -6113,6 +6123,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            mAudioMixer->setThreadCount(getMixerThreadCount());
             for (const auto &track : mTracks) {
                 const int trackId = track->id();
                 status_t status = mAudioMixer->create(
@@ -6139,6 +6150,11 @@ void AudioFlinger::MixerThread::dumpInternals_l(int fd, const Vector<String16>&
     PlaybackThread::dumpInternals_l(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: %s\n", mAudioMixer->trackNames().c_str());
+    const AudioMixer::SilenceStats silenceStats = mAudioMixer->getSilenceStats();
+    dprintf(fd, "  AudioMixer silent tracks skipped: %u last period, %.2f per period\n",
+            silenceStats.lastSkippedTracks,
+            silenceStats.periods > 0
+                    ? (double)silenceStats.skippedTracks / silenceStats.periods : 0.);
     dprintf(fd, "  Master mono: %s\n", mMasterMono ? "on" : "off");
     dprintf(fd, "  Master balance: %f (%s)\n", mMasterBalance.load(),
             (hasFastMixer() ? std::to_string(mFastMixer->getMasterBalance())
@@ -43,7 +43,12 @@ MediaExtractorService::~MediaExtractorService() {
         ::android::sp<::android::IMediaExtractor>* _aidl_return) {
     ALOGV("@@@ MediaExtractorService::makeExtractor for %s", mime ? mime->c_str() : nullptr);
 
-    sp<DataSource> localSource = CreateDataSourceFromIDataSource(remoteSource);
+    // The sources made by makeIDataSource() are read directly, which lets the extractor use
+    // views of a mapped file.
+    sp<DataSource> localSource = RemoteDataSource::getLocalSource(remoteSource);
+    if (localSource == nullptr) {
+        localSource = CreateDataSourceFromIDataSource(remoteSource);
+    }
 
     MediaBuffer::useSharedMemory();
     sp<IMediaExtractor> extractor = MediaExtractorFactory::CreateFromService(